@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "AsteroidField.h"
+
+#include "ConfigurationGenerator.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace
+{
+    // Instances per job of Update().
+    const size_t UpdateChunk = 4096;
+    // Random values drawn per instance.
+    const uint64_t ValuesPerInstance = 10;
+
+    float UnitFloat(uint64_t value)
+    {
+        return static_cast<float>(value >> 40) * (1.0f / 16777216.0f);
+    }
+}
+
+AsteroidField::AsteroidField(const AsteroidFieldSettings& settings) :
+    settings(settings)
+{
+    if (settings.templateCount < 1)
+        throw "Asteroid field needs at least one template!";
+
+    size_t count = settings.instanceCount;
+    orbits.Reserve(count);
+
+    // Templates get equal shares, the rocks of one template follow each other.
+    templateFirst.resize(settings.templateCount + 1);
+    for (int t = 0; t <= settings.templateCount; t++)
+        templateFirst[t] = count * t / settings.templateCount;
+
+    float innerSquared = settings.innerRadius * settings.innerRadius;
+    float outerSquared = settings.outerRadius * settings.outerRadius;
+    for (size_t i = 0; i < count; i++) {
+        float u[ValuesPerInstance];
+        for (uint64_t v = 0; v < ValuesPerInstance; v++)
+            u[v] = UnitFloat(ConfigurationGenerator::CounterRandom(settings.seed, i * ValuesPerInstance + v));
+
+        OrbitBody body;
+        // Uniform over the area of the belt, thinner towards its top and bottom.
+        body.radius = std::sqrt(innerSquared + (outerSquared - innerSquared) * u[0]);
+        body.phase = u[1] * DirectX::XM_2PI;
+        body.angularVelocity = settings.orbitalSpeed * std::pow(settings.innerRadius / body.radius, 1.5f);
+        body.height = (u[2] + u[3] - 1.0f) * settings.thickness;
+        body.scale = settings.scale.min + (settings.scale.max - settings.scale.min) * u[4] * u[4];
+
+        // The orbit plane is tilted a little away from the one of the belt.
+        float tilt = u[8] * settings.inclination;
+        float tiltDirection = u[9] * DirectX::XM_2PI;
+        body.inclinationAxis = DirectX::XMFLOAT3(std::sin(tilt) * std::cos(tiltDirection), std::cos(tilt), std::sin(tilt) * std::sin(tiltDirection));
+
+        float z = u[5] * 2.0f - 1.0f;
+        float azimuth = u[6] * DirectX::XM_2PI;
+        float ring = std::sqrt(1.0f - z * z);
+        body.spinAxis = DirectX::XMFLOAT3(ring * std::cos(azimuth), ring * std::sin(azimuth), z);
+        body.spinPhase = u[1] * 7.0f;
+        body.spinVelocity = (u[7] * 2.0f - 1.0f) * settings.maxSpin;
+        orbits.AddBody(body);
+    }
+}
+
+void AsteroidField::Update(double time, InstanceTransform* instances) const
+{
+    // Chunks are a multiple of OrbitSimulation::Width, so every one of them takes the vector path.
+    size_t count = GetInstanceCount();
+    size_t chunks = (count + UpdateChunk - 1) / UpdateChunk;
+    ThreadPool::GetInstance()->ParallelFor(chunks, [&](size_t chunk) {
+        size_t first = chunk * UpdateChunk;
+        size_t last = std::min(count, (chunk + 1) * UpdateChunk);
+        orbits.Update(time, first, last, instances);
+        if (!useGravity)
+            return;
+        // Spin from the orbits, positions from the gravity simulation.
+        for (size_t i = first; i < last; i++) {
+            DirectX::XMFLOAT3 position = gravity.GetPosition(i);
+            instances[i].rows[0].w = position.x;
+            instances[i].rows[1].w = position.y;
+            instances[i].rows[2].w = position.z;
+        }
+    });
+}
+
+void AsteroidField::Update(double time, const DirectX::XMFLOAT3* from, const DirectX::XMFLOAT3* to, float alpha, InstanceTransform* instances) const
+{
+    size_t count = GetInstanceCount();
+    size_t chunks = (count + UpdateChunk - 1) / UpdateChunk;
+    ThreadPool::GetInstance()->ParallelFor(chunks, [&](size_t chunk) {
+        size_t first = chunk * UpdateChunk;
+        size_t last = std::min(count, (chunk + 1) * UpdateChunk);
+        orbits.Update(time, first, last, instances);
+        if (to == nullptr)
+            return;
+        for (size_t i = first; i < last; i++) {
+            instances[i].rows[0].w = from[i].x + (to[i].x - from[i].x) * alpha;
+            instances[i].rows[1].w = from[i].y + (to[i].y - from[i].y) * alpha;
+            instances[i].rows[2].w = from[i].z + (to[i].z - from[i].z) * alpha;
+        }
+    });
+}
+
+float AsteroidField::GetStarMass() const
+{
+    // Circular speed at the inner radius is orbitalSpeed * innerRadius, so GM = v^2 * r.
+    return settings.orbitalSpeed * settings.orbitalSpeed * settings.innerRadius * settings.innerRadius * settings.innerRadius;
+}
+
+void AsteroidField::EnableGravity(double time, const NBodySettings& gravitySettings)
+{
+    size_t count = GetInstanceCount();
+    float rockMass = count > 0 ? GetStarMass() * settings.beltMass / count : 0.0f;
+
+    gravity = NBodySimulation(gravitySettings);
+    gravity.Reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        DirectX::XMFLOAT3 position, velocity;
+        orbits.GetState(time, i, position, velocity);
+        gravity.AddBody(position, velocity, rockMass);
+    }
+    useGravity = true;
+}
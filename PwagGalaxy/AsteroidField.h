@@ -0,0 +1,63 @@
+#pragma once
+
+#include "OrbitSimulation.h"
+#include "NBodySimulation.h"
+
+struct AsteroidFieldSettings
+{
+    uint64_t seed = 1;
+    size_t instanceCount = 100000;
+    int templateCount = 8;          // Template meshes, every rock is drawn with one of them.
+    int templateResolution = 10;    // Grid of a template face, low since every vertex is drawn per instance.
+    float innerRadius = 2.0f;
+    float outerRadius = 5.0f;
+    float thickness = 0.15f;        // Half height of the belt.
+    float inclination = 0.05f;      // Largest tilt of an orbit plane against the belt, in radians.
+    struct { float min, max; } scale = { 0.01f, 0.04f };
+    float orbitalSpeed = 0.2f;      // Radians per second at the inner radius, slower outwards (Kepler's third law).
+    float maxSpin = 1.5f;           // Radians per second.
+    float beltMass = 1e-4f;         // Mass of all rocks together against the one of the star, for the gravity mode.
+};
+
+// A belt of rocks around the star, drawn with a few template meshes instead of one object per rock.
+// The orbits are an OrbitSimulation, sorted by template so the transforms of one template are
+// contiguous and it takes a single instanced draw.
+// Optionally the rocks are handed over to an NBodySimulation, then they move under the gravity of the
+// star, the planets and each other and only their spin is still taken from the orbits.
+class AsteroidField
+{
+public:
+    AsteroidField() = default;
+    explicit AsteroidField(const AsteroidFieldSettings& settings);
+
+    // Write the transforms of every instance at the given time (instances in parallel).
+    void Update(double time, InstanceTransform* instances) const;
+    // Same with the positions of the gravity mode interpolated between two states by alpha (null for the
+    // orbit positions). Only reads the orbits, so it can run while another thread advances the gravity.
+    void Update(double time, const DirectX::XMFLOAT3* from, const DirectX::XMFLOAT3* to, float alpha, InstanceTransform* instances) const;
+
+    size_t GetInstanceCount() const { return orbits.GetBodyCount(); }
+    int GetTemplateCount() const { return settings.templateCount; }
+    // Instances of a template are [GetFirstInstance(t), GetFirstInstance(t) + GetInstanceCount(t)).
+    size_t GetFirstInstance(int templateIndex) const { return templateFirst[templateIndex]; }
+    size_t GetInstanceCount(int templateIndex) const { return templateFirst[templateIndex + 1] - templateFirst[templateIndex]; }
+    const AsteroidFieldSettings& GetSettings() const { return settings; }
+
+    const OrbitSimulation& GetOrbits() const { return orbits; }
+
+    // Start the gravity mode from the orbit positions and velocities at the given time.
+    void EnableGravity(double time, const NBodySettings& gravitySettings);
+    void DisableGravity() { useGravity = false; }
+    bool UsesGravity() const { return useGravity; }
+    NBodySimulation& GetGravity() { return gravity; }
+    const NBodySimulation& GetGravity() const { return gravity; }
+    // Mass of the star at the origin that keeps the orbits of the field circular.
+    float GetStarMass() const;
+
+private:
+    AsteroidFieldSettings settings;
+    OrbitSimulation orbits;
+    std::vector<size_t> templateFirst;  // templateCount + 1 entries.
+    NBodySimulation gravity;
+    bool useGravity = false;
+};
@@ -0,0 +1,85 @@
+#include "stdafx.h"
+#include "BakedPlanetMaterial.h"
+
+std::vector<D3D12_ROOT_PARAMETER> BakedPlanetMaterial::CreateRootParameters()
+{
+    // Create the root descriptor (for wvp matrices)
+    D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
+    rootCBVDescriptor.ShaderRegister = 0; // b0 in shader
+    rootCBVDescriptor.RegisterSpace = 0;
+
+    // Create another root descriptor (for lighting parameters)
+    D3D12_ROOT_DESCRIPTOR lightingCBVDescriptor;
+    lightingCBVDescriptor.ShaderRegister = 1; // b1 in shader
+    lightingCBVDescriptor.RegisterSpace = 0;
+
+    // The tint texture shared with the lit material.
+    descriptorTableTintRanges.resize(1);
+    descriptorTableTintRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    descriptorTableTintRanges[0].NumDescriptors = 1;
+    descriptorTableTintRanges[0].BaseShaderRegister = 0; // t0 in shader
+    descriptorTableTintRanges[0].RegisterSpace = 0;
+    descriptorTableTintRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+    D3D12_ROOT_DESCRIPTOR_TABLE descriptorTableTint;
+    descriptorTableTint.NumDescriptorRanges = descriptorTableTintRanges.size();
+    descriptorTableTint.pDescriptorRanges = descriptorTableTintRanges.data();
+
+    // The normal and colour cube maps of the body, next to each other in the heap.
+    descriptorTableCubeMapRanges.resize(1);
+    descriptorTableCubeMapRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    descriptorTableCubeMapRanges[0].NumDescriptors = 2;
+    descriptorTableCubeMapRanges[0].BaseShaderRegister = 1; // t1 and t2 in shader
+    descriptorTableCubeMapRanges[0].RegisterSpace = 0;
+    descriptorTableCubeMapRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+    D3D12_ROOT_DESCRIPTOR_TABLE descriptorTableCubeMaps;
+    descriptorTableCubeMaps.NumDescriptorRanges = descriptorTableCubeMapRanges.size();
+    descriptorTableCubeMaps.pDescriptorRanges = descriptorTableCubeMapRanges.data();
+
+    rootParameters.resize(4);
+    // WVP matrix (the pixel shader needs the world and view matrices for the sampled normals).
+    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    rootParameters[0].Descriptor = rootCBVDescriptor;
+    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_ALL;
+
+    // Lighting parameters.
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    rootParameters[1].Descriptor = lightingCBVDescriptor;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    // Tint texture.
+    rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[2].DescriptorTable = descriptorTableTint;
+    rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    // Cube maps.
+    rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[3].DescriptorTable = descriptorTableCubeMaps;
+    rootParameters[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    return rootParameters;
+}
+
+D3D12_STATIC_SAMPLER_DESC BakedPlanetMaterial::CreateSampler()
+{
+    // Filtered lookups, the cube faces are seamless so clamping is enough.
+    D3D12_STATIC_SAMPLER_DESC sampler = Material::CreateSampler();
+    sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+    sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+
+    return sampler;
+}
+
+D3D12_ROOT_SIGNATURE_FLAGS BakedPlanetMaterial::CreateRootSignatureFlags()
+{
+    D3D12_ROOT_SIGNATURE_FLAGS flags = (
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
+
+    return flags;
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include "Material.h"
+
+// Lit material for bodies drawn with their baked cube maps (see PlanetBake). The surface normal and
+// colour come from the cube maps instead of the vertices, so a coarse mesh keeps the detail.
+class BakedPlanetMaterial : public Material
+{
+public:
+    BakedPlanetMaterial() = default;
+
+private:
+    std::vector<D3D12_DESCRIPTOR_RANGE> descriptorTableTintRanges;
+    std::vector<D3D12_DESCRIPTOR_RANGE> descriptorTableCubeMapRanges;
+    std::vector<D3D12_ROOT_PARAMETER> rootParameters;
+
+    virtual std::vector<D3D12_ROOT_PARAMETER> CreateRootParameters();
+    virtual D3D12_STATIC_SAMPLER_DESC CreateSampler();
+    virtual D3D12_ROOT_SIGNATURE_FLAGS CreateRootSignatureFlags();
+};
@@ -0,0 +1,2139 @@
+#include "stdafx.h"
+#include "Benchmarks.h"
+
+#include "AsteroidField.h"
+#include "BoundingVolumeHierarchy.h"
+#include "ConfigurationGenerator.h"
+#include "EntityWorld.h"
+#include "FrustumCuller.h"
+#include "Galaxy.h"
+#include "GalaxyDatabase.h"
+#include "GenerationWorkers.h"
+#include "KeplerOrbit.h"
+#include "NBodySimulation.h"
+#include "OrbitSimulation.h"
+#include "PlanetRing.h"
+#include "PlanetSurfaceQuery.h"
+#include "RenderThread.h"
+#include "SceneSystems.h"
+#include "SimulationLoop.h"
+#include "SunAnimation.h"
+#include "ThreadPool.h"
+#include "TransformBatch.h"
+#include "TransformHierarchy.h"
+#include <chrono>
+#include <functional>
+#include <random>
+
+namespace
+{
+    double SecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Uniformly distributed unit directions, fixed seed so runs are comparable.
+    std::vector<DirectX::XMFLOAT3> RandomDirections(size_t count, unsigned int seed)
+    {
+        std::mt19937 generator(seed);
+        std::normal_distribution<float> distribution(0.0f, 1.0f);
+        std::vector<DirectX::XMFLOAT3> directions(count);
+        for (DirectX::XMFLOAT3& direction : directions) {
+            DirectX::XMVECTOR d = DirectX::XMVectorSet(distribution(generator), distribution(generator), distribution(generator), 0.0f);
+            DirectX::XMStoreFloat3(&direction, DirectX::XMVector3Normalize(d));
+        }
+        return directions;
+    }
+
+    // A unit vector perpendicular to a unit direction.
+    DirectX::XMFLOAT3 PerpendicularTo(const DirectX::XMFLOAT3& direction)
+    {
+        DirectX::XMVECTOR d = DirectX::XMLoadFloat3(&direction);
+        DirectX::XMVECTOR reference = std::abs(direction.x) < 0.9f ? DirectX::XMVectorSet(1, 0, 0, 0) : DirectX::XMVectorSet(0, 1, 0, 0);
+        DirectX::XMFLOAT3 perpendicular;
+        DirectX::XMStoreFloat3(&perpendicular, DirectX::XMVector3Normalize(DirectX::XMVector3Cross(reference, d)));
+        return perpendicular;
+    }
+}
+
+bool EngineBenchmarks::Run(const std::string& name)
+{
+    bool all = name == "all";
+    bool found = false;
+
+    if (all || name == "surface") {
+        SurfaceQueries();
+        found = true;
+    }
+
+    if (all || name == "craters") {
+        CraterFields();
+        found = true;
+    }
+
+    if (all || name == "erosion") {
+        Erosion();
+        found = true;
+    }
+
+    if (all || name == "sun") {
+        SunAnimations();
+        found = true;
+    }
+
+    if (all || name == "noise") {
+        NoiseTiers();
+        found = true;
+    }
+
+    if (all || name == "seeds") {
+        SeedDerivations();
+        found = true;
+    }
+
+    if (all || name == "batch") {
+        ConfigurationBatches();
+        found = true;
+    }
+
+    if (all || name == "galaxy") {
+        GalaxyStreaming();
+        found = true;
+    }
+
+    if (all || name == "database") {
+        GalaxyDatabaseQueries();
+        found = true;
+    }
+
+    if (all || name == "workers") {
+        GenerationWorkers();
+        found = true;
+    }
+
+    if (all || name == "asteroids") {
+        AsteroidFields();
+        found = true;
+    }
+
+    if (all || name == "orbits") {
+        OrbitUpdates();
+        found = true;
+    }
+
+    if (all || name == "nbody") {
+        NBodyGravity();
+        found = true;
+    }
+
+    if (all || name == "rings") {
+        PlanetRings();
+        found = true;
+    }
+
+    if (all || name == "entities") {
+        EntityUpdates();
+        found = true;
+    }
+
+    if (all || name == "transforms") {
+        TransformBatches();
+        found = true;
+    }
+
+    if (all || name == "scene") {
+        SceneUpdateScaling();
+        found = true;
+    }
+
+    if (all || name == "dirty") {
+        DirtyTracking();
+        found = true;
+    }
+
+    if (all || name == "kepler") {
+        KeplerOrbits();
+        found = true;
+    }
+
+    if (all || name == "simulation") {
+        SimulationThread();
+        found = true;
+    }
+
+    if (all || name == "renderthread") {
+        RenderThreadOverlap();
+        found = true;
+    }
+
+    if (all || name == "hierarchy") {
+        HierarchyPropagation();
+        found = true;
+    }
+
+    if (all || name == "bvh") {
+        BoundingVolumes();
+        found = true;
+    }
+
+    if (all || name == "culling") {
+        FrustumCulling();
+        found = true;
+    }
+
+    if (!found)
+        std::cout << "Unknown benchmark '" << name << "'." << std::endl;
+    return found;
+}
+
+void EngineBenchmarks::SurfaceQueries()
+{
+    std::cout << "--- Surface queries ---" << std::endl;
+
+    ConfigurationGenerator generator;
+    PlanetConfiguration planetDescription = generator.GeneratePlanetConfiguration("bench001", 3.0f, DirectX::XMFLOAT3(0, 0, 0));
+    std::shared_ptr<PlanetTerrain> terrain = std::make_shared<PlanetTerrain>(planetDescription, 1);
+
+    std::shared_ptr<PlanetBake> bake = std::make_shared<PlanetBake>();
+    auto start = std::chrono::steady_clock::now();
+    bake->Bake(*terrain, 256);
+    std::cout << "Bake 6x256x256: " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+
+    PlanetSurfaceQuery baked(terrain, bake);
+    PlanetSurfaceQuery exact(terrain, nullptr);
+
+    const size_t queryCount = 1 << 20;
+    std::vector<DirectX::XMFLOAT3> directions = RandomDirections(queryCount, 42);
+    std::vector<float> heights(queryCount);
+    std::vector<DirectX::XMFLOAT3> normals(queryCount);
+
+    start = std::chrono::steady_clock::now();
+    baked.Heights(directions.data(), heights.data(), queryCount);
+    double seconds = SecondsSince(start);
+    std::cout << "Baked heights:  " << queryCount / seconds / 1e6 << " M queries/s" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    baked.Normals(directions.data(), normals.data(), queryCount);
+    seconds = SecondsSince(start);
+    std::cout << "Baked normals:  " << queryCount / seconds / 1e6 << " M queries/s" << std::endl;
+
+    // Batches from several threads at once, as physics and AI would issue them.
+    const size_t batchSize = 4096;
+    start = std::chrono::steady_clock::now();
+    ThreadPool::GetInstance()->ParallelFor(queryCount / batchSize, [&](size_t batch) {
+        baked.Heights(&directions[batch * batchSize], &heights[batch * batchSize], batchSize);
+    });
+    seconds = SecondsSince(start);
+    std::cout << "Baked heights, " << ThreadPool::GetInstance()->GetThreadCount() << " threads: " << queryCount / seconds / 1e6 << " M queries/s" << std::endl;
+
+    // The exact path is much slower, measure it on a subset.
+    const size_t exactCount = queryCount / 16;
+    std::vector<float> exactHeights(exactCount);
+    start = std::chrono::steady_clock::now();
+    exact.Heights(directions.data(), exactHeights.data(), exactCount);
+    seconds = SecondsSince(start);
+    std::cout << "Exact heights:  " << exactCount / seconds / 1e6 << " M queries/s" << std::endl;
+
+    float maxHeightError = 0.0f;
+    double heightErrorSum = 0.0;
+    float maxNormalError = 0.0f;
+    double normalErrorSum = 0.0;
+    const size_t normalCount = exactCount / 16;
+    for (size_t i = 0; i < exactCount; i++) {
+        float error = std::abs(heights[i] - exactHeights[i]);
+        maxHeightError = std::max(maxHeightError, error);
+        heightErrorSum += error;
+
+        if (i < normalCount) {
+            DirectX::XMFLOAT3 exactNormal = exact.ExactNormal(directions[i]);
+            float cosine = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMLoadFloat3(&exactNormal), DirectX::XMLoadFloat3(&normals[i])));
+            float angle = std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 180.0f / DirectX::XM_PI;
+            maxNormalError = std::max(maxNormalError, angle);
+            normalErrorSum += angle;
+        }
+    }
+    std::cout << "Height error (planet radii): max " << maxHeightError << ", mean " << heightErrorSum / exactCount << std::endl;
+    std::cout << "Normal error (degrees): max " << maxNormalError << ", mean " << normalErrorSum / normalCount << std::endl;
+}
+
+void EngineBenchmarks::CraterFields()
+{
+    std::cout << "--- Crater fields ---" << std::endl;
+
+    ConfigurationGenerator generator;
+    PlanetConfiguration asteroidDescription = generator.GeneratePlanetConfiguration("asteroidabench", 3.0f, DirectX::XMFLOAT3(0, 0, 0));
+    // The vertices of one asteroid mesh.
+    std::vector<DirectX::XMFLOAT3> directions = RandomDirections(6 * 40 * 40, 7);
+    std::vector<float> hashed(directions.size());
+    std::vector<float> bruteForce(directions.size());
+
+    const int craterCounts[] = { 50, 200, 800, 3200 };
+    for (int craterCount : craterCounts) {
+        PlanetCraterSettings settings;
+        settings.count = { craterCount, craterCount };
+        CraterField field(generator.GenerateCraterConfiguration(asteroidDescription.seed, settings), asteroidDescription.seed);
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < directions.size(); i++)
+            hashed[i] = field.Evaluate(directions[i]);
+        double hashedSeconds = SecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < directions.size(); i++)
+            bruteForce[i] = field.EvaluateBruteForce(directions[i]);
+        double bruteForceSeconds = SecondsSince(start);
+
+        float maxDifference = 0.0f;
+        for (size_t i = 0; i < directions.size(); i++)
+            maxDifference = std::max(maxDifference, std::abs(hashed[i] - bruteForce[i]));
+
+        std::cout << craterCount << " craters, " << directions.size() << " vertices: hashed " << hashedSeconds * 1000.0
+            << " ms, brute force " << bruteForceSeconds * 1000.0 << " ms, max difference " << maxDifference << std::endl;
+    }
+}
+
+void EngineBenchmarks::Erosion()
+{
+    std::cout << "--- Erosion ---" << std::endl;
+
+    ConfigurationGenerator generator;
+    PlanetConfiguration planetDescription = generator.GeneratePlanetConfiguration("bench001", 3.0f, DirectX::XMFLOAT3(0, 0, 0));
+    PlanetTerrain terrain(planetDescription, 1);
+    const int resolution = 256;
+
+    PlanetBake plain;
+    auto start = std::chrono::steady_clock::now();
+    plain.Bake(terrain, resolution);
+    std::cout << "Bake without erosion: " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+
+    ErosionSettings erosion;
+    erosion.enabled = true;
+    erosion.seed = 1;
+
+    PlanetBake eroded;
+    start = std::chrono::steady_clock::now();
+    eroded.Bake(terrain, resolution, erosion);
+    std::cout << "Bake with erosion:    " << SecondsSince(start) * 1000.0 << " ms ("
+        << erosion.hydraulicPasses << " hydraulic passes, " << erosion.thermalIterations << " thermal iterations, "
+        << ThreadPool::GetInstance()->GetThreadCount() << " threads)" << std::endl;
+
+    // A second run has to match the first texel for texel.
+    PlanetBake repeated;
+    repeated.Bake(terrain, resolution, erosion);
+
+    float maxChange = 0.0f;
+    double changeSum = 0.0;
+    int mismatches = 0;
+    for (int face = 0; face < PlanetBake::FaceCount; face++) {
+        for (int y = 0; y < resolution; y++) {
+            for (int x = 0; x < resolution; x++) {
+                float height = eroded.GetTexelHeight(face, x, y);
+                float change = std::abs(height - plain.GetTexelHeight(face, x, y));
+                maxChange = std::max(maxChange, change);
+                changeSum += change;
+                if (height != repeated.GetTexelHeight(face, x, y))
+                    mismatches++;
+            }
+        }
+    }
+    std::cout << "Elevation change max " << maxChange << " mean " << changeSum / (PlanetBake::FaceCount * resolution * resolution)
+        << ", texels differing between runs: " << mismatches << std::endl;
+
+    // A time budget below what the passes take cuts them short and says so.
+    ErosionSettings capped = erosion;
+    capped.timeBudgetMs = 1.0f;
+    PlanetBake cut;
+    cut.Bake(terrain, resolution, capped);
+    std::cout << "Within a 1 ms budget: " << (cut.IsErosionComplete() ? "complete" : "cut short") << ", without one: "
+        << (eroded.IsErosionComplete() ? "complete" : "cut short") << std::endl;
+}
+
+void EngineBenchmarks::SunAnimations()
+{
+    std::cout << "--- Sun animation ---" << std::endl;
+
+    Noise noise(1);
+    const size_t sampleCount = 1 << 20;
+    std::vector<DirectX::XMFLOAT3> directions = RandomDirections(sampleCount, 3);
+    std::vector<float> values(sampleCount);
+
+    auto start = std::chrono::steady_clock::now();
+    noise.Evaluate(directions.data(), 0.5f, values.data(), sampleCount);
+    double seconds = SecondsSince(start);
+    std::cout << "4D noise: " << sampleCount / seconds / 1e6 << " M samples/s" << std::endl;
+
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sampleCount; i++)
+        values[i] = noise.Evaluate(directions[i]);
+    seconds = SecondsSince(start);
+    std::cout << "3D noise: " << sampleCount / seconds / 1e6 << " M samples/s" << std::endl;
+
+    SunAnimationSettings settings;
+    start = std::chrono::steady_clock::now();
+    SunAnimation animation(settings, 0);
+    double createSeconds = SecondsSince(start);
+
+    // A few keyframes at several frame rates, every tile is evaluated several times. The animation runs
+    // on real time, so each rate ends up at the same keyframe.
+    size_t tileBytes = static_cast<size_t>(settings.tileSize) * settings.tileSize * sizeof(UINT);
+    std::cout << settings.faceResolution << "x" << settings.faceResolution << " faces, " << settings.samplesPerFrame << " samples per frame: at most "
+        << animation.GetTilesPerFrame() << " tiles (" << animation.GetTilesPerFrame() * tileBytes / 1024 << " KB upload) per frame, "
+        << animation.GetTileCount() << " tiles per keyframe every " << animation.GetKeyframeSeconds() << " s" << std::endl;
+    for (int framesPerSecond : { 30, 60, 144 }) {
+        SunAnimation timed(settings, 0);
+        const int frameCount = static_cast<int>(std::ceil(4.0 * settings.keyframeSeconds * framesPerSecond));
+        double maxFrameSeconds = 0.0;
+        size_t tiles = 0;
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frameCount; frame++) {
+            auto frameStart = std::chrono::steady_clock::now();
+            timed.Update(1.0 / framesPerSecond);
+            maxFrameSeconds = std::max(maxFrameSeconds, SecondsSince(frameStart));
+            tiles += timed.GetUpdatedTiles().size();
+        }
+        seconds = SecondsSince(start);
+        std::cout << framesPerSecond << " fps: frame mean " << seconds / frameCount * 1000.0 << " ms, max " << maxFrameSeconds * 1000.0 << " ms, "
+            << static_cast<double>(tiles) / frameCount << " tiles per frame, " << timed.GetCycle() << " keyframes after " << frameCount << " frames" << std::endl;
+    }
+    std::cout << "Full update of two keyframes at creation " << createSeconds * 1000.0 << " ms" << std::endl;
+}
+
+void EngineBenchmarks::NoiseTiers()
+{
+    std::cout << "--- Noise tiers ---" << std::endl;
+
+    const size_t sampleCount = 1 << 18;
+    std::vector<DirectX::XMFLOAT3> directions = RandomDirections(sampleCount, 5);
+    std::vector<float> values(sampleCount);
+    NoisePermutation permutation(1);
+    FractalSettings settings;
+
+    // The runtime Noise class as the baseline (one octave per sample).
+    Noise noise(1);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sampleCount; i++)
+        values[i] = noise.Evaluate(directions[i]);
+    double baseline = sampleCount / SecondsSince(start) / 1e6;
+    std::cout << "Noise class: " << baseline << " M octaves/s" << std::endl;
+
+    const char* basisNames[] = { "simplex", "value", "cellular" };
+    const char* fractalNames[] = { "fbm", "ridged", "billow", "warped" };
+    const char* precisionNames[] = { "double", "float" };
+    for (int basis = 0; basis < 3; basis++) {
+        for (int fractal = 0; fractal < 4; fractal++) {
+            for (int precision = 0; precision < 2; precision++) {
+                NoiseBatchFunction evaluate = SelectNoiseBatchFunction(static_cast<NoiseBasis>(basis), static_cast<NoiseFractal>(fractal), static_cast<NoisePrecision>(precision));
+                start = std::chrono::steady_clock::now();
+                evaluate(permutation, directions.data(), values.data(), sampleCount, settings);
+                double rate = sampleCount * settings.octaves / SecondsSince(start) / 1e6;
+                std::cout << basisNames[basis] << " " << fractalNames[fractal] << " " << precisionNames[precision] << ": "
+                    << rate << " M octaves/s (" << rate / baseline << "x)" << std::endl;
+            }
+        }
+    }
+}
+
+void EngineBenchmarks::SeedDerivations()
+{
+    std::cout << "--- Seed derivation ---" << std::endl;
+
+    // Reference values, they have to be the same on every platform and build.
+    const char reference[] = "SUN";
+    uint64_t hash = ConfigurationGenerator::Hash64(reference, sizeof(reference) - 1);
+    std::cout << "Hash64(\"SUN\") = " << std::hex << hash << ", CounterRandom(hash, 0) = " << ConfigurationGenerator::CounterRandom(hash, 0) << std::dec << std::endl;
+
+    const int configurationCount = 20000;
+    std::vector<std::string> ids(configurationCount);
+    for (int i = 0; i < configurationCount; i++)
+        ids[i] = "bench" + std::to_string(i);
+
+    const SeedDerivation derivations[] = { SeedDerivation::Portable, SeedDerivation::Legacy };
+    const char* names[] = { "portable", "legacy" };
+    for (int d = 0; d < 2; d++) {
+        ConfigurationGenerator generator(derivations[d]);
+        float radiusSum = 0.0f;
+        auto start = std::chrono::steady_clock::now();
+        for (const std::string& id : ids)
+            radiusSum += generator.GeneratePlanetConfiguration(id, 1.0f, DirectX::XMFLOAT3(0, 0, 0)).radius;
+        double seconds = SecondsSince(start);
+        std::cout << names[d] << ": " << configurationCount / seconds / 1000.0 << " k configurations/s (mean radius " << radiusSum / configurationCount << ")" << std::endl;
+    }
+}
+
+void EngineBenchmarks::ConfigurationBatches()
+{
+    std::cout << "--- Configuration batches ---" << std::endl;
+
+    const int configurationCount = 200000;
+    std::vector<std::string> ids(configurationCount);
+    std::vector<float> orbits(configurationCount);
+    for (int i = 0; i < configurationCount; i++) {
+        ids[i] = "bench" + std::to_string(i);
+        orbits[i] = static_cast<float>(i % 8);
+    }
+
+    ConfigurationGenerator generator;
+    auto start = std::chrono::steady_clock::now();
+    float radiusSum = 0.0f;
+    for (int i = 0; i < configurationCount; i++)
+        radiusSum += generator.GeneratePlanetConfiguration(ids[i], orbits[i], DirectX::XMFLOAT3(0, 0, 0)).radius;
+    double singleSeconds = SecondsSince(start);
+
+    PlanetConfigurationBatch batch;
+    start = std::chrono::steady_clock::now();
+    generator.GeneratePlanetConfigurations(ids.data(), orbits.data(), ids.size(), batch);
+    double batchSeconds = SecondsSince(start);
+
+    // Keys only, the id strings are hashed before the timing starts.
+    std::vector<uint64_t> keys(batch.key);
+    start = std::chrono::steady_clock::now();
+    generator.GeneratePlanetConfigurations(keys.data(), orbits.data(), keys.size(), batch);
+    double keySeconds = SecondsSince(start);
+
+    // The batch has to give the same configurations as the single calls.
+    int mismatches = 0;
+    for (int i = 0; i < configurationCount; i += 97) {
+        PlanetConfiguration single = generator.GeneratePlanetConfiguration(ids[i], orbits[i], DirectX::XMFLOAT3(0, 0, 0));
+        PlanetConfiguration expanded = generator.ExpandConfiguration(batch, i, ids[i], DirectX::XMFLOAT3(0, 0, 0));
+        bool same = single.seed == expanded.seed && single.exist == expanded.exist && single.radius == expanded.radius &&
+            single.orbit == expanded.orbit && single.orbitAngle == expanded.orbitAngle && single.numberOfLayers == expanded.numberOfLayers &&
+            single.craters.count == expanded.craters.count && single.craters.depth == expanded.craters.depth;
+        for (int l = 0; same && l < single.numberOfLayers; l++)
+            same = single.layers[l].roughness == expanded.layers[l].roughness && single.layers[l].userFirstLayerAsMask == expanded.layers[l].userFirstLayerAsMask;
+        if (!same)
+            mismatches++;
+    }
+
+    std::cout << "single calls: " << configurationCount / singleSeconds / 1000.0 << " k configurations/s (mean radius " << radiusSum / configurationCount << ")" << std::endl;
+    std::cout << "batch from ids: " << configurationCount / batchSeconds / 1000.0 << " k configurations/s" << std::endl;
+    std::cout << "batch from keys: " << configurationCount / keySeconds / 1000.0 << " k configurations/s on " << ThreadPool::GetInstance()->GetThreadCount() << " threads" << std::endl;
+    std::cout << "mismatches against single calls: " << mismatches << std::endl;
+}
+
+void EngineBenchmarks::GalaxyStreaming()
+{
+    std::cout << "--- Galaxy streaming ---" << std::endl;
+
+    // A small budget, so the flight has to evict.
+    GalaxySettings galaxySettings;
+    galaxySettings.memoryBudget = 1024 * 1024;
+    Galaxy galaxy(galaxySettings);
+    const GalaxySettings& settings = galaxy.GetSettings();
+
+    // Until every sector around the start is resident.
+    std::vector<GalaxySystem> nearest;
+    for (int i = 0; i < 16; i++)
+        galaxy.Update(DirectX::XMFLOAT3(0, 0, 0));
+    galaxy.FindNearestSystems(DirectX::XMFLOAT3(0, 0, 0), 16, nearest);
+    std::vector<uint64_t> firstKeys;
+    for (const GalaxySystem& system : nearest)
+        firstKeys.push_back(system.key);
+
+    // Fly out along a diagonal at a sector per 30 frames and back again, a frame is one Update().
+    const int sectorsOut = 24;
+    const int framesPerSector = 30;
+    const int frameCount = 2 * sectorsOut * framesPerSector;
+    double updateMsSum = 0.0;
+    size_t maxResidentSystems = 0;
+    size_t maxMemory = 0;
+    for (int frame = 0; frame <= frameCount; frame++) {
+        int step = frame <= frameCount / 2 ? frame : frameCount - frame;
+        float distance = settings.sectorSize * step / framesPerSector;
+        galaxy.Update(DirectX::XMFLOAT3(distance, distance * 0.5f, distance * 0.25f));
+        updateMsSum += galaxy.GetStats().lastUpdateMs;
+        maxResidentSystems = std::max(maxResidentSystems, galaxy.GetStats().residentSystems);
+        maxMemory = std::max(maxMemory, galaxy.GetStats().memory);
+    }
+
+    // Evicted sectors come back the same when they are generated again.
+    galaxy.FindNearestSystems(DirectX::XMFLOAT3(0, 0, 0), 16, nearest);
+    int changed = 0;
+    for (size_t i = 0; i < nearest.size(); i++)
+        changed += (i >= firstKeys.size() || nearest[i].key != firstKeys[i]) ? 1 : 0;
+
+    const GalaxyStats& stats = galaxy.GetStats();
+    std::cout << "resident: " << stats.residentSectors << " sectors, " << stats.residentSystems << " systems, " << stats.residentPlanets << " planets, " <<
+        stats.memory / 1024 << " KB (budget " << settings.memoryBudget / 1024 << " KB)" << std::endl;
+    std::cout << "peak: " << maxResidentSystems << " systems, " << maxMemory / 1024 << " KB" << std::endl;
+    std::cout << "generated " << stats.generatedSectors << " sectors, evicted " << stats.evictedSectors << std::endl;
+    std::cout << "update: mean " << updateMsSum / (frameCount + 1) << " ms, max " << stats.maxUpdateMs << " ms, " << stats.meanSectorMs << " ms per sector" << std::endl;
+    std::cout << "nearest systems changed after returning: " << changed << " of " << nearest.size() << std::endl;
+}
+
+void EngineBenchmarks::GalaxyDatabaseQueries()
+{
+    std::cout << "--- Galaxy database ---" << std::endl;
+
+    GalaxySettings settings;
+    const int radius = 12;
+    const std::string path = "galaxy_benchmark.bin";
+    if (!GalaxyDatabase::Bake(settings, radius, path))
+        return;
+
+    GalaxyDatabase database;
+    if (!database.Open(path)) {
+        std::cout << "Cannot open the baked database." << std::endl;
+        return;
+    }
+
+    // Query positions inside the baked cube.
+    const int queryCount = 20000;
+    const size_t neighbours = 16;
+    std::vector<DirectX::XMFLOAT3> positions = RandomDirections(queryCount, 11);
+    for (size_t i = 0; i < positions.size(); i++) {
+        float distance = settings.sectorSize * radius * 0.8f * ((i * 7919) % 1000) / 1000.0f;
+        positions[i] = DirectX::XMFLOAT3(positions[i].x * distance, positions[i].y * distance, positions[i].z * distance);
+    }
+
+    std::vector<GalaxySystem> nearest;
+    auto start = std::chrono::steady_clock::now();
+    size_t found = 0;
+    for (const DirectX::XMFLOAT3& position : positions) {
+        database.FindNearestSystems(position, neighbours, nearest);
+        found += nearest.size();
+    }
+    double seconds = SecondsSince(start);
+    std::cout << neighbours << " nearest systems: " << queryCount / seconds / 1000.0 << " k queries/s (" << found / queryCount << " found per query)" << std::endl;
+
+    // Brute force over every system for a few of the queries.
+    std::vector<GalaxySystem> all;
+    std::vector<GalaxySystem> sectorSystems;
+    for (int z = -radius; z <= radius; z++)
+        for (int y = -radius; y <= radius; y++)
+            for (int x = -radius; x <= radius; x++) {
+                database.GetSectorSystems(x, y, z, sectorSystems);
+                all.insert(all.end(), sectorSystems.begin(), sectorSystems.end());
+            }
+    int wrong = 0;
+    for (int q = 0; q < 200; q++) {
+        const DirectX::XMFLOAT3& position = positions[q * (queryCount / 200)];
+        auto distance = [&position](const GalaxySystem& system) {
+            float dx = system.position.x - position.x, dy = system.position.y - position.y, dz = system.position.z - position.z;
+            return dx * dx + dy * dy + dz * dz;
+        };
+        std::partial_sort(all.begin(), all.begin() + neighbours, all.end(), [&distance](const GalaxySystem& a, const GalaxySystem& b) { return distance(a) < distance(b); });
+        database.FindNearestSystems(position, neighbours, nearest);
+        for (size_t i = 0; i < neighbours; i++)
+            wrong += nearest[i].key != all[i].key ? 1 : 0;
+    }
+
+    // The baked planets have to be the streamed ones.
+    Galaxy galaxy(settings);
+    galaxy.Update(DirectX::XMFLOAT3(0, 0, 0));
+    galaxy.FindNearestSystems(DirectX::XMFLOAT3(0, 0, 0), 8, nearest);
+    std::vector<GalaxySystem> baked;
+    database.FindNearestSystems(DirectX::XMFLOAT3(0, 0, 0), 8, baked);
+    int mismatches = 0;
+    for (size_t i = 0; i < nearest.size(); i++) {
+        if (i >= baked.size() || baked[i].key != nearest[i].key) {
+            mismatches++;
+            continue;
+        }
+        for (int p = 0; p < nearest[i].planetCount; p++) {
+            PlanetConfiguration streamed = galaxy.GetPlanetConfiguration(nearest[i], p);
+            PlanetConfiguration mapped = database.GetPlanetConfiguration(baked[i], p);
+            if (streamed.seed != mapped.seed || streamed.orbit != mapped.orbit || streamed.numberOfLayers != mapped.numberOfLayers || streamed.craters.depth != mapped.craters.depth)
+                mismatches++;
+        }
+    }
+
+    std::cout << database.GetSystemCount() << " systems, " << database.GetPlanetCount() << " planets, " << database.GetFileSize() / (1024 * 1024) << " MB mapped" << std::endl;
+    std::cout << "wrong neighbours against brute force: " << wrong << ", mismatches against streaming: " << mismatches << std::endl;
+    database.Close();
+    std::remove(path.c_str());
+}
+
+void EngineBenchmarks::GenerationWorkers()
+{
+    std::cout << "--- Generation workers ---" << std::endl;
+
+    const int jobCount = 96;
+    const int resolution = 64;
+    const size_t texels = static_cast<size_t>(6) * resolution * resolution;
+    std::vector<uint64_t> keys(jobCount);
+    for (int i = 0; i < jobCount; i++) {
+        std::string id = "worker" + std::to_string(i);
+        keys[i] = ConfigurationGenerator::Hash64(id.data(), id.size());
+    }
+
+    std::vector<float> reference(jobCount * texels);
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool::GetInstance()->ParallelFor(jobCount, [&](size_t i) {
+        GenerationWorkerPool::BakeElevations(keys[i], resolution, &reference[i * texels]);
+    });
+    double poolSeconds = SecondsSince(start);
+    std::cout << "thread pool: " << jobCount / poolSeconds << " planets/s on " << ThreadPool::GetInstance()->GetThreadCount() << " threads" << std::endl;
+
+    int workerCount = static_cast<int>(ThreadPool::GetInstance()->GetThreadCount());
+    start = std::chrono::steady_clock::now();
+    GenerationWorkerPool workers(workerCount, 2 * workerCount, resolution);
+    double startupSeconds = SecondsSince(start);
+
+    // Results are compared in place, straight from the shared slabs.
+    size_t differences = 0;
+    auto compare = [&](size_t i, const float* heights) {
+        differences += std::memcmp(heights, &reference[i * texels], texels * sizeof(float)) != 0 ? 1 : 0;
+    };
+    workers.Run(keys, compare);
+    std::cout << workerCount << " worker processes: " << jobCount / workers.GetStats().seconds << " planets/s (" << workers.GetStats().meanWorkerMs <<
+        " ms per job in a worker, " << startupSeconds * 1000.0 << " ms to start them)" << std::endl;
+
+    // Same again with a worker killed halfway through.
+    workers.Run(keys, [&](size_t i, const float* heights) {
+        compare(i, heights);
+        if (i == jobCount / 2)
+            workers.TerminateWorker(0);
+    });
+    const GenerationWorkerStats& stats = workers.GetStats();
+    std::cout << "with a killed worker: " << jobCount / stats.seconds << " planets/s, " << stats.restartedWorkers << " restarted, " << stats.requeuedJobs << " jobs queued again" << std::endl;
+    std::cout << "results that differ from the thread pool: " << differences << std::endl;
+}
+
+void EngineBenchmarks::AsteroidFields()
+{
+    std::cout << "--- Asteroid fields ---" << std::endl;
+
+    const int frames = 20;
+    for (size_t count : { static_cast<size_t>(10000), static_cast<size_t>(100000), static_cast<size_t>(1000000) }) {
+        AsteroidFieldSettings settings;
+        settings.instanceCount = count;
+        auto start = std::chrono::steady_clock::now();
+        AsteroidField field(settings);
+        double setupSeconds = SecondsSince(start);
+
+        std::vector<InstanceTransform> instances(count);
+        start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+            field.Update(frame / 60.0f, instances.data());
+        double updateMs = SecondsSince(start) * 1000.0 / frames;
+
+        std::cout << count << " rocks: " << updateMs << " ms per update (" << updateMs * 1e6 / count << " ns per rock), " <<
+            count * sizeof(InstanceTransform) / 1024 << " KB uploaded per frame, " << field.GetTemplateCount() << " draws, set up in " << setupSeconds * 1000.0 << " ms" << std::endl;
+    }
+}
+
+void EngineBenchmarks::OrbitUpdates()
+{
+    std::cout << "--- Orbit updates ---" << std::endl;
+
+    const size_t count = 4000000;
+    const size_t chunk = 4096;
+    const int frames = 10;
+    AsteroidFieldSettings settings;
+    settings.instanceCount = count;
+    AsteroidField field(settings);
+    const OrbitSimulation& orbits = field.GetOrbits();
+    std::cout << "vector path: " << (OrbitSimulation::HasVectorPath() ? "8-wide" : "not available") << std::endl;
+
+    std::vector<InstanceTransform> scalar(count);
+    std::vector<InstanceTransform> vector(count);
+    auto start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        orbits.UpdateScalar(frame / 60.0f, 0, count, scalar.data());
+    double scalarMs = SecondsSince(start) * 1000.0 / frames;
+
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        orbits.Update(frame / 60.0f, 0, count, vector.data());
+    double vectorMs = SecondsSince(start) * 1000.0 / frames;
+
+    start = std::chrono::steady_clock::now();
+    for (int frame = 0; frame < frames; frame++)
+        field.Update(frame / 60.0f, vector.data());
+    double parallelMs = SecondsSince(start) * 1000.0 / frames;
+
+    std::cout << count << " bodies, scalar: " << count / scalarMs / 1e6 << " M bodies/ms (" << scalarMs << " ms)" << std::endl;
+    std::cout << count << " bodies, vector: " << count / vectorMs / 1e6 << " M bodies/ms (" << vectorMs << " ms)" << std::endl;
+    std::cout << count << " bodies, vector on " << ThreadPool::GetInstance()->GetThreadCount() << " threads: " << count / parallelMs / 1e6 << " M bodies/ms (" << parallelMs << " ms)" << std::endl;
+
+    // Both paths after an hour and after four days of simulated time.
+    for (double time : { 3600.0, 345600.0 }) {
+        orbits.UpdateScalar(time, 0, count, scalar.data());
+        orbits.Update(time, 0, count, vector.data());
+        float maxError = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            const float* a = &scalar[i].rows[0].x;
+            const float* b = &vector[i].rows[0].x;
+            for (int v = 0; v < 12; v++)
+                maxError = std::max(maxError, std::abs(a[v] - b[v]));
+        }
+        std::cout << "largest difference between the paths at t = " << time << " s: " << maxError << std::endl;
+    }
+
+    // A frame later the bodies have to move by their speed, not by a step of the float angle.
+    const double lateTime = 345600.0;
+    double maxStepError = 0.0;
+    for (size_t i = 0; i < count; i += 997) {
+        DirectX::XMFLOAT3 position, velocity, nextPosition, nextVelocity;
+        orbits.GetState(lateTime, i, position, velocity);
+        orbits.GetState(lateTime + 1.0 / 60.0, i, nextPosition, nextVelocity);
+        double speed = std::sqrt(velocity.x * velocity.x + velocity.y * velocity.y + velocity.z * velocity.z);
+        double dx = nextPosition.x - position.x, dy = nextPosition.y - position.y, dz = nextPosition.z - position.z;
+        maxStepError = std::max(maxStepError, std::abs(std::sqrt(dx * dx + dy * dy + dz * dz) - speed / 60.0));
+    }
+    std::cout << "largest error of a frame step at t = " << lateTime << " s: " << maxStepError << std::endl;
+}
+
+void EngineBenchmarks::NBodyGravity()
+{
+    std::cout << "--- N-body gravity ---" << std::endl;
+
+    // Scaling: the belt around its star, the steps after the first one (which builds the first tree).
+    for (size_t count : { static_cast<size_t>(1000), static_cast<size_t>(10000), static_cast<size_t>(100000), static_cast<size_t>(1000000) }) {
+        AsteroidFieldSettings settings;
+        settings.instanceCount = count;
+        AsteroidField field(settings);
+        field.EnableGravity(0.0f, NBodySettings());
+        NBodySimulation& gravity = field.GetGravity();
+        gravity.SetAttractors({ { DirectX::XMFLOAT3(0, 0, 0), field.GetStarMass() } });
+        gravity.Step();
+
+        const int steps = count >= 1000000 ? 2 : 5;
+        double buildMs = 0.0, forceMs = 0.0;
+        auto start = std::chrono::steady_clock::now();
+        for (int step = 0; step < steps; step++) {
+            gravity.Step();
+            buildMs += gravity.GetStats().buildMs;
+            forceMs += gravity.GetStats().forceMs;
+        }
+        double stepMs = SecondsSince(start) * 1000.0 / steps;
+        std::cout << count << " bodies: " << stepMs << " ms per step (tree " << buildMs / steps << " ms, forces " << forceMs / steps << " ms), " <<
+            gravity.GetStats().nodeCount << " cells, " << gravity.GetStats().meanInteractions << " interactions per body" << std::endl;
+    }
+
+    // Accuracy of the tree against direct summation, mutual forces only so the star does not hide the error.
+    {
+        AsteroidFieldSettings settings;
+        settings.instanceCount = 20000;
+        AsteroidField field(settings);
+        const size_t samples = 500;
+        for (float openingAngle : { 0.3f, 0.5f, 0.7f, 1.0f }) {
+            NBodySettings gravitySettings;
+            gravitySettings.openingAngle = openingAngle;
+            field.EnableGravity(0.0f, gravitySettings);
+            NBodySimulation& gravity = field.GetGravity();
+            gravity.Step();
+
+            double errorSum = 0.0, maxError = 0.0;
+            for (size_t s = 0; s < samples; s++) {
+                size_t body = s * gravity.GetBodyCount() / samples;
+                DirectX::XMFLOAT3 directAcceleration = gravity.ComputeDirectAcceleration(body);
+                DirectX::XMFLOAT3 treeAcceleration = gravity.ComputeTreeAcceleration(body);
+                DirectX::XMVECTOR direct = DirectX::XMLoadFloat3(&directAcceleration);
+                DirectX::XMVECTOR tree = DirectX::XMLoadFloat3(&treeAcceleration);
+                double error = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(tree, direct))) / DirectX::XMVectorGetX(DirectX::XMVector3Length(direct));
+                errorSum += error;
+                maxError = std::max(maxError, error);
+            }
+            std::cout << "opening angle " << openingAngle << ": mean relative force error " << errorSum / samples << ", largest " << maxError <<
+                ", " << gravity.GetStats().meanInteractions << " interactions per body" << std::endl;
+        }
+    }
+
+    // Energy drift: a heavy belt around its star for ten orbits of the inner edge.
+    {
+        AsteroidFieldSettings settings;
+        settings.instanceCount = 2000;
+        settings.beltMass = 0.01f;
+        AsteroidField field(settings);
+        NBodySettings gravitySettings;
+        gravitySettings.softening = settings.scale.max;
+        field.EnableGravity(0.0f, gravitySettings);
+        NBodySimulation& gravity = field.GetGravity();
+        gravity.SetAttractors({ { DirectX::XMFLOAT3(0, 0, 0), field.GetStarMass() } });
+
+        const int steps = static_cast<int>(10.0f * DirectX::XM_2PI / settings.orbitalSpeed / gravitySettings.timeStep);
+        const int samples = 10;
+        double initialEnergy = gravity.ComputeEnergy();
+        double maxDrift = 0.0, finalDrift = 0.0;
+        for (int step = 1; step <= steps; step++) {
+            gravity.Step();
+            if (step % (steps / samples) != 0)
+                continue;
+            finalDrift = (gravity.ComputeEnergy() - initialEnergy) / std::abs(initialEnergy);
+            maxDrift = std::max(maxDrift, std::abs(finalDrift));
+        }
+        std::cout << gravity.GetBodyCount() << " bodies, " << steps << " steps of " << gravitySettings.timeStep << " s: relative energy drift " << finalDrift <<
+            " at the end, largest " << maxDrift << std::endl;
+    }
+}
+
+void EngineBenchmarks::PlanetRings()
+{
+    std::cout << "--- Planet rings ---" << std::endl;
+
+    const float planetRadius = 0.5f;
+    const DirectX::XMFLOAT3 planetPosition(10.0f, 0.0f, 0.0f);
+    const int frames = 20;
+    for (size_t count : { static_cast<size_t>(1000000), static_cast<size_t>(4000000) }) {
+        PlanetRingSettings settings;
+        settings.particleCount = count;
+        auto start = std::chrono::steady_clock::now();
+        PlanetRing ring(settings, planetRadius);
+        std::cout << count << " particles in " << ring.GetBandCount() << " bands, set up in " << SecondsSince(start) * 1000.0 << " ms" << std::endl;
+
+        // Cameras in the ring plane, from outside the near distance to the middle of the ring.
+        DirectX::XMMATRIX world = ring.GetWorldMatrix(planetPosition);
+        std::vector<RingParticle> particles(settings.maxNearParticles);
+        for (float localRadius : { 5.0f, 3.5f, 2.9f, 2.2f }) {
+            DirectX::XMFLOAT3 camera;
+            DirectX::XMStoreFloat3(&camera, DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(localRadius, 0.02f, 0.0f, 1.0f), world));
+
+            size_t written = 0;
+            double updateMs = 0.0;
+            for (int frame = 0; frame < frames; frame++) {
+                written = ring.Update(frame / 60.0, planetPosition, camera, particles.data(), particles.size());
+                updateMs += ring.GetStats().updateMs;
+            }
+            const PlanetRingStats& stats = ring.GetStats();
+            std::cout << "camera at " << localRadius << " planet radii: " << written << " near particles in " << stats.nearBands << " bands, " <<
+                updateMs / frames << " ms per frame, " << written * sizeof(RingParticle) / 1024 << " KB uploaded, " << stats.droppedParticles << " over the budget" << std::endl;
+        }
+
+        // The scalar path as the reference, inside the ring where the most particles are written.
+        DirectX::XMFLOAT3 camera;
+        DirectX::XMStoreFloat3(&camera, DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(2.2f, 0.02f, 0.0f, 1.0f), world));
+        std::vector<RingParticle> reference(settings.maxNearParticles);
+        const double time = 3600.0;
+        size_t written = ring.Update(time, planetPosition, camera, particles.data(), particles.size());
+        settings.vectorPath = false;
+        PlanetRing scalarRing(settings, planetRadius);
+        double scalarMs = 0.0;
+        for (int frame = 0; frame < frames; frame++) {
+            scalarRing.Update(time, planetPosition, camera, reference.data(), reference.size());
+            scalarMs += scalarRing.GetStats().updateMs;
+        }
+        float maxError = 0.0f;
+        for (size_t i = 0; i < written; i++) {
+            const float* a = &particles[i].positionSize.x;
+            const float* b = &reference[i].positionSize.x;
+            for (int v = 0; v < 4; v++)
+                maxError = std::max(maxError, std::abs(a[v] - b[v]));
+        }
+        std::cout << "scalar path: " << scalarMs / frames << " ms per frame, largest difference after an hour " << maxError << std::endl;
+    }
+}
+
+namespace
+{
+    // Layout of an engine object before the entity world: transform, per-frame state and resources
+    // interleaved in one record (the resources stand in for the meshes, textures and bakes).
+    struct LegacyObject
+    {
+        int idx;
+        char mesh[96];
+        DirectX::XMFLOAT4 position;
+        DirectX::XMFLOAT4X4 rotation;
+        DirectX::XMFLOAT4X4 worldMat;
+        DirectX::XMMATRIX delta_rotXMat;
+        DirectX::XMMATRIX delta_rotYMat;
+        DirectX::XMMATRIX delta_rotZMat;
+        bool planetDesc;
+        PlanetConfiguration planetDescripton;
+        char resources[256];
+    };
+
+    // The per-object constant buffer of the engine.
+    struct ObjectConstants
+    {
+        DirectX::XMFLOAT4X4 wvpMat;
+        DirectX::XMFLOAT4X4 worldMat;
+        DirectX::XMFLOAT4X4 viewMat;
+        DirectX::XMFLOAT4X4 projectionMat;
+    };
+}
+
+void EngineBenchmarks::EntityUpdates()
+{
+    std::cout << "--- Entity updates ---" << std::endl;
+
+    DirectX::XMMATRIX viewProjMat = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0, 50, -200, 1), DirectX::XMVectorZero(), DirectX::XMVectorSet(0, 1, 0, 0)) *
+        DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    for (size_t count : { static_cast<size_t>(1000), static_cast<size_t>(100000), static_cast<size_t>(1000000) }) {
+        const int frames = count > 100000 ? 5 : 50;
+        std::vector<DirectX::XMFLOAT3> axes = RandomDirections(count, 41);
+        std::mt19937 generator(41);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<ObjectConstants> constantBuffer(count);
+
+        std::vector<LegacyObject> legacyObjects(count);
+        EntityWorld world;
+        for (size_t i = 0; i < count; i++) {
+            float radius = 0.1f + uniform(generator);
+            float distance = 5.0f + 100.0f * uniform(generator);
+            float initialAngle = 6.28f * uniform(generator);
+            float step = 0.001f + 0.01f * uniform(generator);
+            DirectX::XMVECTOR axis = DirectX::XMLoadFloat3(&axes[i]);
+
+            LegacyObject& object = legacyObjects[i];
+            object.idx = static_cast<int>(i);
+            object.position = DirectX::XMFLOAT4(distance, 0.0f, 0.0f, 1.0f);
+            DirectX::XMStoreFloat4x4(&object.rotation, DirectX::XMMatrixRotationAxis(axis, initialAngle));
+            object.planetDesc = true;
+            object.planetDescripton.radius = radius;
+            object.planetDescripton.velocity = 1.0f;
+            object.planetDescripton.orbitAngle = step;
+            object.planetDescripton.orbitAxis = axes[i];
+
+            // The same circle as a Kepler orbit, a turn of step per frame at 60 frames per second.
+            TransformComponent transform;
+            DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+            transform.scale = radius;
+            OrbitComponent orbit = KeplerOrbit::Create(axes[i], DirectX::XMFLOAT3(1, 0, 0), DirectX::XMFLOAT3(0, 0, 0), distance, 0.0f, step * 60.0f, initialAngle);
+            KeplerOrbit::Evaluate(orbit, 0.0, transform);
+            WorldMatrixComponent worldMatrix;
+            DirectX::XMStoreFloat4x4(&worldMatrix.world, ComposeWorldMatrix(transform));
+            RenderableComponent renderable = { static_cast<uint32_t>(i), 0 };
+            PlanetComponent planet = { radius, 0 };
+            world.Create(transform, worldMatrix, orbit, renderable, planet);
+        }
+
+        // The former update: every object in turn, its whole record pulled through the cache.
+        ObjectConstants legacyConstants = {};
+        auto start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++) {
+            for (LegacyObject& object : legacyObjects) {
+                DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationAxis(DirectX::XMLoadFloat3(&object.planetDescripton.orbitAxis), object.planetDescripton.velocity * object.planetDescripton.orbitAngle);
+                DirectX::XMMATRIX rotMat = DirectX::XMLoadFloat4x4(&object.rotation) * rotationMatrix;
+                DirectX::XMStoreFloat4x4(&object.rotation, rotMat);
+                float scale = object.planetDescripton.radius;
+                DirectX::XMMATRIX worldMat = DirectX::XMMatrixScaling(scale, scale, scale) * DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat4(&object.position)) * rotMat;
+                DirectX::XMStoreFloat4x4(&object.worldMat, worldMat);
+                DirectX::XMStoreFloat4x4(&legacyConstants.worldMat, DirectX::XMMatrixTranspose(worldMat));
+                DirectX::XMStoreFloat4x4(&legacyConstants.wvpMat, DirectX::XMMatrixTranspose(worldMat * viewProjMat));
+                memcpy(&constantBuffer[object.idx], &legacyConstants, sizeof(legacyConstants));
+            }
+        }
+        double legacySeconds = SecondsSince(start) / frames;
+
+        // The systems of VoyagerEngine::UpdateEntities(), serial and on the thread pool.
+        double entitySeconds[2];
+        float maxError = 0.0f;
+        int entityFrame = 0;
+        for (int parallel = 0; parallel < 2; parallel++) {
+            double time = 0.0;
+            auto orbitSystem = [&](size_t chunkCount, TransformComponent* transforms, OrbitComponent* orbits) {
+                for (size_t i = 0; i < chunkCount; i++)
+                    KeplerOrbit::Evaluate(orbits[i], time, transforms[i]);
+            };
+            auto matrixSystem = [&](size_t chunkCount, const TransformComponent* transforms, WorldMatrixComponent* worlds, const RenderableComponent* renderables) {
+                ObjectConstants constants = {};
+                for (size_t i = 0; i < chunkCount; i++) {
+                    DirectX::XMMATRIX worldMat = ComposeWorldMatrix(transforms[i]);
+                    DirectX::XMStoreFloat4x4(&worlds[i].world, worldMat);
+                    DirectX::XMStoreFloat4x4(&constants.worldMat, DirectX::XMMatrixTranspose(worldMat));
+                    DirectX::XMStoreFloat4x4(&constants.wvpMat, DirectX::XMMatrixTranspose(worldMat * viewProjMat));
+                    memcpy(&constantBuffer[renderables[i].object], &constants, sizeof(constants));
+                }
+            };
+            start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < frames; frame++) {
+                time = ++entityFrame / 60.0;
+                if (parallel) {
+                    world.ParallelForEachChunk<TransformComponent, OrbitComponent>(orbitSystem);
+                    world.ParallelForEachChunk<TransformComponent, WorldMatrixComponent, RenderableComponent>(matrixSystem);
+                }
+                else {
+                    world.ForEachChunk<TransformComponent, OrbitComponent>(orbitSystem);
+                    world.ForEachChunk<TransformComponent, WorldMatrixComponent, RenderableComponent>(matrixSystem);
+                }
+            }
+            entitySeconds[parallel] = SecondsSince(start) / frames;
+
+            // After the same number of frames both keep the objects on the same orbits.
+            if (!parallel) {
+                world.ForEachChunk<WorldMatrixComponent, RenderableComponent>([&](size_t chunkCount, const WorldMatrixComponent* worlds, const RenderableComponent* renderables) {
+                    for (size_t i = 0; i < chunkCount; i++) {
+                        const DirectX::XMFLOAT4X4& legacy = legacyObjects[renderables[i].object].worldMat;
+                        maxError = std::max(maxError, std::abs(worlds[i].world._41 - legacy._41));
+                        maxError = std::max(maxError, std::abs(worlds[i].world._42 - legacy._42));
+                        maxError = std::max(maxError, std::abs(worlds[i].world._43 - legacy._43));
+                    }
+                });
+            }
+        }
+
+        std::cout << count << " objects (" << world.GetChunkCount() << " chunks of " << EntityWorld::ChunkBytes / 1024 << " KB, legacy record " << sizeof(LegacyObject) << " bytes): " <<
+            "legacy " << legacySeconds * 1000.0 << " ms, entities " << entitySeconds[0] * 1000.0 << " ms serial, " << entitySeconds[1] * 1000.0 << " ms on " <<
+            ThreadPool::GetInstance()->GetThreadCount() << " threads per frame (" << legacySeconds / entitySeconds[0] << "x serial), " <<
+            count / entitySeconds[1] / 1e6 << " M objects/s, largest position difference " << maxError << std::endl;
+    }
+
+    // Creating and destroying keeps the chunks dense and the handles of the others valid.
+    EntityWorld world;
+    std::vector<Entity> entities;
+    for (uint32_t i = 0; i < 10000; i++) {
+        RenderableComponent renderable = { i, 0 };
+        entities.push_back(world.Create(renderable));
+    }
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < entities.size(); i += 2)
+        world.Destroy(entities[i]);
+    double destroyMs = SecondsSince(start) * 1000.0;
+    size_t valid = 0;
+    for (size_t i = 1; i < entities.size(); i += 2) {
+        const RenderableComponent* renderable = world.Get<RenderableComponent>(entities[i]);
+        if (renderable != nullptr && renderable->object == i)
+            valid++;
+    }
+    std::cout << "destroyed every second of 10000 entities in " << destroyMs << " ms, " << valid << " of " << entities.size() / 2 << " remaining handles valid, " <<
+        world.GetChunkCount() << " chunks left, destroyed handles alive: " << (world.IsAlive(entities[0]) ? "yes" : "no") << std::endl;
+}
+
+void EngineBenchmarks::TransformBatches()
+{
+    std::cout << "--- Transform batches ---" << std::endl;
+
+    TransformBatchFrame frame;
+    DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0, 50, -200, 1), DirectX::XMVectorZero(), DirectX::XMVectorSet(0, 1, 0, 0));
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    DirectX::XMStoreFloat4x4(&frame.viewProjection, view * projection);
+    DirectX::XMStoreFloat4x4(&frame.viewTransposed, DirectX::XMMatrixTranspose(view));
+    DirectX::XMStoreFloat4x4(&frame.projectionTransposed, DirectX::XMMatrixTranspose(projection));
+    const size_t slotStride = 256;
+
+    std::cout << "widest path on this CPU: " << TransformBatch::GetPathName(TransformBatch::GetBestPath()) << std::endl;
+    for (size_t count : { static_cast<size_t>(1000), static_cast<size_t>(100000), static_cast<size_t>(1000000) }) {
+        const int repeats = count > 100000 ? 5 : 50;
+        std::vector<DirectX::XMFLOAT3> axes = RandomDirections(count, 42);
+        std::mt19937 generator(42);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        std::vector<TransformComponent> transforms(count);
+        std::vector<RenderableComponent> renderables(count);
+        for (size_t i = 0; i < count; i++) {
+            TransformComponent& transform = transforms[i];
+            DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&axes[count - 1 - i]), 6.28f * uniform(generator)));
+            DirectX::XMStoreFloat4(&transform.orbit, DirectX::XMQuaternionRotationAxis(DirectX::XMLoadFloat3(&axes[i]), 6.28f * uniform(generator)));
+            transform.position = DirectX::XMFLOAT3(5.0f + 100.0f * uniform(generator), 0.0f, 0.0f);
+            transform.scale = 0.1f + uniform(generator);
+            // Slots in a different order than the entities, as after entities were destroyed.
+            renderables[i].object = static_cast<uint32_t>((i * 7919) % count);
+            renderables[i].drawBaked = 0;
+        }
+
+        // The upload buffers of the GPU are aligned to far more than the 32 bytes of the streaming stores.
+        std::unique_ptr<uint8_t[]> referenceMemory(new uint8_t[count * slotStride + 64]);
+        std::unique_ptr<uint8_t[]> bufferMemory(new uint8_t[count * slotStride + 64]);
+        uint8_t* referenceBuffer = referenceMemory.get() + (64 - reinterpret_cast<uintptr_t>(referenceMemory.get()) % 64);
+        uint8_t* buffer = bufferMemory.get() + (64 - reinterpret_cast<uintptr_t>(bufferMemory.get()) % 64);
+        std::vector<WorldMatrixComponent> referenceWorlds(count), worlds(count);
+
+        std::cout << count << " entities:";
+        double scalarSeconds = 0.0;
+        for (TransformBatch::Path path : { TransformBatch::Path::Scalar, TransformBatch::Path::Avx2, TransformBatch::Path::Avx512 }) {
+            if (path != TransformBatch::Path::Scalar && static_cast<int>(path) > static_cast<int>(TransformBatch::GetBestPath()))
+                continue;
+            bool reference = path == TransformBatch::Path::Scalar;
+            // Timed from the second run, the first one also maps the pages of the buffers.
+            auto start = std::chrono::steady_clock::now();
+            for (int repeat = -1; repeat < repeats; repeat++) {
+                if (repeat == 0)
+                    start = std::chrono::steady_clock::now();
+                TransformBatch::Compute(path, count, transforms.data(), renderables.data(), reference ? referenceWorlds.data() : worlds.data(), frame, reference ? referenceBuffer : buffer, slotStride);
+            }
+            double seconds = SecondsSince(start) / repeats;
+            if (reference) {
+                scalarSeconds = seconds;
+                std::cout << " scalar " << seconds * 1000.0 << " ms (" << count / seconds / 1000.0 << " per ms)";
+                continue;
+            }
+
+            float maxError = 0.0f;
+            for (size_t i = 0; i < count; i++) {
+                for (int e = 0; e < 16; e++)
+                    maxError = std::max(maxError, std::abs((&worlds[i].world.m[0][0])[e] - (&referenceWorlds[i].world.m[0][0])[e]));
+            }
+            const float* slots = reinterpret_cast<const float*>(buffer);
+            const float* referenceSlots = reinterpret_cast<const float*>(referenceBuffer);
+            for (size_t f = 0; f < count * slotStride / sizeof(float); f++)
+                maxError = std::max(maxError, std::abs(slots[f] - referenceSlots[f]));
+            std::cout << ", " << TransformBatch::GetPathName(path) << " " << seconds * 1000.0 << " ms (" << scalarSeconds / seconds << "x, largest difference " << maxError << ")";
+        }
+        std::cout << std::endl;
+    }
+}
+
+void EngineBenchmarks::SceneUpdateScaling()
+{
+    std::cout << "--- Scene update scaling ---" << std::endl;
+
+    SceneFrame frame;
+    DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0, 50, -200, 1), DirectX::XMVectorZero(), DirectX::XMVectorSet(0, 1, 0, 0));
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    DirectX::XMStoreFloat4x4(&frame.matrices.viewProjection, view * projection);
+    DirectX::XMStoreFloat4x4(&frame.matrices.viewTransposed, DirectX::XMMatrixTranspose(view));
+    DirectX::XMStoreFloat4x4(&frame.matrices.projectionTransposed, DirectX::XMMatrixTranspose(projection));
+    frame.cameraPosition = DirectX::XMFLOAT3(0, 50, -200);
+    frame.cameraFront = DirectX::XMFLOAT3(0, 0, 1);
+    frame.cameraUp = DirectX::XMFLOAT3(0, 1, 0);
+    DirectX::XMStoreFloat4(&frame.cameraTurn, DirectX::XMQuaternionIdentity());
+    frame.fullDetailDistance = 8.0f;
+    frame.path = TransformBatch::GetBestPath();
+    frame.slotStride = 256;
+    frame.simulationTime = 0.0;
+
+    ThreadPool* pool = ThreadPool::GetInstance();
+    for (size_t count : { static_cast<size_t>(10000), static_cast<size_t>(100000) }) {
+        const int frames = 20;
+        std::vector<DirectX::XMFLOAT3> axes = RandomDirections(count, 43);
+        std::mt19937 generator(43);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        EntityWorld world;
+        for (size_t i = 0; i < count; i++) {
+            TransformComponent transform;
+            DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+            transform.scale = 0.1f + uniform(generator);
+            OrbitComponent orbit = KeplerOrbit::Create(axes[i], PerpendicularTo(axes[i]), DirectX::XMFLOAT3(0, 0, 0), 5.0f + 100.0f * uniform(generator),
+                0.1f * uniform(generator), 0.06f + 0.6f * uniform(generator), 6.28f * uniform(generator));
+            KeplerOrbit::Evaluate(orbit, 0.0, transform);
+            WorldMatrixComponent worldMatrix;
+            DirectX::XMStoreFloat4x4(&worldMatrix.world, ComposeWorldMatrix(transform));
+            RenderableComponent renderable = { static_cast<uint32_t>(i), 0 };
+            PlanetComponent planet = { transform.scale, 1 };
+            world.Create(transform, worldMatrix, orbit, renderable, planet, CreateTransformVersion());
+        }
+        std::unique_ptr<uint8_t[]> bufferMemory(new uint8_t[count * frame.slotStride + 64]);
+        frame.constantBuffer = bufferMemory.get() + (64 - reinterpret_cast<uintptr_t>(bufferMemory.get()) % 64);
+        frame.frameSlot = 0;
+        frame.cameraChanged = true;
+        SceneSystems::Update(world, frame);
+        frame.cameraChanged = false;
+
+        std::cout << count << " entities in " << world.GetChunkCount() << " chunks (" << TransformBatch::GetPathName(frame.path) << "):";
+        double singleThread = 0.0;
+        std::vector<unsigned int> threadCounts;
+        for (unsigned int threads = 1; threads < pool->GetThreadCount(); threads *= 2)
+            threadCounts.push_back(threads);
+        threadCounts.push_back(pool->GetThreadCount());
+        for (unsigned int threads : threadCounts) {
+            pool->SetThreadLimit(threads);
+            auto start = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; f++) {
+                frame.simulationTime += 1.0 / 60.0;
+                SceneSystems::Update(world, frame);
+            }
+            double seconds = SecondsSince(start) / frames;
+            if (threads == 1)
+                singleThread = seconds;
+            std::cout << " " << threads << (threads == 1 ? " thread " : " threads ") << seconds * 1000.0 << " ms (" << singleThread / seconds << "x)";
+        }
+        pool->SetThreadLimit(0);
+        std::cout << std::endl;
+    }
+}
+
+void EngineBenchmarks::DirtyTracking()
+{
+    std::cout << "--- Dirty tracking ---" << std::endl;
+
+    const size_t count = 100000;
+    const int frames = 30;
+    const size_t slotStride = 256;
+    const int frameSlots = TransformVersionComponent::FrameSlots;
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+
+    for (float movingShare : { 1.0f, 0.1f, 0.0f }) {
+        for (bool cameraMoves : { true, false }) {
+            std::vector<DirectX::XMFLOAT3> axes = RandomDirections(count, 44);
+            std::mt19937 generator(44);
+            std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+            EntityWorld world;
+            for (size_t i = 0; i < count; i++) {
+                TransformComponent transform;
+                DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+                transform.scale = 0.1f + uniform(generator);
+                // The moving ones spread over the chunks, as planets among static bodies would be.
+                bool moving = uniform(generator) < movingShare;
+                OrbitComponent orbit = KeplerOrbit::Create(axes[i], PerpendicularTo(axes[i]), DirectX::XMFLOAT3(0, 0, 0), 5.0f + 100.0f * uniform(generator),
+                    0.1f * uniform(generator), moving ? 0.06f + 0.6f * uniform(generator) : 0.0f, 6.28f * uniform(generator));
+                KeplerOrbit::Evaluate(orbit, 0.0, transform);
+                WorldMatrixComponent worldMatrix;
+                DirectX::XMStoreFloat4x4(&worldMatrix.world, ComposeWorldMatrix(transform));
+                RenderableComponent renderable = { static_cast<uint32_t>(i), 0 };
+                PlanetComponent planet = { transform.scale, 1 };
+                world.Create(transform, worldMatrix, orbit, renderable, planet, CreateTransformVersion());
+            }
+
+            std::vector<std::unique_ptr<uint8_t[]>> bufferMemory;
+            std::vector<uint8_t*> buffers;
+            for (int slot = 0; slot < frameSlots; slot++) {
+                bufferMemory.emplace_back(new uint8_t[count * slotStride + 64]);
+                buffers.push_back(bufferMemory.back().get() + (64 - reinterpret_cast<uintptr_t>(bufferMemory.back().get()) % 64));
+            }
+
+            // The camera tracking of VoyagerEngine::UpdateEntities().
+            SceneFrame frame;
+            frame.cameraFront = DirectX::XMFLOAT3(0, 0, 1);
+            frame.cameraUp = DirectX::XMFLOAT3(0, 1, 0);
+            DirectX::XMStoreFloat4(&frame.cameraTurn, DirectX::XMQuaternionIdentity());
+            frame.fullDetailDistance = 8.0f;
+            frame.path = TransformBatch::GetBestPath();
+            frame.slotStride = slotStride;
+            TransformBatchFrame lastMatrices = {};
+            uint32_t cameraVersion = 1;
+            uint32_t uploadedCameraVersion[frameSlots] = {};
+
+            SceneUpdateStats total;
+            double seconds = 0.0;
+            for (int f = 0; f < frames + frameSlots; f++) {
+                DirectX::XMVECTOR eye = DirectX::XMVectorSet(cameraMoves ? 0.1f * f : 0.0f, 50, -200, 1);
+                DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(eye, DirectX::XMVectorZero(), DirectX::XMVectorSet(0, 1, 0, 0));
+                DirectX::XMStoreFloat4x4(&frame.matrices.viewProjection, view * projection);
+                DirectX::XMStoreFloat4x4(&frame.matrices.viewTransposed, DirectX::XMMatrixTranspose(view));
+                DirectX::XMStoreFloat4x4(&frame.matrices.projectionTransposed, DirectX::XMMatrixTranspose(projection));
+                DirectX::XMStoreFloat3(&frame.cameraPosition, eye);
+                frame.frameSlot = f % frameSlots;
+                frame.constantBuffer = buffers[frame.frameSlot];
+                frame.simulationTime = f / 60.0;
+
+                auto start = std::chrono::steady_clock::now();
+                if (memcmp(&frame.matrices, &lastMatrices, sizeof(lastMatrices)) != 0) {
+                    cameraVersion++;
+                    lastMatrices = frame.matrices;
+                }
+                frame.cameraChanged = uploadedCameraVersion[frame.frameSlot] != cameraVersion;
+                uploadedCameraVersion[frame.frameSlot] = cameraVersion;
+                SceneUpdateStats stats = SceneSystems::Update(world, frame);
+
+                // The first frames fill every slot once.
+                if (f >= frameSlots) {
+                    seconds += SecondsSince(start);
+                    total.recomputed += stats.recomputed;
+                    total.projected += stats.projected;
+                    total.skipped += stats.skipped;
+                }
+            }
+
+            // The slots of the last frame hold what a full update would write.
+            std::vector<uint8_t> referenceMemory(count * slotStride);
+            world.ForEachChunk<TransformComponent, RenderableComponent>([&](size_t chunkCount, const TransformComponent* transforms, const RenderableComponent* renderables) {
+                std::vector<WorldMatrixComponent> worlds(chunkCount);
+                TransformBatch::Compute(TransformBatch::Path::Scalar, chunkCount, transforms, renderables, worlds.data(), frame.matrices, referenceMemory.data(), slotStride);
+            });
+            float maxError = 0.0f;
+            const float* slots = reinterpret_cast<const float*>(frame.constantBuffer);
+            const float* referenceSlots = reinterpret_cast<const float*>(referenceMemory.data());
+            for (size_t v = 0; v < count * slotStride / sizeof(float); v++)
+                maxError = std::max(maxError, std::abs(slots[v] - referenceSlots[v]));
+
+            std::cout << movingShare * 100.0f << "% moving, camera " << (cameraMoves ? "moving" : "still") << ": " << seconds / frames * 1000.0 << " ms per frame, per frame " <<
+                total.recomputed / frames << " recomputed, " << total.projected / frames << " reprojected, " << total.skipped / frames << " skipped, " <<
+                "largest difference to a full update " << maxError << std::endl;
+        }
+    }
+}
+
+void EngineBenchmarks::KeplerOrbits()
+{
+    std::cout << "--- Kepler orbits ---" << std::endl;
+
+    // The former per-frame turn drifts, the closed form does not: one body after an hour at 60 fps.
+    {
+        const int frames = 60 * 3600;
+        const float step = 0.0137f;
+        DirectX::XMVECTOR axis = DirectX::XMVector3Normalize(DirectX::XMVectorSet(0.3f, 1.0f, 0.2f, 0.0f));
+        DirectX::XMFLOAT3 axisValues;
+        DirectX::XMStoreFloat3(&axisValues, axis);
+        DirectX::XMFLOAT3 periapsis = PerpendicularTo(axisValues);
+        DirectX::XMVECTOR stepped = DirectX::XMQuaternionIdentity();
+        DirectX::XMVECTOR turn = DirectX::XMQuaternionRotationAxis(axis, step);
+        for (int f = 0; f < frames; f++)
+            stepped = DirectX::XMQuaternionMultiply(stepped, turn);
+        OrbitComponent orbit = KeplerOrbit::Create(axisValues, periapsis, DirectX::XMFLOAT3(0, 0, 0), 100.0f, 0.0f, step * 60.0f, 0.0f);
+        TransformComponent transform = {};
+        KeplerOrbit::Evaluate(orbit, frames / 60.0, transform);
+        // Exact angles in double precision, each of its own rate (60 * step is rounded to float).
+        DirectX::XMVECTOR position = DirectX::XMVectorScale(DirectX::XMLoadFloat3(&periapsis), 100.0f);
+        auto distance = [&](DirectX::XMVECTOR rotation, double angle) {
+            DirectX::XMVECTOR exact = DirectX::XMQuaternionRotationAxis(axis, static_cast<float>(std::remainder(angle, 2.0 * DirectX::XM_PI)));
+            DirectX::XMVECTOR moved = DirectX::XMVector3Rotate(position, rotation);
+            return DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(moved, DirectX::XMVector3Rotate(position, exact))));
+        };
+        std::cout << "After " << frames << " frames on a circle of radius 100: stepped quaternion off by " << distance(stepped, static_cast<double>(step) * frames) <<
+            ", closed form off by " << distance(DirectX::XMLoadFloat4(&transform.orbit), static_cast<double>(orbit.meanMotion) * frames / 60.0) << std::endl;
+    }
+
+    // Accuracy of the Newton steps against a double precision solution, over eccentricities and times.
+    {
+        std::mt19937 generator(45);
+        std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+        float maxResidual = 0.0f, maxSinCosError = 0.0f;
+        for (int i = 0; i < 100000; i++) {
+            float e = KeplerOrbit::MaxEccentricity * uniform(generator);
+            float meanAnomaly = DirectX::XM_PI * (2.0f * uniform(generator) - 1.0f);
+            float sinE, cosE;
+            float eccentricAnomaly = KeplerOrbit::SolveEccentricAnomaly(meanAnomaly, e, sinE, cosE);
+            double residual = eccentricAnomaly - e * std::sin(static_cast<double>(eccentricAnomaly)) - meanAnomaly;
+            maxResidual = std::max(maxResidual, static_cast<float>(std::abs(residual)));
+            // The sine and cosine turned along with the Newton steps.
+            maxSinCosError = std::max(maxSinCosError, static_cast<float>(std::abs(sinE - std::sin(static_cast<double>(eccentricAnomaly)))));
+            maxSinCosError = std::max(maxSinCosError, static_cast<float>(std::abs(cosE - std::cos(static_cast<double>(eccentricAnomaly)))));
+        }
+        std::cout << "Kepler equation, eccentricity up to " << KeplerOrbit::MaxEccentricity << ": largest residual " << maxResidual << " rad, sine and cosine off by " << maxSinCosError << std::endl;
+    }
+
+    // Cost of a frame of the orbit and transform systems at growing time warps, and with most entities
+    // culled: their orbits move on as before, only their slots are not written.
+    const size_t count = 100000;
+    const size_t slotStride = 256;
+    std::vector<DirectX::XMFLOAT3> axes = RandomDirections(count, 45);
+    std::mt19937 generator(45);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    std::unique_ptr<uint8_t[]> bufferMemory(new uint8_t[count * slotStride + 64]);
+    for (float culledShare : { 0.0f, 0.9f }) {
+        EntityWorld world;
+        for (size_t i = 0; i < count; i++) {
+            TransformComponent transform;
+            DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+            transform.scale = 0.1f + uniform(generator);
+            OrbitComponent orbit = KeplerOrbit::Create(axes[i], PerpendicularTo(axes[i]), DirectX::XMFLOAT3(0, 0, 0), 5.0f + 100.0f * uniform(generator),
+                KeplerOrbit::MaxEccentricity * uniform(generator), 0.06f + 0.6f * uniform(generator), 6.28f * uniform(generator));
+            KeplerOrbit::Evaluate(orbit, 0.0, transform);
+            WorldMatrixComponent worldMatrix;
+            DirectX::XMStoreFloat4x4(&worldMatrix.world, ComposeWorldMatrix(transform));
+            RenderableComponent renderable = { static_cast<uint32_t>(i), 0, uniform(generator) < culledShare ? 1u : 0u };
+            world.Create(transform, worldMatrix, orbit, renderable, CreateTransformVersion());
+        }
+
+        SceneFrame frame = {};
+        DirectX::XMStoreFloat4x4(&frame.matrices.viewProjection, DirectX::XMMatrixIdentity());
+        frame.path = TransformBatch::GetBestPath();
+        frame.constantBuffer = bufferMemory.get() + (64 - reinterpret_cast<uintptr_t>(bufferMemory.get()) % 64);
+        frame.slotStride = slotStride;
+        std::cout << count << " orbits, " << culledShare * 100.0f << "% culled:";
+        for (double warp : { 1.0, 1e3, 1e6 }) {
+            const int frames = 30;
+            auto start = std::chrono::steady_clock::now();
+            for (int f = 0; f < frames; f++) {
+                frame.simulationTime += warp / 60.0;
+                SceneSystems::AdvanceOrbits(world, frame);
+                SceneSystems::WriteTransforms(world, frame);
+            }
+            std::cout << " warp " << warp << "x " << SecondsSince(start) / frames * 1000.0 << " ms";
+        }
+        std::cout << " per frame";
+
+        // Culled or not, the world matrices follow the orbits, for the bounds and the children.
+        float maxError = 0.0f;
+        world.ForEachChunk<TransformComponent, WorldMatrixComponent>([&](size_t chunkCount, const TransformComponent* transforms, const WorldMatrixComponent* worlds) {
+            for (size_t i = 0; i < chunkCount; i++) {
+                DirectX::XMFLOAT4X4 expected;
+                DirectX::XMStoreFloat4x4(&expected, ComposeWorldMatrix(transforms[i]));
+                maxError = std::max(maxError, std::abs(worlds[i].world._41 - expected._41));
+                maxError = std::max(maxError, std::abs(worlds[i].world._42 - expected._42));
+                maxError = std::max(maxError, std::abs(worlds[i].world._43 - expected._43));
+            }
+        });
+        std::cout << ", world matrices off their orbits by " << maxError << std::endl;
+    }
+}
+
+void EngineBenchmarks::SimulationThread()
+{
+    std::cout << "--- Simulation thread ---" << std::endl;
+
+    // The asteroid gravity of VoyagerEngine::AdvanceAsteroidField(), one step per tick, few enough bodies
+    // for a tick to fit into its interval on one core.
+    AsteroidFieldSettings settings;
+    settings.instanceCount = 4000;
+    const double ticksPerSecond = 60.0;
+    NBodySettings gravitySettings;
+    gravitySettings.timeStep = static_cast<float>(1.0 / ticksPerSecond);
+    gravitySettings.softening = settings.scale.max;
+    auto startGravity = [&](AsteroidField& field) {
+        field.EnableGravity(0.0f, gravitySettings);
+        field.GetGravity().SetAttractors({ { DirectX::XMFLOAT3(0, 0, 0), field.GetStarMass() } });
+    };
+    auto tick = [](AsteroidField& field, const SimulationSnapshot& current, SimulationSnapshot& next, double tickSeconds) {
+        next.asteroidTime = current.asteroidTime + tickSeconds;
+        next.asteroidGravity = true;
+        NBodySimulation& gravity = field.GetGravity();
+        gravity.Advance(tickSeconds);
+        next.asteroidPositions.resize(gravity.GetBodyCount());
+        for (size_t i = 0; i < next.asteroidPositions.size(); i++)
+            next.asteroidPositions[i] = gravity.GetPosition(i);
+    };
+
+    // The frames read and interpolate while the ticks run, at frame rates below, at and above the tick rate.
+    for (double framesPerSecond : { 30.0, 60.0, 144.0 }) {
+        AsteroidField field(settings);
+        startGravity(field);
+        std::vector<InstanceTransform> instances(field.GetInstanceCount());
+        SimulationSnapshot initial;
+        initial.asteroidGravity = true;
+        initial.asteroidPositions.resize(field.GetInstanceCount());
+        for (size_t i = 0; i < initial.asteroidPositions.size(); i++)
+            initial.asteroidPositions[i] = field.GetGravity().GetPosition(i);
+
+        SimulationLoop loop;
+        loop.Start(ticksPerSecond, initial, [&](const SimulationSnapshot& current, SimulationSnapshot& next, double tickSeconds) {
+            tick(field, current, next, tickSeconds);
+        });
+        const int frames = static_cast<int>(framesPerSecond);
+        double frameMsSum = 0.0;
+        auto frameDue = std::chrono::steady_clock::now();
+        for (int f = 0; f < frames; f++) {
+            frameDue += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / framesPerSecond));
+            auto start = std::chrono::steady_clock::now();
+            loop.Read([&](const SimulationSnapshot& previous, const SimulationSnapshot& current, float alpha) {
+                double time = previous.asteroidTime + (current.asteroidTime - previous.asteroidTime) * alpha;
+                field.Update(time, previous.asteroidPositions.data(), current.asteroidPositions.data(), alpha, instances.data());
+            });
+            frameMsSum += SecondsSince(start) * 1000.0;
+            std::this_thread::sleep_until(frameDue);
+        }
+        loop.Stop();
+        SimulationStats stats = loop.TakeStats();
+
+        // The ticks do not depend on the frames: the same steps without the thread give the same state.
+        uint64_t ticks = 0;
+        float maxDifference = 0.0f;
+        AsteroidField replay(settings);
+        startGravity(replay);
+        loop.Read([&](const SimulationSnapshot&, const SimulationSnapshot& current, float) {
+            ticks = current.tick;
+            for (uint64_t t = 0; t < ticks; t++)
+                replay.GetGravity().Advance(1.0 / ticksPerSecond);
+            for (size_t i = 0; i < current.asteroidPositions.size(); i++) {
+                DirectX::XMFLOAT3 position = replay.GetGravity().GetPosition(i);
+                maxDifference = std::max(maxDifference, std::abs(position.x - current.asteroidPositions[i].x));
+                maxDifference = std::max(maxDifference, std::abs(position.y - current.asteroidPositions[i].y));
+                maxDifference = std::max(maxDifference, std::abs(position.z - current.asteroidPositions[i].z));
+            }
+        });
+
+        std::cout << framesPerSecond << " frames/s against " << ticksPerSecond << " ticks/s, " << settings.instanceCount << " bodies: tick " << stats.meanTickMs << " ms (max " <<
+            stats.maxTickMs << ", " << stats.droppedTicks << " dropped), frame " << frameMsSum / frames << " ms, latency " << stats.meanLatencyMs << " ms, " <<
+            ticks << " ticks, difference to the same ticks without the thread " << maxDifference << std::endl;
+    }
+}
+
+namespace
+{
+    // Stands in for the command list: the calls VoyagerEngine::PopulateCommandList() makes for the draws.
+    struct RecordedCommand
+    {
+        uint32_t type;
+        uint32_t value;
+        uint64_t address;
+    };
+
+    void RecordPacket(const RenderPacket& packet, size_t slotStride, std::vector<RecordedCommand>& commands)
+    {
+        commands.clear();
+        const RenderDraw* previous = nullptr;
+        for (size_t d = 0; d < packet.drawCount; d++) {
+            const RenderDraw& draw = packet.draws[d];
+            bool newMaterial = !previous || draw.material != previous->material;
+            if (newMaterial)
+                commands.push_back({ 0, static_cast<uint32_t>(draw.material), 0 });
+            if (!previous || draw.mesh != previous->mesh)
+                commands.push_back({ 1, 0, reinterpret_cast<uintptr_t>(draw.mesh) });
+            if (draw.constants && (newMaterial || draw.constants != previous->constants))
+                commands.push_back({ 2, draw.constantCount, reinterpret_cast<uintptr_t>(draw.constants) });
+            commands.push_back({ 3, 0, draw.slot * slotStride });
+            if (draw.texture != RenderDraw::NoTexture)
+                commands.push_back({ 4, draw.texture, 0 });
+            commands.push_back({ 5, draw.instanceCount, draw.firstInstance });
+            previous = &draw;
+        }
+    }
+}
+
+void EngineBenchmarks::RenderThreadOverlap()
+{
+    std::cout << "--- Render thread ---" << std::endl;
+
+    SceneFrame frame;
+    DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0, 50, -200, 1), DirectX::XMVectorZero(), DirectX::XMVectorSet(0, 1, 0, 0));
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    DirectX::XMStoreFloat4x4(&frame.matrices.viewProjection, view * projection);
+    DirectX::XMStoreFloat4x4(&frame.matrices.viewTransposed, DirectX::XMMatrixTranspose(view));
+    DirectX::XMStoreFloat4x4(&frame.matrices.projectionTransposed, DirectX::XMMatrixTranspose(projection));
+    frame.cameraPosition = DirectX::XMFLOAT3(0, 50, -200);
+    frame.cameraFront = DirectX::XMFLOAT3(0, 0, 1);
+    frame.cameraUp = DirectX::XMFLOAT3(0, 1, 0);
+    DirectX::XMStoreFloat4(&frame.cameraTurn, DirectX::XMQuaternionIdentity());
+    frame.fullDetailDistance = 8.0f;
+    frame.path = TransformBatch::GetBestPath();
+    frame.slotStride = 256;
+    frame.cameraChanged = false;
+
+    // Planets with a baked texture each, every one of them moving and drawn.
+    const size_t count = 20000;
+    const int frames = 120;
+    const uint32_t textureCount = 32;
+    std::vector<DirectX::XMFLOAT3> axes = RandomDirections(count, 47);
+    std::mt19937 generator(47);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    EntityWorld world;
+    for (size_t i = 0; i < count; i++) {
+        TransformComponent transform;
+        DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+        transform.scale = 0.1f + uniform(generator);
+        OrbitComponent orbit = KeplerOrbit::Create(axes[i], PerpendicularTo(axes[i]), DirectX::XMFLOAT3(0, 0, 0), 5.0f + 100.0f * uniform(generator),
+            0.1f * uniform(generator), 0.06f + 0.6f * uniform(generator), 6.28f * uniform(generator));
+        KeplerOrbit::Evaluate(orbit, 0.0, transform);
+        WorldMatrixComponent worldMatrix;
+        DirectX::XMStoreFloat4x4(&worldMatrix.world, ComposeWorldMatrix(transform));
+        RenderableComponent renderable = { static_cast<uint32_t>(i), 0 };
+        PlanetComponent planet = { transform.scale, 1 };
+        world.Create(transform, worldMatrix, orbit, renderable, planet, CreateTransformVersion());
+    }
+    // One constant buffer per frame slot, as the engine has.
+    std::unique_ptr<uint8_t[]> bufferMemory(new uint8_t[3 * count * frame.slotStride + 64]);
+    uint8_t* buffers = bufferMemory.get() + (64 - reinterpret_cast<uintptr_t>(bufferMemory.get()) % 64);
+    // The meshes are only told apart by their address.
+    std::vector<char> meshes(count);
+
+    // VoyagerEngine::OnUpdate() and BuildRenderPacket().
+    auto update = [&](int f, RenderPacket& packet) {
+        frame.frameSlot = f % 3;
+        frame.constantBuffer = buffers + frame.frameSlot * count * frame.slotStride;
+        frame.simulationTime = f / 60.0;
+        SceneSystems::Update(world, frame);
+
+        packet.Reset(world.GetEntityCount());
+        packet.frameSlot = frame.frameSlot;
+        world.ForEachChunk<RenderableComponent>([&](size_t chunkCount, const RenderableComponent* renderables) {
+            for (size_t i = 0; i < chunkCount; i++) {
+                if (renderables[i].culled)
+                    continue;
+                Mesh* mesh = reinterpret_cast<Mesh*>(&meshes[renderables[i].object]);
+                if (renderables[i].drawBaked)
+                    packet.AddDraw(RenderMaterial::BakedPlanet, mesh, renderables[i].object).texture = renderables[i].object % textureCount;
+                else
+                    packet.AddDraw(RenderMaterial::Lit, mesh, renderables[i].object);
+            }
+        });
+    };
+
+    // Update and recording one after the other on the game thread, as before the render thread.
+    std::vector<RecordedCommand> commands;
+    commands.reserve(8 * count);
+    RenderPacket packet;
+    double updateMsSum = 0.0;
+    double recordMsSum = 0.0;
+    size_t serialCommands = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        auto updateStart = std::chrono::steady_clock::now();
+        update(f, packet);
+        auto recordStart = std::chrono::steady_clock::now();
+        RecordPacket(packet, frame.slotStride, commands);
+        serialCommands += commands.size();
+        updateMsSum += std::chrono::duration<double, std::milli>(recordStart - updateStart).count();
+        recordMsSum += SecondsSince(recordStart) * 1000.0;
+    }
+    double serialMs = SecondsSince(start) * 1000.0 / frames;
+    std::cout << count << " draws, serial: frame " << serialMs << " ms (update and packet " << updateMsSum / frames << " ms, recording " <<
+        recordMsSum / frames << " ms), packet " << packet.arena.GetUsedBytes() / 1024 << " KB" << std::endl;
+
+    // The same frames with the recording of frame N on the render thread while N + 1 is updated.
+    size_t threadedCommands = 0;
+    RenderThread renderThread;
+    renderThread.Start([&](const RenderPacket& submitted) {
+        RecordPacket(submitted, frame.slotStride, commands);
+        threadedCommands += commands.size();
+    });
+    start = std::chrono::steady_clock::now();
+    for (int f = 0; f < frames; f++) {
+        RenderPacket& next = renderThread.Acquire();
+        update(f, next);
+        renderThread.Submit();
+    }
+    renderThread.Stop();
+    double threadedMs = SecondsSince(start) * 1000.0 / frames;
+    RenderThreadStats stats = renderThread.TakeStats();
+    std::cout << count << " draws, render thread: frame " << threadedMs << " ms (" << serialMs / threadedMs << "x), recording " << stats.meanRenderMs <<
+        " ms (max " << stats.maxRenderMs << "), game thread waited " << stats.meanWaitMs << " ms, " << std::thread::hardware_concurrency() << " hardware threads, " <<
+        (threadedCommands == serialCommands ? "same" : "different") << " commands" << std::endl;
+}
+
+void EngineBenchmarks::HierarchyPropagation()
+{
+    std::cout << "--- Transform hierarchy ---" << std::endl;
+
+    // Stars, planets around them, moons around the planets (both following the position only) and
+    // stations fixed to the moons (rigidly), about 100k nodes.
+    const int depthCounts[4] = { 100, 20, 5, 9 };
+    struct PointerNode
+    {
+        DirectX::XMFLOAT4X4 local;
+        DirectX::XMFLOAT4X4 world;
+        PointerNode* parent;
+        std::vector<PointerNode*> children;
+        bool dirty;
+        bool positionOnly;
+    };
+    std::mt19937 generator(48);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto randomLocal = [&](float distance) {
+        DirectX::XMFLOAT4X4 local;
+        DirectX::XMVECTOR axis = DirectX::XMVector3Normalize(DirectX::XMVectorSet(uniform(generator), uniform(generator), uniform(generator), 0.0f));
+        DirectX::XMStoreFloat4x4(&local, DirectX::XMMatrixScaling(1.0f, 1.0f, 1.0f) * DirectX::XMMatrixRotationAxis(axis, 3.0f * uniform(generator)) *
+            DirectX::XMMatrixTranslation(distance * uniform(generator), distance * uniform(generator), distance * uniform(generator)));
+        return local;
+    };
+
+    // The same tree twice, the pointer nodes allocated one by one in a shuffled order, as a scene graph
+    // built over time would have them.
+    TransformHierarchy flat;
+    std::vector<uint32_t> parentOf;
+    std::vector<int> depthOf;
+    std::vector<DirectX::XMFLOAT4X4> locals;
+    std::vector<uint32_t> level, nextLevel;
+    for (int depth = 0; depth < 4; depth++) {
+        nextLevel.clear();
+        size_t parents = depth == 0 ? 1 : level.size();
+        for (size_t p = 0; p < parents; p++) {
+            for (int c = 0; c < depthCounts[depth]; c++) {
+                uint32_t parent = depth == 0 ? TransformHierarchy::NoNode : level[p];
+                TransformHierarchy::Inherit inherit = depth == 3 ? TransformHierarchy::Inherit::Full : TransformHierarchy::Inherit::Position;
+                locals.push_back(randomLocal(depth == 0 ? 10000.0f : 1000.0f / (depth * depth)));
+                nextLevel.push_back(flat.Add(locals.back(), parent, inherit));
+                parentOf.push_back(parent);
+                depthOf.push_back(depth);
+            }
+        }
+        level.swap(nextLevel);
+    }
+    const size_t count = locals.size();
+    std::vector<size_t> allocationOrder(count);
+    for (size_t i = 0; i < count; i++)
+        allocationOrder[i] = i;
+    std::shuffle(allocationOrder.begin(), allocationOrder.end(), generator);
+    std::vector<std::unique_ptr<PointerNode>> pointerNodes(count);
+    for (size_t i : allocationOrder)
+        pointerNodes[i].reset(new PointerNode());
+    std::vector<PointerNode*> roots;
+    for (size_t i = 0; i < count; i++) {
+        PointerNode& node = *pointerNodes[i];
+        node.local = locals[i];
+        node.parent = parentOf[i] == TransformHierarchy::NoNode ? nullptr : pointerNodes[parentOf[i]].get();
+        node.dirty = true;
+        node.positionOnly = depthOf[i] < 3;
+        if (node.parent)
+            node.parent->children.push_back(&node);
+        else
+            roots.push_back(&node);
+    }
+
+    // Depth first, every node visited through the pointers of its parent.
+    std::function<size_t(PointerNode&, bool)> propagate = [&](PointerNode& node, bool parentUpdated) {
+        size_t updated = 0;
+        bool update = node.dirty || parentUpdated;
+        if (update) {
+            DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&node.local);
+            if (node.parent) {
+                DirectX::XMMATRIX parentWorld = DirectX::XMLoadFloat4x4(&node.parent->world);
+                if (node.positionOnly)
+                    world.r[3] = DirectX::XMVectorSelect(world.r[3], DirectX::XMVectorAdd(world.r[3], parentWorld.r[3]), DirectX::g_XMSelect1110);
+                else
+                    world = DirectX::XMMatrixMultiply(world, parentWorld);
+            }
+            DirectX::XMStoreFloat4x4(&node.world, world);
+            node.dirty = false;
+            updated++;
+        }
+        for (PointerNode* child : node.children)
+            updated += propagate(*child, update);
+        return updated;
+    };
+    auto propagatePointers = [&]() {
+        size_t updated = 0;
+        for (PointerNode* root : roots)
+            updated += propagate(*root, false);
+        return updated;
+    };
+    auto maxDifference = [&]() {
+        float difference = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+            const DirectX::XMFLOAT4X4& a = flat.GetWorld(static_cast<uint32_t>(i));
+            const DirectX::XMFLOAT4X4& b = pointerNodes[i]->world;
+            for (int r = 0; r < 4; r++) {
+                for (int c = 0; c < 4; c++)
+                    difference = std::max(difference, std::abs(a.m[r][c] - b.m[r][c]));
+            }
+        }
+        return difference;
+    };
+    flat.Propagate();
+    propagatePointers();
+    std::cout << count << " nodes in " << flat.GetDepthCount() << " depths, largest difference " << maxDifference() << std::endl;
+
+    // Every star moved: the whole tree.
+    const int passes = 20;
+    double flatMs = 0.0, pointerMs = 0.0;
+    for (int pass = 0; pass < passes; pass++) {
+        for (size_t i = 0; i < static_cast<size_t>(depthCounts[0]); i++) {
+            flat.SetLocal(static_cast<uint32_t>(i), locals[i]);
+            pointerNodes[i]->dirty = true;
+        }
+        auto start = std::chrono::steady_clock::now();
+        flat.Propagate();
+        flatMs += SecondsSince(start) * 1000.0;
+        start = std::chrono::steady_clock::now();
+        propagatePointers();
+        pointerMs += SecondsSince(start) * 1000.0;
+    }
+    std::cout << "Full propagation: flat " << flatMs / passes << " ms, pointer tree " << pointerMs / passes << " ms (" << pointerMs / flatMs << "x)" << std::endl;
+
+    // A few moons moved, their stations with them: the passes skip everything else.
+    for (float share : { 0.01f, 0.1f }) {
+        std::uniform_int_distribution<size_t> anyNode(0, count - 1);
+        size_t flatUpdated = 0, pointerUpdated = 0;
+        flatMs = 0.0;
+        pointerMs = 0.0;
+        for (int pass = 0; pass < passes; pass++) {
+            for (size_t d = 0; d < static_cast<size_t>(share * count); d++) {
+                size_t i = anyNode(generator);
+                flat.SetLocal(static_cast<uint32_t>(i), locals[i]);
+                pointerNodes[i]->dirty = true;
+            }
+            auto start = std::chrono::steady_clock::now();
+            flatUpdated += flat.Propagate();
+            flatMs += SecondsSince(start) * 1000.0;
+            start = std::chrono::steady_clock::now();
+            pointerUpdated += propagatePointers();
+            pointerMs += SecondsSince(start) * 1000.0;
+        }
+        std::cout << share * 100.0f << "% dirty (" << flatUpdated / passes << " nodes updated" << (flatUpdated == pointerUpdated ? "" : ", different counts!") << "): flat " <<
+            flatMs / passes << " ms, pointer tree " << pointerMs / passes << " ms (" << pointerMs / flatMs << "x)" << std::endl;
+    }
+
+    // Moons handed to other planets (same depth) and to stars or stations (a depth up or down, their
+    // stations with them).
+    for (int depthChange : { 0, -1, 1 }) {
+        const int moves = 1000;
+        std::uniform_int_distribution<size_t> anyNode(0, count - 1);
+        double flatMoveMs = 0.0, pointerMoveMs = 0.0;
+        for (int m = 0; m < moves; m++) {
+            size_t node, parent;
+            do {
+                node = anyNode(generator);
+            } while (flat.GetDepth(static_cast<uint32_t>(node)) != 2);
+            do {
+                parent = anyNode(generator);
+            } while (flat.GetDepth(static_cast<uint32_t>(parent)) != static_cast<uint32_t>(1 + depthChange));
+
+            auto start = std::chrono::steady_clock::now();
+            flat.SetParent(static_cast<uint32_t>(node), static_cast<uint32_t>(parent));
+            flatMoveMs += SecondsSince(start) * 1000.0;
+            start = std::chrono::steady_clock::now();
+            PointerNode& moved = *pointerNodes[node];
+            std::vector<PointerNode*>& siblings = moved.parent->children;
+            siblings.erase(std::find(siblings.begin(), siblings.end(), &moved));
+            moved.parent = pointerNodes[parent].get();
+            moved.parent->children.push_back(&moved);
+            moved.dirty = true;
+            pointerMoveMs += SecondsSince(start) * 1000.0;
+
+            // Moved back, so every round starts from the same tree.
+            flat.SetParent(static_cast<uint32_t>(node), parentOf[node]);
+            moved.parent->children.pop_back();
+            moved.parent = pointerNodes[parentOf[node]].get();
+            moved.parent->children.push_back(&moved);
+        }
+        flat.Propagate();
+        propagatePointers();
+        std::cout << "Re-parent, depth " << (depthChange == 0 ? "kept" : depthChange < 0 ? "up" : "down") << ": flat " << flatMoveMs * 1000.0 / moves <<
+            " us, pointer tree " << pointerMoveMs * 1000.0 / moves << " us per move, largest difference " << maxDifference() << std::endl;
+    }
+
+    // The scene systems on planets with a moon each, roots and children in the same chunks. With the
+    // camera moving every frame, the moved chunks take the composing path of WriteTransforms(), which has
+    // to leave the hierarchy alone: every slot holds the propagated world matrix.
+    const size_t planetCount = 64;
+    const int frames = 10;
+    EntityWorld sceneWorld;
+    TransformHierarchy sceneHierarchy;
+    std::vector<Entity> entities;
+    std::vector<DirectX::XMFLOAT3> axes = RandomDirections(planetCount, 48);
+    for (size_t p = 0; p < planetCount; p++) {
+        uint32_t planetNode = TransformHierarchy::NoNode;
+        for (int moon = 0; moon < 2; moon++) {
+            TransformComponent transform;
+            DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+            transform.scale = moon ? 0.2f : 1.0f;
+            OrbitComponent orbit = KeplerOrbit::Create(axes[p], PerpendicularTo(axes[p]), DirectX::XMFLOAT3(0, 0, 0), moon ? 3.0f : 50.0f + p,
+                0.1f, moon ? 0.6f : 0.06f, 0.1f * p);
+            KeplerOrbit::Evaluate(orbit, 0.0, transform);
+            DirectX::XMFLOAT4X4 local;
+            DirectX::XMStoreFloat4x4(&local, ComposeWorldMatrix(transform));
+            HierarchyComponent node;
+            node.node = moon ? sceneHierarchy.Add(local, planetNode, TransformHierarchy::Inherit::Position) : sceneHierarchy.Add(local);
+            if (!moon)
+                planetNode = node.node;
+            sceneHierarchy.Propagate();
+            WorldMatrixComponent worldMatrix;
+            worldMatrix.world = sceneHierarchy.GetWorld(node.node);
+            RenderableComponent renderable = { static_cast<uint32_t>(entities.size()), 0 };
+            entities.push_back(sceneWorld.Create(transform, worldMatrix, orbit, renderable, node, CreateTransformVersion()));
+        }
+    }
+    std::unique_ptr<uint8_t[]> sceneBufferMemory(new uint8_t[entities.size() * 256 + 64]);
+    SceneFrame frame = {};
+    frame.path = TransformBatch::GetBestPath();
+    frame.constantBuffer = sceneBufferMemory.get() + (64 - reinterpret_cast<uintptr_t>(sceneBufferMemory.get()) % 64);
+    frame.slotStride = 256;
+    frame.cameraChanged = true;
+    frame.hierarchy = &sceneHierarchy;
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 1000.0f);
+    DirectX::XMStoreFloat4x4(&frame.matrices.projectionTransposed, DirectX::XMMatrixTranspose(projection));
+    float maxSlotError = 0.0f;
+    for (int f = 0; f < frames; f++) {
+        DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(1.0f * f, 50, -200, 1), DirectX::XMVectorZero(), DirectX::XMVectorSet(0, 1, 0, 0));
+        DirectX::XMStoreFloat4x4(&frame.matrices.viewProjection, view * projection);
+        DirectX::XMStoreFloat4x4(&frame.matrices.viewTransposed, DirectX::XMMatrixTranspose(view));
+        frame.simulationTime = (f + 1) / 60.0;
+        SceneSystems::Update(sceneWorld, frame);
+
+        for (Entity entity : entities) {
+            uint32_t node = sceneWorld.Get<HierarchyComponent>(entity)->node;
+            DirectX::XMFLOAT4X4 expected;
+            DirectX::XMStoreFloat4x4(&expected, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&sceneHierarchy.GetWorld(node)) * view * projection));
+            const float* slot = reinterpret_cast<const float*>(frame.constantBuffer + sceneWorld.Get<RenderableComponent>(entity)->object * frame.slotStride);
+            for (int e = 0; e < 16; e++)
+                maxSlotError = std::max(maxSlotError, std::abs(slot[e] - (&expected._11)[e]));
+        }
+    }
+    std::cout << "Scene systems, " << planetCount << " planets with a moon in " << sceneWorld.GetChunkCount() << " chunks: WVP slots off the hierarchy by " << maxSlotError <<
+        (maxSlotError < 1e-3f ? "" : ", the moons lost their planets!") << std::endl;
+}
+
+void EngineBenchmarks::BoundingVolumes()
+{
+    std::cout << "--- Bounding volume hierarchy ---" << std::endl;
+
+    // The rocks of the asteroid belt, as the ship collision sees them.
+    AsteroidFieldSettings settings;
+    settings.instanceCount = 100000;
+    AsteroidField field(settings);
+    const size_t count = field.GetInstanceCount();
+    std::vector<InstanceTransform> instances(count);
+    std::vector<BoundingSphere> spheres(count);
+    auto place = [&](float time) {
+        field.Update(time, instances.data());
+        for (size_t i = 0; i < count; i++) {
+            const DirectX::XMFLOAT4* rows = instances[i].rows;
+            spheres[i].center = DirectX::XMFLOAT3(rows[0].w, rows[1].w, rows[2].w);
+            spheres[i].radius = 1.2f * std::sqrt(rows[0].x * rows[0].x + rows[0].y * rows[0].y + rows[0].z * rows[0].z);
+        }
+    };
+    place(0.0f);
+
+    // Build on one thread and on all of them.
+    ThreadPool* pool = ThreadPool::GetInstance();
+    BoundingVolumeHierarchy tree;
+    const int builds = 5;
+    double singleMs = 0.0;
+    for (unsigned int threads : { 1u, pool->GetThreadCount() }) {
+        pool->SetThreadLimit(threads);
+        auto start = std::chrono::steady_clock::now();
+        for (int b = 0; b < builds; b++)
+            tree.Build(spheres.data(), count);
+        double ms = SecondsSince(start) * 1000.0 / builds;
+        if (threads == 1)
+            singleMs = ms;
+        std::cout << count << " spheres, build on " << threads << (threads == 1 ? " thread: " : " threads: ") << ms << " ms (" << singleMs / ms << "x), " << tree.GetNodeCount() << " nodes" << std::endl;
+    }
+    pool->SetThreadLimit(0);
+
+    // Refit at the simulation rate while the rocks orbit, until the tree asks for a rebuild.
+    {
+        const int ticks = 600;
+        double refitMs = 0.0;
+        int refits = 0, rebuilds = 0;
+        for (int t = 1; t <= ticks; t++) {
+            place(t / 60.0f);
+            auto start = std::chrono::steady_clock::now();
+            bool built = tree.Update(spheres.data(), count);
+            double ms = SecondsSince(start) * 1000.0;
+            if (built) {
+                rebuilds++;
+            }
+            else {
+                refitMs += ms;
+                refits++;
+            }
+        }
+        std::cout << ticks << " ticks of orbiting: refit " << (refits > 0 ? refitMs / refits : 0.0) << " ms, " << rebuilds << " rebuilds, cost growth now " << tree.GetCostGrowth() << std::endl;
+    }
+
+    std::mt19937 generator(49);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto randomPoint = [&]() {
+        float radius = settings.outerRadius * 1.2f;
+        return DirectX::XMFLOAT3(radius * uniform(generator), settings.thickness * 2.0f * uniform(generator), radius * uniform(generator));
+    };
+    auto report = [&](const char* name, int queries, double treeMs, double bruteMs, size_t found, bool same) {
+        std::cout << name << ": tree " << treeMs * 1000.0 / queries << " us, brute force " << bruteMs * 1000.0 / queries << " us per query (" << bruteMs / treeMs <<
+            "x), " << static_cast<double>(found) / queries << " found, " << (same ? "same" : "different") << " results" << std::endl;
+    };
+
+    // Rays through the belt (picking).
+    {
+        const int queries = 1000;
+        double treeMs = 0.0, bruteMs = 0.0;
+        size_t hits = 0;
+        bool same = true;
+        for (int q = 0; q < queries; q++) {
+            DirectX::XMFLOAT3 origin = randomPoint();
+            DirectX::XMVECTOR from = DirectX::XMLoadFloat3(&origin);
+            DirectX::XMFLOAT3 target = randomPoint();
+            DirectX::XMVECTOR direction = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&target), from));
+            DirectX::XMFLOAT3 d;
+            DirectX::XMStoreFloat3(&d, direction);
+
+            auto start = std::chrono::steady_clock::now();
+            float distance;
+            uint32_t hit = tree.Raycast(from, direction, FLT_MAX, &distance);
+            treeMs += SecondsSince(start) * 1000.0;
+
+            start = std::chrono::steady_clock::now();
+            float nearest = FLT_MAX;
+            uint32_t nearestItem = BoundingVolumeHierarchy::NoItem;
+            for (size_t i = 0; i < count; i++) {
+                float ox = origin.x - spheres[i].center.x, oy = origin.y - spheres[i].center.y, oz = origin.z - spheres[i].center.z;
+                float b = ox * d.x + oy * d.y + oz * d.z;
+                float c = ox * ox + oy * oy + oz * oz - spheres[i].radius * spheres[i].radius;
+                float discriminant = b * b - c;
+                if (c > 0.0f && (b > 0.0f || discriminant < 0.0f))
+                    continue;
+                float t = c <= 0.0f ? 0.0f : -b - std::sqrt(discriminant);
+                if (t < nearest) {
+                    nearest = t;
+                    nearestItem = static_cast<uint32_t>(i);
+                }
+            }
+            bruteMs += SecondsSince(start) * 1000.0;
+            hits += hit != BoundingVolumeHierarchy::NoItem ? 1 : 0;
+            // Overlapping rocks tie, and the distances may differ in the last bits (contracted multiply-adds).
+            same = same && (hit == nearestItem || (hit != BoundingVolumeHierarchy::NoItem && std::abs(nearest - distance) < 1e-4f));
+        }
+        report("Rays", queries, treeMs, bruteMs, hits, same);
+    }
+
+    // Ship-sized spheres (collision).
+    {
+        const int queries = 1000;
+        double treeMs = 0.0, bruteMs = 0.0;
+        size_t found = 0;
+        bool same = true;
+        std::vector<uint32_t> treeFound, bruteFound;
+        for (int q = 0; q < queries; q++) {
+            BoundingSphere ship = { randomPoint(), 0.05f };
+            treeFound.clear();
+            auto start = std::chrono::steady_clock::now();
+            tree.QuerySphere(ship, treeFound);
+            treeMs += SecondsSince(start) * 1000.0;
+
+            bruteFound.clear();
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                float x = spheres[i].center.x - ship.center.x, y = spheres[i].center.y - ship.center.y, z = spheres[i].center.z - ship.center.z;
+                float reach = spheres[i].radius + ship.radius;
+                if (x * x + y * y + z * z <= reach * reach)
+                    bruteFound.push_back(static_cast<uint32_t>(i));
+            }
+            bruteMs += SecondsSince(start) * 1000.0;
+            std::sort(treeFound.begin(), treeFound.end());
+            same = same && treeFound == bruteFound;
+            found += treeFound.size();
+        }
+        report("Spheres", queries, treeMs, bruteMs, found, same);
+    }
+
+    // Views from inside and above the belt (culling).
+    {
+        const int queries = 100;
+        double treeMs = 0.0, bruteMs = 0.0;
+        size_t found = 0;
+        bool same = true;
+        std::vector<uint32_t> treeFound, bruteFound;
+        DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.01f, 4.0f);
+        for (int q = 0; q < queries; q++) {
+            DirectX::XMFLOAT3 eye = randomPoint();
+            DirectX::XMFLOAT3 target = randomPoint();
+            DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMLoadFloat3(&eye), DirectX::XMLoadFloat3(&target), DirectX::XMVectorSet(0, 1, 0, 0));
+            Frustum frustum = Frustum::FromViewProjection(view * projection);
+            treeFound.clear();
+            auto start = std::chrono::steady_clock::now();
+            tree.QueryFrustum(frustum, treeFound);
+            treeMs += SecondsSince(start) * 1000.0;
+
+            bruteFound.clear();
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < count; i++) {
+                bool visible = true;
+                for (int p = 0; p < 6 && visible; p++) {
+                    const DirectX::XMFLOAT4& plane = frustum.planes[p];
+                    visible = plane.x * spheres[i].center.x + plane.y * spheres[i].center.y + plane.z * spheres[i].center.z + plane.w >= -spheres[i].radius;
+                }
+                if (visible)
+                    bruteFound.push_back(static_cast<uint32_t>(i));
+            }
+            bruteMs += SecondsSince(start) * 1000.0;
+            std::sort(treeFound.begin(), treeFound.end());
+            same = same && treeFound == bruteFound;
+            found += treeFound.size();
+        }
+        report("Frustums", queries, treeMs, bruteMs, found, same);
+    }
+}
+
+void EngineBenchmarks::FrustumCulling()
+{
+    std::cout << "--- Frustum culling ---" << std::endl;
+    std::cout << "8-wide path: " << (FrustumCuller::HasVectorPath() ? "yes" : "no") << std::endl;
+
+    std::mt19937 generator(50);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    DirectX::XMMATRIX projection = DirectX::XMMatrixPerspectiveFovLH(1.0f, 16.0f / 9.0f, 0.1f, 100.0f);
+    for (size_t count : { 100, 1000, 10000, 100000 }) {
+        // Bodies spread around the camera, about a quarter of them is in view.
+        std::vector<BoundingSphere> spheres(count);
+        FrustumCuller culler;
+        culler.Reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            spheres[i].center = DirectX::XMFLOAT3(50.0f * uniform(generator), 10.0f * uniform(generator), 50.0f * uniform(generator));
+            spheres[i].radius = 0.1f + 0.4f * std::abs(uniform(generator));
+            culler.AddSphere(spheres[i]);
+        }
+        BoundingVolumeHierarchy tree;
+        tree.Build(spheres.data(), count);
+
+        const int views = std::max(100, static_cast<int>(1000000 / count));
+        double scalarMs = 0.0, vectorMs = 0.0, treeMs = 0.0;
+        size_t visible = 0;
+        bool same = true;
+        std::vector<uint32_t> scalarFound, vectorFound, treeFound;
+        for (int v = 0; v < views; v++) {
+            float angle = DirectX::XM_2PI * v / views;
+            DirectX::XMVECTOR target = DirectX::XMVectorSet(std::cos(angle), 0.1f * uniform(generator), std::sin(angle), 1.0f);
+            DirectX::XMMATRIX view = DirectX::XMMatrixLookAtLH(DirectX::XMVectorSet(0, 0, 0, 1), target, DirectX::XMVectorSet(0, 1, 0, 0));
+            Frustum frustum = Frustum::FromViewProjection(view * projection);
+
+            auto start = std::chrono::steady_clock::now();
+            culler.CullScalar(frustum, scalarFound);
+            scalarMs += SecondsSince(start) * 1000.0;
+
+            start = std::chrono::steady_clock::now();
+            culler.Cull(frustum, vectorFound);
+            vectorMs += SecondsSince(start) * 1000.0;
+
+            treeFound.clear();
+            start = std::chrono::steady_clock::now();
+            tree.QueryFrustum(frustum, treeFound);
+            treeMs += SecondsSince(start) * 1000.0;
+
+            std::sort(treeFound.begin(), treeFound.end());
+            same = same && scalarFound == vectorFound && treeFound == vectorFound;
+            visible += vectorFound.size();
+        }
+        std::cout << count << " spheres, " << 100.0 * visible / (static_cast<double>(views) * count) << "% visible: scalar " << scalarMs * 1000.0 / views <<
+            " us, 8-wide " << vectorMs * 1000.0 / views << " us (" << scalarMs / vectorMs << "x), tree " << treeMs * 1000.0 / views << " us, " <<
+            (same ? "same" : "different") << " results" << std::endl;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+// Headless CPU benchmarks of engine systems, started with "-benchmark <name>" on the command line
+// ("-benchmark all" runs every one of them). Results are printed to the console.
+class EngineBenchmarks
+{
+public:
+    // Returns false when no benchmark of that name exists.
+    static bool Run(const std::string& name);
+
+private:
+    // Surface height/normal queries: throughput of baked and exact lookups and the error between them.
+    static void SurfaceQueries();
+    // Crater field: spatial hash vs. visiting every crater, for growing crater counts.
+    static void CraterFields();
+    // Erosion at load: bake time with and without it, and whether two runs give the same elevations.
+    static void Erosion();
+    // Animated star: 4D noise throughput and the cost of one frame of the animation vs. a full update.
+    static void SunAnimations();
+    // Noise library: throughput of every basis, fractal mode and precision.
+    static void NoiseTiers();
+    // Planet configurations per second with the portable and the legacy seed derivation.
+    static void SeedDerivations();
+    // Batched configuration generation (structure of arrays, worker threads) vs. one call per body.
+    static void ConfigurationBatches();
+    // Galaxy streaming along a flight path: resident systems, generation latency, memory and eviction.
+    static void GalaxyStreaming();
+    // Baked galaxy database: bake throughput, nearest-system queries against brute force and streaming.
+    static void GalaxyDatabaseQueries();
+    // Elevation bakes in worker processes vs. the in-process thread pool, with one worker killed midway.
+    static void GenerationWorkers();
+    // Asteroid field: cost of writing the instance transforms of a frame for growing rock counts.
+    static void AsteroidFields();
+    // Orbit simulation: bodies per millisecond of the scalar and the 8-wide path, and their difference.
+    static void OrbitUpdates();
+    // Barnes-Hut gravity: step time for 1k to 1M bodies, force error per opening angle and energy drift.
+    static void NBodyGravity();
+    // Planet rings: near particles, update time and upload per frame for cameras from far away to inside the ring.
+    static void PlanetRings();
+    // Scene update: the entity world, serial and on the thread pool, vs. the former array of engine objects.
+    static void EntityUpdates();
+    // Batched world/WVP matrices: entities per millisecond of every path and their difference to the scalar one.
+    static void TransformBatches();
+    // Scene systems of a frame as jobs on the thread pool: frame time for 1 thread up to all of them.
+    static void SceneUpdateScaling();
+    // Change tracking: frame time and skipped uploads with few or no moving entities and a still or moving camera.
+    static void DirtyTracking();
+    // Closed-form orbits: drift against the per-frame turn, Kepler solver accuracy, cost at any time warp.
+    static void KeplerOrbits();
+    // Fixed-rate simulation thread: tick cost, interpolating frame cost and latency at several frame rates.
+    static void SimulationThread();
+    // Render thread: frame time with the packet recorded after the update and while the next frame is updated.
+    static void RenderThreadOverlap();
+    // Transform hierarchy: full and sparse propagation and re-parenting of the flat arrays vs. a pointer tree.
+    static void HierarchyPropagation();
+    // Bounding volume hierarchy over 100k asteroids: build, refit and ray, sphere and frustum queries vs. brute force.
+    static void BoundingVolumes();
+    // Frustum culling of scenes from 100 to 100k spheres: one at a time, eight at a time and the tree.
+    static void FrustumCulling();
+};
@@ -0,0 +1,393 @@
+#include "stdafx.h"
+#include "BoundingVolumeHierarchy.h"
+
+#include "ThreadPool.h"
+
+constexpr float BoundingVolumeHierarchy::RebuildCostGrowth;
+
+namespace
+{
+    struct Box
+    {
+        float min[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float max[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+        void Grow(const BoundingSphere& sphere)
+        {
+            const float center[3] = { sphere.center.x, sphere.center.y, sphere.center.z };
+            for (int a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], center[a] - sphere.radius);
+                max[a] = std::max(max[a], center[a] + sphere.radius);
+            }
+        }
+
+        void Grow(const Box& box)
+        {
+            for (int a = 0; a < 3; a++) {
+                min[a] = std::min(min[a], box.min[a]);
+                max[a] = std::max(max[a], box.max[a]);
+            }
+        }
+
+        float Area() const
+        {
+            float x = max[0] - min[0], y = max[1] - min[1], z = max[2] - min[2];
+            return x < 0.0f ? 0.0f : 2.0f * (x * y + y * z + z * x);
+        }
+    };
+
+    float Component(const DirectX::XMFLOAT3& vector, int axis)
+    {
+        return axis == 0 ? vector.x : axis == 1 ? vector.y : vector.z;
+    }
+}
+
+Frustum Frustum::FromViewProjection(DirectX::FXMMATRIX viewProjection)
+{
+    // A clip coordinate is the dot product of the point with a column of the matrix.
+    DirectX::XMMATRIX columns = DirectX::XMMatrixTranspose(viewProjection);
+    DirectX::XMVECTOR planes[6] = {
+        DirectX::XMVectorAdd(columns.r[3], columns.r[0]),         // Left: -w <= x.
+        DirectX::XMVectorSubtract(columns.r[3], columns.r[0]),    // Right: x <= w.
+        DirectX::XMVectorAdd(columns.r[3], columns.r[1]),         // Bottom.
+        DirectX::XMVectorSubtract(columns.r[3], columns.r[1]),    // Top.
+        columns.r[2],                                             // Near: 0 <= z.
+        DirectX::XMVectorSubtract(columns.r[3], columns.r[2])     // Far: z <= w.
+    };
+    Frustum frustum;
+    for (int p = 0; p < 6; p++) {
+        float length = DirectX::XMVectorGetX(DirectX::XMVector3Length(planes[p]));
+        DirectX::XMStoreFloat4(&frustum.planes[p], DirectX::XMVectorScale(planes[p], 1.0f / length));
+    }
+    return frustum;
+}
+
+void BoundingVolumeHierarchy::Build(const BoundingSphere* spheres, size_t count)
+{
+    this->spheres.assign(spheres, spheres + count);
+    items.resize(count);
+    for (size_t i = 0; i < count; i++)
+        items[i] = static_cast<uint32_t>(i);
+    nodes.clear();
+    cost = 0.0f;
+    builtCost = 0.0f;
+    if (count == 0)
+        return;
+
+    // The top of the tree on this thread, down to enough subtrees for every thread to take a few.
+    ThreadPool* pool = ThreadPool::GetInstance();
+    uint32_t taskSize = std::max(1024u, static_cast<uint32_t>(count / (4 * pool->GetThreadCount())));
+    std::vector<BuildTask> tasks;
+    nodes.reserve(2 * count / MaxLeafItems + 1);
+    nodes.resize(1);
+    BuildNode(nodes, 0, 0, static_cast<uint32_t>(count), 0, taskSize, pool->GetThreadCount() > 1 ? &tasks : nullptr);
+
+    if (!tasks.empty()) {
+        std::vector<std::vector<Node>> subtrees(tasks.size());
+        pool->ParallelFor(tasks.size(), [&](size_t t) {
+            subtrees[t].reserve(2 * tasks[t].count / MaxLeafItems + 1);
+            subtrees[t].resize(1);
+            BuildNode(subtrees[t], 0, tasks[t].first, tasks[t].count, tasks[t].depth, 0, nullptr);
+        });
+        // Appended behind the top, so children still come after their parents. The subtree root takes
+        // the place of the task.
+        for (size_t t = 0; t < tasks.size(); t++) {
+            uint32_t offset = static_cast<uint32_t>(nodes.size()) - 1;
+            for (size_t n = 0; n < subtrees[t].size(); n++) {
+                Node node = subtrees[t][n];
+                if (node.count == 0)
+                    node.first += offset;
+                if (n == 0)
+                    nodes[tasks[t].node] = node;
+                else
+                    nodes.push_back(node);
+            }
+        }
+    }
+
+    Refit(this->spheres.data());
+    builtCost = cost;
+}
+
+void BoundingVolumeHierarchy::Refit(const BoundingSphere* spheres)
+{
+    if (spheres != this->spheres.data())
+        std::copy(spheres, spheres + this->spheres.size(), this->spheres.begin());
+    if (nodes.empty())
+        return;
+
+    // Children come after their parents, so backwards every node finds the boxes of its children done.
+    // The cost adds up the areas of the nodes a random ray would visit, a leaf for each of its items.
+    float area = 0.0f;
+    for (size_t n = nodes.size(); n-- > 0;) {
+        Node& node = nodes[n];
+        Box box;
+        if (node.count > 0) {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+                box.Grow(this->spheres[items[i]]);
+        }
+        else {
+            for (uint32_t c = node.first; c <= node.first + 1; c++) {
+                const Node& child = nodes[c];
+                Box childBox;
+                memcpy(childBox.min, &child.min, sizeof(childBox.min));
+                memcpy(childBox.max, &child.max, sizeof(childBox.max));
+                box.Grow(childBox);
+            }
+        }
+        memcpy(&node.min, box.min, sizeof(node.min));
+        memcpy(&node.max, box.max, sizeof(node.max));
+        area += box.Area() * std::max(node.count, 1u);
+    }
+    Box root;
+    memcpy(root.min, &nodes[0].min, sizeof(root.min));
+    memcpy(root.max, &nodes[0].max, sizeof(root.max));
+    cost = root.Area() > 0.0f ? area / root.Area() : 0.0f;
+}
+
+bool BoundingVolumeHierarchy::Update(const BoundingSphere* spheres, size_t count)
+{
+    if (count != this->spheres.size() || nodes.empty()) {
+        Build(spheres, count);
+        return true;
+    }
+    Refit(spheres);
+    if (GetCostGrowth() > RebuildCostGrowth) {
+        Build(spheres, count);
+        return true;
+    }
+    return false;
+}
+
+void BoundingVolumeHierarchy::BuildNode(std::vector<Node>& out, uint32_t node, uint32_t first, uint32_t count, uint32_t depth, uint32_t taskSize, std::vector<BuildTask>* tasks)
+{
+    if (count <= MaxLeafItems) {
+        out[node].first = first;
+        out[node].count = count;
+        return;
+    }
+    if (tasks != nullptr && count <= taskSize) {
+        BuildTask task = { node, first, count, depth };
+        tasks->push_back(task);
+        return;
+    }
+
+    uint32_t leftCount = Partition(first, count, depth);
+    uint32_t children = static_cast<uint32_t>(out.size());
+    out.resize(out.size() + 2);
+    out[node].first = children;
+    out[node].count = 0;
+    BuildNode(out, children, first, leftCount, depth + 1, taskSize, tasks);
+    BuildNode(out, children + 1, first + leftCount, count - leftCount, depth + 1, taskSize, tasks);
+}
+
+uint32_t BoundingVolumeHierarchy::Partition(uint32_t first, uint32_t count, uint32_t depth)
+{
+    // Split along the longest extent of the centres.
+    Box centers;
+    for (uint32_t i = first; i < first + count; i++) {
+        BoundingSphere center = { spheres[items[i]].center, 0.0f };
+        centers.Grow(center);
+    }
+    int axis = 0;
+    for (int a = 1; a < 3; a++) {
+        if (centers.max[a] - centers.min[a] > centers.max[axis] - centers.min[axis])
+            axis = a;
+    }
+    float extent = centers.max[axis] - centers.min[axis];
+    // All centres in one spot: any split is as good as another.
+    if (extent <= 0.0f)
+        return count / 2;
+
+    std::vector<uint32_t>::iterator begin = items.begin() + first;
+    std::vector<uint32_t>::iterator end = begin + count;
+    auto median = [&]() {
+        std::nth_element(begin, begin + count / 2, end, [&](uint32_t left, uint32_t right) {
+            return Component(spheres[left].center, axis) < Component(spheres[right].center, axis);
+        });
+        return count / 2;
+    };
+    if (depth >= SurfaceAreaDepth)
+        return median();
+
+    // Binned surface area heuristic: the split between two bins with the least area times items.
+    float scale = BinCount / extent;
+    auto binOf = [&](uint32_t item) {
+        return std::min(BinCount - 1, static_cast<int>((Component(spheres[item].center, axis) - centers.min[axis]) * scale));
+    };
+    Box bins[BinCount];
+    uint32_t binCounts[BinCount] = {};
+    for (uint32_t i = first; i < first + count; i++) {
+        int bin = binOf(items[i]);
+        bins[bin].Grow(spheres[items[i]]);
+        binCounts[bin]++;
+    }
+    float rightCosts[BinCount] = {};
+    Box right;
+    uint32_t rightCount = 0;
+    for (int b = BinCount - 1; b > 0; b--) {
+        right.Grow(bins[b]);
+        rightCount += binCounts[b];
+        rightCosts[b] = right.Area() * rightCount;
+    }
+    Box left;
+    uint32_t leftCount = 0;
+    float bestCost = FLT_MAX;
+    int bestSplit = -1;
+    for (int b = 0; b < BinCount - 1; b++) {
+        left.Grow(bins[b]);
+        leftCount += binCounts[b];
+        float splitCost = left.Area() * leftCount + rightCosts[b + 1];
+        if (leftCount > 0 && leftCount < count && splitCost < bestCost) {
+            bestCost = splitCost;
+            bestSplit = b;
+        }
+    }
+    if (bestSplit < 0)
+        return median();
+
+    std::vector<uint32_t>::iterator split = std::partition(begin, end, [&](uint32_t item) { return binOf(item) <= bestSplit; });
+    return static_cast<uint32_t>(split - begin);
+}
+
+uint32_t BoundingVolumeHierarchy::Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, float* distance) const
+{
+    DirectX::XMFLOAT3 o, d;
+    DirectX::XMStoreFloat3(&o, origin);
+    DirectX::XMStoreFloat3(&d, direction);
+    const float from[3] = { o.x, o.y, o.z };
+    // Infinite for an axis the ray runs parallel to, the slab test still works out.
+    const float inverse[3] = { 1.0f / d.x, 1.0f / d.y, 1.0f / d.z };
+
+    float nearest = maxDistance;
+    uint32_t hit = NoItem;
+    uint32_t stack[MaxDepth + 1];
+    int top = 0;
+    if (!nodes.empty())
+        stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        const float* min = &node.min.x;
+        const float* max = &node.max.x;
+        float enter = 0.0f, leave = nearest;
+        for (int a = 0; a < 3; a++) {
+            float t0 = (min[a] - from[a]) * inverse[a];
+            float t1 = (max[a] - from[a]) * inverse[a];
+            enter = std::max(enter, std::min(t0, t1));
+            leave = std::min(leave, std::max(t0, t1));
+        }
+        if (enter > leave)
+            continue;
+
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            const BoundingSphere& sphere = spheres[items[i]];
+            float ox = o.x - sphere.center.x, oy = o.y - sphere.center.y, oz = o.z - sphere.center.z;
+            float b = ox * d.x + oy * d.y + oz * d.z;
+            float c = ox * ox + oy * oy + oz * oz - sphere.radius * sphere.radius;
+            float t;
+            if (c <= 0.0f) {
+                t = 0.0f;
+            }
+            else {
+                float discriminant = b * b - c;
+                if (b > 0.0f || discriminant < 0.0f)
+                    continue;
+                t = -b - std::sqrt(discriminant);
+            }
+            if (t <= nearest) {
+                nearest = t;
+                hit = items[i];
+            }
+        }
+    }
+    if (distance != nullptr)
+        *distance = nearest;
+    return hit;
+}
+
+void BoundingVolumeHierarchy::QuerySphere(const BoundingSphere& sphere, std::vector<uint32_t>& found) const
+{
+    const float center[3] = { sphere.center.x, sphere.center.y, sphere.center.z };
+    uint32_t stack[MaxDepth + 1];
+    int top = 0;
+    if (!nodes.empty())
+        stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        const float* min = &node.min.x;
+        const float* max = &node.max.x;
+        // Squared distance from the centre to the box.
+        float distanceSq = 0.0f;
+        for (int a = 0; a < 3; a++) {
+            float outside = std::max(min[a] - center[a], center[a] - max[a]);
+            if (outside > 0.0f)
+                distanceSq += outside * outside;
+        }
+        if (distanceSq > sphere.radius * sphere.radius)
+            continue;
+
+        if (node.count == 0) {
+            stack[top++] = node.first;
+            stack[top++] = node.first + 1;
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            const BoundingSphere& other = spheres[items[i]];
+            float x = other.center.x - center[0], y = other.center.y - center[1], z = other.center.z - center[2];
+            float reach = other.radius + sphere.radius;
+            if (x * x + y * y + z * z <= reach * reach)
+                found.push_back(items[i]);
+        }
+    }
+}
+
+void BoundingVolumeHierarchy::QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& found) const
+{
+    // Subtrees entirely inside are taken without further tests, marked in the top bit of the stack entry.
+    const uint32_t Inside = 0x80000000u;
+    uint32_t stack[MaxDepth + 1];
+    int top = 0;
+    if (!nodes.empty())
+        stack[top++] = 0;
+    while (top > 0) {
+        uint32_t entry = stack[--top];
+        const Node& node = nodes[entry & ~Inside];
+        bool inside = (entry & Inside) != 0;
+        if (!inside) {
+            float center[3] = { 0.5f * (node.min.x + node.max.x), 0.5f * (node.min.y + node.max.y), 0.5f * (node.min.z + node.max.z) };
+            float extent[3] = { 0.5f * (node.max.x - node.min.x), 0.5f * (node.max.y - node.min.y), 0.5f * (node.max.z - node.min.z) };
+            bool outside = false;
+            inside = true;
+            for (int p = 0; p < 6 && !outside; p++) {
+                const DirectX::XMFLOAT4& plane = frustum.planes[p];
+                float distance = plane.x * center[0] + plane.y * center[1] + plane.z * center[2] + plane.w;
+                float reach = std::abs(plane.x) * extent[0] + std::abs(plane.y) * extent[1] + std::abs(plane.z) * extent[2];
+                outside = distance + reach < 0.0f;
+                inside = inside && distance - reach >= 0.0f;
+            }
+            if (outside)
+                continue;
+        }
+
+        if (node.count == 0) {
+            stack[top++] = node.first | (inside ? Inside : 0);
+            stack[top++] = (node.first + 1) | (inside ? Inside : 0);
+            continue;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+            const BoundingSphere& sphere = spheres[items[i]];
+            bool visible = true;
+            for (int p = 0; p < 6 && visible && !inside; p++) {
+                const DirectX::XMFLOAT4& plane = frustum.planes[p];
+                visible = plane.x * sphere.center.x + plane.y * sphere.center.y + plane.z * sphere.center.z + plane.w >= -sphere.radius;
+            }
+            if (visible)
+                found.push_back(items[i]);
+        }
+    }
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <vector>
+
+struct BoundingSphere
+{
+    DirectX::XMFLOAT3 center;
+    float radius;
+};
+
+// The six planes of a view frustum with their normals pointing inwards: a point p is inside when
+// dot(plane.xyz, p) + plane.w >= 0 for every plane. The normals are unit length, so that is the distance.
+struct Frustum
+{
+    DirectX::XMFLOAT4 planes[6];
+
+    // From a view * projection matrix (row vectors, depth from 0 to 1 as in Direct3D).
+    static Frustum FromViewProjection(DirectX::FXMMATRIX viewProjection);
+};
+
+// Broad phase over bounding spheres: a binary tree of axis-aligned boxes, built with the surface area
+// heuristic. Culling, picking and collision ask it for the spheres near a frustum, a ray or another
+// sphere instead of testing all of them.
+// Moving spheres (orbiting bodies, the asteroids) keep the tree and only refit its boxes, which is one
+// linear pass. A refit tree gets looser as the spheres drift away from the ones it was built for; Update()
+// builds it anew once its surface area cost grew too much. The subtrees of a build are built in parallel.
+// Items are the indices of the spheres in the array handed to Build().
+class BoundingVolumeHierarchy
+{
+public:
+    static const uint32_t NoItem = UINT32_MAX;
+    static const uint32_t MaxLeafItems = 4;
+    // Refitting is fine until the surface area cost is this many times the one of a fresh build.
+    static constexpr float RebuildCostGrowth = 1.5f;
+
+    BoundingVolumeHierarchy() = default;
+
+    void Build(const BoundingSphere* spheres, size_t count);
+    // New boxes for the same items, moved to the given spheres (as many as were built).
+    void Refit(const BoundingSphere* spheres);
+    // Refits, or builds when the count changed or the refit tree got too costly. True when it built.
+    bool Update(const BoundingSphere* spheres, size_t count);
+
+    // Nearest sphere the ray (unit direction) enters within maxDistance, NoItem if there is none.
+    // A ray starting inside a sphere hits it at distance 0.
+    uint32_t Raycast(DirectX::FXMVECTOR origin, DirectX::FXMVECTOR direction, float maxDistance, float* distance = nullptr) const;
+    // Appends the items whose spheres overlap the sphere.
+    void QuerySphere(const BoundingSphere& sphere, std::vector<uint32_t>& found) const;
+    // Appends the items whose spheres are at least partly inside the frustum.
+    void QueryFrustum(const Frustum& frustum, std::vector<uint32_t>& found) const;
+
+    size_t GetItemCount() const { return spheres.size(); }
+    size_t GetNodeCount() const { return nodes.size(); }
+    // Surface area cost against the one after the last build.
+    float GetCostGrowth() const { return builtCost > 0.0f ? cost / builtCost : 1.0f; }
+
+private:
+    // Inner nodes: count is 0 and the children are first and first + 1, always after their parent.
+    // Leaves: the items [first, first + count) of items.
+    struct Node
+    {
+        DirectX::XMFLOAT3 min;
+        uint32_t first;
+        DirectX::XMFLOAT3 max;
+        uint32_t count;
+    };
+    // A subtree left for the parallel part of a build.
+    struct BuildTask
+    {
+        uint32_t node;
+        uint32_t first;
+        uint32_t count;
+        uint32_t depth;
+    };
+
+    static const int BinCount = 16;
+    // Below this the splits are by the median, which bounds the depth (and the traversal stacks).
+    static const uint32_t SurfaceAreaDepth = 32;
+    static const int MaxDepth = 64;
+
+    // Splits the items [first, first + count) below node into out. Subtrees smaller than taskSize go to
+    // tasks instead when there is a task list.
+    void BuildNode(std::vector<Node>& out, uint32_t node, uint32_t first, uint32_t count, uint32_t depth, uint32_t taskSize, std::vector<BuildTask>* tasks);
+    uint32_t Partition(uint32_t first, uint32_t count, uint32_t depth);
+
+    std::vector<Node> nodes;
+    std::vector<uint32_t> items;
+    std::vector<BoundingSphere> spheres;    // By item.
+    float cost = 0.0f;
+    float builtCost = 0.0f;
+};
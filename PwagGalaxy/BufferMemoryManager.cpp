@@ -72,6 +72,24 @@ void BufferMemoryManager::FillBuffer(ComPtr<ID3D12Resource>& bufferResource, D3D
     }
 }
 
+void BufferMemoryManager::FillBuffer(ComPtr<ID3D12Resource>& bufferResource, const std::vector<D3D12_SUBRESOURCE_DATA>& data, ComPtr<ID3D12Resource>& uploadBufferResource, D3D12_RESOURCE_STATES finalBufferState, bool forceFlushAndWait)
+{
+    usedResources.push_back(uploadBufferResource);
+
+    UpdateSubresources(commandList.Get(), bufferResource.Get(), usedResources.back().Get(), 0, 0, static_cast<UINT>(data.size()), data.data());
+    CD3DX12_RESOURCE_BARRIER transitionBarrier = CD3DX12_RESOURCE_BARRIER::Transition(bufferResource.Get(), D3D12_RESOURCE_STATE_COPY_DEST, finalBufferState);
+    commandList->ResourceBarrier(1, &transitionBarrier);
+
+    cmdNeedsFlushing = true;
+    cmdNeedsResetting = true;
+
+    if (forceFlushAndWait)
+    {
+        FlushAndWait();
+        ResetCommandListAndAllocator();
+    }
+}
+
 void BufferMemoryManager::Initialize()
 {
     // Describe and create the command queue.
@@ -26,6 +26,13 @@ public:
         ComPtr<ID3D12Resource>& uploadBufferResource,
         D3D12_RESOURCE_STATES finalBufferState,
         bool forceFlushAndWait = false);
+    // Same as above for resources with several subresources (e.g. the six faces of a cube map).
+    void FillBuffer(
+        ComPtr<ID3D12Resource>& bufferResource,
+        const std::vector<D3D12_SUBRESOURCE_DATA>& data,
+        ComPtr<ID3D12Resource>& uploadBufferResource,
+        D3D12_RESOURCE_STATES finalBufferState,
+        bool forceFlushAndWait = false);
 private:
     // Initialize static members of the class.
     static void Initialize();
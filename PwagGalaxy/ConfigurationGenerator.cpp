@@ -1,22 +1,109 @@
 #include "stdafx.h"
 #include "ConfigurationGenerator.h"
 
-#include <iomanip>
-#include <sstream>
+#include "ThreadPool.h"
 #include <string>
 
+namespace
+{
+    // Lowercase hex digits of a value, all 16 of them or without leading zeros (as std::hex prints).
+    void AppendHex(std::string& text, uint64_t value, bool allDigits)
+    {
+        const char digits[] = "0123456789abcdef";
+        int shift = 60;
+        if (!allDigits) {
+            while (shift > 0 && ((value >> shift) & 0xf) == 0)
+                shift -= 4;
+        }
+        for (; shift >= 0; shift -= 4)
+            text += digits[(value >> shift) & 0xf];
+    }
+
+    uint32_t ParseHex(const char* text, int length)
+    {
+        uint32_t value = 0;
+        for (int i = 0; i < length; i++) {
+            char c = text[i];
+            uint32_t digit;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else break;
+            value = (value << 4) | digit;
+        }
+        return value;
+    }
+}
+
+ConfigurationGenerator::ConfigurationGenerator(SeedDerivation derivation) :
+    derivation(derivation)
+{
+    // Batches store the layers inline, more would be cut off silently.
+    if (planetSettings.numberOfLayers.max > PlanetConfigurationBatch::MaxLayers)
+        throw "Planet settings allow more layers than a configuration batch holds!";
+}
+
+uint64_t ConfigurationGenerator::Hash64(const char* data, size_t length, uint64_t seed) {
+    uint64_t hash = 0xcbf29ce484222325ull ^ seed;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ull;
+    }
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint64_t ConfigurationGenerator::CounterRandom(uint64_t key, uint64_t counter) {
+    uint64_t z = key + (counter + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+ProbabilityTable ConfigurationGenerator::GenerateProbabilityTable(uint64_t key, uint64_t stream) {
+    ProbabilityTable probability;
+    for (int i = 0; i < ProbabilityTable::Size; i++) {
+        uint32_t value = static_cast<uint32_t>(CounterRandom(key, stream * ProbabilityTable::Size + i) >> 32);
+        probability.values[i] = static_cast<float>(value) / static_cast<float>(UINT32_MAX);
+    }
+    return probability;
+}
+
 std::string ConfigurationGenerator::GenerateSeed(std::string key) {
-    std::hash<std::string> hasher;
-    size_t hashValue = hasher(key);
+    if (derivation == SeedDerivation::Legacy)
+        return GenerateSeedLegacy(key);
 
-    std::stringstream ss;
-    ss << std::hex << hashValue;
-    std::string hashString = ss.str();
+    char seed[64];
+    FormatSeed(Hash64(key.data(), key.size()), seed);
+    return std::string(seed, sizeof(seed));
+}
 
-    while (hashString.length() < 64) {
+void ConfigurationGenerator::FormatSeed(uint64_t key, char (&seed)[64]) {
+    const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 4; i++) {
+        uint64_t value = CounterRandom(key, i);
+        for (int digit = 0; digit < 16; digit++)
+            seed[i * 16 + digit] = digits[(value >> (60 - digit * 4)) & 0xf];
+    }
+}
+
+uint64_t ConfigurationGenerator::CraterKey(const char* seed, size_t length) {
+    const char stream[] = "craters";
+    return Hash64(seed, length, Hash64(stream, sizeof(stream) - 1));
+}
+
+std::string ConfigurationGenerator::GenerateSeedLegacy(const std::string& key) {
+    std::hash<std::string> hasher;
+    std::string hashString;
+    AppendHex(hashString, hasher(key), false);
 
-        ss << std::hex << hasher(hashString + key);
-        hashString = ss.str();
+    while (hashString.length() < 64) {
+        AppendHex(hashString, hasher(hashString + key), false);
     }
     if (hashString.length() > 64) {
         hashString = hashString.substr(hashString.length() - 64);
@@ -26,13 +113,146 @@ std::string ConfigurationGenerator::GenerateSeed(std::string key) {
 }
 
 PlanetConfiguration ConfigurationGenerator::GeneratePlanetConfiguration(std::string id, float orbit, DirectX::XMFLOAT3 starPosition) {
-	PlanetConfiguration planetConfiguration;
-
+    if (derivation == SeedDerivation::Legacy)
+        return GeneratePlanetConfigurationLegacy(id, orbit, starPosition);
 
-	planetConfiguration.id = generalSettings.planetCode + id;
+    PlanetConfiguration planetConfiguration;
+    planetConfiguration.id = generalSettings.planetCode + id;
     planetConfiguration.seed = GenerateSeed(id);
 
-    std::vector<float> probability = GenerateProbabilityTable(planetConfiguration.seed);
+    // Every group of attributes has its own stream of the body key: 0 body and orbit, 1 more orbit
+    // and the layer count, 2 + i layer i.
+    uint64_t key = Hash64(id.data(), id.size());
+    EstimateBody(planetConfiguration, GenerateProbabilityTable(key, 0), GenerateProbabilityTable(key, 1));
+    planetConfiguration.orbit = orbit + planetConfiguration.orbitEmptyRange + planetConfiguration.radius;
+    planetConfiguration.starPosition = starPosition;
+
+    planetConfiguration.layers.reserve(planetConfiguration.numberOfLayers);
+    for (int i = 0; i < planetConfiguration.numberOfLayers; i++) {
+        planetConfiguration.layers.push_back(EstimateLayer(GenerateProbabilityTable(key, 2 + i), i));
+    }
+
+    planetConfiguration.craters = GenerateCraterConfiguration(planetConfiguration.seed, planetSettings.craterDescriptor);
+
+    return planetConfiguration;
+}
+
+void PlanetConfigurationBatch::Resize(size_t count) {
+    key.resize(count);
+    exist.resize(count);
+    radius.resize(count);
+    velocity.resize(count);
+    orbitOffset.resize(count);
+    orbitInitialAngleRad.resize(count);
+    orbitEmptyRange.resize(count);
+    orbitAxis.resize(count);
+    orbitAngle.resize(count);
+    numberOfLayers.resize(count);
+    orbit.resize(count);
+    layers.resize(count);
+    craters.resize(count);
+}
+
+size_t PlanetConfigurationBatch::GetMemoryUsage() const {
+    size_t bodyBytes = sizeof(uint64_t) + sizeof(uint8_t) + 7 * sizeof(float) + sizeof(DirectX::XMFLOAT3) + sizeof(int) +
+        sizeof(Layers) + sizeof(PlanetCraterConfiguration);
+    return key.capacity() * bodyBytes;
+}
+
+void ConfigurationGenerator::GeneratePlanetConfigurations(const std::string* ids, const float* orbits, size_t count, PlanetConfigurationBatch& batch) const {
+    std::vector<uint64_t> keys(count);
+    for (size_t i = 0; i < count; i++)
+        keys[i] = Hash64(ids[i].data(), ids[i].size());
+    GeneratePlanetConfigurations(keys.data(), orbits, count, batch);
+}
+
+void ConfigurationGenerator::GeneratePlanetConfigurations(const uint64_t* keys, const float* orbits, size_t count, PlanetConfigurationBatch& batch) const {
+    batch.Resize(count);
+
+    // Chunks of bodies per job, so the scheduling cost stays small next to a few microseconds per body.
+    const size_t chunkSize = 256;
+    size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    ThreadPool::GetInstance()->ParallelFor(chunkCount, [&](size_t chunk) {
+        GenerateBatchRange(keys, orbits, chunk * chunkSize, std::min(count, (chunk + 1) * chunkSize), batch);
+    });
+}
+
+void ConfigurationGenerator::GenerateBatchRange(const uint64_t* keys, const float* orbits, size_t first, size_t last, PlanetConfigurationBatch& batch) const {
+    for (size_t i = first; i < last; i++) {
+        uint64_t key = keys[i];
+
+        // The id, seed and layers of the scratch configuration stay empty, so it never allocates.
+        PlanetConfiguration body;
+        EstimateBody(body, GenerateProbabilityTable(key, 0), GenerateProbabilityTable(key, 1));
+
+        batch.key[i] = key;
+        batch.exist[i] = body.exist ? 1 : 0;
+        batch.radius[i] = body.radius;
+        batch.velocity[i] = body.velocity;
+        batch.orbitOffset[i] = body.orbitOffset;
+        batch.orbitInitialAngleRad[i] = body.orbitInitialAngleRad;
+        batch.orbitEmptyRange[i] = body.orbitEmptyRange;
+        batch.orbitAxis[i] = body.orbitAxis;
+        batch.orbitAngle[i] = body.orbitAngle;
+        batch.orbit[i] = (orbits ? orbits[i] : 0.0f) + body.orbitEmptyRange + body.radius;
+
+        // Within MaxLayers, the constructor rejects settings that allow more.
+        int layerCount = body.numberOfLayers;
+        batch.numberOfLayers[i] = layerCount;
+        for (int l = 0; l < layerCount; l++)
+            batch.layers[i].layers[l] = EstimateLayer(GenerateProbabilityTable(key, 2 + l), l);
+
+        char seed[64];
+        FormatSeed(key, seed);
+        batch.craters[i] = EstimateCraters(GenerateProbabilityTable(CraterKey(seed, sizeof(seed)), 0), planetSettings.craterDescriptor);
+    }
+}
+
+PlanetConfiguration ConfigurationGenerator::ExpandConfiguration(const PlanetConfigurationBatch& batch, size_t index, const std::string& id, DirectX::XMFLOAT3 starPosition) const {
+    PlanetConfiguration planetConfiguration;
+    planetConfiguration.id = generalSettings.planetCode + id;
+    char seed[64];
+    FormatSeed(batch.key[index], seed);
+    planetConfiguration.seed.assign(seed, sizeof(seed));
+
+    planetConfiguration.exist = batch.exist[index] != 0;
+    planetConfiguration.radius = batch.radius[index];
+    planetConfiguration.velocity = batch.velocity[index];
+    planetConfiguration.orbitOffset = batch.orbitOffset[index];
+    planetConfiguration.orbitInitialAngleRad = batch.orbitInitialAngleRad[index];
+    planetConfiguration.orbitEmptyRange = batch.orbitEmptyRange[index];
+    planetConfiguration.orbitAxis = batch.orbitAxis[index];
+    planetConfiguration.orbitAngle = batch.orbitAngle[index];
+    planetConfiguration.numberOfLayers = batch.numberOfLayers[index];
+    planetConfiguration.orbit = batch.orbit[index];
+    planetConfiguration.starPosition = starPosition;
+    planetConfiguration.layers.assign(batch.layers[index].layers, batch.layers[index].layers + batch.numberOfLayers[index]);
+    planetConfiguration.craters = batch.craters[index];
+
+    return planetConfiguration;
+}
+
+PlanetConfiguration ConfigurationGenerator::GeneratePlanetConfigurationLegacy(std::string id, float orbit, DirectX::XMFLOAT3 starPosition) {
+    PlanetConfiguration planetConfiguration;
+    planetConfiguration.id = generalSettings.planetCode + id;
+    planetConfiguration.seed = GenerateSeedLegacy(id);
+
+    std::string seed = GenerateSeedLegacy(planetConfiguration.seed.substr(56, 8));
+    EstimateBody(planetConfiguration, GenerateProbabilityTable(planetConfiguration.seed), GenerateProbabilityTable(seed));
+    planetConfiguration.orbit = orbit + planetConfiguration.orbitEmptyRange + planetConfiguration.radius;
+    planetConfiguration.starPosition = starPosition;
+
+    for (int i = 0; i < planetConfiguration.numberOfLayers; i++) {
+        seed = GenerateSeedLegacy(seed);
+        planetConfiguration.layers.push_back(EstimateLayer(GenerateProbabilityTable(seed), i));
+    }
+
+    planetConfiguration.craters = GenerateCraterConfiguration(planetConfiguration.seed, planetSettings.craterDescriptor);
+
+    return planetConfiguration;
+}
+
+void ConfigurationGenerator::EstimateBody(PlanetConfiguration& planetConfiguration, const ProbabilityTable& probability, const ProbabilityTable& secondProbability) const {
     planetConfiguration.exist = probability[0] < planetSettings.probability;
     planetConfiguration.radius = EstimateValue(planetSettings.radius, probability[1]);
     planetConfiguration.velocity = EstimateValue(planetSettings.velocity, probability[2]);
@@ -43,44 +263,49 @@ PlanetConfiguration ConfigurationGenerator::GeneratePlanetConfiguration(std::str
     planetConfiguration.orbitAxis.x = probability[6];
     planetConfiguration.orbitAxis.y = probability[7];
 
-    std::string seed = GenerateSeed(planetConfiguration.seed.substr(56, 8));
-    probability = GenerateProbabilityTable(seed);
-    planetConfiguration.orbitAxis.z = probability[0];
-    planetConfiguration.orbitAngle = EstimateValue(planetSettings.orbitDescriptor.rotationAngle, probability[1]);
-    planetConfiguration.numberOfLayers = EstimateValue(planetSettings.numberOfLayers, probability[2]);
-    planetConfiguration.orbit = orbit + planetConfiguration.orbitEmptyRange + planetConfiguration.radius;
-    planetConfiguration.starPosition = starPosition;
+    planetConfiguration.orbitAxis.z = secondProbability[0];
+    planetConfiguration.orbitAngle = EstimateValue(planetSettings.orbitDescriptor.rotationAngle, secondProbability[1]);
+    planetConfiguration.numberOfLayers = EstimateValue(planetSettings.numberOfLayers, secondProbability[2]);
+}
 
-    for (int i = 0; i < planetConfiguration.numberOfLayers; i++) {
+PlanetSurfaceConfiguration ConfigurationGenerator::EstimateLayer(const ProbabilityTable& probability, int layer) const {
+    PlanetSurfaceConfiguration surfaceConfiguration;
+    surfaceConfiguration.baseRoughness = EstimateValue(planetSettings.surfaceDescriptor.baseRoughness, probability[0]);
+    surfaceConfiguration.roughness = EstimateValue(planetSettings.surfaceDescriptor.roughness, probability[1]);
+    surfaceConfiguration.persistance = EstimateValue(planetSettings.surfaceDescriptor.persistance, probability[2]);
+    surfaceConfiguration.minValue = EstimateValue(planetSettings.surfaceDescriptor.minValue, probability[3]);
+    surfaceConfiguration.strength = EstimateValue(planetSettings.surfaceDescriptor.strength, probability[4]);
+    surfaceConfiguration.steps = EstimateValue(planetSettings.surfaceDescriptor.steps, probability[5]);
+    surfaceConfiguration.centre = DirectX::XMFLOAT3(0, 0, 0);
+    surfaceConfiguration.userFirstLayerAsMask = (layer == 0) ? false : (probability[7] < planetSettings.surfaceDescriptor.maskProbability);
+    return surfaceConfiguration;
+}
 
-        PlanetSurfaceConfiguration surfaceConfiguration;
-        seed = GenerateSeed(seed);
-        probability = GenerateProbabilityTable(seed);
-        surfaceConfiguration.baseRoughness = EstimateValue(planetSettings.surfaceDescriptor.baseRoughness, probability[0]);
-        surfaceConfiguration.roughness = EstimateValue(planetSettings.surfaceDescriptor.roughness, probability[1]);
-        surfaceConfiguration.persistance = EstimateValue(planetSettings.surfaceDescriptor.persistance, probability[2]);
-        surfaceConfiguration.minValue = EstimateValue(planetSettings.surfaceDescriptor.minValue, probability[3]);
-        surfaceConfiguration.strength = EstimateValue(planetSettings.surfaceDescriptor.strength, probability[4]);
-        surfaceConfiguration.steps = EstimateValue(planetSettings.surfaceDescriptor.steps, probability[5]);
-        surfaceConfiguration.centre = DirectX::XMFLOAT3(0, 0, 0);
-        surfaceConfiguration.userFirstLayerAsMask = (i == 0) ? false : (probability[7] < planetSettings.surfaceDescriptor.maskProbability);
-        planetConfiguration.layers.push_back(surfaceConfiguration);
-    }
+PlanetCraterConfiguration ConfigurationGenerator::GenerateCraterConfiguration(const std::string& seed, const PlanetCraterSettings& settings) {
+    if (derivation == SeedDerivation::Legacy)
+        return EstimateCraters(GenerateProbabilityTable(GenerateSeedLegacy("craters" + seed)), settings);
 
-    return planetConfiguration;
+    return EstimateCraters(GenerateProbabilityTable(CraterKey(seed.data(), seed.size()), 0), settings);
 }
 
+PlanetCraterConfiguration ConfigurationGenerator::EstimateCraters(const ProbabilityTable& probability, const PlanetCraterSettings& settings) const {
+    PlanetCraterConfiguration craterConfiguration;
+    craterConfiguration.count = EstimateValue(settings.count, probability[0]);
+    craterConfiguration.minRadius = EstimateValue(settings.minRadius, probability[1]);
+    craterConfiguration.maxRadius = EstimateValue(settings.maxRadius, probability[2]);
+    craterConfiguration.depth = EstimateValue(settings.depth, probability[3]);
+    craterConfiguration.rimHeight = EstimateValue(settings.rimHeight, probability[4]);
+    craterConfiguration.rimWidth = EstimateValue(settings.rimWidth, probability[5]);
 
-std::vector<float> ConfigurationGenerator::GenerateProbabilityTable(const std::string& seed) {
-    std::vector<float> probability(8, 0.0f);
+    return craterConfiguration;
+}
 
-    for (int i = 0; i < 8; i++) {
-        std::string hexSubstring = seed.substr(i * 8, 8);
-        std::stringstream hexStream(hexSubstring);
-        uint32_t hexValue;
-        hexStream >> std::hex >> hexValue;
+ProbabilityTable ConfigurationGenerator::GenerateProbabilityTable(const std::string& seed) {
+    ProbabilityTable probability = {};
 
-        probability[i] = static_cast<float>(hexValue) / static_cast<float>(UINT32_MAX);
+    for (int i = 0; i < ProbabilityTable::Size && (i + 1) * 8 <= static_cast<int>(seed.size()); i++) {
+        uint32_t hexValue = ParseHex(&seed[i * 8], 8);
+        probability.values[i] = static_cast<float>(hexValue) / static_cast<float>(UINT32_MAX);
     }
 
     return probability;
@@ -88,11 +313,11 @@ std::vector<float> ConfigurationGenerator::GenerateProbabilityTable(const std::s
 
 
 
-float ConfigurationGenerator::EstimateValue(MinMaxRange attribute, float probability) {
+float ConfigurationGenerator::EstimateValue(MinMaxRange attribute, float probability) const {
     return attribute.min + (attribute.max - attribute.min) * probability;
 }
 
-int ConfigurationGenerator::EstimateValue(MinMaxRangeInt attribute, float probability){
+int ConfigurationGenerator::EstimateValue(MinMaxRangeInt attribute, float probability) const {
     return attribute.min + (attribute.max - attribute.min) * probability;
 }
 
@@ -127,4 +352,5 @@ void ConfigurationGenerator::PrintPlanetConfiguration(const PlanetConfiguration&
         std::cout << std::endl;
     }
 
+    std::cout << "Craters: " << planetConfig.craters.count << std::endl;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <string>
+#include "NoiseLibrary.h"
 
 struct MinMaxRange
 {
@@ -39,10 +40,20 @@ struct PlanetOrbitSettings {
     MinMaxRange rotationAngle = { -360.0f, 360.0f };
 };
 
+struct PlanetCraterSettings {
+    MinMaxRangeInt count = { 0, 0 };
+    MinMaxRange minRadius = { 0.02f, 0.04f };   // Chord radius on the unit sphere.
+    MinMaxRange maxRadius = { 0.15f, 0.3f };
+    MinMaxRange depth = { 0.15f, 0.3f };        // Relative to the crater radius.
+    MinMaxRange rimHeight = { 0.04f, 0.08f };   // Relative to the crater radius.
+    MinMaxRange rimWidth = { 0.3f, 0.5f };      // Falloff of the rim outside the crater, relative to the radius.
+};
+
 struct PlanetSettings
 {
     PlanetSurfaceSettings surfaceDescriptor;
     PlanetOrbitSettings orbitDescriptor;
+    PlanetCraterSettings craterDescriptor;
     float probability = 0.2f;
     MinMaxRange radius = { 0.2f, 0.6f };
     MinMaxRange velocity = { 0.0000005f, 0.00005f };
@@ -59,6 +70,19 @@ struct PlanetSurfaceConfiguration {
     float minValue;
     float strength;
     bool userFirstLayerAsMask = false;
+    // Noise specialisation of the layer (see NoiseLibrary.h), cheaper tiers for small or distant bodies.
+    NoiseBasis basis = NoiseBasis::Simplex;
+    NoiseFractal fractal = NoiseFractal::Fbm;
+    NoisePrecision precision = NoisePrecision::Double;
+};
+
+struct PlanetCraterConfiguration {
+    int count = 0;
+    float minRadius;
+    float maxRadius;
+    float depth;
+    float rimHeight;
+    float rimWidth;
 };
 
 struct PlanetConfiguration
@@ -77,26 +101,112 @@ struct PlanetConfiguration
     float orbit;
     DirectX::XMFLOAT3 starPosition;
     std::vector<PlanetSurfaceConfiguration> layers;
+    PlanetCraterConfiguration craters;
+};
+
+
+
+
+// How seeds and probability tables are derived from the ids.
+enum class SeedDerivation
+{
+    // Fixed 64-bit hash and counter-based random numbers, the same on every platform (default).
+    Portable,
+    // The original std::hash chain. Reproduces seeds generated before, but only with the same standard library.
+    Legacy
 };
 
+// Eight uniform values in [0, 1] that drive one group of generated attributes.
+struct ProbabilityTable
+{
+    static const int Size = 8;
+    float values[Size];
 
+    float operator[](int index) const { return values[index]; }
+};
 
+// Configurations of many bodies as structure of arrays, filled by ConfigurationGenerator::GeneratePlanetConfigurations.
+// Element i of every array belongs to body i. The layers of a body are stored inline (at most MaxLayers,
+// the largest count the settings can produce), so generating a batch does not allocate per body.
+struct PlanetConfigurationBatch
+{
+    static const int MaxLayers = 4;
+    struct Layers
+    {
+        PlanetSurfaceConfiguration layers[MaxLayers];
+    };
+
+    std::vector<uint64_t> key;          // Hash64 of the id, the whole configuration is derived from it.
+    std::vector<uint8_t> exist;
+    std::vector<float> radius;
+    std::vector<float> velocity;
+    std::vector<float> orbitOffset;
+    std::vector<float> orbitInitialAngleRad;
+    std::vector<float> orbitEmptyRange;
+    std::vector<DirectX::XMFLOAT3> orbitAxis;
+    std::vector<float> orbitAngle;
+    std::vector<int> numberOfLayers;
+    std::vector<float> orbit;
+    std::vector<Layers> layers;
+    std::vector<PlanetCraterConfiguration> craters;
+
+    void Resize(size_t count);
+    size_t Size() const { return key.size(); }
+    // Bytes held by the arrays.
+    size_t GetMemoryUsage() const;
+};
 
 class ConfigurationGenerator
 {
     public:
+        ConfigurationGenerator(SeedDerivation derivation = SeedDerivation::Portable);
+
         PlanetConfiguration GeneratePlanetConfiguration(std::string id, float orbit, DirectX::XMFLOAT3 starPosition);
+        // Configurations of count bodies at once, spread over the worker threads. Orbits are given per body
+        // (nullptr means zero). Always uses the portable derivation and gives the same values as
+        // GeneratePlanetConfiguration with that derivation.
+        void GeneratePlanetConfigurations(const std::string* ids, const float* orbits, size_t count, PlanetConfigurationBatch& batch) const;
+        // Same, for bodies identified by their keys (Hash64 of the id).
+        void GeneratePlanetConfigurations(const uint64_t* keys, const float* orbits, size_t count, PlanetConfigurationBatch& batch) const;
+        // The full configuration of one body of a batch.
+        PlanetConfiguration ExpandConfiguration(const PlanetConfigurationBatch& batch, size_t index, const std::string& id, DirectX::XMFLOAT3 starPosition) const;
+        // 64 hex characters derived from the key.
         std::string GenerateSeed(std::string key);
+        // Crater layer of a body, drawn from its seed (craters are placed by the terrain from the same seed).
+        PlanetCraterConfiguration GenerateCraterConfiguration(const std::string& seed, const PlanetCraterSettings& settings);
         void PrintPlanetConfiguration(const PlanetConfiguration& planetConfig);
+
+        // 64-bit FNV-1a of the bytes (starting from the FNV offset basis xor seed), finished with the
+        // MurmurHash3 fmix64 avalanche. Fixed here, so it does not depend on the standard library.
+        // Reference: Hash64("SUN", 3) = 0xbb43741286bb9c9b.
+        static uint64_t Hash64(const char* data, size_t length, uint64_t seed = 0);
+        // Counter-based generator: the SplitMix64 output function applied to key + (counter + 1) * golden
+        // ratio. Any value of a stream can be drawn directly, without generating the ones before it.
+        static uint64_t CounterRandom(uint64_t key, uint64_t counter);
+        // Table of the stream of a key, values are CounterRandom(key, stream * Size + i) scaled to [0, 1].
+        static ProbabilityTable GenerateProbabilityTable(uint64_t key, uint64_t stream);
+
     private:
         GeneralSettings generalSettings;
         PlanetSettings planetSettings;
-        std::vector<float> GenerateProbabilityTable(const std::string& seed);
-        float EstimateValue(MinMaxRange attribute, float probability);
-        int EstimateValue(MinMaxRangeInt attribute, float probability);
-        
+        SeedDerivation derivation;
+
+        PlanetConfiguration GeneratePlanetConfigurationLegacy(std::string id, float orbit, DirectX::XMFLOAT3 starPosition);
+        std::string GenerateSeedLegacy(const std::string& key);
+        // Parses the 64 hex characters of a legacy seed.
+        ProbabilityTable GenerateProbabilityTable(const std::string& seed);
+
+        // Portable seed of a key, written to a buffer so batches do not allocate.
+        static void FormatSeed(uint64_t key, char (&seed)[64]);
+        static uint64_t CraterKey(const char* seed, size_t length);
+        void GenerateBatchRange(const uint64_t* keys, const float* orbits, size_t first, size_t last, PlanetConfigurationBatch& batch) const;
+
+        // Attributes drawn from the tables, shared by both derivations.
+        void EstimateBody(PlanetConfiguration& planetConfiguration, const ProbabilityTable& probability, const ProbabilityTable& secondProbability) const;
+        PlanetSurfaceConfiguration EstimateLayer(const ProbabilityTable& probability, int layer) const;
+        PlanetCraterConfiguration EstimateCraters(const ProbabilityTable& probability, const PlanetCraterSettings& settings) const;
 
-       
-    
+        float EstimateValue(MinMaxRange attribute, float probability) const;
+        int EstimateValue(MinMaxRangeInt attribute, float probability) const;
 };
 
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+#include "CraterField.h"
+
+#include <algorithm>
+
+
+CraterField::CraterField(const PlanetCraterConfiguration& configuration, const std::string& seed)
+{
+    if (configuration.count <= 0)
+        return;
+
+    // The same fixed hash and counter-based generator as the configurations, so the craters do not
+    // depend on the platform or the standard library. Floats are built from the raw output for the same reason.
+    const char stream[] = "craterfield";
+    uint64_t key = ConfigurationGenerator::Hash64(seed.data(), seed.size(), ConfigurationGenerator::Hash64(stream, sizeof(stream) - 1));
+    uint64_t counter = 0;
+    auto random = [key, &counter]() { return (ConfigurationGenerator::CounterRandom(key, counter++) >> 40) * (1.0f / 16777216.0f); };
+
+    rimWidth = configuration.rimWidth;
+    influence = 1.0f + 3.0f * rimWidth;
+
+    craters.resize(configuration.count);
+    float maxRadius = 0.0f;
+    for (Crater& crater : craters) {
+        // Uniform direction on the sphere.
+        float z = random() * 2.0f - 1.0f;
+        float angle = random() * DirectX::XM_2PI;
+        float ring = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        crater.centre = DirectX::XMFLOAT3(ring * std::cos(angle), ring * std::sin(angle), z);
+
+        // Many small craters and few large ones.
+        float size = random();
+        crater.radius = configuration.minRadius + (configuration.maxRadius - configuration.minRadius) * size * size * size;
+        crater.depth = configuration.depth * crater.radius;
+        crater.rimHeight = configuration.rimHeight * crater.radius;
+        maxRadius = std::max(maxRadius, crater.radius);
+    }
+
+    // Cells of about twice the average crater reach. Every crater is added to each cell its reach
+    // overlaps, so a lookup only needs the cell of the direction; the few large craters cover many cells.
+    float meanReach = 0.0f;
+    for (const Crater& crater : craters)
+        meanReach += crater.radius * influence;
+    meanReach /= craters.size();
+    cellSize = std::max(2.0f * meanReach, 1e-3f);
+
+    // Calls visit(x, y, z) for every cell the reach (a ball around the centre) of a crater touches.
+    auto forEachCell = [this](const Crater& crater, auto visit) {
+        float reach = crater.radius * influence;
+        float centre[3] = { crater.centre.x, crater.centre.y, crater.centre.z };
+        int low[3], high[3];
+        for (int axis = 0; axis < 3; axis++) {
+            low[axis] = static_cast<int>(std::floor((centre[axis] - reach) / cellSize));
+            high[axis] = static_cast<int>(std::floor((centre[axis] + reach) / cellSize));
+        }
+        for (int z = low[2]; z <= high[2]; z++) {
+            for (int y = low[1]; y <= high[1]; y++) {
+                for (int x = low[0]; x <= high[0]; x++) {
+                    float dx = std::max({ x * cellSize - centre[0], 0.0f, centre[0] - (x + 1) * cellSize });
+                    float dy = std::max({ y * cellSize - centre[1], 0.0f, centre[1] - (y + 1) * cellSize });
+                    float dz = std::max({ z * cellSize - centre[2], 0.0f, centre[2] - (z + 1) * cellSize });
+                    if (dx * dx + dy * dy + dz * dz <= reach * reach)
+                        visit(x, y, z);
+                }
+            }
+        }
+    };
+
+    size_t entryCount = 0;
+    for (const Crater& crater : craters)
+        forEachCell(crater, [&entryCount](int, int, int) { entryCount++; });
+
+    size_t bucketCount = 1;
+    while (bucketCount < entryCount * 2)
+        bucketCount <<= 1;
+    bucketMask = bucketCount - 1;
+
+    std::vector<std::pair<size_t, UINT>> entries;
+    entries.reserve(entryCount);
+    for (size_t i = 0; i < craters.size(); i++) {
+        forEachCell(craters[i], [&](int x, int y, int z) { entries.push_back({ BucketIndex(x, y, z), static_cast<UINT>(i) }); });
+    }
+    // Cells that collide in the table must not list the same crater twice.
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+    // CSR layout, entries are already sorted by bucket.
+    bucketStart.assign(bucketCount + 1, 0);
+    bucketCraters.resize(entries.size());
+    for (size_t i = 0; i < entries.size(); i++) {
+        bucketStart[entries[i].first + 1]++;
+        bucketCraters[i] = entries[i].second;
+    }
+    for (size_t i = 0; i < bucketCount; i++)
+        bucketStart[i + 1] += bucketStart[i];
+}
+
+float CraterField::Evaluate(DirectX::XMFLOAT3 direction) const
+{
+    if (craters.empty())
+        return 0.0f;
+
+    size_t bucket = BucketIndex(
+        static_cast<int>(std::floor(direction.x / cellSize)),
+        static_cast<int>(std::floor(direction.y / cellSize)),
+        static_cast<int>(std::floor(direction.z / cellSize)));
+
+    float offset = 0.0f;
+    for (UINT i = bucketStart[bucket]; i < bucketStart[bucket + 1]; i++) {
+        const Crater& crater = craters[bucketCraters[i]];
+        float dx = direction.x - crater.centre.x;
+        float dy = direction.y - crater.centre.y;
+        float dz = direction.z - crater.centre.z;
+        offset += CraterProfile(crater, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    return offset;
+}
+
+float CraterField::EvaluateBruteForce(DirectX::XMFLOAT3 direction) const
+{
+    float offset = 0.0f;
+    for (const Crater& crater : craters) {
+        float dx = direction.x - crater.centre.x;
+        float dy = direction.y - crater.centre.y;
+        float dz = direction.z - crater.centre.z;
+        offset += CraterProfile(crater, std::sqrt(dx * dx + dy * dy + dz * dz));
+    }
+    return offset;
+}
+
+float CraterField::CraterProfile(const Crater& crater, float distance) const
+{
+    float x = distance / crater.radius;
+    if (x >= influence)
+        return 0.0f;
+
+    if (x < 1.0f) {
+        // Bowl with a flat floor, rising into the rim at the edge (continuous at x = 1).
+        float bowl = std::max(x * x - 1.0f, -0.7f) * crater.depth;
+        return bowl + crater.rimHeight * x * x * x * x;
+    }
+
+    // Rim falling off outside the crater.
+    float t = (x - 1.0f) / rimWidth;
+    return crater.rimHeight * std::exp(-t * t);
+}
+
+size_t CraterField::BucketIndex(int x, int y, int z) const
+{
+    size_t hash = static_cast<size_t>(static_cast<uint32_t>(x) * 73856093u ^ static_cast<uint32_t>(y) * 19349663u ^ static_cast<uint32_t>(z) * 83492791u);
+    return hash & bucketMask;
+}
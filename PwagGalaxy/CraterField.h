@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ConfigurationGenerator.h"
+
+struct Crater
+{
+    DirectX::XMFLOAT3 centre;   // Unit direction.
+    float radius;               // Chord radius on the unit sphere.
+    float depth;
+    float rimHeight;
+};
+
+// Impact craters of a body as an elevation offset over the unit sphere. Crater centres are drawn
+// from the body seed, so a body always gets the same craters. Craters are bucketed in a spatial
+// hash of 3D cells around the sphere, each crater in every cell its reach overlaps: a lookup only
+// visits the craters listed in the cell of the direction, so the cost per vertex stays about the
+// same however many craters the body has.
+class CraterField
+{
+public:
+    CraterField() = default;
+    CraterField(const PlanetCraterConfiguration& configuration, const std::string& seed);
+
+    // Elevation offset (in planet radii) at a unit direction, 0 away from all craters.
+    float Evaluate(DirectX::XMFLOAT3 direction) const;
+    // Same result by visiting every crater, as a reference for the spatial hash.
+    float EvaluateBruteForce(DirectX::XMFLOAT3 direction) const;
+
+    size_t GetCraterCount() const { return craters.size(); }
+    bool IsEmpty() const { return craters.empty(); }
+
+private:
+    float CraterProfile(const Crater& crater, float distance) const;
+    size_t BucketIndex(int x, int y, int z) const;
+
+    std::vector<Crater> craters;
+    float rimWidth = 0.0f;
+    // Craters reach this far relative to their radius (rim falloff included).
+    float influence = 0.0f;
+
+    float cellSize = 1.0f;
+    size_t bucketMask = 0;
+    // Craters of bucket i are bucketCraters[bucketStart[i]] .. bucketCraters[bucketStart[i + 1] - 1].
+    std::vector<UINT> bucketStart;
+    std::vector<UINT> bucketCraters;
+};
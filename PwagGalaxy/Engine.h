@@ -14,6 +14,7 @@ public:
     virtual void OnKeyDown(UINT8 keyCode) {};
     virtual void OnKeyUp(UINT8 keyCode) {};
     virtual void OnMouseMove(int mouseX, int mouseY) {};
+    virtual void OnMouseClick(int mouseX, int mouseY) {};
     virtual void OnGotFocus() {};
     virtual void OnLostFocus() {};
 
@@ -1,6 +1,10 @@
 #pragma once
 #include "Mesh.h"
 #include "ConfigurationGenerator.h"
+#include "Texture.h"
+#include "PlanetBake.h"
+#include "PlanetSurfaceQuery.h"
+#include "EntityWorld.h"
 
 
 
@@ -9,16 +13,21 @@ class EngineObject
 	public:
 		int idx;
 		Mesh mesh;
-		DirectX::XMFLOAT4 position;
-		DirectX::XMFLOAT4X4 rotation;
-		DirectX::XMFLOAT4X4 worldMat;
-		DirectX::XMMATRIX delta_rotXMat;
-		DirectX::XMMATRIX delta_rotYMat;
-		DirectX::XMMATRIX delta_rotZMat;
+		// Transform and per-frame state live in the entity world (see SceneComponents.h), this holds
+		// the resources of the object.
+		Entity entity;
 		EngineObject() = default;
 		EngineObject(int index, Mesh mesh);
 		bool planetDesc = false;
 		PlanetConfiguration planetDescripton;
+		// Baked terrain, only for planets (see VoyagerEngine::BakePlanet). Far away the body is
+		// drawn with the coarse mesh and the cube maps instead of the full mesh.
+		std::shared_ptr<PlanetBake> bake;
+		Mesh bakedMesh;
+		Texture bakedNormalMap;
+		Texture bakedColorMap;
+		// Height and normal queries of the body surface (every generated body has one).
+		std::shared_ptr<PlanetSurfaceQuery> surface;
 	private:
 		
 };
@@ -0,0 +1,114 @@
+#include "stdafx.h"
+#include "EntityWorld.h"
+
+namespace
+{
+    const size_t CacheLine = 64;
+
+    size_t AlignUp(size_t value, size_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+void EntityWorld::Destroy(Entity entity)
+{
+    if (!IsAlive(entity))
+        return;
+
+    EntityRecord& record = records[entity.index];
+    Archetype& archetype = archetypes[record.archetype];
+    Chunk& chunk = archetype.chunks[record.chunk];
+
+    // The last row of the archetype fills the hole, so chunks stay dense and only the last one is partial.
+    Chunk& lastChunk = archetype.chunks.back();
+    uint32_t lastRow = static_cast<uint32_t>(lastChunk.count - 1);
+    if (&lastChunk != &chunk || lastRow != record.row) {
+        for (int id = 0; id < MaxComponents; id++) {
+            if (archetype.mask & (1u << id))
+                std::memcpy(RowPointer(archetype, chunk, id, record.row), RowPointer(archetype, lastChunk, id, lastRow), archetype.sizes[id]);
+        }
+        uint32_t movedIndex = reinterpret_cast<uint32_t*>(lastChunk.data + archetype.entityOffset)[lastRow];
+        reinterpret_cast<uint32_t*>(chunk.data + archetype.entityOffset)[record.row] = movedIndex;
+        records[movedIndex].chunk = record.chunk;
+        records[movedIndex].row = record.row;
+    }
+    lastChunk.count--;
+    if (lastChunk.count == 0)
+        archetype.chunks.pop_back();
+
+    record.alive = false;
+    record.generation++;
+    freeRecords.push_back(entity.index);
+    entityCount--;
+}
+
+bool EntityWorld::IsAlive(Entity entity) const
+{
+    return entity.index < records.size() && records[entity.index].alive && records[entity.index].generation == entity.generation;
+}
+
+size_t EntityWorld::GetChunkCount() const
+{
+    size_t count = 0;
+    for (const Archetype& archetype : archetypes)
+        count += archetype.chunks.size();
+    return count;
+}
+
+uint32_t EntityWorld::FindArchetype(uint32_t mask, const int* ids, const size_t* sizes, size_t componentCount)
+{
+    for (uint32_t a = 0; a < archetypes.size(); a++) {
+        if (archetypes[a].mask == mask)
+            return a;
+    }
+
+    Archetype archetype;
+    archetype.mask = mask;
+    std::fill(std::begin(archetype.offsets), std::end(archetype.offsets), 0);
+    std::fill(std::begin(archetype.sizes), std::end(archetype.sizes), 0);
+    size_t rowBytes = sizeof(uint32_t);
+    for (size_t c = 0; c < componentCount; c++) {
+        if (ids[c] < 0 || ids[c] >= MaxComponents)
+            throw "Component id out of range!";
+        archetype.sizes[ids[c]] = sizes[c];
+        rowBytes += sizes[c];
+    }
+    // Every array starts on a cache line, which costs up to one line per array.
+    size_t padding = CacheLine * (componentCount + 1);
+    if (rowBytes + padding > ChunkBytes)
+        throw "Entity components do not fit into a chunk!";
+    archetype.capacity = (ChunkBytes - padding) / rowBytes;
+
+    size_t offset = 0;
+    for (int id = 0; id < MaxComponents; id++) {
+        if ((mask & (1u << id)) == 0)
+            continue;
+        archetype.offsets[id] = offset;
+        offset = AlignUp(offset + archetype.sizes[id] * archetype.capacity, CacheLine);
+    }
+    archetype.entityOffset = offset;
+
+    archetypes.push_back(std::move(archetype));
+    return static_cast<uint32_t>(archetypes.size() - 1);
+}
+
+void EntityWorld::AllocateRow(uint32_t archetypeIndex, uint32_t& chunk, uint32_t& row)
+{
+    Archetype& archetype = archetypes[archetypeIndex];
+    if (archetype.chunks.empty() || archetype.chunks.back().count == archetype.capacity) {
+        Chunk newChunk;
+        newChunk.memory.reset(new uint8_t[ChunkBytes + CacheLine]);
+        uintptr_t address = reinterpret_cast<uintptr_t>(newChunk.memory.get());
+        newChunk.data = reinterpret_cast<uint8_t*>(AlignUp(address, CacheLine));
+        newChunk.count = 0;
+        archetype.chunks.push_back(std::move(newChunk));
+    }
+    chunk = static_cast<uint32_t>(archetype.chunks.size() - 1);
+    row = static_cast<uint32_t>(archetype.chunks.back().count++);
+}
+
+uint8_t* EntityWorld::RowPointer(const Archetype& archetype, const Chunk& chunk, int id, uint32_t row) const
+{
+    return chunk.data + archetype.offsets[id] + archetype.sizes[id] * row;
+}
@@ -0,0 +1,225 @@
+#pragma once
+
+#include "ThreadPool.h"
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Handle of an entity, stays invalid after the entity is destroyed (the slot gets a new generation).
+struct Entity
+{
+    uint32_t index = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return index != UINT32_MAX; }
+};
+
+// True when all the types can be copied with memcpy.
+template<typename... Types>
+struct ArePlainData { static const bool value = true; };
+template<typename First, typename... Rest>
+struct ArePlainData<First, Rest...> { static const bool value = std::is_trivially_copyable<First>::value && ArePlainData<Rest...>::value; };
+
+// Every component type specialises this with its bit in the archetype masks (see SceneComponents.h).
+template<typename T> struct ComponentId;
+
+// Entities grouped by their set of components (the archetype). An archetype keeps its entities in chunks
+// of ChunkBytes, inside a chunk every component is an array of its own, aligned to a cache line, so a
+// system that reads two components of 10k entities streams through two arrays and never touches the
+// others. Components are plain data (copied with memcpy when an entity is destroyed); resources that
+// own memory stay outside and are referenced by index.
+// Chunks are independent, systems iterate them with ForEachChunk() or spread them over the thread pool
+// with ParallelForEachChunk().
+class EntityWorld
+{
+public:
+    static const size_t ChunkBytes = 16 * 1024;
+    static const int MaxComponents = 32;
+
+    EntityWorld() = default;
+    EntityWorld(const EntityWorld&) = delete;
+    EntityWorld& operator=(const EntityWorld&) = delete;
+
+    template<typename... Components>
+    Entity Create(const Components&... components);
+    void Destroy(Entity entity);
+    bool IsAlive(Entity entity) const;
+
+    // The component of an entity, nullptr when the entity does not have it.
+    template<typename T>
+    T* Get(Entity entity);
+    template<typename T>
+    const T* Get(Entity entity) const;
+
+    // Calls function(count, Components* arrays...) for every chunk of the archetypes with all the components.
+    template<typename... Components, typename Function>
+    void ForEachChunk(Function function);
+    // Same, the chunks spread over the thread pool. The function must only write to its own chunk.
+    template<typename... Components, typename Function>
+    void ParallelForEachChunk(Function function);
+    // Same, leaving out the archetypes that also have the Excluded component.
+    template<typename Excluded, typename... Components, typename Function>
+    void ParallelForEachChunkWithout(Function function);
+
+    size_t GetEntityCount() const { return entityCount; }
+    size_t GetChunkCount() const;
+    size_t GetArchetypeCount() const { return archetypes.size(); }
+
+private:
+    struct Chunk
+    {
+        std::unique_ptr<uint8_t[]> memory;
+        uint8_t* data;              // memory aligned to a cache line.
+        size_t count;
+    };
+
+    struct Archetype
+    {
+        uint32_t mask;
+        size_t capacity;            // Entities per chunk.
+        size_t offsets[MaxComponents];
+        size_t sizes[MaxComponents];
+        size_t entityOffset;        // Index of the entity of every row, to fix the records when rows move.
+        std::vector<Chunk> chunks;
+    };
+
+    struct EntityRecord
+    {
+        uint32_t archetype;
+        uint32_t chunk;
+        uint32_t row;
+        uint32_t generation;
+        bool alive;
+    };
+
+    template<typename... Components>
+    static uint32_t MaskOf();
+    template<typename... Components, typename Function>
+    void ParallelForEachChunkMasked(uint32_t excludedMask, Function function);
+
+    uint32_t FindArchetype(uint32_t mask, const int* ids, const size_t* sizes, size_t componentCount);
+    // A free row at the end of the archetype, a new chunk when the last one is full.
+    void AllocateRow(uint32_t archetype, uint32_t& chunk, uint32_t& row);
+    uint8_t* RowPointer(const Archetype& archetype, const Chunk& chunk, int id, uint32_t row) const;
+
+    std::vector<Archetype> archetypes;
+    std::vector<EntityRecord> records;
+    std::vector<uint32_t> freeRecords;
+    size_t entityCount = 0;
+};
+
+template<typename... Components>
+uint32_t EntityWorld::MaskOf()
+{
+    const uint32_t bits[] = { 0u, (1u << ComponentId<Components>::Value)... };
+    uint32_t mask = 0;
+    for (uint32_t bit : bits)
+        mask |= bit;
+    return mask;
+}
+
+template<typename... Components>
+Entity EntityWorld::Create(const Components&... components)
+{
+    static_assert(sizeof...(Components) > 0, "An entity needs at least one component.");
+    static_assert(ArePlainData<Components...>::value, "Entity components have to be plain data.");
+
+    const int ids[] = { ComponentId<Components>::Value... };
+    const size_t sizes[] = { sizeof(Components)... };
+    uint32_t archetypeIndex = FindArchetype(MaskOf<Components...>(), ids, sizes, sizeof...(Components));
+
+    uint32_t chunkIndex, row;
+    AllocateRow(archetypeIndex, chunkIndex, row);
+    const Archetype& archetype = archetypes[archetypeIndex];
+    const Chunk& chunk = archetype.chunks[chunkIndex];
+    const void* sources[] = { &components... };
+    for (size_t c = 0; c < sizeof...(Components); c++)
+        std::memcpy(RowPointer(archetype, chunk, ids[c], row), sources[c], sizes[c]);
+
+    uint32_t index;
+    if (!freeRecords.empty()) {
+        index = freeRecords.back();
+        freeRecords.pop_back();
+    }
+    else {
+        index = static_cast<uint32_t>(records.size());
+        records.push_back(EntityRecord{ 0, 0, 0, 0, false });
+    }
+    EntityRecord& record = records[index];
+    record.archetype = archetypeIndex;
+    record.chunk = chunkIndex;
+    record.row = row;
+    record.alive = true;
+    reinterpret_cast<uint32_t*>(chunk.data + archetype.entityOffset)[row] = index;
+    entityCount++;
+
+    Entity entity;
+    entity.index = index;
+    entity.generation = record.generation;
+    return entity;
+}
+
+template<typename T>
+T* EntityWorld::Get(Entity entity)
+{
+    return const_cast<T*>(static_cast<const EntityWorld*>(this)->Get<T>(entity));
+}
+
+template<typename T>
+const T* EntityWorld::Get(Entity entity) const
+{
+    if (!IsAlive(entity))
+        return nullptr;
+    const EntityRecord& record = records[entity.index];
+    const Archetype& archetype = archetypes[record.archetype];
+    if ((archetype.mask & (1u << ComponentId<T>::Value)) == 0)
+        return nullptr;
+    return reinterpret_cast<const T*>(RowPointer(archetype, archetype.chunks[record.chunk], ComponentId<T>::Value, record.row));
+}
+
+template<typename... Components, typename Function>
+void EntityWorld::ForEachChunk(Function function)
+{
+    uint32_t mask = MaskOf<Components...>();
+    for (Archetype& archetype : archetypes) {
+        if ((archetype.mask & mask) != mask)
+            continue;
+        for (Chunk& chunk : archetype.chunks) {
+            if (chunk.count > 0)
+                function(chunk.count, reinterpret_cast<Components*>(chunk.data + archetype.offsets[ComponentId<Components>::Value])...);
+        }
+    }
+}
+
+template<typename... Components, typename Function>
+void EntityWorld::ParallelForEachChunk(Function function)
+{
+    ParallelForEachChunkMasked<Components...>(0, function);
+}
+
+template<typename Excluded, typename... Components, typename Function>
+void EntityWorld::ParallelForEachChunkWithout(Function function)
+{
+    ParallelForEachChunkMasked<Components...>(MaskOf<Excluded>(), function);
+}
+
+template<typename... Components, typename Function>
+void EntityWorld::ParallelForEachChunkMasked(uint32_t excludedMask, Function function)
+{
+    // Gathered first, the jobs index them.
+    std::vector<std::pair<Archetype*, Chunk*>> chunks;
+    uint32_t mask = MaskOf<Components...>();
+    for (Archetype& archetype : archetypes) {
+        if ((archetype.mask & mask) != mask || (archetype.mask & excludedMask) != 0)
+            continue;
+        for (Chunk& chunk : archetype.chunks) {
+            if (chunk.count > 0)
+                chunks.push_back(std::make_pair(&archetype, &chunk));
+        }
+    }
+    ThreadPool::GetInstance()->ParallelFor(chunks.size(), [&](size_t c) {
+        Archetype& archetype = *chunks[c].first;
+        Chunk& chunk = *chunks[c].second;
+        function(chunk.count, reinterpret_cast<Components*>(chunk.data + archetype.offsets[ComponentId<Components>::Value])...);
+    });
+}
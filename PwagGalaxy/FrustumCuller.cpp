@@ -0,0 +1,110 @@
+#include "stdafx.h"
+#include "FrustumCuller.h"
+
+#include "VectorMath.h"
+
+void FrustumCuller::Clear()
+{
+    centerX.clear();
+    centerY.clear();
+    centerZ.clear();
+    radius.clear();
+}
+
+void FrustumCuller::Reserve(size_t count)
+{
+    centerX.reserve(count);
+    centerY.reserve(count);
+    centerZ.reserve(count);
+    radius.reserve(count);
+}
+
+size_t FrustumCuller::AddSphere(const BoundingSphere& sphere)
+{
+    centerX.push_back(sphere.center.x);
+    centerY.push_back(sphere.center.y);
+    centerZ.push_back(sphere.center.z);
+    radius.push_back(sphere.radius);
+    return radius.size() - 1;
+}
+
+bool FrustumCuller::HasVectorPath()
+{
+    return VectorMath::HasAvx();
+}
+
+size_t FrustumCuller::Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    if (!HasVectorPath())
+        return CullScalar(frustum, visible);
+
+    // Every index is written, only the visible ones are kept.
+    visible.resize(radius.size());
+    size_t vectorLast = radius.size() / Width * Width;
+    size_t count = CullRangeVector(frustum, 0, vectorLast, visible.data(), 0);
+    count = CullRangeScalar(frustum, vectorLast, radius.size(), visible.data(), count);
+    visible.resize(count);
+    return count;
+}
+
+size_t FrustumCuller::CullScalar(const Frustum& frustum, std::vector<uint32_t>& visible) const
+{
+    visible.resize(radius.size());
+    size_t count = CullRangeScalar(frustum, 0, radius.size(), visible.data(), 0);
+    visible.resize(count);
+    return count;
+}
+
+size_t FrustumCuller::CullRangeScalar(const Frustum& frustum, size_t first, size_t last, uint32_t* visible, size_t count) const
+{
+    for (size_t i = first; i < last; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6; p++) {
+            const DirectX::XMFLOAT4& plane = frustum.planes[p];
+            // The same order of operations as the vector path, so both agree on the spheres touching a plane.
+            float distance = centerX[i] * plane.x + centerY[i] * plane.y;
+            distance = distance + centerZ[i] * plane.z;
+            distance = distance + plane.w;
+            inside = inside && distance >= -radius[i];
+        }
+        visible[count] = static_cast<uint32_t>(i);
+        count += inside ? 1 : 0;
+    }
+    return count;
+}
+
+size_t FrustumCuller::CullRangeVector(const Frustum& frustum, size_t first, size_t last, uint32_t* visible, size_t count) const
+{
+    __m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm256_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm256_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm256_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm256_set1_ps(frustum.planes[p].w);
+    }
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+    for (size_t i = first; i < last; i += Width) {
+        __m256 x = _mm256_loadu_ps(&centerX[i]);
+        __m256 y = _mm256_loadu_ps(&centerY[i]);
+        __m256 z = _mm256_loadu_ps(&centerZ[i]);
+        __m256 negativeRadius = _mm256_xor_ps(_mm256_loadu_ps(&radius[i]), signBit);
+
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (int p = 0; p < 6; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_mul_ps(x, planeX[p]), _mm256_mul_ps(y, planeY[p]));
+            distance = _mm256_add_ps(distance, _mm256_mul_ps(z, planeZ[p]));
+            distance = _mm256_add_ps(distance, planeW[p]);
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+        }
+
+        // Compacted without branches: each index is written to the next free place, which only moves on
+        // when the sphere is visible.
+        int mask = _mm256_movemask_ps(inside);
+        for (uint32_t k = 0; k < Width; k++) {
+            visible[count] = static_cast<uint32_t>(i) + k;
+            count += (mask >> k) & 1;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vector>
+
+#include "BoundingVolumeHierarchy.h"
+
+// Bounding spheres kept as a structure of arrays, culled against a view frustum eight at a time: every
+// plane is one multiply-add per coordinate over eight spheres, the six results are and-ed together and
+// the mask picks the visible ones into a compact list. A few hundred bodies fit in a handful of cache
+// lines, so a linear sweep beats walking the tree of the scene bounds.
+// With AVX the blocks of eight spheres are tested in vector registers, the rest falls back to
+// CullScalar(), which is also the reference for the vector path.
+class FrustumCuller
+{
+public:
+    static const size_t Width = 8;
+
+    FrustumCuller() = default;
+
+    void Clear();
+    void Reserve(size_t count);
+    size_t AddSphere(const BoundingSphere& sphere);
+    size_t GetSphereCount() const { return radius.size(); }
+
+    // Replaces visible by the indices of the spheres at least partly inside the frustum, in order.
+    // Returns how many there are.
+    size_t Cull(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+    // Same, one sphere at a time.
+    size_t CullScalar(const Frustum& frustum, std::vector<uint32_t>& visible) const;
+
+    // True when Cull() uses the 8-wide path on this CPU.
+    static bool HasVectorPath();
+
+private:
+    // Spheres [first, last) into visible from count on, returns the new count. visible has room for all.
+    size_t CullRangeScalar(const Frustum& frustum, size_t first, size_t last, uint32_t* visible, size_t count) const;
+    size_t CullRangeVector(const Frustum& frustum, size_t first, size_t last, uint32_t* visible, size_t count) const;
+
+    std::vector<float> centerX, centerY, centerZ;
+    std::vector<float> radius;
+};
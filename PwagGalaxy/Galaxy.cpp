@@ -0,0 +1,238 @@
+#include "stdafx.h"
+#include "Galaxy.h"
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <string>
+
+namespace
+{
+    const int SectorBits = 21;
+    const int SectorBias = 1 << (SectorBits - 1);
+
+    int ChebyshevDistance(int x, int y, int z)
+    {
+        return std::max(std::abs(x), std::max(std::abs(y), std::abs(z)));
+    }
+}
+
+Galaxy::Galaxy(const GalaxySettings& settings) :
+    settings(settings)
+{
+}
+
+uint64_t Galaxy::SectorKey(int x, int y, int z)
+{
+    const uint64_t mask = (1ull << SectorBits) - 1;
+    return ((static_cast<uint64_t>(x + SectorBias) & mask) << (2 * SectorBits)) |
+        ((static_cast<uint64_t>(y + SectorBias) & mask) << SectorBits) |
+        (static_cast<uint64_t>(z + SectorBias) & mask);
+}
+
+uint64_t Galaxy::GetSectorKey(DirectX::XMFLOAT3 position) const
+{
+    return SectorKey(SectorCoordinate(position.x), SectorCoordinate(position.y), SectorCoordinate(position.z));
+}
+
+int Galaxy::SectorCoordinate(float position) const
+{
+    return static_cast<int>(std::floor(position / settings.sectorSize + 0.5f));
+}
+
+void Galaxy::Update(DirectX::XMFLOAT3 cameraPosition)
+{
+    auto start = std::chrono::steady_clock::now();
+    int cameraX = SectorCoordinate(cameraPosition.x);
+    int cameraY = SectorCoordinate(cameraPosition.y);
+    int cameraZ = SectorCoordinate(cameraPosition.z);
+
+    // Missing sectors around the camera, the nearest ones are generated first.
+    std::vector<DirectX::XMINT3> missing;
+    int radius = settings.generationRadius;
+    for (int z = -radius; z <= radius; z++) {
+        for (int y = -radius; y <= radius; y++) {
+            for (int x = -radius; x <= radius; x++) {
+                if (sectors.find(SectorKey(cameraX + x, cameraY + y, cameraZ + z)) == sectors.end())
+                    missing.push_back(DirectX::XMINT3(x, y, z));
+            }
+        }
+    }
+    std::sort(missing.begin(), missing.end(), [](const DirectX::XMINT3& a, const DirectX::XMINT3& b) {
+        return a.x * a.x + a.y * a.y + a.z * a.z < b.x * b.x + b.y * b.y + b.z * b.z;
+    });
+    if (missing.size() > static_cast<size_t>(settings.sectorsPerUpdate))
+        missing.resize(settings.sectorsPerUpdate);
+
+    if (!missing.empty()) {
+        // One sector per job, the planet batches of a sector are too small to be split further.
+        std::vector<GalaxySector> generated(missing.size());
+        ThreadPool::GetInstance()->ParallelFor(generated.size(), [&](size_t i) {
+            GenerateSector(cameraX + missing[i].x, cameraY + missing[i].y, cameraZ + missing[i].z, generated[i]);
+        });
+        double generationMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        for (GalaxySector& sector : generated) {
+            stats.residentSystems += sector.systems.size();
+            stats.residentPlanets += sector.planets.Size();
+            stats.memory += sector.memory;
+            sectors.emplace(SectorKey(sector.x, sector.y, sector.z), std::move(sector));
+        }
+        stats.generatedSectors += generated.size();
+        totalSectorMs += generationMs;
+        stats.meanSectorMs = totalSectorMs / stats.generatedSectors;
+    }
+
+    if (stats.memory > settings.memoryBudget)
+        EvictSectors(cameraX, cameraY, cameraZ);
+    stats.residentSectors = sectors.size();
+
+    stats.lastUpdateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.maxUpdateMs = std::max(stats.maxUpdateMs, stats.lastUpdateMs);
+}
+
+void Galaxy::GenerateSector(int x, int y, int z, GalaxySector& sector) const
+{
+    sector.x = x;
+    sector.y = y;
+    sector.z = z;
+    uint64_t sectorKey = SectorKey(sector.x, sector.y, sector.z);
+    uint64_t sectorSeed = ConfigurationGenerator::CounterRandom(settings.seed, sectorKey);
+    bool homeSector = sector.x == 0 && sector.y == 0 && sector.z == 0;
+    DirectX::XMFLOAT3 centre(sector.x * settings.sectorSize, sector.y * settings.sectorSize, sector.z * settings.sectorSize);
+    float extent = settings.sectorSize * (0.5f - settings.sectorMargin);
+
+    // Stream s of the sector seed decides slot s, the system keys come from the streams after the slots.
+    std::vector<uint64_t> planetKeys;
+    for (int slot = 0; slot < settings.systemsPerSector; slot++) {
+        ProbabilityTable probability = ConfigurationGenerator::GenerateProbabilityTable(sectorSeed, slot);
+
+        GalaxySystem system;
+        system.key = ConfigurationGenerator::CounterRandom(sectorSeed, (settings.systemsPerSector + slot) * ProbabilityTable::Size);
+        system.sectorKey = sectorKey;
+        system.slot = slot;
+        system.position = DirectX::XMFLOAT3(
+            centre.x + (probability[1] * 2.0f - 1.0f) * extent,
+            centre.y + (probability[2] * 2.0f - 1.0f) * extent,
+            centre.z + (probability[3] * 2.0f - 1.0f) * extent);
+        system.starRadius = settings.starRadius.min + (settings.starRadius.max - settings.starRadius.min) * probability[4];
+        system.planetCount = static_cast<int>(settings.planetCount.min + (settings.planetCount.max - settings.planetCount.min) * probability[5]);
+
+        if (homeSector && slot == 0) {
+            // The home system always exists and sits on the origin.
+            system.position = DirectX::XMFLOAT3(0, 0, 0);
+        }
+        else {
+            if (probability[0] >= settings.systemProbability)
+                continue;
+            float homeDistance = std::sqrt(system.position.x * system.position.x + system.position.y * system.position.y + system.position.z * system.position.z);
+            if (homeSector && homeDistance < settings.homeClearance * settings.sectorSize)
+                continue;
+        }
+
+        system.firstPlanet = static_cast<int>(planetKeys.size());
+        for (int p = 0; p < system.planetCount; p++)
+            planetKeys.push_back(ConfigurationGenerator::CounterRandom(system.key, p));
+        sector.systems.push_back(system);
+    }
+
+    generator.GeneratePlanetConfigurations(planetKeys.data(), nullptr, planetKeys.size(), sector.planets);
+
+    // Orbits are chained outwards from the star, every planet keeps its empty range on both sides.
+    for (const GalaxySystem& system : sector.systems) {
+        float orbit = system.starRadius;
+        for (int p = system.firstPlanet; p < system.firstPlanet + system.planetCount; p++) {
+            sector.planets.orbit[p] = orbit + sector.planets.orbitEmptyRange[p] + sector.planets.radius[p];
+            orbit = sector.planets.orbit[p] + sector.planets.orbitEmptyRange[p] + sector.planets.radius[p];
+        }
+    }
+
+    // The map node adds two pointers and the key.
+    sector.memory = sizeof(GalaxySector) + 2 * sizeof(void*) + sizeof(uint64_t) +
+        sector.systems.capacity() * sizeof(GalaxySystem) + sector.planets.GetMemoryUsage();
+}
+
+void Galaxy::EvictSectors(int cameraX, int cameraY, int cameraZ)
+{
+    std::vector<std::pair<int, uint64_t>> candidates;
+    for (const auto& entry : sectors) {
+        const GalaxySector& sector = entry.second;
+        int distance = ChebyshevDistance(sector.x - cameraX, sector.y - cameraY, sector.z - cameraZ);
+        if (distance > settings.evictionRadius)
+            candidates.push_back(std::make_pair(distance, entry.first));
+    }
+
+    // Farthest first.
+    std::sort(candidates.begin(), candidates.end(), [](const std::pair<int, uint64_t>& a, const std::pair<int, uint64_t>& b) {
+        return a.first > b.first;
+    });
+    for (const std::pair<int, uint64_t>& candidate : candidates) {
+        if (stats.memory <= settings.memoryBudget)
+            break;
+        auto entry = sectors.find(candidate.second);
+        stats.residentSystems -= entry->second.systems.size();
+        stats.residentPlanets -= entry->second.planets.Size();
+        stats.memory -= entry->second.memory;
+        stats.evictedSectors++;
+        sectors.erase(entry);
+    }
+}
+
+void Galaxy::FindNearestSystems(DirectX::XMFLOAT3 position, size_t count, std::vector<GalaxySystem>& systems) const
+{
+    systems.clear();
+    int positionX = SectorCoordinate(position.x);
+    int positionY = SectorCoordinate(position.y);
+    int positionZ = SectorCoordinate(position.z);
+
+    std::vector<std::pair<float, const GalaxySystem*>> candidates;
+    int radius = settings.generationRadius;
+    for (int z = -radius; z <= radius; z++) {
+        for (int y = -radius; y <= radius; y++) {
+            for (int x = -radius; x <= radius; x++) {
+                auto entry = sectors.find(SectorKey(positionX + x, positionY + y, positionZ + z));
+                if (entry == sectors.end())
+                    continue;
+                for (const GalaxySystem& system : entry->second.systems) {
+                    float dx = system.position.x - position.x;
+                    float dy = system.position.y - position.y;
+                    float dz = system.position.z - position.z;
+                    candidates.push_back(std::make_pair(dx * dx + dy * dy + dz * dz, &system));
+                }
+            }
+        }
+    }
+
+    size_t resultCount = std::min(count, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + resultCount, candidates.end(),
+        [](const std::pair<float, const GalaxySystem*>& a, const std::pair<float, const GalaxySystem*>& b) { return a.first < b.first; });
+    for (size_t i = 0; i < resultCount; i++)
+        systems.push_back(*candidates[i].second);
+}
+
+GalaxySystem Galaxy::GetHomeSystem()
+{
+    uint64_t key = SectorKey(0, 0, 0);
+    auto entry = sectors.find(key);
+    if (entry == sectors.end()) {
+        GalaxySector sector;
+        GenerateSector(0, 0, 0, sector);
+        stats.residentSystems += sector.systems.size();
+        stats.residentPlanets += sector.planets.Size();
+        stats.memory += sector.memory;
+        stats.generatedSectors++;
+        entry = sectors.emplace(key, std::move(sector)).first;
+        stats.residentSectors = sectors.size();
+    }
+    return entry->second.systems.front();
+}
+
+PlanetConfiguration Galaxy::GetPlanetConfiguration(const GalaxySystem& system, int planet) const
+{
+    auto entry = sectors.find(system.sectorKey);
+    if (entry == sectors.end())
+        throw "Galaxy sector of the system is not resident!";
+
+    std::string id = std::to_string(system.key) + "-" + std::to_string(planet);
+    return generator.ExpandConfiguration(entry->second.planets, system.firstPlanet + planet, id, system.position);
+}
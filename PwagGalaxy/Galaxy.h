@@ -0,0 +1,103 @@
+#pragma once
+
+#include "ConfigurationGenerator.h"
+#include <unordered_map>
+
+struct GalaxySettings
+{
+    uint64_t seed = 0;
+    float sectorSize = 64.0f;               // World units along the edge of a cubic sector, sector (0, 0, 0) is centred on the origin.
+    int systemsPerSector = 4;               // Slots per sector, every one holds a system with systemProbability.
+    float systemProbability = 0.5f;
+    float sectorMargin = 0.15f;             // Systems keep this fraction of the sector size away from its faces.
+    MinMaxRange starRadius = { 0.8f, 1.2f };
+    MinMaxRangeInt planetCount = { 3, 8 };
+    float homeClearance = 0.3f;             // Other systems keep this fraction of the sector size away from the home system.
+
+    int generationRadius = 2;               // Sectors around the camera sector (along every axis) that get configurations.
+    int evictionRadius = 3;                 // Sectors further away than this may be evicted.
+    size_t memoryBudget = 4 * 1024 * 1024;  // Bytes of resident sectors before eviction starts.
+    int sectorsPerUpdate = 16;              // Generation budget of one Update(), the nearest missing sectors go first.
+};
+
+// A star and its planets. Planet configurations live in the sector, see Galaxy::GetPlanetConfiguration.
+struct GalaxySystem
+{
+    uint64_t key;
+    uint64_t sectorKey;
+    int slot;
+    DirectX::XMFLOAT3 position;
+    float starRadius;
+    int firstPlanet;
+    int planetCount;
+};
+
+struct GalaxySector
+{
+    int x;
+    int y;
+    int z;
+    std::vector<GalaxySystem> systems;
+    // Planets of all systems of the sector, one after another in the order of the systems.
+    PlanetConfigurationBatch planets;
+    size_t memory = 0;
+};
+
+struct GalaxyStats
+{
+    size_t residentSectors = 0;
+    size_t residentSystems = 0;
+    size_t residentPlanets = 0;
+    size_t memory = 0;                      // Estimated bytes of the resident sectors.
+    size_t generatedSectors = 0;            // Totals since the galaxy was created.
+    size_t evictedSectors = 0;
+    double lastUpdateMs = 0.0;              // Generation and eviction time of the last Update().
+    double maxUpdateMs = 0.0;
+    double meanSectorMs = 0.0;              // Generation time per sector, averaged over all of them.
+};
+
+// Star systems derived from sector coordinates, so any part of the galaxy can be generated on its own and
+// always comes out the same. Sectors are kept in a hash map keyed by their packed coordinates; Update()
+// generates the missing ones around the camera (configurations only, meshes are up to the caller) and
+// evicts far away ones, farthest first, while the resident sectors are over the memory budget. Sectors
+// within the eviction radius are never evicted, so the budget can be exceeded when it is set too small.
+class Galaxy
+{
+public:
+    Galaxy() = default;
+    Galaxy(const GalaxySettings& settings);
+
+    void Update(DirectX::XMFLOAT3 cameraPosition);
+
+    // Resident systems closest to the position, nearest first (at most count of them).
+    void FindNearestSystems(DirectX::XMFLOAT3 position, size_t count, std::vector<GalaxySystem>& systems) const;
+    // The system at the origin, generated on demand (its sector is loaded if it is not resident).
+    GalaxySystem GetHomeSystem();
+    // Full configuration of a planet of a resident system, orbits are chained outwards from the star.
+    PlanetConfiguration GetPlanetConfiguration(const GalaxySystem& system, int planet) const;
+
+    const GalaxyStats& GetStats() const { return stats; }
+    const GalaxySettings& GetSettings() const { return settings; }
+
+    // Systems and planets of one sector, the same whether it is streamed or baked (see GalaxyDatabase).
+    void GenerateSector(int x, int y, int z, GalaxySector& sector) const;
+
+    // Key of the sector a position lies in.
+    uint64_t GetSectorKey(DirectX::XMFLOAT3 position) const;
+    static uint64_t SectorKey(int x, int y, int z);
+
+private:
+    struct SectorKeyHash
+    {
+        size_t operator()(uint64_t key) const { return static_cast<size_t>(ConfigurationGenerator::CounterRandom(key, 0)); }
+    };
+
+    int SectorCoordinate(float position) const;
+    void EvictSectors(int cameraX, int cameraY, int cameraZ);
+
+    GalaxySettings settings;
+    ConfigurationGenerator generator;
+    std::unordered_map<uint64_t, GalaxySector, SectorKeyHash> sectors;
+    GalaxyStats stats;
+    double totalSectorMs = 0.0;
+};
@@ -0,0 +1,411 @@
+#include "stdafx.h"
+#include "GalaxyDatabase.h"
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace
+{
+    const char Magic[8] = { 'P', 'W', 'G', 'A', 'L', 'A', 'X', 'Y' };
+    const int CoordinateBias = 1 << 20;
+
+    // The lowest 21 bits of a value moved to every third bit.
+    uint64_t SpreadBits(uint64_t value)
+    {
+        value &= 0x1fffff;
+        value = (value | value << 32) & 0x1f00000000ffffull;
+        value = (value | value << 16) & 0x1f0000ff0000ffull;
+        value = (value | value << 8) & 0x100f00f00f00f00full;
+        value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+        value = (value | value << 2) & 0x1249249249249249ull;
+        return value;
+    }
+
+    // Records of one sector, made by a worker and written in order by the calling thread.
+    struct BakedSector
+    {
+        uint64_t mortonCode;
+        std::vector<GalaxySystemRecord> systems;
+        std::vector<GalaxyPlanetRecord> planets;
+    };
+}
+
+GalaxyDatabase::~GalaxyDatabase()
+{
+    Close();
+}
+
+uint64_t GalaxyDatabase::MortonCode(int x, int y, int z)
+{
+    return SpreadBits(static_cast<uint64_t>(x + CoordinateBias)) |
+        (SpreadBits(static_cast<uint64_t>(y + CoordinateBias)) << 1) |
+        (SpreadBits(static_cast<uint64_t>(z + CoordinateBias)) << 2);
+}
+
+bool GalaxyDatabase::Bake(const GalaxySettings& settings, int radius, const std::string& path)
+{
+    auto start = std::chrono::steady_clock::now();
+    Galaxy galaxy(settings);
+
+    // Every sector of the cube, in Morton order.
+    std::vector<std::pair<uint64_t, DirectX::XMINT3>> order;
+    int side = 2 * radius + 1;
+    order.reserve(static_cast<size_t>(side) * side * side);
+    for (int z = -radius; z <= radius; z++)
+        for (int y = -radius; y <= radius; y++)
+            for (int x = -radius; x <= radius; x++)
+                order.push_back(std::make_pair(MortonCode(x, y, z), DirectX::XMINT3(x, y, z)));
+    std::sort(order.begin(), order.end(), [](const std::pair<uint64_t, DirectX::XMINT3>& a, const std::pair<uint64_t, DirectX::XMINT3>& b) {
+        return a.first < b.first;
+    });
+
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    if (!output) {
+        std::cout << "Cannot write the galaxy database '" << path << "'." << std::endl;
+        return false;
+    }
+
+    GalaxyFileHeader header = {};
+    std::copy(Magic, Magic + sizeof(Magic), header.magic);
+    header.version = Version;
+    header.headerSize = sizeof(GalaxyFileHeader);
+    header.systemRecordSize = sizeof(GalaxySystemRecord);
+    header.planetRecordSize = sizeof(GalaxyPlanetRecord);
+    header.sectorRecordSize = sizeof(GalaxySectorRecord);
+    header.radius = radius;
+    header.seed = settings.seed;
+    header.sectorSize = settings.sectorSize;
+    header.planetOffset = sizeof(GalaxyFileHeader);
+    // Written again with the counts and offsets at the end.
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    // Planets are streamed to the file block by block, systems and the index are kept until the end.
+    std::vector<GalaxySystemRecord> systems;
+    std::vector<GalaxySectorRecord> index;
+    uint64_t planetCount = 0;
+
+    const size_t blockSize = 4096;
+    std::vector<BakedSector> block;
+    for (size_t first = 0; first < order.size(); first += blockSize) {
+        size_t count = std::min(blockSize, order.size() - first);
+        block.assign(count, BakedSector());
+
+        ThreadPool::GetInstance()->ParallelFor(count, [&](size_t i) {
+            const DirectX::XMINT3& coordinates = order[first + i].second;
+            GalaxySector sector;
+            galaxy.GenerateSector(coordinates.x, coordinates.y, coordinates.z, sector);
+
+            BakedSector& baked = block[i];
+            baked.mortonCode = order[first + i].first;
+            for (const GalaxySystem& system : sector.systems) {
+                GalaxySystemRecord record = {};
+                record.key = system.key;
+                record.position[0] = system.position.x;
+                record.position[1] = system.position.y;
+                record.position[2] = system.position.z;
+                record.starRadius = system.starRadius;
+                record.sector[0] = coordinates.x;
+                record.sector[1] = coordinates.y;
+                record.sector[2] = coordinates.z;
+                record.slot = system.slot;
+                record.firstPlanet = system.firstPlanet;
+                record.planetCount = system.planetCount;
+                baked.systems.push_back(record);
+            }
+            for (size_t p = 0; p < sector.planets.Size(); p++)
+                baked.planets.push_back(WritePlanet(sector.planets, p));
+        });
+
+        for (BakedSector& baked : block) {
+            if (baked.systems.empty())
+                continue;
+            GalaxySectorRecord sectorRecord = { baked.mortonCode, static_cast<uint32_t>(systems.size()), static_cast<uint32_t>(baked.systems.size()) };
+            index.push_back(sectorRecord);
+            for (GalaxySystemRecord& record : baked.systems) {
+                record.firstPlanet += planetCount;
+                systems.push_back(record);
+            }
+            output.write(reinterpret_cast<const char*>(baked.planets.data()), baked.planets.size() * sizeof(GalaxyPlanetRecord));
+            planetCount += baked.planets.size();
+        }
+    }
+
+    header.systemCount = static_cast<uint32_t>(systems.size());
+    header.planetCount = planetCount;
+    header.sectorCount = static_cast<uint32_t>(index.size());
+    header.systemOffset = header.planetOffset + planetCount * sizeof(GalaxyPlanetRecord);
+    header.sectorOffset = header.systemOffset + systems.size() * sizeof(GalaxySystemRecord);
+    output.write(reinterpret_cast<const char*>(systems.data()), systems.size() * sizeof(GalaxySystemRecord));
+    output.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(GalaxySectorRecord));
+    output.seekp(0);
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    output.close();
+    if (!output) {
+        std::cout << "Writing the galaxy database '" << path << "' failed." << std::endl;
+        return false;
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Baked " << order.size() << " sectors, " << header.systemCount << " systems and " << planetCount << " planets in " << seconds << " s (" <<
+        header.systemCount / seconds / 1000.0 << " k systems/s on " << ThreadPool::GetInstance()->GetThreadCount() << " threads), " <<
+        header.sectorOffset + index.size() * sizeof(GalaxySectorRecord) << " bytes." << std::endl;
+    return true;
+}
+
+bool GalaxyDatabase::Open(const std::string& path)
+{
+    Close();
+
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart < static_cast<LONGLONG>(sizeof(GalaxyFileHeader))) {
+        Close();
+        return false;
+    }
+    fileSize = static_cast<uint64_t>(size.QuadPart);
+
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr)
+        view = static_cast<const UINT8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (view == nullptr) {
+        Close();
+        return false;
+    }
+
+    // Files of other versions or record layouts are not read at all.
+    const GalaxyFileHeader* fileHeader = reinterpret_cast<const GalaxyFileHeader*>(view);
+    bool valid = std::equal(Magic, Magic + sizeof(Magic), fileHeader->magic) &&
+        fileHeader->version == Version &&
+        fileHeader->headerSize == sizeof(GalaxyFileHeader) &&
+        fileHeader->systemRecordSize == sizeof(GalaxySystemRecord) &&
+        fileHeader->planetRecordSize == sizeof(GalaxyPlanetRecord) &&
+        fileHeader->sectorRecordSize == sizeof(GalaxySectorRecord) &&
+        fileHeader->planetOffset + fileHeader->planetCount * sizeof(GalaxyPlanetRecord) <= fileHeader->systemOffset &&
+        fileHeader->systemOffset + fileHeader->systemCount * sizeof(GalaxySystemRecord) <= fileHeader->sectorOffset &&
+        fileHeader->sectorOffset + fileHeader->sectorCount * sizeof(GalaxySectorRecord) <= fileSize;
+    if (!valid) {
+        std::cout << "The galaxy database '" << path << "' is not a version " << Version << " database." << std::endl;
+        Close();
+        return false;
+    }
+
+    header = fileHeader;
+    planets = reinterpret_cast<const GalaxyPlanetRecord*>(view + header->planetOffset);
+    systemRecords = reinterpret_cast<const GalaxySystemRecord*>(view + header->systemOffset);
+    sectors = reinterpret_cast<const GalaxySectorRecord*>(view + header->sectorOffset);
+    return true;
+}
+
+void GalaxyDatabase::Close()
+{
+    if (view != nullptr)
+        UnmapViewOfFile(view);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+    view = nullptr;
+    fileSize = 0;
+    header = nullptr;
+    planets = nullptr;
+    systemRecords = nullptr;
+    sectors = nullptr;
+}
+
+bool GalaxyDatabase::Matches(const GalaxySettings& settings) const
+{
+    return header != nullptr && header->seed == settings.seed && header->sectorSize == settings.sectorSize;
+}
+
+const GalaxySectorRecord* GalaxyDatabase::FindSector(int x, int y, int z) const
+{
+    if (header == nullptr || std::abs(x) > header->radius || std::abs(y) > header->radius || std::abs(z) > header->radius)
+        return nullptr;
+
+    uint64_t code = MortonCode(x, y, z);
+    const GalaxySectorRecord* end = sectors + header->sectorCount;
+    const GalaxySectorRecord* sector = std::lower_bound(sectors, end, code, [](const GalaxySectorRecord& record, uint64_t value) {
+        return record.mortonCode < value;
+    });
+    return (sector != end && sector->mortonCode == code) ? sector : nullptr;
+}
+
+GalaxySystem GalaxyDatabase::ToSystem(const GalaxySystemRecord& record) const
+{
+    GalaxySystem system;
+    system.key = record.key;
+    system.sectorKey = Galaxy::SectorKey(record.sector[0], record.sector[1], record.sector[2]);
+    system.slot = record.slot;
+    system.position = DirectX::XMFLOAT3(record.position[0], record.position[1], record.position[2]);
+    system.starRadius = record.starRadius;
+    system.firstPlanet = static_cast<int>(record.firstPlanet);
+    system.planetCount = static_cast<int>(record.planetCount);
+    return system;
+}
+
+void GalaxyDatabase::GetSectorSystems(int x, int y, int z, std::vector<GalaxySystem>& systems) const
+{
+    systems.clear();
+    const GalaxySectorRecord* sector = FindSector(x, y, z);
+    if (sector == nullptr)
+        return;
+    for (uint32_t i = 0; i < sector->systemCount; i++)
+        systems.push_back(ToSystem(systemRecords[sector->firstSystem + i]));
+}
+
+void GalaxyDatabase::FindNearestSystems(DirectX::XMFLOAT3 position, size_t count, std::vector<GalaxySystem>& systems) const
+{
+    systems.clear();
+    if (header == nullptr || count == 0)
+        return;
+
+    float sectorSize = header->sectorSize;
+    int centreX = static_cast<int>(std::floor(position.x / sectorSize + 0.5f));
+    int centreY = static_cast<int>(std::floor(position.y / sectorSize + 0.5f));
+    int centreZ = static_cast<int>(std::floor(position.z / sectorSize + 0.5f));
+    int lastShell = header->radius + std::max(std::abs(centreX), std::max(std::abs(centreY), std::abs(centreZ)));
+
+    // Best candidates so far as a max-heap on the squared distance.
+    std::vector<std::pair<float, uint32_t>> best;
+    auto farther = [](const std::pair<float, uint32_t>& a, const std::pair<float, uint32_t>& b) { return a.first < b.first; };
+
+    for (int shell = 0; shell <= lastShell; shell++) {
+        // Every system of this shell is at least shell - 1 sectors away.
+        float shellDistance = std::max(0, shell - 1) * sectorSize;
+        if (best.size() == count && best.front().first <= shellDistance * shellDistance)
+            break;
+
+        for (int z = -shell; z <= shell; z++) {
+            for (int y = -shell; y <= shell; y++) {
+                // Inside the shell only the two x faces are visited.
+                bool surface = std::abs(z) == shell || std::abs(y) == shell;
+                for (int x = -shell; x <= shell; x += surface ? 1 : std::max(1, 2 * shell)) {
+                    const GalaxySectorRecord* sector = FindSector(centreX + x, centreY + y, centreZ + z);
+                    if (sector == nullptr)
+                        continue;
+                    for (uint32_t i = sector->firstSystem; i < sector->firstSystem + sector->systemCount; i++) {
+                        const GalaxySystemRecord& record = systemRecords[i];
+                        float dx = record.position[0] - position.x;
+                        float dy = record.position[1] - position.y;
+                        float dz = record.position[2] - position.z;
+                        float distance = dx * dx + dy * dy + dz * dz;
+                        if (best.size() < count) {
+                            best.push_back(std::make_pair(distance, i));
+                            std::push_heap(best.begin(), best.end(), farther);
+                        }
+                        else if (distance < best.front().first) {
+                            std::pop_heap(best.begin(), best.end(), farther);
+                            best.back() = std::make_pair(distance, i);
+                            std::push_heap(best.begin(), best.end(), farther);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    std::sort_heap(best.begin(), best.end(), farther);
+    for (const std::pair<float, uint32_t>& candidate : best)
+        systems.push_back(ToSystem(systemRecords[candidate.second]));
+}
+
+PlanetConfiguration GalaxyDatabase::GetPlanetConfiguration(const GalaxySystem& system, int planet) const
+{
+    if (header == nullptr || planet < 0 || planet >= system.planetCount || system.firstPlanet + planet >= header->planetCount)
+        throw "Planet is not in the galaxy database!";
+
+    PlanetConfigurationBatch batch;
+    batch.Resize(1);
+    ReadPlanet(planets[system.firstPlanet + planet], batch, 0);
+    std::string id = std::to_string(system.key) + "-" + std::to_string(planet);
+    return generator.ExpandConfiguration(batch, 0, id, system.position);
+}
+
+GalaxyPlanetRecord GalaxyDatabase::WritePlanet(const PlanetConfigurationBatch& batch, size_t index)
+{
+    GalaxyPlanetRecord record = {};
+    record.key = batch.key[index];
+    record.radius = batch.radius[index];
+    record.velocity = batch.velocity[index];
+    record.orbitOffset = batch.orbitOffset[index];
+    record.orbitInitialAngleRad = batch.orbitInitialAngleRad[index];
+    record.orbitEmptyRange = batch.orbitEmptyRange[index];
+    record.orbitAxis[0] = batch.orbitAxis[index].x;
+    record.orbitAxis[1] = batch.orbitAxis[index].y;
+    record.orbitAxis[2] = batch.orbitAxis[index].z;
+    record.orbitAngle = batch.orbitAngle[index];
+    record.orbit = batch.orbit[index];
+    record.exist = batch.exist[index];
+    record.numberOfLayers = static_cast<uint8_t>(batch.numberOfLayers[index]);
+
+    for (int l = 0; l < batch.numberOfLayers[index]; l++) {
+        const PlanetSurfaceConfiguration& layer = batch.layers[index].layers[l];
+        GalaxyLayerRecord& layerRecord = record.layers[l];
+        layerRecord.baseRoughness = layer.baseRoughness;
+        layerRecord.roughness = layer.roughness;
+        layerRecord.persistance = layer.persistance;
+        layerRecord.minValue = layer.minValue;
+        layerRecord.strength = layer.strength;
+        layerRecord.steps = layer.steps;
+        layerRecord.userFirstLayerAsMask = layer.userFirstLayerAsMask ? 1 : 0;
+        layerRecord.basis = static_cast<uint8_t>(layer.basis);
+        layerRecord.fractal = static_cast<uint8_t>(layer.fractal);
+        layerRecord.precision = static_cast<uint8_t>(layer.precision);
+    }
+
+    const PlanetCraterConfiguration& craters = batch.craters[index];
+    record.craterCount = craters.count;
+    record.craterMinRadius = craters.minRadius;
+    record.craterMaxRadius = craters.maxRadius;
+    record.craterDepth = craters.depth;
+    record.craterRimHeight = craters.rimHeight;
+    record.craterRimWidth = craters.rimWidth;
+    return record;
+}
+
+void GalaxyDatabase::ReadPlanet(const GalaxyPlanetRecord& record, PlanetConfigurationBatch& batch, size_t index)
+{
+    batch.key[index] = record.key;
+    batch.radius[index] = record.radius;
+    batch.velocity[index] = record.velocity;
+    batch.orbitOffset[index] = record.orbitOffset;
+    batch.orbitInitialAngleRad[index] = record.orbitInitialAngleRad;
+    batch.orbitEmptyRange[index] = record.orbitEmptyRange;
+    batch.orbitAxis[index] = DirectX::XMFLOAT3(record.orbitAxis[0], record.orbitAxis[1], record.orbitAxis[2]);
+    batch.orbitAngle[index] = record.orbitAngle;
+    batch.orbit[index] = record.orbit;
+    batch.exist[index] = record.exist;
+    batch.numberOfLayers[index] = std::min<int>(record.numberOfLayers, PlanetConfigurationBatch::MaxLayers);
+
+    for (int l = 0; l < batch.numberOfLayers[index]; l++) {
+        const GalaxyLayerRecord& layerRecord = record.layers[l];
+        PlanetSurfaceConfiguration& layer = batch.layers[index].layers[l];
+        layer.baseRoughness = layerRecord.baseRoughness;
+        layer.roughness = layerRecord.roughness;
+        layer.persistance = layerRecord.persistance;
+        layer.minValue = layerRecord.minValue;
+        layer.strength = layerRecord.strength;
+        layer.steps = layerRecord.steps;
+        layer.centre = DirectX::XMFLOAT3(0, 0, 0);
+        layer.userFirstLayerAsMask = layerRecord.userFirstLayerAsMask != 0;
+        layer.basis = static_cast<NoiseBasis>(layerRecord.basis);
+        layer.fractal = static_cast<NoiseFractal>(layerRecord.fractal);
+        layer.precision = static_cast<NoisePrecision>(layerRecord.precision);
+    }
+
+    PlanetCraterConfiguration& craters = batch.craters[index];
+    craters.count = record.craterCount;
+    craters.minRadius = record.craterMinRadius;
+    craters.maxRadius = record.craterMaxRadius;
+    craters.depth = record.craterDepth;
+    craters.rimHeight = record.craterRimHeight;
+    craters.rimWidth = record.craterRimWidth;
+}
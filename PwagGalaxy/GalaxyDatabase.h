@@ -0,0 +1,140 @@
+#pragma once
+
+#include "Galaxy.h"
+
+// On-disk layout of a baked galaxy (all little endian, every record has a fixed size):
+//   header | planet records | system records | sector index
+// Systems are sorted by the Morton code of their sector (then by slot), so nearby sectors are close
+// in the file, and the planets of a system follow each other in the same order. The sector index holds
+// every non-empty sector, sorted by the same code, for binary search.
+struct GalaxyFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t systemRecordSize;
+    uint32_t planetRecordSize;
+    uint32_t sectorRecordSize;
+    int32_t radius;                 // Sectors from -radius to radius along every axis are baked.
+    uint64_t seed;
+    float sectorSize;
+    uint32_t systemCount;
+    uint64_t planetCount;
+    uint32_t sectorCount;
+    uint32_t padding;
+    uint64_t planetOffset;
+    uint64_t systemOffset;
+    uint64_t sectorOffset;
+};
+
+struct GalaxySystemRecord
+{
+    uint64_t key;
+    float position[3];
+    float starRadius;
+    int32_t sector[3];
+    int32_t slot;
+    uint64_t firstPlanet;
+    uint32_t planetCount;
+    uint32_t padding;
+};
+
+struct GalaxyLayerRecord
+{
+    float baseRoughness;
+    float roughness;
+    float persistance;
+    float minValue;
+    float strength;
+    int32_t steps;
+    uint8_t userFirstLayerAsMask;
+    uint8_t basis;
+    uint8_t fractal;
+    uint8_t precision;
+};
+
+struct GalaxyPlanetRecord
+{
+    uint64_t key;
+    float radius;
+    float velocity;
+    float orbitOffset;
+    float orbitInitialAngleRad;
+    float orbitEmptyRange;
+    float orbitAxis[3];
+    float orbitAngle;
+    float orbit;
+    uint8_t exist;
+    uint8_t numberOfLayers;
+    uint8_t padding[2];
+    GalaxyLayerRecord layers[PlanetConfigurationBatch::MaxLayers];
+    int32_t craterCount;
+    float craterMinRadius;
+    float craterMaxRadius;
+    float craterDepth;
+    float craterRimHeight;
+    float craterRimWidth;
+};
+
+struct GalaxySectorRecord
+{
+    uint64_t mortonCode;
+    uint32_t firstSystem;
+    uint32_t systemCount;
+};
+
+// A galaxy baked offline by Bake() and memory-mapped at runtime. Queries only read the mapped records,
+// nothing is generated; the systems and planets are the same as the ones Galaxy streams with the same
+// settings. Started from the command line with "-bakegalaxy <file> <radius>".
+class GalaxyDatabase
+{
+public:
+    static const uint32_t Version = 1;
+
+    GalaxyDatabase() = default;
+    ~GalaxyDatabase();
+    GalaxyDatabase(const GalaxyDatabase& other) = delete;
+    void operator=(const GalaxyDatabase&) = delete;
+
+    // Generate every sector within the radius (sectors in parallel) and write the file.
+    static bool Bake(const GalaxySettings& settings, int radius, const std::string& path);
+
+    // Map a baked file. Returns false when it is missing or was written by another version.
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return header != nullptr; }
+    // True when the file was baked with the seed and sector size of these settings.
+    bool Matches(const GalaxySettings& settings) const;
+
+    // The k systems closest to the position, nearest first. Sectors are visited in growing shells
+    // around the one of the position until no closer system can be found.
+    void FindNearestSystems(DirectX::XMFLOAT3 position, size_t count, std::vector<GalaxySystem>& systems) const;
+    // Systems of a sector (none when it is empty or outside the baked radius).
+    void GetSectorSystems(int x, int y, int z, std::vector<GalaxySystem>& systems) const;
+    PlanetConfiguration GetPlanetConfiguration(const GalaxySystem& system, int planet) const;
+
+    uint32_t GetSystemCount() const { return header ? header->systemCount : 0; }
+    uint64_t GetPlanetCount() const { return header ? header->planetCount : 0; }
+    uint64_t GetFileSize() const { return fileSize; }
+
+    static uint64_t MortonCode(int x, int y, int z);
+
+private:
+    const GalaxySectorRecord* FindSector(int x, int y, int z) const;
+    GalaxySystem ToSystem(const GalaxySystemRecord& record) const;
+
+    static GalaxyPlanetRecord WritePlanet(const PlanetConfigurationBatch& batch, size_t index);
+    static void ReadPlanet(const GalaxyPlanetRecord& record, PlanetConfigurationBatch& batch, size_t index);
+
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+    const UINT8* view = nullptr;
+    uint64_t fileSize = 0;
+
+    const GalaxyFileHeader* header = nullptr;
+    const GalaxyPlanetRecord* planets = nullptr;
+    const GalaxySystemRecord* systemRecords = nullptr;
+    const GalaxySectorRecord* sectors = nullptr;
+
+    ConfigurationGenerator generator;
+};
@@ -0,0 +1,243 @@
+#include "stdafx.h"
+#include "GenerationWorkers.h"
+
+#include "ConfigurationGenerator.h"
+#include "PlanetBake.h"
+#include "ThreadPool.h"
+#include <chrono>
+#include <sstream>
+
+namespace
+{
+    // Entry state of a running job is RunningBase + the index of its worker, so a claim also records who has it.
+    const LONG RunningBase = 16;
+    const DWORD WaitMs = 100;
+}
+
+GenerationWorkerPool::GenerationWorkerPool(int workerCount, int capacity, int resolution) :
+    capacity(capacity),
+    resolution(resolution)
+{
+    if (capacity < 1 || capacity > MaxCapacity)
+        throw "Generation worker ring capacity is out of range!";
+
+    DWORD coordinator = GetCurrentProcessId();
+    uint64_t size = sizeof(RingHeader) + static_cast<uint64_t>(capacity) * SlabSize(resolution);
+    mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32), static_cast<DWORD>(size), ObjectName(coordinator, L"ring").c_str());
+    if (mapping == nullptr)
+        throw "Cannot create the generation worker ring!";
+    ring = static_cast<RingHeader*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (ring == nullptr)
+        throw "Cannot map the generation worker ring!";
+
+    // The pages of a new mapping are zero, so every entry starts out Free.
+    ring->capacity = capacity;
+    ring->resolution = resolution;
+    ring->slabSize = SlabSize(resolution);
+    ring->shutdown = 0;
+
+    // Room for a count per entry and the wake up of every worker at shutdown.
+    jobsQueued = CreateSemaphoreW(nullptr, 0, capacity + workerCount, ObjectName(coordinator, L"queued").c_str());
+    jobDone = CreateEventW(nullptr, FALSE, FALSE, ObjectName(coordinator, L"done").c_str());
+    if (jobsQueued == nullptr || jobDone == nullptr)
+        throw "Cannot create the generation worker events!";
+
+    workers.assign(workerCount, nullptr);
+    for (int i = 0; i < workerCount; i++)
+        StartWorker(i);
+}
+
+GenerationWorkerPool::~GenerationWorkerPool()
+{
+    if (ring != nullptr) {
+        InterlockedExchange(&ring->shutdown, 1);
+        // Workers also look at the flag whenever their wait times out.
+        ReleaseSemaphore(jobsQueued, static_cast<LONG>(workers.size()), nullptr);
+    }
+
+    if (!workers.empty()) {
+        if (WaitForMultipleObjects(static_cast<DWORD>(workers.size()), workers.data(), TRUE, 10 * WaitMs) == WAIT_TIMEOUT) {
+            for (HANDLE worker : workers)
+                TerminateProcess(worker, 1);
+        }
+        for (HANDLE worker : workers)
+            CloseHandle(worker);
+    }
+
+    if (jobDone != nullptr)
+        CloseHandle(jobDone);
+    if (jobsQueued != nullptr)
+        CloseHandle(jobsQueued);
+    if (ring != nullptr)
+        UnmapViewOfFile(ring);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+}
+
+std::wstring GenerationWorkerPool::ObjectName(DWORD coordinator, const wchar_t* object)
+{
+    return L"Local\\PwagGalaxyWorkers-" + std::to_wstring(coordinator) + L"-" + object;
+}
+
+float* GenerationWorkerPool::Slab(int entry) const
+{
+    return reinterpret_cast<float*>(reinterpret_cast<UINT8*>(ring) + sizeof(RingHeader) + entry * ring->slabSize);
+}
+
+void GenerationWorkerPool::StartWorker(int worker)
+{
+    wchar_t path[MAX_PATH];
+    GetModuleFileNameW(nullptr, path, MAX_PATH);
+    std::wstring commandLine = L"\"" + std::wstring(path) + L"\" -generationworker " + std::to_wstring(GetCurrentProcessId()) + L" " + std::to_wstring(worker);
+
+    STARTUPINFOW startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo = {};
+    if (!CreateProcessW(nullptr, &commandLine[0], nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &startupInfo, &processInfo))
+        throw "Cannot start a generation worker!";
+
+    CloseHandle(processInfo.hThread);
+    workers[worker] = processInfo.hProcess;
+}
+
+void GenerationWorkerPool::TerminateWorker(int worker)
+{
+    TerminateProcess(workers[worker], 1);
+}
+
+void GenerationWorkerPool::RecoverWorkers()
+{
+    for (int i = 0; i < static_cast<int>(workers.size()); i++) {
+        if (WaitForSingleObject(workers[i], 0) != WAIT_OBJECT_0)
+            continue;
+
+        // Jobs the worker had claimed go back to the queue.
+        for (int e = 0; e < capacity; e++) {
+            if (InterlockedCompareExchange(&ring->entries[e].state, Queued, RunningBase + i) == RunningBase + i) {
+                if (!ReleaseSemaphore(jobsQueued, 1, nullptr))
+                    throw "Cannot queue a generation job again!";
+                stats.requeuedJobs++;
+            }
+        }
+
+        CloseHandle(workers[i]);
+        StartWorker(i);
+        stats.restartedWorkers++;
+    }
+}
+
+void GenerationWorkerPool::Run(const std::vector<uint64_t>& keys, const std::function<void(size_t, const float*)>& visit)
+{
+    auto start = std::chrono::steady_clock::now();
+    double workerMs = 0.0;
+    size_t next = 0;
+    size_t oldest = 0;
+
+    while (oldest < keys.size()) {
+        // Keep the ring full.
+        while (next < keys.size() && next - oldest < static_cast<size_t>(capacity)) {
+            RingEntry& entry = ring->entries[next % capacity];
+            entry.key = keys[next];
+            entry.workerMs = 0.0;
+            InterlockedExchange(&entry.state, Queued);
+            if (!ReleaseSemaphore(jobsQueued, 1, nullptr))
+                throw "Cannot queue a generation job!";
+            next++;
+        }
+
+        // Results are handed out in order, nothing new is queued until the oldest job is done.
+        RingEntry& entry = ring->entries[oldest % capacity];
+        if (InterlockedCompareExchange(&entry.state, Done, Done) != Done) {
+            RecoverWorkers();
+            WaitForSingleObject(jobDone, WaitMs);
+            continue;
+        }
+
+        visit(oldest, Slab(static_cast<int>(oldest % capacity)));
+        workerMs += entry.workerMs;
+        InterlockedExchange(&entry.state, Free);
+        oldest++;
+    }
+
+    stats.completedJobs += keys.size();
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.meanWorkerMs = keys.empty() ? 0.0 : workerMs / keys.size();
+}
+
+int GenerationWorkerPool::RunWorker(const std::wstring& arguments)
+{
+    std::wstringstream argumentStream(arguments);
+    DWORD coordinator = 0;
+    int index = -1;
+    argumentStream >> coordinator >> index;
+    if (index < 0)
+        return 1;
+
+    // The other workers run on the remaining cores, one thread each is enough.
+    ThreadPool::SetThreadCount(1);
+
+    HANDLE coordinatorProcess = OpenProcess(SYNCHRONIZE, FALSE, coordinator);
+    HANDLE mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, ObjectName(coordinator, L"ring").c_str());
+    HANDLE jobsQueued = OpenSemaphoreW(SYNCHRONIZE | SEMAPHORE_MODIFY_STATE, FALSE, ObjectName(coordinator, L"queued").c_str());
+    HANDLE jobDone = OpenEventW(EVENT_MODIFY_STATE, FALSE, ObjectName(coordinator, L"done").c_str());
+    RingHeader* ring = mapping != nullptr ? static_cast<RingHeader*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0)) : nullptr;
+
+    if (coordinatorProcess != nullptr && ring != nullptr && jobsQueued != nullptr && jobDone != nullptr) {
+        while (ring->shutdown == 0) {
+            // Nobody is left to collect the results.
+            if (WaitForSingleObject(coordinatorProcess, 0) == WAIT_OBJECT_0)
+                break;
+            // The ring is also looked through when the wait times out: a worker that died between taking
+            // a count and claiming its entry left that entry Queued without a count.
+            bool counted = WaitForSingleObject(jobsQueued, WaitMs) == WAIT_OBJECT_0;
+
+            for (uint32_t e = 0; e < ring->capacity; e++) {
+                RingEntry& entry = ring->entries[e];
+                if (InterlockedCompareExchange(&entry.state, RunningBase + index, Queued) != Queued)
+                    continue;
+                // A claim found by the scan takes a count as well, if its count is still there, so the
+                // counts do not pile up past the maximum of the semaphore.
+                if (!counted)
+                    WaitForSingleObject(jobsQueued, 0);
+
+                auto start = std::chrono::steady_clock::now();
+                float* heights = reinterpret_cast<float*>(reinterpret_cast<UINT8*>(ring) + sizeof(RingHeader) + e * ring->slabSize);
+                BakeElevations(entry.key, ring->resolution, heights);
+                entry.workerMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+                InterlockedExchange(&entry.state, Done);
+                SetEvent(jobDone);
+                break;
+            }
+        }
+    }
+
+    if (ring != nullptr)
+        UnmapViewOfFile(ring);
+    if (mapping != nullptr)
+        CloseHandle(mapping);
+    if (jobsQueued != nullptr)
+        CloseHandle(jobsQueued);
+    if (jobDone != nullptr)
+        CloseHandle(jobDone);
+    if (coordinatorProcess != nullptr)
+        CloseHandle(coordinatorProcess);
+    return 0;
+}
+
+void GenerationWorkerPool::BakeElevations(uint64_t key, int resolution, float* heights)
+{
+    ConfigurationGenerator generator;
+    PlanetConfigurationBatch batch;
+    generator.GeneratePlanetConfigurations(&key, nullptr, 1, batch);
+    PlanetConfiguration planetDescription = generator.ExpandConfiguration(batch, 0, std::to_string(key), DirectX::XMFLOAT3(0, 0, 0));
+
+    PlanetTerrain terrain(planetDescription, static_cast<int>(key & 0x7fffffff));
+    PlanetBake bake;
+    bake.Bake(terrain, resolution);
+
+    for (int face = 0; face < PlanetBake::FaceCount; face++)
+        for (int y = 0; y < resolution; y++)
+            for (int x = 0; x < resolution; x++)
+                heights[(static_cast<size_t>(face) * resolution + y) * resolution + x] = bake.GetTexelHeight(face, x, y);
+}
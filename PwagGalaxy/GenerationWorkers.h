@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+
+struct GenerationWorkerStats
+{
+    size_t completedJobs = 0;
+    size_t restartedWorkers = 0;
+    size_t requeuedJobs = 0;
+    double seconds = 0.0;               // Wall time of the last Run().
+    double meanWorkerMs = 0.0;          // Time a worker spent on one job, averaged over the last Run().
+};
+
+// Terrain generation in child processes, for bakes too large for one process and so a crash only costs
+// the job it happened in. The coordinator and its workers share one named file mapping: a ring of job
+// entries followed by one result slab per entry. A job is the key of a planet configuration (Hash64 of
+// its id, see ConfigurationGenerator), the worker derives the configuration from it and writes the
+// baked elevations into the slab of the entry, where the coordinator reads them in place.
+// At most capacity jobs are in flight, the coordinator waits for the oldest one before queueing more.
+// Workers are watched while waiting; one that exits is started again and its job is queued again.
+// A worker process runs its jobs on one thread, the parallelism comes from the worker count.
+class GenerationWorkerPool
+{
+public:
+    static const int MaxCapacity = 64;
+
+    // Start workerCount copies of this executable with "-generationworker".
+    GenerationWorkerPool(int workerCount, int capacity, int resolution);
+    ~GenerationWorkerPool();
+    GenerationWorkerPool(const GenerationWorkerPool& other) = delete;
+    void operator=(const GenerationWorkerPool&) = delete;
+
+    // Bake the elevations of every key. visit(i, heights) is called in key order, heights points to
+    // 6 * resolution * resolution values in the shared slab and is only valid during the call.
+    void Run(const std::vector<uint64_t>& keys, const std::function<void(size_t, const float*)>& visit);
+    // Kill a worker, to exercise the recovery. It is started again the next time Run() waits.
+    void TerminateWorker(int worker);
+
+    const GenerationWorkerStats& GetStats() const { return stats; }
+    int GetResolution() const { return resolution; }
+
+    // Entry point of a worker process, arguments are the ones after "-generationworker".
+    static int RunWorker(const std::wstring& arguments);
+    // The work of one job, shared by the workers and in-process generation (6 * resolution^2 values).
+    static void BakeElevations(uint64_t key, int resolution, float* heights);
+
+private:
+    // A running job holds RunningBase + the index of its worker instead (see GenerationWorkers.cpp).
+    enum EntryState : LONG { Free, Queued, Done };
+
+    struct RingEntry
+    {
+        volatile LONG state;
+        uint64_t key;
+        double workerMs;
+    };
+
+    struct RingHeader
+    {
+        uint32_t capacity;
+        uint32_t resolution;
+        uint64_t slabSize;
+        volatile LONG shutdown;
+        RingEntry entries[MaxCapacity];
+    };
+
+    static std::wstring ObjectName(DWORD coordinator, const wchar_t* object);
+    static size_t SlabSize(int resolution) { return static_cast<size_t>(6) * resolution * resolution * sizeof(float); }
+    float* Slab(int entry) const;
+    void StartWorker(int worker);
+    // Restart workers that have exited and queue their jobs again.
+    void RecoverWorkers();
+
+    int capacity;
+    int resolution;
+    HANDLE mapping = nullptr;
+    RingHeader* ring = nullptr;
+    HANDLE jobsQueued = nullptr;        // Semaphore, one count per queued entry.
+    HANDLE jobDone = nullptr;           // Auto-reset event set by a worker after every job.
+    std::vector<HANDLE> workers;
+
+    GenerationWorkerStats stats;
+};
@@ -0,0 +1,67 @@
+#include "stdafx.h"
+#include "InstancedMaterial.h"
+
+std::vector<D3D12_ROOT_PARAMETER> InstancedMaterial::CreateRootParameters()
+{
+    // Create the root descriptor (for view and projection matrices)
+    D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
+    rootCBVDescriptor.ShaderRegister = 0; // b0 in shader
+    rootCBVDescriptor.RegisterSpace = 0;
+
+    // Create another root descriptor (for lighting parameters)
+    D3D12_ROOT_DESCRIPTOR lightingCBVDescriptor;
+    lightingCBVDescriptor.ShaderRegister = 1; // b1 in shader
+    lightingCBVDescriptor.RegisterSpace = 0;
+
+    // The instance transforms, bound at the first instance of every draw.
+    D3D12_ROOT_DESCRIPTOR instanceSRVDescriptor;
+    instanceSRVDescriptor.ShaderRegister = 1; // t1 in shader
+    instanceSRVDescriptor.RegisterSpace = 0;
+
+    // Create the descriptor table for the texture resource.
+    descriptorTablePixelRanges.resize(1);
+    descriptorTablePixelRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    descriptorTablePixelRanges[0].NumDescriptors = 1;
+    descriptorTablePixelRanges[0].BaseShaderRegister = 0; // t0 in shader
+    descriptorTablePixelRanges[0].RegisterSpace = 0;
+    descriptorTablePixelRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+    D3D12_ROOT_DESCRIPTOR_TABLE descriptorTablePixel;
+    descriptorTablePixel.NumDescriptorRanges = descriptorTablePixelRanges.size();
+    descriptorTablePixel.pDescriptorRanges = descriptorTablePixelRanges.data();
+
+    // The first three parameters match LitMaterial, so the bindings of the main pass carry over.
+    rootParameters.resize(4);
+    // View and projection matrices.
+    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    rootParameters[0].Descriptor = rootCBVDescriptor;
+    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    // Lighting parameters.
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    rootParameters[1].Descriptor = lightingCBVDescriptor;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    // Texture.
+    rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[2].DescriptorTable = descriptorTablePixel;
+    rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    // Instance transforms.
+    rootParameters[3].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParameters[3].Descriptor = instanceSRVDescriptor;
+    rootParameters[3].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    return rootParameters;
+}
+
+D3D12_ROOT_SIGNATURE_FLAGS InstancedMaterial::CreateRootSignatureFlags()
+{
+    D3D12_ROOT_SIGNATURE_FLAGS flags = (
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
+
+    return flags;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "Material.h"
+
+// Lit material for instanced draws: the world matrices come from a structured buffer (t1, a root SRV)
+// indexed with SV_InstanceID, the constant buffer at b0 only provides the view and projection.
+class InstancedMaterial : public Material
+{
+public:
+    InstancedMaterial() = default;
+
+private:
+    std::vector<D3D12_DESCRIPTOR_RANGE> descriptorTablePixelRanges;
+    std::vector<D3D12_ROOT_PARAMETER> rootParameters;
+
+    // Inheriting classes can override the following methods to specialize.
+    virtual std::vector<D3D12_ROOT_PARAMETER> CreateRootParameters();
+    virtual D3D12_ROOT_SIGNATURE_FLAGS CreateRootSignatureFlags();
+};
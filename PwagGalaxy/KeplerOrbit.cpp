@@ -0,0 +1,81 @@
+#include "stdafx.h"
+#include "KeplerOrbit.h"
+
+namespace
+{
+    // Enough for eccentricities up to KeplerOrbit::MaxEccentricity starting from E = M + e sin M.
+    const int NewtonSteps = 3;
+}
+
+constexpr float KeplerOrbit::MaxEccentricity;
+constexpr float KeplerOrbit::ConfiguredUpdateRate;
+
+OrbitComponent KeplerOrbit::Create(const DirectX::XMFLOAT3& axis, const DirectX::XMFLOAT3& periapsis, const DirectX::XMFLOAT3& focus,
+    float semiMajorAxis, float eccentricity, float meanMotion, float meanAnomalyAtEpoch)
+{
+    OrbitComponent orbit;
+    DirectX::XMStoreFloat3(&orbit.axis, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&axis)));
+    orbit.periapsis = periapsis;
+    orbit.focus = focus;
+    orbit.semiMajorAxis = semiMajorAxis;
+    orbit.eccentricity = std::min(std::max(eccentricity, 0.0f), MaxEccentricity);
+    orbit.meanMotion = meanMotion;
+    orbit.meanAnomalyAtEpoch = meanAnomalyAtEpoch;
+    orbit.evaluatedTime = -1.0;
+    return orbit;
+}
+
+void KeplerOrbit::Evaluate(OrbitComponent& orbit, double time, TransformComponent& transform)
+{
+    // Reduced to [-pi, pi] in double, the product grows past float precision after a few hours of time warp.
+    const double twoPi = 2.0 * DirectX::XM_PI;
+    double meanAnomaly = orbit.meanAnomalyAtEpoch + static_cast<double>(orbit.meanMotion) * time;
+    meanAnomaly -= std::floor(meanAnomaly / twoPi + 0.5) * twoPi;
+
+    float e = orbit.eccentricity;
+    float sinE, cosE;
+    float eccentricAnomaly = SolveEccentricAnomaly(static_cast<float>(meanAnomaly), e, sinE, cosE);
+    float radius = orbit.semiMajorAxis * (1.0f - e * cosE);
+    // Half angles of E from its cosine (cos(E / 2) >= 0 in [-pi, pi]), the sine from sin E while that is
+    // not ill-conditioned.
+    float halfCosE = std::sqrt(std::max(0.5f * (1.0f + cosE), 0.0f));
+    float halfSinE = halfCosE > 0.5f ? sinE / (2.0f * halfCosE) : std::copysign(std::sqrt(std::max(0.5f * (1.0f - cosE), 0.0f)), eccentricAnomaly);
+    // tan(v / 2) = sqrt((1 + e) / (1 - e)) tan(E / 2) gives the half angle of the true anomaly without atan2.
+    float halfSin = std::sqrt(1.0f + e) * halfSinE;
+    float halfCos = std::sqrt(1.0f - e) * halfCosE;
+    float halfLength = std::sqrt(halfSin * halfSin + halfCos * halfCos);
+    halfSin /= halfLength;
+    halfCos /= halfLength;
+
+    transform.position = DirectX::XMFLOAT3(
+        orbit.focus.x + orbit.periapsis.x * radius,
+        orbit.focus.y + orbit.periapsis.y * radius,
+        orbit.focus.z + orbit.periapsis.z * radius);
+    transform.orbit = DirectX::XMFLOAT4(orbit.axis.x * halfSin, orbit.axis.y * halfSin, orbit.axis.z * halfSin, halfCos);
+    orbit.evaluatedTime = time;
+}
+
+float KeplerOrbit::SolveEccentricAnomaly(float meanAnomaly, float eccentricity)
+{
+    float sinE, cosE;
+    return SolveEccentricAnomaly(meanAnomaly, eccentricity, sinE, cosE);
+}
+
+float KeplerOrbit::SolveEccentricAnomaly(float meanAnomaly, float eccentricity, float& sinE, float& cosE)
+{
+    float eccentricAnomaly = meanAnomaly + eccentricity * std::sin(meanAnomaly);
+    sinE = std::sin(eccentricAnomaly);
+    cosE = std::cos(eccentricAnomaly);
+    for (int step = 0; step < NewtonSteps; step++) {
+        float delta = -(eccentricAnomaly - eccentricity * sinE - meanAnomaly) / (1.0f - eccentricity * cosE);
+        eccentricAnomaly += delta;
+        // The corrections are small, sine and cosine are turned along by their series instead of evaluated again.
+        float delta2 = delta * delta;
+        float sinDelta = delta * (1.0f - delta2 / 6.0f * (1.0f - delta2 / 20.0f));
+        float cosDelta = 1.0f - delta2 / 2.0f * (1.0f - delta2 / 12.0f * (1.0f - delta2 / 30.0f));
+        float turnedSin = sinE * cosDelta + cosE * sinDelta;
+        cosE = cosE * cosDelta - sinE * sinDelta;
+        sinE = turnedSin;
+    }
+    return eccentricAnomaly;
+}
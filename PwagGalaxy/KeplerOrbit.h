@@ -0,0 +1,31 @@
+#pragma once
+
+#include "SceneComponents.h"
+
+// Orbits as Kepler elements. The mean anomaly grows linearly with the simulation time and is reduced in
+// double precision, so even at the largest time warp the angle keeps its float precision. Kepler's
+// equation is solved by a fixed number of Newton steps, which makes the cost of a body the same for every
+// time and allows evaluating only the bodies that are needed, at the time they are needed.
+class KeplerOrbit
+{
+public:
+    // Orbits of the generated bodies keep eccentricities below this, where the Newton steps converge.
+    static constexpr float MaxEccentricity = 0.5f;
+    // PlanetConfiguration::velocity * orbitAngle was the turn of one update, tuned at this rate.
+    static constexpr float ConfiguredUpdateRate = 60.0f;
+
+    // Orbit with its transform not evaluated yet. The axis is normalised and the eccentricity clamped.
+    static OrbitComponent Create(const DirectX::XMFLOAT3& axis, const DirectX::XMFLOAT3& periapsis, const DirectX::XMFLOAT3& focus,
+        float semiMajorAxis, float eccentricity, float meanMotion, float meanAnomalyAtEpoch);
+
+    // Writes position and orbit of the transform for the given simulation time and remembers the time.
+    // The orbit quaternion turns the body by its true anomaly, so it keeps facing the focus with the same side.
+    static void Evaluate(OrbitComponent& orbit, double time, TransformComponent& transform);
+
+    // Eccentric anomaly of a mean anomaly in [-pi, pi].
+    static float SolveEccentricAnomaly(float meanAnomaly, float eccentricity);
+    // Same, with its sine and cosine.
+    static float SolveEccentricAnomaly(float meanAnomaly, float eccentricity, float& sinE, float& cosE);
+    // Largest distance from the focus.
+    static float GetApoapsis(const OrbitComponent& orbit) { return orbit.semiMajorAxis * (1.0f + orbit.eccentricity); }
+};
@@ -98,6 +98,11 @@ void Mesh::InsertDrawIndexed(ComPtr<ID3D12GraphicsCommandList> commandList)
     commandList->DrawIndexedInstanced(indexCount, 1, 0, 0, 0);
 }
 
+void Mesh::InsertDrawIndexedInstanced(ComPtr<ID3D12GraphicsCommandList> commandList, UINT instanceCount)
+{
+    commandList->DrawIndexedInstanced(indexCount, instanceCount, 0, 0, 0);
+}
+
 void Mesh::InsertBufferBind(ComPtr<ID3D12GraphicsCommandList> commandList)
 {
     commandList->IASetVertexBuffers(0, 1, &vertexBufferView);
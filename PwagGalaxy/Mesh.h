@@ -21,6 +21,8 @@ public:
     void CreateFromFile(const std::string fileName);
 
     void InsertDrawIndexed(ComPtr<ID3D12GraphicsCommandList> commandList);
+    // Draw the mesh instanceCount times, SV_InstanceID counts from 0 in every draw.
+    void InsertDrawIndexedInstanced(ComPtr<ID3D12GraphicsCommandList> commandList, UINT instanceCount);
     void InsertBufferBind(ComPtr<ID3D12GraphicsCommandList> commandList);
 
 private:
@@ -0,0 +1,494 @@
+#include "stdafx.h"
+#include "NBodySimulation.h"
+
+#include "ThreadPool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // Bits of a Morton code per axis, also the deepest level of the tree.
+    const int MaxDepth = 21;
+    // The cells of the second level, built in parallel.
+    const int BucketBits = 6;
+    const int BucketCount = 1 << BucketBits;
+    // Bodies per job of the per-body passes.
+    const size_t Chunk = 1024;
+    // Below this many bodies the tree is built on the calling thread.
+    const size_t ParallelBuildThreshold = 4096;
+
+    size_t ChunkCount(size_t count)
+    {
+        return (count + Chunk - 1) / Chunk;
+    }
+
+    // Spread the low 21 bits of v so there are two zero bits between every two of them.
+    uint64_t ExpandBits(uint64_t v)
+    {
+        v &= 0x1fffff;
+        v = (v | v << 32) & 0x1f00000000ffffull;
+        v = (v | v << 16) & 0x1f0000ff0000ffull;
+        v = (v | v << 8) & 0x100f00f00f00f00full;
+        v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+        v = (v | v << 2) & 0x1249249249249249ull;
+        return v;
+    }
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+NBodySimulation::NBodySimulation(const NBodySettings& settings) :
+    settings(settings)
+{
+}
+
+void NBodySimulation::Reserve(size_t count)
+{
+    for (std::vector<float>* values : { &x, &y, &z, &vx, &vy, &vz, &ax, &ay, &az, &mass })
+        values->reserve(count);
+}
+
+size_t NBodySimulation::AddBody(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 velocity, float bodyMass)
+{
+    x.push_back(position.x);
+    y.push_back(position.y);
+    z.push_back(position.z);
+    vx.push_back(velocity.x);
+    vy.push_back(velocity.y);
+    vz.push_back(velocity.z);
+    ax.push_back(0.0f);
+    ay.push_back(0.0f);
+    az.push_back(0.0f);
+    mass.push_back(bodyMass);
+    accelerationsValid = false;
+    return x.size() - 1;
+}
+
+void NBodySimulation::SetAttractors(const std::vector<NBodyAttractor>& attractors)
+{
+    this->attractors = attractors;
+}
+
+int NBodySimulation::Advance(double deltaTime)
+{
+    timeAccumulator += deltaTime;
+    int steps = 0;
+    while (timeAccumulator >= settings.timeStep && steps < settings.maxStepsPerAdvance) {
+        Step();
+        timeAccumulator -= settings.timeStep;
+        steps++;
+    }
+    // Falling behind, the simulation slows down instead of taking ever more steps per frame.
+    if (timeAccumulator >= settings.timeStep)
+        timeAccumulator = std::fmod(timeAccumulator, static_cast<double>(settings.timeStep));
+    return steps;
+}
+
+void NBodySimulation::Step()
+{
+    if (x.empty())
+        return;
+
+    if (!accelerationsValid) {
+        BuildTree();
+        ComputeAccelerations();
+        accelerationsValid = true;
+    }
+
+    float dt = settings.timeStep;
+    Kick(0.5f * dt);
+    Drift(dt);
+    BuildTree();
+    ComputeAccelerations();
+    Kick(0.5f * dt);
+}
+
+void NBodySimulation::Kick(float dt)
+{
+    size_t count = x.size();
+    ThreadPool::GetInstance()->ParallelFor(ChunkCount(count), [&](size_t chunk) {
+        for (size_t i = chunk * Chunk; i < std::min(count, (chunk + 1) * Chunk); i++) {
+            vx[i] += ax[i] * dt;
+            vy[i] += ay[i] * dt;
+            vz[i] += az[i] * dt;
+        }
+    });
+}
+
+void NBodySimulation::Drift(float dt)
+{
+    size_t count = x.size();
+    ThreadPool::GetInstance()->ParallelFor(ChunkCount(count), [&](size_t chunk) {
+        for (size_t i = chunk * Chunk; i < std::min(count, (chunk + 1) * Chunk); i++) {
+            x[i] += vx[i] * dt;
+            y[i] += vy[i] * dt;
+            z[i] += vz[i] * dt;
+        }
+    });
+}
+
+void NBodySimulation::BuildTree()
+{
+    auto start = std::chrono::steady_clock::now();
+    ThreadPool* pool = ThreadPool::GetInstance();
+    size_t count = x.size();
+    size_t chunks = ChunkCount(count);
+
+    // Bounding cube of the bodies.
+    std::vector<DirectX::XMFLOAT3> chunkMin(chunks, DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX));
+    std::vector<DirectX::XMFLOAT3> chunkMax(chunks, DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+    pool->ParallelFor(chunks, [&](size_t chunk) {
+        for (size_t i = chunk * Chunk; i < std::min(count, (chunk + 1) * Chunk); i++) {
+            chunkMin[chunk] = DirectX::XMFLOAT3(std::min(chunkMin[chunk].x, x[i]), std::min(chunkMin[chunk].y, y[i]), std::min(chunkMin[chunk].z, z[i]));
+            chunkMax[chunk] = DirectX::XMFLOAT3(std::max(chunkMax[chunk].x, x[i]), std::max(chunkMax[chunk].y, y[i]), std::max(chunkMax[chunk].z, z[i]));
+        }
+    });
+    DirectX::XMFLOAT3 low = chunkMin[0];
+    DirectX::XMFLOAT3 high = chunkMax[0];
+    for (size_t c = 1; c < chunks; c++) {
+        low = DirectX::XMFLOAT3(std::min(low.x, chunkMin[c].x), std::min(low.y, chunkMin[c].y), std::min(low.z, chunkMin[c].z));
+        high = DirectX::XMFLOAT3(std::max(high.x, chunkMax[c].x), std::max(high.y, chunkMax[c].y), std::max(high.z, chunkMax[c].z));
+    }
+    // Slightly larger, so the bodies on the far faces still quantize inside.
+    rootSize = std::max(high.x - low.x, std::max(high.y - low.y, high.z - low.z)) * 1.0001f + 1e-6f;
+
+    // Morton codes.
+    std::vector<SortEntry> entries(count);
+    float quantize = static_cast<float>(1 << MaxDepth) / rootSize;
+    const float maxCell = static_cast<float>((1 << MaxDepth) - 1);
+    pool->ParallelFor(chunks, [&](size_t chunk) {
+        for (size_t i = chunk * Chunk; i < std::min(count, (chunk + 1) * Chunk); i++) {
+            uint64_t qx = static_cast<uint64_t>(std::min(maxCell, (x[i] - low.x) * quantize));
+            uint64_t qy = static_cast<uint64_t>(std::min(maxCell, (y[i] - low.y) * quantize));
+            uint64_t qz = static_cast<uint64_t>(std::min(maxCell, (z[i] - low.z) * quantize));
+            entries[i].code = ExpandBits(qx) << 2 | ExpandBits(qy) << 1 | ExpandBits(qz);
+            entries[i].body = static_cast<uint32_t>(i);
+        }
+    });
+
+    // Distribute by the cell of the second level, then sort every one of them on its own.
+    const int bucketShift = 3 * MaxDepth - BucketBits;
+    std::vector<uint32_t> bucketFirst(BucketCount + 1, 0);
+    for (const SortEntry& entry : entries)
+        bucketFirst[(entry.code >> bucketShift) + 1]++;
+    for (int b = 0; b < BucketCount; b++)
+        bucketFirst[b + 1] += bucketFirst[b];
+    sorted.resize(count);
+    std::vector<uint32_t> bucketNext(bucketFirst.begin(), bucketFirst.end() - 1);
+    for (const SortEntry& entry : entries)
+        sorted[bucketNext[entry.code >> bucketShift]++] = entry;
+    pool->ParallelFor(BucketCount, [&](size_t b) {
+        std::sort(sorted.begin() + bucketFirst[b], sorted.begin() + bucketFirst[b + 1],
+            [](const SortEntry& left, const SortEntry& right) { return left.code < right.code; });
+    });
+
+    sortedX.resize(count);
+    sortedY.resize(count);
+    sortedZ.resize(count);
+    sortedMass.resize(count);
+    pool->ParallelFor(chunks, [&](size_t chunk) {
+        for (size_t s = chunk * Chunk; s < std::min(count, (chunk + 1) * Chunk); s++) {
+            uint32_t body = sorted[s].body;
+            sortedX[s] = x[body];
+            sortedY[s] = y[body];
+            sortedZ[s] = z[body];
+            sortedMass[s] = mass[body];
+        }
+    });
+
+    nodes.clear();
+    nodes.push_back(Node());
+    if (count < ParallelBuildThreshold) {
+        BuildNode(nodes, 0, 0, static_cast<uint32_t>(count), 0);
+    }
+    else {
+        // Subtrees of the second level in parallel, each with its root at index 0.
+        std::vector<std::vector<Node>> subtrees(BucketCount);
+        pool->ParallelFor(BucketCount, [&](size_t b) {
+            if (bucketFirst[b] == bucketFirst[b + 1])
+                return;
+            subtrees[b].push_back(Node());
+            BuildNode(subtrees[b], 0, bucketFirst[b], bucketFirst[b + 1], 2);
+        });
+
+        // Root, then the first level, then the roots of the second level grouped by their parent.
+        const int octants = 8;
+        std::vector<uint32_t> levelOne;
+        nodes[0].firstChild = 1;
+        nodes[0].childCount = 0;
+        for (int o = 0; o < octants; o++) {
+            if (bucketFirst[o * octants] == bucketFirst[(o + 1) * octants])
+                continue;
+            levelOne.push_back(o);
+            nodes.push_back(Node());
+            nodes[0].childCount++;
+        }
+        std::vector<uint32_t> subtreeRoot(BucketCount, 0);
+        for (size_t l = 0; l < levelOne.size(); l++) {
+            uint32_t parent = static_cast<uint32_t>(1 + l);
+            nodes[parent].size = rootSize * 0.5f;
+            nodes[parent].firstChild = static_cast<uint32_t>(nodes.size());
+            for (int b = levelOne[l] * octants; b < (levelOne[l] + 1) * octants; b++) {
+                if (subtrees[b].empty())
+                    continue;
+                subtreeRoot[b] = static_cast<uint32_t>(nodes.size());
+                nodes.push_back(subtrees[b][0]);
+                nodes[parent].childCount++;
+            }
+        }
+        // The rest of every subtree, local index j > 0 moves to offset + j - 1.
+        for (int b = 0; b < BucketCount; b++) {
+            if (subtrees[b].empty())
+                continue;
+            uint32_t offset = static_cast<uint32_t>(nodes.size()) - 1;
+            if (nodes[subtreeRoot[b]].childCount > 0)
+                nodes[subtreeRoot[b]].firstChild += offset;
+            for (size_t j = 1; j < subtrees[b].size(); j++) {
+                Node node = subtrees[b][j];
+                if (node.childCount > 0)
+                    node.firstChild += offset;
+                nodes.push_back(node);
+            }
+        }
+
+        for (size_t l = 0; l < levelOne.size(); l++)
+            SumChildren(nodes, static_cast<uint32_t>(1 + l));
+        nodes[0].size = rootSize;
+        SumChildren(nodes, 0);
+    }
+
+    stats.nodeCount = nodes.size();
+    stats.buildMs = MillisecondsSince(start);
+}
+
+void NBodySimulation::BuildNode(std::vector<Node>& tree, uint32_t slot, uint32_t first, uint32_t last, int depth) const
+{
+    Node node = {};
+    node.size = std::ldexp(rootSize, -depth);
+    node.first = first;
+    node.count = last - first;
+
+    if (node.count <= static_cast<uint32_t>(settings.leafSize) || depth == MaxDepth) {
+        double massSum = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+        for (uint32_t s = first; s < last; s++) {
+            massSum += sortedMass[s];
+            cx += sortedX[s] * sortedMass[s];
+            cy += sortedY[s] * sortedMass[s];
+            cz += sortedZ[s] * sortedMass[s];
+        }
+        node.mass = static_cast<float>(massSum);
+        if (massSum > 0.0) {
+            node.centerX = static_cast<float>(cx / massSum);
+            node.centerY = static_cast<float>(cy / massSum);
+            node.centerZ = static_cast<float>(cz / massSum);
+        }
+        tree[slot] = node;
+        return;
+    }
+
+    // Within the cell the octant of the next level is sorted too, find where each one starts.
+    int shift = 3 * (MaxDepth - 1 - depth);
+    uint32_t bounds[9];
+    bounds[0] = first;
+    for (uint64_t octant = 0; octant < 8; octant++) {
+        auto end = std::partition_point(sorted.begin() + bounds[octant], sorted.begin() + last,
+            [shift, octant](const SortEntry& entry) { return ((entry.code >> shift) & 7) <= octant; });
+        bounds[octant + 1] = static_cast<uint32_t>(end - sorted.begin());
+    }
+
+    node.firstChild = static_cast<uint32_t>(tree.size());
+    for (int octant = 0; octant < 8; octant++) {
+        if (bounds[octant + 1] > bounds[octant])
+            node.childCount++;
+    }
+    tree.resize(tree.size() + node.childCount);
+    tree[slot] = node;
+
+    uint32_t child = node.firstChild;
+    for (int octant = 0; octant < 8; octant++) {
+        if (bounds[octant + 1] > bounds[octant])
+            BuildNode(tree, child++, bounds[octant], bounds[octant + 1], depth + 1);
+    }
+    SumChildren(tree, slot);
+}
+
+void NBodySimulation::SumChildren(std::vector<Node>& tree, uint32_t slot) const
+{
+    Node& node = tree[slot];
+    double massSum = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+    node.first = tree[node.firstChild].first;
+    node.count = 0;
+    for (uint32_t c = node.firstChild; c < node.firstChild + node.childCount; c++) {
+        const Node& child = tree[c];
+        massSum += child.mass;
+        cx += static_cast<double>(child.centerX) * child.mass;
+        cy += static_cast<double>(child.centerY) * child.mass;
+        cz += static_cast<double>(child.centerZ) * child.mass;
+        node.count += child.count;
+    }
+    node.mass = static_cast<float>(massSum);
+    if (massSum > 0.0) {
+        node.centerX = static_cast<float>(cx / massSum);
+        node.centerY = static_cast<float>(cy / massSum);
+        node.centerZ = static_cast<float>(cz / massSum);
+    }
+}
+
+void NBodySimulation::ComputeAccelerations()
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t count = x.size();
+    size_t chunks = ChunkCount(count);
+    std::vector<size_t> chunkVisited(chunks, 0);
+
+    // In Morton order, so neighbouring bodies walk nearly the same cells.
+    ThreadPool::GetInstance()->ParallelFor(chunks, [&](size_t chunk) {
+        for (size_t s = chunk * Chunk; s < std::min(count, (chunk + 1) * Chunk); s++) {
+            float accelerationX = 0.0f, accelerationY = 0.0f, accelerationZ = 0.0f;
+            TreeAcceleration(static_cast<uint32_t>(s), accelerationX, accelerationY, accelerationZ, chunkVisited[chunk]);
+            AttractorAcceleration(sortedX[s], sortedY[s], sortedZ[s], accelerationX, accelerationY, accelerationZ);
+            uint32_t body = sorted[s].body;
+            ax[body] = accelerationX;
+            ay[body] = accelerationY;
+            az[body] = accelerationZ;
+        }
+    });
+
+    size_t visited = 0;
+    for (size_t v : chunkVisited)
+        visited += v;
+    stats.meanInteractions = count > 0 ? static_cast<double>(visited) / count : 0.0;
+    stats.forceMs = MillisecondsSince(start);
+}
+
+void NBodySimulation::TreeAcceleration(uint32_t s, float& accelerationX, float& accelerationY, float& accelerationZ, size_t& visited) const
+{
+    const float px = sortedX[s], py = sortedY[s], pz = sortedZ[s];
+    const float thetaSquared = settings.openingAngle * settings.openingAngle;
+    const float epsilonSquared = settings.softening * settings.softening;
+
+    // Every level pushes at most eight cells and pops one.
+    uint32_t stack[8 * (MaxDepth + 1)];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        float dx = node.centerX - px;
+        float dy = node.centerY - py;
+        float dz = node.centerZ - pz;
+        float distanceSquared = dx * dx + dy * dy + dz * dz;
+
+        // Far enough and not the cell of the body itself: the cell as one mass.
+        bool containsBody = s >= node.first && s < node.first + node.count;
+        if (!containsBody && node.size * node.size < thetaSquared * distanceSquared) {
+            float r2 = distanceSquared + epsilonSquared;
+            float scale = node.mass / (r2 * std::sqrt(r2));
+            accelerationX += dx * scale;
+            accelerationY += dy * scale;
+            accelerationZ += dz * scale;
+            visited++;
+            continue;
+        }
+
+        if (node.childCount == 0) {
+            for (uint32_t j = node.first; j < node.first + node.count; j++) {
+                if (j == s)
+                    continue;
+                float bx = sortedX[j] - px;
+                float by = sortedY[j] - py;
+                float bz = sortedZ[j] - pz;
+                float r2 = bx * bx + by * by + bz * bz + epsilonSquared;
+                float scale = sortedMass[j] / (r2 * std::sqrt(r2));
+                accelerationX += bx * scale;
+                accelerationY += by * scale;
+                accelerationZ += bz * scale;
+            }
+            visited += node.count;
+            continue;
+        }
+
+        for (uint32_t c = 0; c < node.childCount; c++)
+            stack[top++] = node.firstChild + c;
+    }
+}
+
+void NBodySimulation::AttractorAcceleration(float px, float py, float pz, float& accelerationX, float& accelerationY, float& accelerationZ) const
+{
+    const float epsilonSquared = settings.softening * settings.softening;
+    for (const NBodyAttractor& attractor : attractors) {
+        float dx = attractor.position.x - px;
+        float dy = attractor.position.y - py;
+        float dz = attractor.position.z - pz;
+        float r2 = dx * dx + dy * dy + dz * dz + epsilonSquared;
+        float scale = attractor.mass / (r2 * std::sqrt(r2));
+        accelerationX += dx * scale;
+        accelerationY += dy * scale;
+        accelerationZ += dz * scale;
+    }
+}
+
+double NBodySimulation::ComputeEnergy() const
+{
+    size_t count = x.size();
+    size_t chunks = ChunkCount(count);
+    std::vector<double> chunkEnergy(chunks, 0.0);
+    const double epsilonSquared = static_cast<double>(settings.softening) * settings.softening;
+
+    ThreadPool::GetInstance()->ParallelFor(chunks, [&](size_t chunk) {
+        double energy = 0.0;
+        for (size_t i = chunk * Chunk; i < std::min(count, (chunk + 1) * Chunk); i++) {
+            energy += 0.5 * mass[i] * (static_cast<double>(vx[i]) * vx[i] + static_cast<double>(vy[i]) * vy[i] + static_cast<double>(vz[i]) * vz[i]);
+            // Every pair once.
+            for (size_t j = i + 1; j < count; j++) {
+                double dx = static_cast<double>(x[j]) - x[i], dy = static_cast<double>(y[j]) - y[i], dz = static_cast<double>(z[j]) - z[i];
+                energy -= static_cast<double>(mass[i]) * mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz + epsilonSquared);
+            }
+            for (const NBodyAttractor& attractor : attractors) {
+                double dx = static_cast<double>(attractor.position.x) - x[i], dy = static_cast<double>(attractor.position.y) - y[i], dz = static_cast<double>(attractor.position.z) - z[i];
+                energy -= static_cast<double>(mass[i]) * attractor.mass / std::sqrt(dx * dx + dy * dy + dz * dz + epsilonSquared);
+            }
+        }
+        chunkEnergy[chunk] = energy;
+    });
+
+    double energy = 0.0;
+    for (double e : chunkEnergy)
+        energy += e;
+    return energy;
+}
+
+DirectX::XMFLOAT3 NBodySimulation::ComputeDirectAcceleration(size_t body) const
+{
+    const float epsilonSquared = settings.softening * settings.softening;
+    double accelerationX = 0.0, accelerationY = 0.0, accelerationZ = 0.0;
+    for (size_t j = 0; j < x.size(); j++) {
+        if (j == body)
+            continue;
+        double dx = static_cast<double>(x[j]) - x[body], dy = static_cast<double>(y[j]) - y[body], dz = static_cast<double>(z[j]) - z[body];
+        double r2 = dx * dx + dy * dy + dz * dz + epsilonSquared;
+        double scale = mass[j] / (r2 * std::sqrt(r2));
+        accelerationX += dx * scale;
+        accelerationY += dy * scale;
+        accelerationZ += dz * scale;
+    }
+    float attractorX = 0.0f, attractorY = 0.0f, attractorZ = 0.0f;
+    AttractorAcceleration(x[body], y[body], z[body], attractorX, attractorY, attractorZ);
+    return DirectX::XMFLOAT3(static_cast<float>(accelerationX) + attractorX, static_cast<float>(accelerationY) + attractorY, static_cast<float>(accelerationZ) + attractorZ);
+}
+
+DirectX::XMFLOAT3 NBodySimulation::ComputeTreeAcceleration(size_t body) const
+{
+    auto entry = std::find_if(sorted.begin(), sorted.end(), [body](const SortEntry& e) { return e.body == body; });
+    if (entry == sorted.end())
+        throw "N-body tree has not been built!";
+
+    uint32_t s = static_cast<uint32_t>(entry - sorted.begin());
+    float accelerationX = 0.0f, accelerationY = 0.0f, accelerationZ = 0.0f;
+    size_t visited = 0;
+    TreeAcceleration(s, accelerationX, accelerationY, accelerationZ, visited);
+    AttractorAcceleration(sortedX[s], sortedY[s], sortedZ[s], accelerationX, accelerationY, accelerationZ);
+    return DirectX::XMFLOAT3(accelerationX, accelerationY, accelerationZ);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// Masses are gravitational parameters (G * m), so G does not appear anywhere.
+struct NBodySettings
+{
+    float openingAngle = 0.5f;      // A cell is used as a whole when its size / distance is below this.
+    float softening = 1e-3f;        // Plummer softening length, keeps close encounters finite.
+    float timeStep = 1.0f / 120.0f; // Seconds per step, independent of the frame rate.
+    int maxStepsPerAdvance = 8;     // Steps one Advance() may take, the rest of the time is dropped.
+    int leafSize = 8;               // Bodies a cell may hold before it is split.
+};
+
+// A massive body that pulls on every other one but is moved by the caller (the star, planets).
+struct NBodyAttractor
+{
+    DirectX::XMFLOAT3 position;
+    float mass;
+};
+
+struct NBodyStats
+{
+    size_t nodeCount = 0;
+    double buildMs = 0.0;           // Tree rebuild of the last step.
+    double forceMs = 0.0;           // Accelerations of the last step.
+    double meanInteractions = 0.0;  // Cells and bodies visited per body in the last step.
+};
+
+// Gravity between many small bodies (asteroids, debris) with the Barnes-Hut approximation, plus the
+// pull of a few attractors summed directly. Every step the octree is rebuilt: bodies are sorted by
+// the Morton code of their position, the 64 cells of the second level are built in parallel and each
+// cell is a contiguous range of the sorted bodies. Integration is leapfrog (kick, drift, kick) on a
+// fixed timestep, which keeps the energy bounded over long runs instead of drifting away.
+class NBodySimulation
+{
+public:
+    NBodySimulation() = default;
+    explicit NBodySimulation(const NBodySettings& settings);
+
+    void Reserve(size_t count);
+    size_t AddBody(DirectX::XMFLOAT3 position, DirectX::XMFLOAT3 velocity, float mass);
+    // Attractors stay where they are during the steps of one Advance().
+    void SetAttractors(const std::vector<NBodyAttractor>& attractors);
+
+    // Take the fixed steps that fit into the elapsed time (with what was left over the last time).
+    // Returns the number of steps taken.
+    int Advance(double deltaTime);
+    void Step();
+
+    size_t GetBodyCount() const { return x.size(); }
+    DirectX::XMFLOAT3 GetPosition(size_t body) const { return DirectX::XMFLOAT3(x[body], y[body], z[body]); }
+    DirectX::XMFLOAT3 GetVelocity(size_t body) const { return DirectX::XMFLOAT3(vx[body], vy[body], vz[body]); }
+    const NBodySettings& GetSettings() const { return settings; }
+    NBodySettings& GetSettings() { return settings; }
+    const NBodyStats& GetStats() const { return stats; }
+
+    // Kinetic plus potential energy by direct summation, O(n^2), for accuracy checks.
+    double ComputeEnergy() const;
+    // Acceleration of one body by direct summation, the reference for the tree.
+    DirectX::XMFLOAT3 ComputeDirectAcceleration(size_t body) const;
+    // Acceleration of one body from the current tree (after at least one step).
+    DirectX::XMFLOAT3 ComputeTreeAcceleration(size_t body) const;
+
+private:
+    struct Node
+    {
+        float centerX, centerY, centerZ;    // Centre of mass.
+        float mass;
+        float size;                         // Edge of the cell.
+        uint32_t firstChild;                // Children are contiguous, none for a leaf.
+        uint32_t childCount;
+        uint32_t first;                     // Sorted bodies in the cell.
+        uint32_t count;
+    };
+
+    struct SortEntry
+    {
+        uint64_t code;
+        uint32_t body;
+    };
+
+    void BuildTree();
+    // Build the cell of sorted bodies [first, last) at the given depth into tree[slot], its subtree is
+    // appended with the children of every cell right after each other.
+    void BuildNode(std::vector<Node>& tree, uint32_t slot, uint32_t first, uint32_t last, int depth) const;
+    // Mass, centre of mass and body range of a cell from its children.
+    void SumChildren(std::vector<Node>& tree, uint32_t slot) const;
+    void ComputeAccelerations();
+    // Acceleration of the sorted body s from the tree, visited counts cells and bodies looked at.
+    void TreeAcceleration(uint32_t s, float& accelerationX, float& accelerationY, float& accelerationZ, size_t& visited) const;
+    void AttractorAcceleration(float px, float py, float pz, float& accelerationX, float& accelerationY, float& accelerationZ) const;
+    void Kick(float dt);
+    void Drift(float dt);
+
+    NBodySettings settings;
+    std::vector<NBodyAttractor> attractors;
+    double timeAccumulator = 0.0;
+    bool accelerationsValid = false;
+
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> ax, ay, az;
+    std::vector<float> mass;
+
+    // Bodies in Morton order, rebuilt with the tree.
+    std::vector<SortEntry> sorted;
+    std::vector<float> sortedX, sortedY, sortedZ, sortedMass;
+    float rootSize = 0.0f;
+    std::vector<Node> nodes;
+
+    NBodyStats stats;
+};
@@ -14,7 +14,7 @@ Noise::Noise() {
 }
 
 
-float Noise::Evaluate(DirectX::XMFLOAT3 point) {
+float Noise::Evaluate(DirectX::XMFLOAT3 point) const {
 
     double x = point.x;
     double y = point.y;
@@ -147,6 +147,108 @@ float Noise::Evaluate(DirectX::XMFLOAT3 point) {
 
 }
 
+float Noise::Evaluate(DirectX::XMFLOAT4 point) const {
+
+    double x = point.x;
+    double y = point.y;
+    double z = point.z;
+    double w = point.w;
+    double n0 = 0, n1 = 0, n2 = 0, n3 = 0, n4 = 0;
+
+    // Skew the 4D space to find the simplex cell.
+    double s = (x + y + z + w) * F4;
+    int i = FastFloor(x + s);
+    int j = FastFloor(y + s);
+    int k = FastFloor(z + s);
+    int l = FastFloor(w + s);
+    double t = (i + j + k + l) * G4;
+    double x0 = x - (i - t);
+    double y0 = y - (j - t);
+    double z0 = z - (k - t);
+    double w0 = w - (l - t);
+
+    // Rank the coordinates, the simplex is traversed from the largest to the smallest one.
+    int rankX = 0, rankY = 0, rankZ = 0, rankW = 0;
+    if (x0 > y0) rankX++; else rankY++;
+    if (x0 > z0) rankX++; else rankZ++;
+    if (x0 > w0) rankX++; else rankW++;
+    if (y0 > z0) rankY++; else rankZ++;
+    if (y0 > w0) rankY++; else rankW++;
+    if (z0 > w0) rankZ++; else rankW++;
+
+    int i1 = rankX >= 3 ? 1 : 0, j1 = rankY >= 3 ? 1 : 0, k1 = rankZ >= 3 ? 1 : 0, l1 = rankW >= 3 ? 1 : 0;
+    int i2 = rankX >= 2 ? 1 : 0, j2 = rankY >= 2 ? 1 : 0, k2 = rankZ >= 2 ? 1 : 0, l2 = rankW >= 2 ? 1 : 0;
+    int i3 = rankX >= 1 ? 1 : 0, j3 = rankY >= 1 ? 1 : 0, k3 = rankZ >= 1 ? 1 : 0, l3 = rankW >= 1 ? 1 : 0;
+
+    double x1 = x0 - i1 + G4;
+    double y1 = y0 - j1 + G4;
+    double z1 = z0 - k1 + G4;
+    double w1 = w0 - l1 + G4;
+
+    double x2 = x0 - i2 + G42;
+    double y2 = y0 - j2 + G42;
+    double z2 = z0 - k2 + G42;
+    double w2 = w0 - l2 + G42;
+
+    double x3 = x0 - i3 + G43;
+    double y3 = y0 - j3 + G43;
+    double z3 = z0 - k3 + G43;
+    double w3 = w0 - l3 + G43;
+
+    double x4 = x0 + G44;
+    double y4 = y0 + G44;
+    double z4 = z0 + G44;
+    double w4 = w0 + G44;
+
+    int ii = i & 0xff;
+    int jj = j & 0xff;
+    int kk = k & 0xff;
+    int ll = l & 0xff;
+
+    double t0 = 0.6 - x0 * x0 - y0 * y0 - z0 * z0 - w0 * w0;
+    if (t0 > 0)
+    {
+        t0 *= t0;
+        int gi0 = _random[ii + _random[jj + _random[kk + _random[ll]]]] % 32;
+        n0 = t0 * t0 * Dot(Grad4[gi0], x0, y0, z0, w0);
+    }
+    double t1 = 0.6 - x1 * x1 - y1 * y1 - z1 * z1 - w1 * w1;
+    if (t1 > 0)
+    {
+        t1 *= t1;
+        int gi1 = _random[ii + i1 + _random[jj + j1 + _random[kk + k1 + _random[ll + l1]]]] % 32;
+        n1 = t1 * t1 * Dot(Grad4[gi1], x1, y1, z1, w1);
+    }
+    double t2 = 0.6 - x2 * x2 - y2 * y2 - z2 * z2 - w2 * w2;
+    if (t2 > 0)
+    {
+        t2 *= t2;
+        int gi2 = _random[ii + i2 + _random[jj + j2 + _random[kk + k2 + _random[ll + l2]]]] % 32;
+        n2 = t2 * t2 * Dot(Grad4[gi2], x2, y2, z2, w2);
+    }
+    double t3 = 0.6 - x3 * x3 - y3 * y3 - z3 * z3 - w3 * w3;
+    if (t3 > 0)
+    {
+        t3 *= t3;
+        int gi3 = _random[ii + i3 + _random[jj + j3 + _random[kk + k3 + _random[ll + l3]]]] % 32;
+        n3 = t3 * t3 * Dot(Grad4[gi3], x3, y3, z3, w3);
+    }
+    double t4 = 0.6 - x4 * x4 - y4 * y4 - z4 * z4 - w4 * w4;
+    if (t4 > 0)
+    {
+        t4 *= t4;
+        int gi4 = _random[ii + 1 + _random[jj + 1 + _random[kk + 1 + _random[ll + 1]]]] % 32;
+        n4 = t4 * t4 * Dot(Grad4[gi4], x4, y4, z4, w4);
+    }
+
+    return (float)(n0 + n1 + n2 + n3 + n4) * 27;
+}
+
+void Noise::Evaluate(const DirectX::XMFLOAT3* points, float w, float* values, size_t count) const {
+    for (size_t i = 0; i < count; i++)
+        values[i] = Evaluate(DirectX::XMFLOAT4(points[i].x, points[i].y, points[i].z, w));
+}
+
 void Noise::Randomize(int seed) {
     _random = new int[RandomSize * 2];
     if (seed != 0) {
@@ -165,7 +267,7 @@ void Noise::Randomize(int seed) {
     }
 }
 
-double Noise::Dot(const int g[3], double x, double y, double z, double t)
+double Noise::Dot(const int g[4], double x, double y, double z, double t)
 {
     return g[0] * x + g[1] * y + g[2] * z + g[3] * t;
 }
@@ -33,7 +33,11 @@ class Noise
 
         Noise(int seed);
 
-		float Evaluate(DirectX::XMFLOAT3 point);
+		float Evaluate(DirectX::XMFLOAT3 point) const;
+        // 4D simplex noise, w is usually time (animated surfaces).
+        float Evaluate(DirectX::XMFLOAT4 point) const;
+        // Batch of 4D evaluations sharing the same w.
+        void Evaluate(const DirectX::XMFLOAT3* points, float w, float* values, size_t count) const;
 	private:
         static constexpr int Source[256] = {
             151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225, 140, 36, 103, 30, 69, 142,
@@ -57,27 +61,38 @@ class Noise
             {0, -1, 1}, {0, 1, -1}, {0, -1, -1}
         };
 
+        static constexpr int Grad4[32][4] = {
+            {0, 1, 1, 1}, {0, 1, 1, -1}, {0, 1, -1, 1}, {0, 1, -1, -1},
+            {0, -1, 1, 1}, {0, -1, 1, -1}, {0, -1, -1, 1}, {0, -1, -1, -1},
+            {1, 0, 1, 1}, {1, 0, 1, -1}, {1, 0, -1, 1}, {1, 0, -1, -1},
+            {-1, 0, 1, 1}, {-1, 0, 1, -1}, {-1, 0, -1, 1}, {-1, 0, -1, -1},
+            {1, 1, 0, 1}, {1, 1, 0, -1}, {1, -1, 0, 1}, {1, -1, 0, -1},
+            {-1, 1, 0, 1}, {-1, 1, 0, -1}, {-1, -1, 0, 1}, {-1, -1, 0, -1},
+            {1, 1, 1, 0}, {1, 1, -1, 0}, {1, -1, 1, 0}, {1, -1, -1, 0},
+            {-1, 1, 1, 0}, {-1, 1, -1, 0}, {-1, -1, 1, 0}, {-1, -1, -1, 0}
+        };
+
         int* _random;
-        const int RandomSize = 256;
-        const double Sqrt3 = 1.7320508075688772935;
-        const double Sqrt5 = 2.2360679774997896964;
-        const double F2 = 0.5 * (Sqrt3 - 1.0);
-        const double G2 = (3.0 - Sqrt3) / 6.0;
-        const double G22 = G2 * 2.0 - 1;
-        const double F3 = 1.0 / 3.0;
-        const double G3 = 1.0 / 6.0;
-        const double F4 = (Sqrt5 - 1.0) / 4.0;
-        const double G4 = (5.0 - Sqrt5) / 20.0;
-        const double G42 = G4 * 2.0;
-        const double G43 = G4 * 3.0;
-        const double G44 = G4 * 4.0 - 1.0;
+        static constexpr int RandomSize = 256;
+        static constexpr double Sqrt3 = 1.7320508075688772935;
+        static constexpr double Sqrt5 = 2.2360679774997896964;
+        static constexpr double F2 = 0.5 * (Sqrt3 - 1.0);
+        static constexpr double G2 = (3.0 - Sqrt3) / 6.0;
+        static constexpr double G22 = G2 * 2.0 - 1;
+        static constexpr double F3 = 1.0 / 3.0;
+        static constexpr double G3 = 1.0 / 6.0;
+        static constexpr double F4 = (Sqrt5 - 1.0) / 4.0;
+        static constexpr double G4 = (5.0 - Sqrt5) / 20.0;
+        static constexpr double G42 = G4 * 2.0;
+        static constexpr double G43 = G4 * 3.0;
+        static constexpr double G44 = G4 * 4.0 - 1.0;
 
 
 		void Randomize(int seed);
 		static int FastFloor(double x);
         static std::vector<uint8_t> UnpackLittleUint32(int value, std::vector<uint8_t>& buffer);
 
-        static double Dot(const int g[3], double x, double y, double z, double t);
+        static double Dot(const int g[4], double x, double y, double z, double t);
         static double Dot(const int g[3], double x, double y, double z);
         static double Dot(const int g[3], double x, double y);
 
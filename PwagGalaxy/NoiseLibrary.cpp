@@ -0,0 +1,44 @@
+#include "stdafx.h"
+#include "NoiseLibrary.h"
+
+constexpr int NoiseTables::Source[256];
+constexpr int NoiseTables::Grad3[12][3];
+constexpr NoiseValueTable ValueBasis::Values;
+
+namespace
+{
+    template<class Basis, typename Real>
+    NoiseBatchFunction SelectFractal(NoiseFractal fractal)
+    {
+        switch (fractal) {
+        case NoiseFractal::Ridged:
+            return &NoiseGenerator<Basis, RidgedFractal, Real>::EvaluateBatch;
+        case NoiseFractal::Billow:
+            return &NoiseGenerator<Basis, BillowFractal, Real>::EvaluateBatch;
+        case NoiseFractal::Warped:
+            return &NoiseGenerator<Basis, WarpedFractal<FbmFractal>, Real>::EvaluateBatch;
+        default:
+            return &NoiseGenerator<Basis, FbmFractal, Real>::EvaluateBatch;
+        }
+    }
+
+    template<typename Real>
+    NoiseBatchFunction SelectBasis(NoiseBasis basis, NoiseFractal fractal)
+    {
+        switch (basis) {
+        case NoiseBasis::Value:
+            return SelectFractal<ValueBasis, Real>(fractal);
+        case NoiseBasis::Cellular:
+            return SelectFractal<CellularBasis, Real>(fractal);
+        default:
+            return SelectFractal<SimplexBasis, Real>(fractal);
+        }
+    }
+}
+
+NoiseBatchFunction SelectNoiseBatchFunction(NoiseBasis basis, NoiseFractal fractal, NoisePrecision precision)
+{
+    if (precision == NoisePrecision::Float)
+        return SelectBasis<float>(basis, fractal);
+    return SelectBasis<double>(basis, fractal);
+}
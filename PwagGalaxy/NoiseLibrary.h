@@ -0,0 +1,324 @@
+#pragma once
+
+/*
+ * Noise assembled at compile time from three policies:
+ *  - basis: the lattice noise (SimplexBasis, ValueBasis, CellularBasis),
+ *  - fractal: how the octaves are combined (FbmFractal, RidgedFractal, BillowFractal, WarpedFractal<>),
+ *  - precision: the arithmetic type (double or float).
+ * For example NoiseGenerator<SimplexBasis, FbmFractal, double> is the same surface as Noise with fBm on
+ * top. The octave loop and the basis are inlined into each other, a body picks its specialisation once
+ * (see SelectNoiseBatchFunction) instead of branching or dispatching per sample.
+ */
+
+enum class NoiseBasis { Simplex, Value, Cellular };
+enum class NoiseFractal { Fbm, Ridged, Billow, Warped };
+enum class NoisePrecision { Double, Float };
+
+struct NoiseTables
+{
+    // Same permutation as Noise, so seeds give the same simplex noise.
+    static constexpr int Source[256] = {
+        151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225, 140, 36, 103, 30, 69, 142,
+        8, 99, 37, 240, 21, 10, 23, 190, 6, 148, 247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203,
+        117, 35, 11, 32, 57, 177, 33, 88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175, 74, 165,
+        71, 134, 139, 48, 27, 166, 77, 146, 158, 231, 83, 111, 229, 122, 60, 211, 133, 230, 220, 105, 92, 41,
+        55, 46, 245, 40, 244, 102, 143, 54, 65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89,
+        18, 169, 200, 196, 135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64, 52, 217, 226, 250,
+        124, 123, 5, 202, 38, 147, 118, 126, 255, 82, 85, 212, 207, 206, 59, 227, 47, 16, 58, 17, 182, 189,
+        28, 42, 223, 183, 170, 213, 119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+        129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104, 218, 246, 97, 228, 251, 34,
+        242, 193, 238, 210, 144, 12, 191, 179, 162, 241, 81, 51, 145, 235, 249, 14, 239, 107, 49, 192, 214, 31,
+        181, 199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254, 138, 236, 205, 93, 222, 114,
+        67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180
+    };
+
+    static constexpr int Grad3[12][3] = {
+        {1, 1, 0}, {-1, 1, 0}, {1, -1, 0},
+        {-1, -1, 0}, {1, 0, 1}, {-1, 0, 1},
+        {1, 0, -1}, {-1, 0, -1}, {0, 1, 1},
+        {0, -1, 1}, {0, 1, -1}, {0, -1, -1}
+    };
+};
+
+// Lattice values of the value noise in [-1, 1], generated from the permutation at compile time.
+struct NoiseValueTable
+{
+    float values[256];
+    constexpr NoiseValueTable() : values()
+    {
+        for (int i = 0; i < 256; i++)
+            values[i] = NoiseTables::Source[(i * 167 + 13) & 255] / 127.5f - 1.0f;
+    }
+};
+
+// Seeded permutation (doubled to avoid wrapping the indices), built like Noise::Randomize.
+class NoisePermutation
+{
+public:
+    explicit NoisePermutation(int seed = 0)
+    {
+        int mask = (seed & 0xff) ^ ((seed >> 8) & 0xff) ^ ((seed >> 16) & 0xff) ^ ((seed >> 24) & 0xff);
+        for (int i = 0; i < 256; i++)
+            values[i] = values[i + 256] = NoiseTables::Source[i] ^ mask;
+    }
+
+    int operator[](int index) const { return values[index]; }
+
+    // Hash of a lattice point, in [0, 255] (same order of lookups as Noise).
+    int Hash(int i, int j, int k) const { return values[(i & 0xff) + values[(j & 0xff) + values[k & 0xff]]]; }
+
+private:
+    int values[512];
+};
+
+template<typename Real>
+inline int NoiseFloor(Real x)
+{
+    return x >= 0 ? static_cast<int>(x) : static_cast<int>(x) - 1;
+}
+
+// 3D simplex noise (see Noise::Evaluate), about [-1, 1].
+struct SimplexBasis
+{
+    template<typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z)
+    {
+        const Real F3 = Real(1.0 / 3.0);
+        const Real G3 = Real(1.0 / 6.0);
+
+        Real s = (x + y + z) * F3;
+        int i = NoiseFloor(x + s);
+        int j = NoiseFloor(y + s);
+        int k = NoiseFloor(z + s);
+        Real t = (i + j + k) * G3;
+        Real x0 = x - (i - t);
+        Real y0 = y - (j - t);
+        Real z0 = z - (k - t);
+
+        int i1, j1, k1;
+        int i2, j2, k2;
+        if (x0 >= y0) {
+            if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+            else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+            else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+        }
+        else {
+            if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+            else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+            else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+        }
+
+        Real x1 = x0 - i1 + G3, y1 = y0 - j1 + G3, z1 = z0 - k1 + G3;
+        Real x2 = x0 - i2 + F3, y2 = y0 - j2 + F3, z2 = z0 - k2 + F3;
+        Real x3 = x0 - Real(0.5), y3 = y0 - Real(0.5), z3 = z0 - Real(0.5);
+
+        Real n = Corner(permutation.Hash(i, j, k), x0, y0, z0)
+            + Corner(permutation.Hash(i + i1, j + j1, k + k1), x1, y1, z1)
+            + Corner(permutation.Hash(i + i2, j + j2, k + k2), x2, y2, z2)
+            + Corner(permutation.Hash(i + 1, j + 1, k + 1), x3, y3, z3);
+        return n * Real(32);
+    }
+
+private:
+    template<typename Real>
+    static Real Corner(int hash, Real x, Real y, Real z)
+    {
+        Real t = Real(0.6) - x * x - y * y - z * z;
+        if (t <= 0)
+            return 0;
+        const int* g = NoiseTables::Grad3[hash % 12];
+        t *= t;
+        return t * t * (g[0] * x + g[1] * y + g[2] * z);
+    }
+};
+
+// Trilinear value noise from the constexpr lattice table, in [-1, 1]. Cheapest of the bases.
+struct ValueBasis
+{
+    template<typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z)
+    {
+        int i = NoiseFloor(x);
+        int j = NoiseFloor(y);
+        int k = NoiseFloor(z);
+        Real u = Fade(x - i);
+        Real v = Fade(y - j);
+        Real w = Fade(z - k);
+
+        Real c000 = Lattice<Real>(permutation, i, j, k),         c100 = Lattice<Real>(permutation, i + 1, j, k);
+        Real c010 = Lattice<Real>(permutation, i, j + 1, k),     c110 = Lattice<Real>(permutation, i + 1, j + 1, k);
+        Real c001 = Lattice<Real>(permutation, i, j, k + 1),     c101 = Lattice<Real>(permutation, i + 1, j, k + 1);
+        Real c011 = Lattice<Real>(permutation, i, j + 1, k + 1), c111 = Lattice<Real>(permutation, i + 1, j + 1, k + 1);
+
+        Real c00 = c000 + (c100 - c000) * u;
+        Real c10 = c010 + (c110 - c010) * u;
+        Real c01 = c001 + (c101 - c001) * u;
+        Real c11 = c011 + (c111 - c011) * u;
+        Real c0 = c00 + (c10 - c00) * v;
+        Real c1 = c01 + (c11 - c01) * v;
+        return c0 + (c1 - c0) * w;
+    }
+
+private:
+    template<typename Real>
+    static Real Fade(Real t) { return t * t * t * (t * (t * Real(6) - Real(15)) + Real(10)); }
+
+    static constexpr NoiseValueTable Values = NoiseValueTable();
+
+    template<typename Real>
+    static Real Lattice(const NoisePermutation& permutation, int i, int j, int k) { return static_cast<Real>(Values.values[permutation.Hash(i, j, k)]); }
+};
+
+// Cellular (Worley) noise: distance to the closest of one feature point per lattice cell, about [-1, 1].
+// The most expensive basis (27 cells per sample), gives cracked or scaled surfaces.
+struct CellularBasis
+{
+    template<typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z)
+    {
+        int i = NoiseFloor(x);
+        int j = NoiseFloor(y);
+        int k = NoiseFloor(z);
+
+        Real closest = Real(8);
+        for (int dk = -1; dk <= 1; dk++) {
+            for (int dj = -1; dj <= 1; dj++) {
+                for (int di = -1; di <= 1; di++) {
+                    int hash = permutation.Hash(i + di, j + dj, k + dk);
+                    Real fx = (i + di) + permutation[hash] / Real(255) - x;
+                    Real fy = (j + dj) + permutation[hash + 1] / Real(255) - y;
+                    Real fz = (k + dk) + permutation[hash + 2] / Real(255) - z;
+                    Real distance = fx * fx + fy * fy + fz * fz;
+                    closest = distance < closest ? distance : closest;
+                }
+            }
+        }
+        return std::sqrt(closest) * Real(2) - Real(1);
+    }
+};
+
+// Parameters shared by the fractal modes.
+struct FractalSettings
+{
+    float frequency = 1.0f;
+    float lacunarity = 2.0f;            // Frequency multiplier per octave.
+    float persistence = 0.5f;           // Amplitude multiplier per octave.
+    int octaves = 4;
+    DirectX::XMFLOAT3 offset = DirectX::XMFLOAT3(0, 0, 0);
+    float warpStrength = 0.5f;          // Only used by WarpedFractal.
+};
+
+// Octaves of (signal + 1) / 2, the classic rolling terrain. Range [0, sum of amplitudes].
+struct FbmFractal
+{
+    template<class Basis, typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z, const FractalSettings& settings)
+    {
+        Real sum = 0;
+        Real amplitude = 1;
+        Real frequency = settings.frequency;
+        for (int octave = 0; octave < settings.octaves; octave++) {
+            Real signal = Basis::template Evaluate<Real>(permutation, x * frequency + settings.offset.x, y * frequency + settings.offset.y, z * frequency + settings.offset.z);
+            sum += amplitude * (signal + 1) * Real(0.5);
+            frequency *= settings.lacunarity;
+            amplitude *= settings.persistence;
+        }
+        return sum;
+    }
+};
+
+// Octaves of (1 - |signal|)^2, sharp crests along the zero crossings of the basis.
+struct RidgedFractal
+{
+    template<class Basis, typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z, const FractalSettings& settings)
+    {
+        Real sum = 0;
+        Real amplitude = 1;
+        Real frequency = settings.frequency;
+        for (int octave = 0; octave < settings.octaves; octave++) {
+            Real signal = Basis::template Evaluate<Real>(permutation, x * frequency + settings.offset.x, y * frequency + settings.offset.y, z * frequency + settings.offset.z);
+            Real ridge = 1 - std::abs(signal);
+            sum += amplitude * ridge * ridge;
+            frequency *= settings.lacunarity;
+            amplitude *= settings.persistence;
+        }
+        return sum;
+    }
+};
+
+// Octaves of |signal|, rounded hills with creases in the valleys.
+struct BillowFractal
+{
+    template<class Basis, typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z, const FractalSettings& settings)
+    {
+        Real sum = 0;
+        Real amplitude = 1;
+        Real frequency = settings.frequency;
+        for (int octave = 0; octave < settings.octaves; octave++) {
+            Real signal = Basis::template Evaluate<Real>(permutation, x * frequency + settings.offset.x, y * frequency + settings.offset.y, z * frequency + settings.offset.z);
+            sum += amplitude * std::abs(signal);
+            frequency *= settings.lacunarity;
+            amplitude *= settings.persistence;
+        }
+        return sum;
+    }
+};
+
+// Another fractal evaluated at a point displaced by two-octave fBm of the same basis (domain warping),
+// gives swirled, flowing features. Costs six extra basis samples.
+template<class Inner = FbmFractal>
+struct WarpedFractal
+{
+    template<class Basis, typename Real>
+    static Real Evaluate(const NoisePermutation& permutation, Real x, Real y, Real z, const FractalSettings& settings)
+    {
+        FractalSettings warp = settings;
+        warp.octaves = 2;
+
+        // fBm of two octaves is in [0, 1.5], centred to about [-1, 1].
+        Real wx = FbmFractal::Evaluate<Basis, Real>(permutation, x, y, z, warp);
+        Real wy = FbmFractal::Evaluate<Basis, Real>(permutation, x + Real(5.2), y + Real(1.3), z + Real(2.8), warp);
+        Real wz = FbmFractal::Evaluate<Basis, Real>(permutation, x + Real(1.7), y + Real(9.2), z + Real(3.4), warp);
+        Real strength = settings.warpStrength / Real(0.75);
+        return Inner::template Evaluate<Basis, Real>(permutation,
+            x + (wx - Real(0.75)) * strength,
+            y + (wy - Real(0.75)) * strength,
+            z + (wz - Real(0.75)) * strength,
+            settings);
+    }
+};
+
+template<class Basis, class Fractal, typename Real>
+class NoiseGenerator
+{
+public:
+    explicit NoiseGenerator(int seed = 0) : permutation(seed) {}
+
+    float Evaluate(DirectX::XMFLOAT3 point, const FractalSettings& settings) const
+    {
+        return static_cast<float>(Fractal::template Evaluate<Basis, Real>(permutation, Real(point.x), Real(point.y), Real(point.z), settings));
+    }
+
+    void Evaluate(const DirectX::XMFLOAT3* points, float* values, size_t count, const FractalSettings& settings) const
+    {
+        EvaluateBatch(permutation, points, values, count, settings);
+    }
+
+    // The whole batch in one call, see SelectNoiseBatchFunction.
+    static void EvaluateBatch(const NoisePermutation& permutation, const DirectX::XMFLOAT3* points, float* values, size_t count, const FractalSettings& settings)
+    {
+        for (size_t i = 0; i < count; i++)
+            values[i] = static_cast<float>(Fractal::template Evaluate<Basis, Real>(permutation, Real(points[i].x), Real(points[i].y), Real(points[i].z), settings));
+    }
+
+private:
+    NoisePermutation permutation;
+};
+
+typedef void (*NoiseBatchFunction)(const NoisePermutation& permutation, const DirectX::XMFLOAT3* points, float* values, size_t count, const FractalSettings& settings);
+
+// The batch evaluation of one specialisation, chosen at run time from a body configuration. The choice is
+// made once per body, the returned function has no branches on the policies inside.
+NoiseBatchFunction SelectNoiseBatchFunction(NoiseBasis basis, NoiseFractal fractal, NoisePrecision precision);
@@ -0,0 +1,189 @@
+#include "stdafx.h"
+#include "OrbitSimulation.h"
+
+#include "VectorMath.h"
+
+namespace
+{
+    const double TwoPi = 6.283185307179586;
+
+    // velocity * time less the whole turns, in [-pi, pi].
+    float TurnedAngle(float velocity, double time)
+    {
+        double angle = velocity * time;
+        return static_cast<float>(angle - std::floor(angle / TwoPi + 0.5) * TwoPi);
+    }
+
+    // The same for eight velocities, four at a time in double precision.
+    __m256 TurnedAngle8(__m256 velocity, __m256d time)
+    {
+        const __m256d twoPi = _mm256_set1_pd(TwoPi);
+        const __m256d inverseTwoPi = _mm256_set1_pd(1.0 / TwoPi);
+        __m256d low = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_castps256_ps128(velocity)), time);
+        __m256d high = _mm256_mul_pd(_mm256_cvtps_pd(_mm256_extractf128_ps(velocity, 1)), time);
+        low = _mm256_sub_pd(low, _mm256_mul_pd(_mm256_round_pd(_mm256_mul_pd(low, inverseTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), twoPi));
+        high = _mm256_sub_pd(high, _mm256_mul_pd(_mm256_round_pd(_mm256_mul_pd(high, inverseTwoPi), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC), twoPi));
+        return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm256_cvtpd_ps(low)), _mm256_cvtpd_ps(high), 1);
+    }
+
+    // Position and rotation of one body, the twelve values of its InstanceTransform in order.
+    void WriteTransform(float c, float s, float spinC, float spinS, float radius, const float u[3], const float v[3], const float offset[3],
+        float scale, const float k[3], InstanceTransform& transform)
+    {
+        // Rotation around the spin axis (Rodrigues), scaled.
+        float t = 1.0f - spinC;
+        transform.rows[0] = DirectX::XMFLOAT4(
+            scale * (spinC + t * k[0] * k[0]), scale * (t * k[0] * k[1] - spinS * k[2]), scale * (t * k[0] * k[2] + spinS * k[1]),
+            radius * (c * u[0] + s * v[0]) + offset[0]);
+        transform.rows[1] = DirectX::XMFLOAT4(
+            scale * (t * k[0] * k[1] + spinS * k[2]), scale * (spinC + t * k[1] * k[1]), scale * (t * k[1] * k[2] - spinS * k[0]),
+            radius * (c * u[1] + s * v[1]) + offset[1]);
+        transform.rows[2] = DirectX::XMFLOAT4(
+            scale * (t * k[0] * k[2] - spinS * k[1]), scale * (t * k[1] * k[2] + spinS * k[0]), scale * (spinC + t * k[2] * k[2]),
+            radius * (c * u[2] + s * v[2]) + offset[2]);
+    }
+}
+
+void OrbitSimulation::Reserve(size_t count)
+{
+    for (std::vector<float>* values : { &radius, &phase, &angularVelocity, &ux, &uy, &uz, &vx, &vy, &vz, &offsetX, &offsetY, &offsetZ,
+        &scale, &spinX, &spinY, &spinZ, &spinPhase, &spinVelocity })
+        values->reserve(count);
+}
+
+size_t OrbitSimulation::AddBody(const OrbitBody& body)
+{
+    DirectX::XMVECTOR normal = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&body.inclinationAxis));
+    DirectX::XMVECTOR reference = std::abs(DirectX::XMVectorGetX(normal)) < 0.9f ? DirectX::XMVectorSet(1, 0, 0, 0) : DirectX::XMVectorSet(0, 1, 0, 0);
+    DirectX::XMVECTOR u = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(reference, normal));
+    DirectX::XMVECTOR v = DirectX::XMVector3Cross(normal, u);
+    DirectX::XMVECTOR spin = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&body.spinAxis));
+
+    radius.push_back(body.radius);
+    phase.push_back(body.phase);
+    angularVelocity.push_back(body.angularVelocity);
+    ux.push_back(DirectX::XMVectorGetX(u));
+    uy.push_back(DirectX::XMVectorGetY(u));
+    uz.push_back(DirectX::XMVectorGetZ(u));
+    vx.push_back(DirectX::XMVectorGetX(v));
+    vy.push_back(DirectX::XMVectorGetY(v));
+    vz.push_back(DirectX::XMVectorGetZ(v));
+    offsetX.push_back(DirectX::XMVectorGetX(normal) * body.height);
+    offsetY.push_back(DirectX::XMVectorGetY(normal) * body.height);
+    offsetZ.push_back(DirectX::XMVectorGetZ(normal) * body.height);
+    scale.push_back(body.scale);
+    spinX.push_back(DirectX::XMVectorGetX(spin));
+    spinY.push_back(DirectX::XMVectorGetY(spin));
+    spinZ.push_back(DirectX::XMVectorGetZ(spin));
+    spinPhase.push_back(body.spinPhase);
+    spinVelocity.push_back(body.spinVelocity);
+    return radius.size() - 1;
+}
+
+bool OrbitSimulation::HasVectorPath()
+{
+    return VectorMath::HasAvx();
+}
+
+void OrbitSimulation::Update(double time, size_t first, size_t last, InstanceTransform* transforms) const
+{
+    if (!HasVectorPath() || first % Width != 0) {
+        UpdateScalar(time, first, last, transforms);
+        return;
+    }
+
+    size_t vectorLast = first + (last - first) / Width * Width;
+    UpdateVector(time, first, vectorLast, transforms);
+    UpdateScalar(time, vectorLast, last, transforms);
+}
+
+void OrbitSimulation::UpdateScalar(double time, size_t first, size_t last, InstanceTransform* transforms) const
+{
+    for (size_t i = first; i < last; i++) {
+        float angle = phase[i] + TurnedAngle(angularVelocity[i], time);
+        float spinAngle = spinPhase[i] + TurnedAngle(spinVelocity[i], time);
+        float u[3] = { ux[i], uy[i], uz[i] };
+        float v[3] = { vx[i], vy[i], vz[i] };
+        float offset[3] = { offsetX[i], offsetY[i], offsetZ[i] };
+        float k[3] = { spinX[i], spinY[i], spinZ[i] };
+        WriteTransform(std::cos(angle), std::sin(angle), std::cos(spinAngle), std::sin(spinAngle), radius[i], u, v, offset, scale[i], k, transforms[i]);
+    }
+}
+
+void OrbitSimulation::GetState(double time, size_t body, DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& velocity) const
+{
+    float angle = phase[body] + TurnedAngle(angularVelocity[body], time);
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    position = DirectX::XMFLOAT3(
+        radius[body] * (c * ux[body] + s * vx[body]) + offsetX[body],
+        radius[body] * (c * uy[body] + s * vy[body]) + offsetY[body],
+        radius[body] * (c * uz[body] + s * vz[body]) + offsetZ[body]);
+    // Derivative of the position along the orbit.
+    float speed = radius[body] * angularVelocity[body];
+    velocity = DirectX::XMFLOAT3(
+        speed * (c * vx[body] - s * ux[body]),
+        speed * (c * vy[body] - s * uy[body]),
+        speed * (c * vz[body] - s * uz[body]));
+}
+
+void OrbitSimulation::UpdateVector(double time, size_t first, size_t last, InstanceTransform* transforms) const
+{
+    const __m256d t = _mm256_set1_pd(time);
+    const __m256 one = _mm256_set1_ps(1.0f);
+
+    for (size_t i = first; i < last; i += Width) {
+        __m256 s, c, spinS, spinC;
+        VectorMath::SinCos8(_mm256_add_ps(_mm256_loadu_ps(&phase[i]), TurnedAngle8(_mm256_loadu_ps(&angularVelocity[i]), t)), s, c);
+        VectorMath::SinCos8(_mm256_add_ps(_mm256_loadu_ps(&spinPhase[i]), TurnedAngle8(_mm256_loadu_ps(&spinVelocity[i]), t)), spinS, spinC);
+
+        // Position: radius * (cos * u + sin * v) + offset.
+        __m256 rc = _mm256_mul_ps(_mm256_loadu_ps(&radius[i]), c);
+        __m256 rs = _mm256_mul_ps(_mm256_loadu_ps(&radius[i]), s);
+        __m256 px = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rc, _mm256_loadu_ps(&ux[i])), _mm256_mul_ps(rs, _mm256_loadu_ps(&vx[i]))), _mm256_loadu_ps(&offsetX[i]));
+        __m256 py = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rc, _mm256_loadu_ps(&uy[i])), _mm256_mul_ps(rs, _mm256_loadu_ps(&vy[i]))), _mm256_loadu_ps(&offsetY[i]));
+        __m256 pz = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rc, _mm256_loadu_ps(&uz[i])), _mm256_mul_ps(rs, _mm256_loadu_ps(&vz[i]))), _mm256_loadu_ps(&offsetZ[i]));
+
+        // Scaled rotation around the spin axis, the same terms as WriteTransform().
+        __m256 sc = _mm256_loadu_ps(&scale[i]);
+        __m256 kx = _mm256_loadu_ps(&spinX[i]);
+        __m256 ky = _mm256_loadu_ps(&spinY[i]);
+        __m256 kz = _mm256_loadu_ps(&spinZ[i]);
+        __m256 tt = _mm256_sub_ps(one, spinC);
+        __m256 txy = _mm256_mul_ps(_mm256_mul_ps(tt, kx), ky);
+        __m256 txz = _mm256_mul_ps(_mm256_mul_ps(tt, kx), kz);
+        __m256 tyz = _mm256_mul_ps(_mm256_mul_ps(tt, ky), kz);
+        __m256 sx = _mm256_mul_ps(spinS, kx);
+        __m256 sy = _mm256_mul_ps(spinS, ky);
+        __m256 sz = _mm256_mul_ps(spinS, kz);
+
+        __m256 m0 = _mm256_mul_ps(sc, _mm256_add_ps(spinC, _mm256_mul_ps(_mm256_mul_ps(tt, kx), kx)));
+        __m256 m1 = _mm256_mul_ps(sc, _mm256_sub_ps(txy, sz));
+        __m256 m2 = _mm256_mul_ps(sc, _mm256_add_ps(txz, sy));
+        __m256 m3 = px;
+        __m256 m4 = _mm256_mul_ps(sc, _mm256_add_ps(txy, sz));
+        __m256 m5 = _mm256_mul_ps(sc, _mm256_add_ps(spinC, _mm256_mul_ps(_mm256_mul_ps(tt, ky), ky)));
+        __m256 m6 = _mm256_mul_ps(sc, _mm256_sub_ps(tyz, sx));
+        __m256 m7 = py;
+        __m256 m8 = _mm256_mul_ps(sc, _mm256_sub_ps(txz, sy));
+        __m256 m9 = _mm256_mul_ps(sc, _mm256_add_ps(tyz, sx));
+        __m256 m10 = _mm256_mul_ps(sc, _mm256_add_ps(spinC, _mm256_mul_ps(_mm256_mul_ps(tt, kz), kz)));
+        __m256 m11 = pz;
+
+        // From one register per value to one transform per body: the first two rows of the eight bodies
+        // are an 8x8 transpose, the last row two 4x4 ones. Stores are sequential for the write-combined heap.
+        VectorMath::Transpose8(m0, m1, m2, m3, m4, m5, m6, m7);
+        __m128 low0 = _mm256_castps256_ps128(m8), low1 = _mm256_castps256_ps128(m9), low2 = _mm256_castps256_ps128(m10), low3 = _mm256_castps256_ps128(m11);
+        __m128 high0 = _mm256_extractf128_ps(m8, 1), high1 = _mm256_extractf128_ps(m9, 1), high2 = _mm256_extractf128_ps(m10, 1), high3 = _mm256_extractf128_ps(m11, 1);
+        _MM_TRANSPOSE4_PS(low0, low1, low2, low3);
+        _MM_TRANSPOSE4_PS(high0, high1, high2, high3);
+
+        const __m256 firstRows[Width] = { m0, m1, m2, m3, m4, m5, m6, m7 };
+        const __m128 lastRows[Width] = { low0, low1, low2, low3, high0, high1, high2, high3 };
+        for (size_t b = 0; b < Width; b++) {
+            float* destination = &transforms[i + b].rows[0].x;
+            _mm256_storeu_ps(destination, firstRows[b]);
+            _mm_storeu_ps(destination + 8, lastRows[b]);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// World transform of one instance, packed as the top three rows of a column-vector affine matrix
+// (world position = rows * float4(position, 1)). Read as a row_major float3x4 by the vertex shader.
+struct InstanceTransform
+{
+    DirectX::XMFLOAT4 rows[3];
+};
+
+// One body on a circular orbit around the origin, the input of OrbitSimulation::AddBody().
+struct OrbitBody
+{
+    float radius;
+    float phase;                        // Orbit angle at time 0.
+    float angularVelocity;              // Radians per second.
+    DirectX::XMFLOAT3 inclinationAxis;  // Normal of the orbit plane.
+    float height;                       // Offset along the normal.
+    float scale;
+    DirectX::XMFLOAT3 spinAxis;         // Unit axis the body turns around.
+    float spinPhase;
+    float spinVelocity;
+};
+
+// Bodies on circular orbits, kept as a structure of arrays so they can be advanced eight at a time.
+// The orbit plane of a body is stored as two unit vectors spanning it, so the position only needs the
+// sine and cosine of the orbit angle. Transforms are a closed form of the time and are written straight
+// into the caller's buffer (usually a mapped upload heap), in body order and without reading it back.
+// With AVX the blocks of eight bodies are evaluated in vector registers, the rest falls back to
+// UpdateScalar(), which is also the reference for the vector path.
+class OrbitSimulation
+{
+public:
+    static const size_t Width = 8;
+
+    OrbitSimulation() = default;
+
+    void Reserve(size_t count);
+    size_t AddBody(const OrbitBody& body);
+    size_t GetBodyCount() const { return radius.size(); }
+
+    // Write the transforms of bodies [first, last) at the given time into transforms[first, last).
+    // first should be a multiple of Width, otherwise the range is evaluated by the scalar path.
+    // The turned angles are reduced to one turn in double precision before the single precision sine
+    // and cosine, so the bodies keep moving smoothly after hours of simulation time.
+    void Update(double time, size_t first, size_t last, InstanceTransform* transforms) const;
+    // Same, one body at a time with the standard library sine and cosine.
+    void UpdateScalar(double time, size_t first, size_t last, InstanceTransform* transforms) const;
+
+    // Position and orbital velocity of one body at the given time, to hand it over to another simulation.
+    void GetState(double time, size_t body, DirectX::XMFLOAT3& position, DirectX::XMFLOAT3& velocity) const;
+
+    // True when Update() uses the 8-wide path on this CPU.
+    static bool HasVectorPath();
+
+private:
+    void UpdateVector(double time, size_t first, size_t last, InstanceTransform* transforms) const;
+
+    std::vector<float> radius;
+    std::vector<float> phase;
+    std::vector<float> angularVelocity;
+    // Unit vectors of the orbit plane, position = radius * (cos * u + sin * v) + offset.
+    std::vector<float> ux, uy, uz;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> offsetX, offsetY, offsetZ;   // Height along the normal of the plane.
+    std::vector<float> scale;
+    std::vector<float> spinX, spinY, spinZ;
+    std::vector<float> spinPhase;
+    std::vector<float> spinVelocity;
+};
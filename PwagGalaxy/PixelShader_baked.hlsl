@@ -0,0 +1,36 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float3 direction : DIRECTION;
+    float4 lightPosition_viewSpace : LIGHT;
+    float4 vertexPosition_viewSpace : VERTVIEW;
+};
+
+struct wvpMatrixValue
+{
+    float4x4 wvpMatrix;
+    float4x4 worldMatrix;
+    float4x4 viewMatrix;
+    float4x4 projMatrix;
+};
+ConstantBuffer<wvpMatrixValue> constantRootDescriptor : register(b0);
+
+Texture2D t0 : register(t0);
+TextureCube normalMap : register(t1);
+TextureCube colorMap : register(t2);
+SamplerState s0 : register(s0);
+
+float4 main(PSInput input) : SV_TARGET
+{
+    // Normals are stored as n * 0.5 + 0.5 in object space.
+    float3 normal = normalMap.Sample(s0, input.direction).xyz * 2.0 - 1.0;
+    float4 normal_worldSpace = normalize(mul(float4(normal, 0), constantRootDescriptor.worldMatrix));
+    float3 normal_viewSpace = normalize(mul(normal_worldSpace, constantRootDescriptor.viewMatrix).xyz);
+
+    float3 lightDirection_viewSpace = normalize((input.lightPosition_viewSpace - input.vertexPosition_viewSpace).xyz);
+    float3 diffuseStrength = clamp(dot(normal_viewSpace, lightDirection_viewSpace), 0.0, 1.0);
+
+    float4 color = colorMap.Sample(s0, input.direction);
+    return t0.Load(int3(0, 0, 0)) * color * float4(diffuseStrength, 1);
+}
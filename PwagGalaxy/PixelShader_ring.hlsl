@@ -0,0 +1,15 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float2 texCoord : TEXCOORD;
+};
+
+float4 main(PSInput input) : SV_TARGET
+{
+    // Particle quads are round, the annulus has its texture coordinates in the middle of the disc.
+    float2 offset = input.texCoord * 2.0 - 1.0;
+    float coverage = saturate(1.0 - dot(offset, offset));
+
+    return float4(input.color.rgb, input.color.a * coverage);
+}
@@ -0,0 +1,28 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float3 direction : DIRECTION;
+};
+
+struct animationParams
+{
+    float blend;
+    uint fromChannel;
+    uint toChannel;
+    float intensity;
+};
+ConstantBuffer<animationParams> animationConstants : register(b1);
+
+TextureCube animationMap : register(t0);
+SamplerState s0 : register(s0);
+
+float4 main(PSInput input) : SV_TARGET
+{
+    // Two of the red, green and blue keyframes are shown, the third one is being updated.
+    float4 keyframes = animationMap.Sample(s0, input.direction);
+    float value = lerp(keyframes[animationConstants.fromChannel], keyframes[animationConstants.toChannel], animationConstants.blend) * 2.0 - 1.0;
+
+    float brightness = 1.0 + value * animationConstants.intensity;
+    return float4(input.color.rgb * brightness, input.color.a);
+}
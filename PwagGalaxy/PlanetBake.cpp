@@ -0,0 +1,261 @@
+#include "stdafx.h"
+#include "PlanetBake.h"
+
+#include "ThreadPool.h"
+#include <random>
+#include <algorithm>
+
+void PlanetBake::Bake(const PlanetTerrain& terrain, int resolution, const ErosionSettings& erosion)
+{
+    this->resolution = resolution;
+    const int stride = Stride();
+    heights.resize(static_cast<size_t>(FaceCount) * stride * stride);
+    normals.resize(heights.size());
+    normalTexels.resize(static_cast<size_t>(FaceCount) * resolution * resolution);
+
+    // Elevations, including the border, evaluated one row at a time.
+    ThreadPool::GetInstance()->ParallelFor(FaceCount, [&](size_t faceIndex) {
+        int face = static_cast<int>(faceIndex);
+        std::vector<DirectX::XMFLOAT3> rowDirections(stride);
+
+        for (int y = -Border; y < resolution + Border; y++) {
+            float v = (y + 0.5f) / resolution;
+            for (int x = -Border; x < resolution + Border; x++) {
+                rowDirections[x + Border] = FaceDirection(face, (x + 0.5f) / resolution, v);
+            }
+            terrain.EvaluateElevations(rowDirections.data(), &heights[TexelIndex(face, -Border, y)], stride);
+        }
+    });
+
+    eroded = erosion.enabled;
+    erosionComplete = true;
+    if (eroded) {
+        std::vector<ErosionFace> faces;
+        for (int face = 0; face < FaceCount; face++)
+            faces.push_back({ &heights[TexelIndex(face, 0, 0)], stride, resolution });
+        // Texels are 2 / resolution apart on the cube, close enough on the sphere.
+        erosionComplete = TerrainErosion(erosion).Erode(faces, 2.0f / resolution);
+    }
+
+    minElevation = FLT_MAX;
+    maxElevation = -FLT_MAX;
+    for (int face = 0; face < FaceCount; face++) {
+        for (int y = 0; y < resolution; y++) {
+            for (int x = 0; x < resolution; x++) {
+                minElevation = std::min(minElevation, heights[TexelIndex(face, x, y)]);
+                maxElevation = std::max(maxElevation, heights[TexelIndex(face, x, y)]);
+            }
+        }
+    }
+    float elevationRange = maxElevation - minElevation > 0.0f ? maxElevation - minElevation : 1.0f;
+
+    // Normals from central differences of the displaced surface. The outermost border ring only
+    // serves as neighbours, so it keeps the undisplaced normal.
+    ThreadPool::GetInstance()->ParallelFor(FaceCount, [&](size_t faceIndex) {
+        int face = static_cast<int>(faceIndex);
+
+        auto surfacePoint = [&](int x, int y) {
+            DirectX::XMFLOAT3 direction = FaceDirection(face, (x + 0.5f) / resolution, (y + 0.5f) / resolution);
+            return DirectX::XMVectorScale(DirectX::XMLoadFloat3(&direction), heights[TexelIndex(face, x, y)]);
+        };
+
+        for (int y = -Border; y < resolution + Border; y++) {
+            for (int x = -Border; x < resolution + Border; x++) {
+                DirectX::XMFLOAT3 direction = FaceDirection(face, (x + 0.5f) / resolution, (y + 0.5f) / resolution);
+                DirectX::XMFLOAT3& normal = normals[TexelIndex(face, x, y)];
+
+                if (x < 1 - Border || y < 1 - Border || x >= resolution + Border - 1 || y >= resolution + Border - 1) {
+                    normal = direction;
+                    continue;
+                }
+
+                DirectX::XMVECTOR tangentU = DirectX::XMVectorSubtract(surfacePoint(x + 1, y), surfacePoint(x - 1, y));
+                DirectX::XMVECTOR tangentV = DirectX::XMVectorSubtract(surfacePoint(x, y + 1), surfacePoint(x, y - 1));
+                DirectX::XMVECTOR n = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(tangentU, tangentV));
+                // Face orientations differ in handedness, always point away from the centre.
+                if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(n, DirectX::XMLoadFloat3(&direction))) < 0.0f)
+                    n = DirectX::XMVectorNegate(n);
+                DirectX::XMStoreFloat3(&normal, n);
+            }
+        }
+
+        for (int y = 0; y < resolution; y++) {
+            for (int x = 0; x < resolution; x++) {
+                const DirectX::XMFLOAT3& n = normals[TexelIndex(face, x, y)];
+                float height = (heights[TexelIndex(face, x, y)] - minElevation) / elevationRange;
+                normalTexels[(static_cast<size_t>(face) * resolution + y) * resolution + x] =
+                    PackColor(n.x * 0.5f + 0.5f, n.y * 0.5f + 0.5f, n.z * 0.5f + 0.5f, height);
+            }
+        }
+    });
+}
+
+void PlanetBake::BakeColors(const ColorGradient& gradient, float minElevation, float maxElevation, DirectX::XMFLOAT4 fallbackColor)
+{
+    colorTexels.resize(static_cast<size_t>(FaceCount) * resolution * resolution);
+
+    ThreadPool::GetInstance()->ParallelFor(FaceCount, [&](size_t faceIndex) {
+        int face = static_cast<int>(faceIndex);
+        for (int y = 0; y < resolution; y++) {
+            for (int x = 0; x < resolution; x++) {
+                float normalizedElevation = PlanetTerrain::NormalizeElevation(heights[TexelIndex(face, x, y)], minElevation, maxElevation);
+                DirectX::XMFLOAT4 color = PlanetTerrain::SampleGradient(gradient, normalizedElevation, fallbackColor);
+                colorTexels[(static_cast<size_t>(face) * resolution + y) * resolution + x] = PackColor(color.x, color.y, color.z, color.w);
+            }
+        }
+    });
+}
+
+float PlanetBake::SampleHeight(DirectX::XMFLOAT3 direction) const
+{
+    float u, v;
+    int face = DirectionToFace(direction, u, v);
+
+    // Texel centres sit at (i + 0.5) / resolution, the border covers the half texel past the edges.
+    float s = std::min(std::max(u * resolution - 0.5f, -1.0f), resolution - 0.001f);
+    float t = std::min(std::max(v * resolution - 0.5f, -1.0f), resolution - 0.001f);
+    int x0 = static_cast<int>(std::floor(s));
+    int y0 = static_cast<int>(std::floor(t));
+    float fx = s - x0;
+    float fy = t - y0;
+
+    float h00 = heights[TexelIndex(face, x0, y0)];
+    float h10 = heights[TexelIndex(face, x0 + 1, y0)];
+    float h01 = heights[TexelIndex(face, x0, y0 + 1)];
+    float h11 = heights[TexelIndex(face, x0 + 1, y0 + 1)];
+
+    return (h00 * (1.0f - fx) + h10 * fx) * (1.0f - fy) + (h01 * (1.0f - fx) + h11 * fx) * fy;
+}
+
+DirectX::XMFLOAT3 PlanetBake::SampleNormal(DirectX::XMFLOAT3 direction) const
+{
+    float u, v;
+    int face = DirectionToFace(direction, u, v);
+
+    float s = std::min(std::max(u * resolution - 0.5f, -1.0f), resolution - 0.001f);
+    float t = std::min(std::max(v * resolution - 0.5f, -1.0f), resolution - 0.001f);
+    int x0 = static_cast<int>(std::floor(s));
+    int y0 = static_cast<int>(std::floor(t));
+    float fx = s - x0;
+    float fy = t - y0;
+
+    DirectX::XMVECTOR n00 = DirectX::XMLoadFloat3(&normals[TexelIndex(face, x0, y0)]);
+    DirectX::XMVECTOR n10 = DirectX::XMLoadFloat3(&normals[TexelIndex(face, x0 + 1, y0)]);
+    DirectX::XMVECTOR n01 = DirectX::XMLoadFloat3(&normals[TexelIndex(face, x0, y0 + 1)]);
+    DirectX::XMVECTOR n11 = DirectX::XMLoadFloat3(&normals[TexelIndex(face, x0 + 1, y0 + 1)]);
+
+    DirectX::XMVECTOR n = DirectX::XMVectorLerp(DirectX::XMVectorLerp(n00, n10, fx), DirectX::XMVectorLerp(n01, n11, fx), fy);
+    DirectX::XMFLOAT3 normal;
+    DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(n));
+    return normal;
+}
+
+PlanetBakeVerification PlanetBake::Verify(const PlanetTerrain& terrain, int sampleCount) const
+{
+    PlanetBakeVerification result = {};
+
+    // Texel centres (every few texels, the bake evaluated exactly these directions).
+    for (int face = 0; face < FaceCount; face++) {
+        for (int y = 0; y < resolution; y += 7) {
+            for (int x = 0; x < resolution; x += 7) {
+                DirectX::XMFLOAT3 direction = FaceDirection(face, (x + 0.5f) / resolution, (y + 0.5f) / resolution);
+                float error = std::abs(terrain.EvaluateElevation(direction) - GetTexelHeight(face, x, y));
+                result.maxTexelError = std::max(result.maxTexelError, error);
+            }
+        }
+    }
+
+    // Random directions, fixed seed so runs are comparable.
+    std::mt19937 generator(1234);
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+    const float pi = 3.14159265f;
+    // Finite difference step of roughly one texel.
+    float epsilon = 2.0f / resolution;
+    double sampleErrorSum = 0.0;
+    double normalErrorSum = 0.0;
+
+    for (int i = 0; i < sampleCount; i++) {
+        DirectX::XMVECTOR d = DirectX::XMVector3Normalize(DirectX::XMVectorSet(distribution(generator), distribution(generator), distribution(generator), 0.0f));
+        DirectX::XMFLOAT3 direction;
+        DirectX::XMStoreFloat3(&direction, d);
+
+        float error = std::abs(terrain.EvaluateElevation(direction) - SampleHeight(direction));
+        result.maxSampleError = std::max(result.maxSampleError, error);
+        sampleErrorSum += error;
+
+        DirectX::XMFLOAT3 exact = terrain.EvaluateNormal(direction, epsilon);
+        DirectX::XMVECTOR exactNormal = DirectX::XMLoadFloat3(&exact);
+
+        DirectX::XMFLOAT3 bakedNormal = SampleNormal(direction);
+        float cosine = DirectX::XMVectorGetX(DirectX::XMVector3Dot(exactNormal, DirectX::XMLoadFloat3(&bakedNormal)));
+        float angle = std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 180.0f / pi;
+        result.maxNormalErrorDeg = std::max(result.maxNormalErrorDeg, angle);
+        normalErrorSum += angle;
+    }
+
+    if (sampleCount > 0) {
+        result.meanSampleError = static_cast<float>(sampleErrorSum / sampleCount);
+        result.meanNormalErrorDeg = static_cast<float>(normalErrorSum / sampleCount);
+    }
+    return result;
+}
+
+DirectX::XMFLOAT3 PlanetBake::FaceDirection(int face, float u, float v)
+{
+    float sc = u * 2.0f - 1.0f;
+    float tc = v * 2.0f - 1.0f;
+
+    DirectX::XMVECTOR direction;
+    switch (face) {
+    case 0: direction = DirectX::XMVectorSet(1.0f, -tc, -sc, 0.0f); break;   // +X
+    case 1: direction = DirectX::XMVectorSet(-1.0f, -tc, sc, 0.0f); break;   // -X
+    case 2: direction = DirectX::XMVectorSet(sc, 1.0f, tc, 0.0f); break;     // +Y
+    case 3: direction = DirectX::XMVectorSet(sc, -1.0f, -tc, 0.0f); break;   // -Y
+    case 4: direction = DirectX::XMVectorSet(sc, -tc, 1.0f, 0.0f); break;    // +Z
+    default: direction = DirectX::XMVectorSet(-sc, -tc, -1.0f, 0.0f); break; // -Z
+    }
+
+    DirectX::XMFLOAT3 result;
+    DirectX::XMStoreFloat3(&result, DirectX::XMVector3Normalize(direction));
+    return result;
+}
+
+int PlanetBake::DirectionToFace(DirectX::XMFLOAT3 direction, float& u, float& v)
+{
+    float ax = std::abs(direction.x);
+    float ay = std::abs(direction.y);
+    float az = std::abs(direction.z);
+
+    int face;
+    float sc, tc, ma;
+    if (ax >= ay && ax >= az) {
+        ma = ax;
+        face = direction.x >= 0.0f ? 0 : 1;
+        sc = direction.x >= 0.0f ? -direction.z : direction.z;
+        tc = -direction.y;
+    }
+    else if (ay >= az) {
+        ma = ay;
+        face = direction.y >= 0.0f ? 2 : 3;
+        sc = direction.x;
+        tc = direction.y >= 0.0f ? direction.z : -direction.z;
+    }
+    else {
+        ma = az;
+        face = direction.z >= 0.0f ? 4 : 5;
+        sc = direction.z >= 0.0f ? direction.x : -direction.x;
+        tc = -direction.y;
+    }
+
+    u = (sc / ma + 1.0f) * 0.5f;
+    v = (tc / ma + 1.0f) * 0.5f;
+    return face;
+}
+
+UINT PlanetBake::PackColor(float r, float g, float b, float a)
+{
+    auto toByte = [](float value) {
+        return static_cast<UINT>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+    };
+    return toByte(r) | (toByte(g) << 8) | (toByte(b) << 16) | (toByte(a) << 24);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "PlanetTerrain.h"
+#include "TerrainErosion.h"
+
+struct PlanetBakeSettings
+{
+    int textureResolution = 256;        // Texels along the edge of one cube face.
+    int coarseMeshResolution = 32;      // Vertices along the edge of one face of the low-poly sphere.
+    float fullDetailDistance = 8.0f;    // Bodies closer than this (in their own radii) use the full-resolution mesh.
+    int queryResolution = 64;           // Elevation grid for surface queries of bodies that are not baked for rendering.
+    ErosionSettings erosion;            // Optional erosion of the baked planet elevations.
+};
+
+struct PlanetBakeVerification
+{
+    float maxTexelError;        // Baked texel vs. direct evaluation at the texel centre (should be zero).
+    float maxSampleError;       // Bilinear lookup vs. direct evaluation at random directions.
+    float meanSampleError;
+    float maxNormalErrorDeg;    // Baked normal vs. finite-difference normal of the direct evaluation.
+    float meanNormalErrorDeg;
+};
+
+// The terrain of one body evaluated once into cube maps of elevation, normals and colour.
+// Faces follow the D3D TextureCube order (+X, -X, +Y, -Y, +Z, -Z) and orientation, so the GPU can
+// sample the uploaded textures directly with a direction. The CPU copy of the elevations is kept
+// for height and normal lookups.
+class PlanetBake
+{
+public:
+    static const int FaceCount = 6;
+    // Texels evaluated around every face, so filtering and normals never need to look at another face.
+    static const int Border = 2;
+
+    // Evaluate elevations and normals at the given resolution, one face per worker thread.
+    // Erosion, when enabled, runs on the elevations before the normals are derived.
+    void Bake(const PlanetTerrain& terrain, int resolution, const ErosionSettings& erosion = ErosionSettings());
+    // Fill the colour cube map from the gradient. Elevations are normalized with the given range.
+    void BakeColors(const ColorGradient& gradient, float minElevation, float maxElevation, DirectX::XMFLOAT4 fallbackColor);
+
+    // Bilinear lookups for any direction (does not need to be normalized).
+    float SampleHeight(DirectX::XMFLOAT3 direction) const;
+    DirectX::XMFLOAT3 SampleNormal(DirectX::XMFLOAT3 direction) const;
+
+    // Compare the bake against direct evaluation of the terrain (meaningless after erosion).
+    PlanetBakeVerification Verify(const PlanetTerrain& terrain, int sampleCount) const;
+
+    // Unit direction through the point (u, v) of a face, u and v are in [0, 1] on the face.
+    static DirectX::XMFLOAT3 FaceDirection(int face, float u, float v);
+    // Face a direction points into and its (u, v) coordinates on that face.
+    static int DirectionToFace(DirectX::XMFLOAT3 direction, float& u, float& v);
+
+    int GetResolution() const { return resolution; }
+    bool IsEroded() const { return eroded; }
+    // False when the erosion ran out of its time budget before all of its passes.
+    bool IsErosionComplete() const { return erosionComplete; }
+    float GetMinElevation() const { return minElevation; }
+    float GetMaxElevation() const { return maxElevation; }
+    float GetTexelHeight(int face, int x, int y) const { return heights[TexelIndex(face, x, y)]; }
+
+    // Texels of the faces one after another, packed as R8G8B8A8_UNORM.
+    // Normals are stored as n * 0.5 + 0.5 with the normalized elevation in alpha.
+    const std::vector<UINT>& GetNormalTexels() const { return normalTexels; }
+    const std::vector<UINT>& GetColorTexels() const { return colorTexels; }
+
+private:
+    int Stride() const { return resolution + 2 * Border; }
+    size_t TexelIndex(int face, int x, int y) const { return (static_cast<size_t>(face) * Stride() + (y + Border)) * Stride() + (x + Border); }
+    static UINT PackColor(float r, float g, float b, float a);
+
+    int resolution = 0;
+    bool eroded = false;
+    bool erosionComplete = true;
+    float minElevation = 0.0f;
+    float maxElevation = 0.0f;
+
+    // Bordered grids, Stride() x Stride() per face.
+    std::vector<float> heights;
+    std::vector<DirectX::XMFLOAT3> normals;
+
+    // resolution x resolution per face, ready for upload.
+    std::vector<UINT> normalTexels;
+    std::vector<UINT> colorTexels;
+};
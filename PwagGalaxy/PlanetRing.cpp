@@ -0,0 +1,322 @@
+#include "stdafx.h"
+#include "PlanetRing.h"
+
+#include "ConfigurationGenerator.h"
+#include "ThreadPool.h"
+#include "VectorMath.h"
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    // Particles per job of Update().
+    const size_t UpdateChunk = 4096;
+    // Random values drawn per particle.
+    const uint64_t ValuesPerParticle = 4;
+    // Streams of CounterRandom() for the bands and the particles.
+    const uint64_t BandStream = 1ull << 40;
+
+    float UnitFloat(uint64_t value)
+    {
+        return static_cast<float>(value >> 40) * (1.0f / 16777216.0f);
+    }
+
+    float SmoothStep(float edge0, float edge1, float x)
+    {
+        float t = std::min(std::max((x - edge0) / (edge1 - edge0), 0.0f), 1.0f);
+        return t * t * (3.0f - 2.0f * t);
+    }
+
+    struct GeneratedParticle
+    {
+        float radius, phase, height, size;
+    };
+
+    struct NearRange
+    {
+        int band;
+        size_t first, last;
+        size_t destination;
+    };
+}
+
+PlanetRing::PlanetRing(const PlanetRingSettings& settings, float planetRadius) :
+    settings(settings),
+    planetRadius(planetRadius)
+{
+    if (settings.bandCount < 1 || settings.outerRadius <= settings.innerRadius)
+        throw "Planet ring needs at least one band between its radii!";
+
+    int bands = settings.bandCount;
+    auto bandRandom = [&settings](uint64_t counter) { return UnitFloat(ConfigurationGenerator::CounterRandom(settings.seed, BandStream + counter)); };
+
+    // Tilt of the ring plane.
+    float tilt = bandRandom(0) * settings.maxTilt;
+    float tiltDirection = bandRandom(1) * DirectX::XM_2PI;
+    DirectX::XMVECTOR normal = DirectX::XMVectorSet(std::sin(tilt) * std::cos(tiltDirection), std::cos(tilt), std::sin(tilt) * std::sin(tiltDirection), 0.0f);
+    DirectX::XMVECTOR reference = std::abs(DirectX::XMVectorGetX(normal)) < 0.9f ? DirectX::XMVectorSet(1, 0, 0, 0) : DirectX::XMVectorSet(0, 0, 1, 0);
+    DirectX::XMVECTOR v = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(reference, normal));
+    DirectX::XMVECTOR u = DirectX::XMVector3Cross(normal, v);
+    DirectX::XMStoreFloat3(&axisU, u);
+    DirectX::XMStoreFloat3(&axisN, normal);
+    DirectX::XMStoreFloat3(&axisV, v);
+
+    // Density of the bands: uneven, thinning towards the edges, with a few gaps.
+    bandDensity.resize(bands);
+    std::vector<float> gapCenters(settings.gapCount), gapWidths(settings.gapCount);
+    for (int g = 0; g < settings.gapCount; g++) {
+        gapCenters[g] = 0.15f + 0.7f * bandRandom(2 + 2 * g);
+        gapWidths[g] = 0.005f + 0.025f * bandRandom(3 + 2 * g);
+    }
+    float densest = 0.0f;
+    for (int b = 0; b < bands; b++) {
+        float t = (b + 0.5f) / bands;
+        float density = (0.35f + 0.65f * bandRandom(100 + b)) * SmoothStep(0.0f, 0.1f, t) * SmoothStep(1.0f, 0.8f, t);
+        for (int g = 0; g < settings.gapCount; g++)
+            density *= SmoothStep(gapWidths[g], 2.0f * gapWidths[g], std::abs(t - gapCenters[g]));
+        bandDensity[b] = density;
+        densest = std::max(densest, density);
+    }
+    if (densest <= 0.0f)
+        throw "Planet ring has no particles!";
+
+    // Particles per band by density and area, the rounding carried over so they add up.
+    bandFirst.resize(bands + 1);
+    bandAngularVelocity.resize(bands);
+    std::vector<double> weights(bands);
+    double weightSum = 0.0;
+    for (int b = 0; b < bands; b++) {
+        bandDensity[b] /= densest;
+        float inner = GetBandInnerRadius(b);
+        float outer = GetBandOuterRadius(b);
+        weights[b] = static_cast<double>(bandDensity[b]) * (outer * outer - inner * inner);
+        weightSum += weights[b];
+        float middle = 0.5f * (inner + outer);
+        bandAngularVelocity[b] = settings.orbitalSpeed * std::pow(settings.innerRadius / middle, 1.5f);
+    }
+    double cumulative = 0.0;
+    bandFirst[0] = 0;
+    for (int b = 0; b < bands; b++) {
+        cumulative += weights[b];
+        bandFirst[b + 1] = static_cast<size_t>(settings.particleCount * (cumulative / weightSum) + 0.5);
+    }
+    bandFirst[bands] = settings.particleCount;
+
+    size_t count = settings.particleCount;
+    radius.resize(count);
+    phase.resize(count);
+    height.resize(count);
+    size.resize(count);
+
+    // Bands are independent, every one is generated and sorted by angle on a worker.
+    ThreadPool::GetInstance()->ParallelFor(bands, [&](size_t b) {
+        float inner = GetBandInnerRadius(static_cast<int>(b));
+        float outer = GetBandOuterRadius(static_cast<int>(b));
+        float innerSquared = inner * inner;
+        float outerSquared = outer * outer;
+
+        std::vector<GeneratedParticle> particles(bandFirst[b + 1] - bandFirst[b]);
+        for (size_t p = 0; p < particles.size(); p++) {
+            uint64_t counter = (bandFirst[b] + p) * ValuesPerParticle;
+            float values[ValuesPerParticle];
+            for (uint64_t k = 0; k < ValuesPerParticle; k++)
+                values[k] = UnitFloat(ConfigurationGenerator::CounterRandom(settings.seed, counter + k));
+            particles[p].radius = std::sqrt(innerSquared + (outerSquared - innerSquared) * values[0]);
+            particles[p].phase = values[1] * DirectX::XM_2PI;
+            particles[p].height = (values[2] * 2.0f - 1.0f) * settings.thickness;
+            particles[p].size = settings.size.min + (settings.size.max - settings.size.min) * values[3] * values[3];
+        }
+        std::sort(particles.begin(), particles.end(), [](const GeneratedParticle& left, const GeneratedParticle& right) { return left.phase < right.phase; });
+
+        for (size_t p = 0; p < particles.size(); p++) {
+            size_t i = bandFirst[b] + p;
+            radius[i] = particles[p].radius;
+            phase[i] = particles[p].phase;
+            height[i] = particles[p].height;
+            size[i] = particles[p].size;
+        }
+    });
+}
+
+float PlanetRing::GetBandInnerRadius(int band) const
+{
+    return settings.innerRadius + (settings.outerRadius - settings.innerRadius) * band / settings.bandCount;
+}
+
+DirectX::XMMATRIX PlanetRing::GetWorldMatrix(DirectX::XMFLOAT3 planetPosition) const
+{
+    // Rows are the images of the local axes (row vectors, as everywhere in DirectXMath).
+    DirectX::XMMATRIX rotation(
+        DirectX::XMVectorSet(axisU.x, axisU.y, axisU.z, 0.0f),
+        DirectX::XMVectorSet(axisN.x, axisN.y, axisN.z, 0.0f),
+        DirectX::XMVectorSet(axisV.x, axisV.y, axisV.z, 0.0f),
+        DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+    return DirectX::XMMatrixScaling(planetRadius, planetRadius, planetRadius) * rotation *
+        DirectX::XMMatrixTranslation(planetPosition.x, planetPosition.y, planetPosition.z);
+}
+
+size_t PlanetRing::Update(double time, DirectX::XMFLOAT3 planetPosition, DirectX::XMFLOAT3 cameraPosition, RingParticle* particles, size_t maxCount)
+{
+    auto start = std::chrono::steady_clock::now();
+    stats = PlanetRingStats();
+    maxCount = std::min(maxCount, settings.maxNearParticles);
+
+    // Camera in the ring plane, in planet radii.
+    float dx = (cameraPosition.x - planetPosition.x) / planetRadius;
+    float dy = (cameraPosition.y - planetPosition.y) / planetRadius;
+    float dz = (cameraPosition.z - planetPosition.z) / planetRadius;
+    float cameraX = dx * axisU.x + dy * axisU.y + dz * axisU.z;
+    float cameraY = dx * axisN.x + dy * axisN.y + dz * axisN.z;
+    float cameraZ = dx * axisV.x + dy * axisV.y + dz * axisV.z;
+    float cameraRadius = std::sqrt(cameraX * cameraX + cameraZ * cameraZ);
+    float cameraAngle = std::atan2(cameraZ, cameraX);
+    float verticalGap = std::max(std::abs(cameraY) - settings.thickness, 0.0f);
+    float nearSquared = settings.nearDistance * settings.nearDistance;
+
+    // Bands within reach, the closest first.
+    std::vector<std::pair<float, int>> bandDistances;
+    for (int b = 0; b < settings.bandCount; b++) {
+        if (bandFirst[b + 1] == bandFirst[b])
+            continue;
+        float radialGap = std::max(std::max(GetBandInnerRadius(b) - cameraRadius, cameraRadius - GetBandOuterRadius(b)), 0.0f);
+        float distanceSquared = radialGap * radialGap + verticalGap * verticalGap;
+        if (distanceSquared <= nearSquared)
+            bandDistances.push_back(std::make_pair(distanceSquared, b));
+    }
+    std::sort(bandDistances.begin(), bandDistances.end());
+
+    // Angles within reach of the camera: a particle at radius r and angle difference a is at
+    // r^2 + rho^2 - 2 r rho cos(a) + height^2 from the camera, the window is the widest one over the band.
+    std::vector<NearRange> ranges;
+    size_t written = 0;
+    for (const std::pair<float, int>& bandDistance : bandDistances) {
+        int b = bandDistance.second;
+        float halfAngle = DirectX::XM_PI;
+        if (cameraRadius > 1e-6f) {
+            float k = cameraRadius * cameraRadius + verticalGap * verticalGap - nearSquared;
+            float r = std::min(std::max(std::sqrt(std::max(k, 0.0f)), GetBandInnerRadius(b)), GetBandOuterRadius(b));
+            float cosine = (r * r + k) / (2.0f * r * cameraRadius);
+            if (cosine > -1.0f)
+                halfAngle = std::acos(std::min(cosine, 1.0f));
+        }
+
+        // The window in the angles at time 0, one or two ranges of the sorted band.
+        std::vector<std::pair<float, float>> windows;
+        if (halfAngle >= DirectX::XM_PI) {
+            windows.push_back(std::make_pair(0.0f, DirectX::XM_2PI));
+        }
+        else {
+            double rotation = std::fmod(static_cast<double>(bandAngularVelocity[b]) * time, static_cast<double>(DirectX::XM_2PI));
+            double from = std::fmod(cameraAngle - halfAngle - rotation, static_cast<double>(DirectX::XM_2PI));
+            if (from < 0.0)
+                from += DirectX::XM_2PI;
+            double to = from + 2.0 * halfAngle;
+            windows.push_back(std::make_pair(static_cast<float>(from), static_cast<float>(std::min(to, static_cast<double>(DirectX::XM_2PI)))));
+            if (to > DirectX::XM_2PI)
+                windows.push_back(std::make_pair(0.0f, static_cast<float>(to - DirectX::XM_2PI)));
+        }
+
+        size_t bandCount = 0;
+        std::vector<NearRange> bandRanges;
+        for (const std::pair<float, float>& window : windows) {
+            auto bandBegin = phase.begin() + bandFirst[b];
+            auto bandEnd = phase.begin() + bandFirst[b + 1];
+            size_t first = std::lower_bound(bandBegin, bandEnd, window.first) - phase.begin();
+            size_t last = std::lower_bound(bandBegin, bandEnd, window.second) - phase.begin();
+            if (window.second >= DirectX::XM_2PI)
+                last = bandFirst[b + 1];
+            if (last > first) {
+                bandRanges.push_back({ b, first, last, 0 });
+                bandCount += last - first;
+            }
+        }
+        // Over the budget the band and all farther ones stay with the billboard.
+        if (written + bandCount > maxCount) {
+            stats.droppedParticles += bandCount;
+            maxCount = written;
+            continue;
+        }
+        for (NearRange& range : bandRanges) {
+            range.destination = written;
+            written += range.last - range.first;
+            ranges.push_back(range);
+        }
+        if (bandCount > 0)
+            stats.nearBands++;
+    }
+
+    // Jobs of at most UpdateChunk particles.
+    std::vector<NearRange> jobs;
+    for (const NearRange& range : ranges) {
+        for (size_t first = range.first; first < range.last; first += UpdateChunk)
+            jobs.push_back({ range.band, first, std::min(range.last, first + UpdateChunk), range.destination + (first - range.first) });
+    }
+
+    Frame frame;
+    const float origin[3] = { planetPosition.x, planetPosition.y, planetPosition.z };
+    const DirectX::XMFLOAT3* axes[3] = { &axisU, &axisN, &axisV };
+    float* frameAxes[3] = { frame.u, frame.n, frame.v };
+    for (int a = 0; a < 3; a++) {
+        frame.origin[a] = origin[a];
+        frameAxes[a][0] = axes[a]->x * planetRadius;
+        frameAxes[a][1] = axes[a]->y * planetRadius;
+        frameAxes[a][2] = axes[a]->z * planetRadius;
+    }
+    bool vector = settings.vectorPath && VectorMath::HasAvx();
+    ThreadPool::GetInstance()->ParallelFor(jobs.size(), [&](size_t j) {
+        const NearRange& job = jobs[j];
+        float rotation = static_cast<float>(std::fmod(static_cast<double>(bandAngularVelocity[job.band]) * time, static_cast<double>(DirectX::XM_2PI)));
+        if (vector)
+            WriteVector(frame, rotation, job.first, job.last, particles + job.destination);
+        else
+            WriteScalar(frame, rotation, job.first, job.last, particles + job.destination);
+    });
+
+    stats.nearParticles = written;
+    stats.updateMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return written;
+}
+
+void PlanetRing::WriteScalar(const Frame& frame, float rotation, size_t first, size_t last, RingParticle* particles) const
+{
+    for (size_t i = first; i < last; i++) {
+        float angle = phase[i] + rotation;
+        float x = radius[i] * std::cos(angle);
+        float y = height[i];
+        float z = radius[i] * std::sin(angle);
+        particles[i - first].positionSize = DirectX::XMFLOAT4(
+            frame.origin[0] + x * frame.u[0] + y * frame.n[0] + z * frame.v[0],
+            frame.origin[1] + x * frame.u[1] + y * frame.n[1] + z * frame.v[1],
+            frame.origin[2] + x * frame.u[2] + y * frame.n[2] + z * frame.v[2],
+            size[i] * planetRadius);
+    }
+}
+
+void PlanetRing::WriteVector(const Frame& frame, float rotation, size_t first, size_t last, RingParticle* particles) const
+{
+    const __m256 turn = _mm256_set1_ps(rotation);
+    const __m256 scale = _mm256_set1_ps(planetRadius);
+    __m256 origin[3], u[3], n[3], v[3];
+    for (int a = 0; a < 3; a++) {
+        origin[a] = _mm256_set1_ps(frame.origin[a]);
+        u[a] = _mm256_set1_ps(frame.u[a]);
+        n[a] = _mm256_set1_ps(frame.n[a]);
+        v[a] = _mm256_set1_ps(frame.v[a]);
+    }
+
+    size_t i = first;
+    for (; i + 8 <= last; i += 8) {
+        __m256 s, c;
+        VectorMath::SinCos8(_mm256_add_ps(_mm256_loadu_ps(&phase[i]), turn), s, c);
+        __m256 r = _mm256_loadu_ps(&radius[i]);
+        __m256 x = _mm256_mul_ps(r, c);
+        __m256 y = _mm256_loadu_ps(&height[i]);
+        __m256 z = _mm256_mul_ps(r, s);
+
+        __m256 world[3];
+        for (int a = 0; a < 3; a++)
+            world[a] = _mm256_add_ps(_mm256_add_ps(origin[a], _mm256_mul_ps(x, u[a])), _mm256_add_ps(_mm256_mul_ps(y, n[a]), _mm256_mul_ps(z, v[a])));
+        VectorMath::StoreInterleaved4(world[0], world[1], world[2], _mm256_mul_ps(_mm256_loadu_ps(&size[i]), scale), &particles[i - first].positionSize.x);
+    }
+    WriteScalar(frame, rotation, i, last, particles + (i - first));
+}
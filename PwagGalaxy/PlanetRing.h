@@ -0,0 +1,91 @@
+#pragma once
+
+// One ring particle as the vertex shader reads it: world position and the half size of its quad.
+struct RingParticle
+{
+    DirectX::XMFLOAT4 positionSize;
+};
+
+struct PlanetRingSettings
+{
+    uint64_t seed = 1;
+    size_t particleCount = 1000000;
+    int bandCount = 128;                // Radial bands, each turns as a whole at the Kepler speed of its middle.
+    float innerRadius = 1.6f;           // In planet radii.
+    float outerRadius = 2.8f;
+    float thickness = 0.01f;            // Half height, in planet radii.
+    struct { float min, max; } size = { 0.002f, 0.006f };  // Half size of a particle quad, in planet radii.
+    float orbitalSpeed = 0.3f;          // Radians per second at the inner radius, slower outwards (Kepler's third law).
+    float maxTilt = 0.4f;               // Largest tilt of the ring plane, in radians.
+    int gapCount = 3;                   // Empty bands cleared by moons.
+    DirectX::XMFLOAT4 color = DirectX::XMFLOAT4(0.82f, 0.76f, 0.66f, 0.85f);  // The alpha is the opacity of the densest band.
+    float nearDistance = 1.0f;          // Particles closer to the camera than this (in planet radii) are drawn one by one.
+    size_t maxNearParticles = 262144;   // Particles written per update at most, bounds the CPU time and the upload.
+    bool vectorPath = true;             // Write 8 particles at a time when the CPU has AVX.
+};
+
+struct PlanetRingStats
+{
+    size_t nearParticles = 0;           // Written by the last update.
+    size_t droppedParticles = 0;        // Near the camera but over the budget, left to the billboard.
+    int nearBands = 0;
+    double updateMs = 0.0;
+};
+
+// Dust ring of a planet. The particles are a structure of arrays sorted by radial band and, within a
+// band, by orbit angle. A band turns as a whole, so the particles of a band near the camera are one or
+// two contiguous index ranges found by binary search, at any time. Far away the ring is drawn as an
+// annulus with the density of every band (see GetBandDensity()), only the particles within
+// nearDistance of the camera are written per frame, the closest bands first and at most
+// maxNearParticles of them, which bounds both the CPU time and the upload of a frame.
+class PlanetRing
+{
+public:
+    PlanetRing() = default;
+    PlanetRing(const PlanetRingSettings& settings, float planetRadius);
+
+    // Ring to world: the tilted ring plane (xz, normal y) scaled by the planet radius, at the planet.
+    DirectX::XMMATRIX GetWorldMatrix(DirectX::XMFLOAT3 planetPosition) const;
+
+    // Write the particles near the camera at the given time into particles, at most maxCount of them
+    // (and maxNearParticles). Returns the number written, see GetStats() for the rest.
+    size_t Update(double time, DirectX::XMFLOAT3 planetPosition, DirectX::XMFLOAT3 cameraPosition, RingParticle* particles, size_t maxCount);
+
+    size_t GetParticleCount() const { return radius.size(); }
+    int GetBandCount() const { return settings.bandCount; }
+    // Radii of a band in planet radii.
+    float GetBandInnerRadius(int band) const;
+    float GetBandOuterRadius(int band) const { return GetBandInnerRadius(band + 1); }
+    // Particles per area of a band against the densest one.
+    float GetBandDensity(int band) const { return bandDensity[band]; }
+    float GetPlanetRadius() const { return planetRadius; }
+    const PlanetRingSettings& GetSettings() const { return settings; }
+    const PlanetRingStats& GetStats() const { return stats; }
+
+private:
+    // Ring plane in world space, the axes scaled by the planet radius.
+    struct Frame
+    {
+        float origin[3];
+        float u[3], n[3], v[3];
+    };
+
+    // Particles [first, last) of a band, turned by the angle of the band, into particles[0, last - first).
+    void WriteScalar(const Frame& frame, float rotation, size_t first, size_t last, RingParticle* particles) const;
+    void WriteVector(const Frame& frame, float rotation, size_t first, size_t last, RingParticle* particles) const;
+
+    PlanetRingSettings settings;
+    float planetRadius = 1.0f;
+    DirectX::XMFLOAT3 axisU, axisN, axisV;     // Ring plane, unit vectors.
+
+    std::vector<size_t> bandFirst;              // bandCount + 1 entries.
+    std::vector<float> bandAngularVelocity;
+    std::vector<float> bandDensity;
+
+    std::vector<float> radius;
+    std::vector<float> phase;                   // In [0, 2 pi), ascending within a band.
+    std::vector<float> height;
+    std::vector<float> size;
+
+    PlanetRingStats stats;
+};
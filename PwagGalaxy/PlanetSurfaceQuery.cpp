@@ -0,0 +1,60 @@
+#include "stdafx.h"
+#include "PlanetSurfaceQuery.h"
+
+
+PlanetSurfaceQuery::PlanetSurfaceQuery(std::shared_ptr<const PlanetTerrain> terrain, std::shared_ptr<const PlanetBake> bake) :
+    terrain(terrain), bake(bake)
+{
+    normalEpsilon = bake != nullptr ? 2.0f / bake->GetResolution() : 2.0f / 256.0f;
+}
+
+float PlanetSurfaceQuery::Height(DirectX::XMFLOAT3 direction) const
+{
+    if (bake == nullptr)
+        return ExactHeight(direction);
+    return bake->SampleHeight(direction);
+}
+
+DirectX::XMFLOAT3 PlanetSurfaceQuery::Normal(DirectX::XMFLOAT3 direction) const
+{
+    if (bake == nullptr)
+        return ExactNormal(direction);
+    return bake->SampleNormal(direction);
+}
+
+float PlanetSurfaceQuery::Altitude(DirectX::XMFLOAT3 localPosition) const
+{
+    DirectX::XMVECTOR position = DirectX::XMLoadFloat3(&localPosition);
+    float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(position));
+    // At the very centre every direction is as good as any other.
+    if (distance == 0.0f)
+        return -Height(DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f));
+    return distance - Height(localPosition);
+}
+
+void PlanetSurfaceQuery::Heights(const DirectX::XMFLOAT3* directions, float* heights, size_t count) const
+{
+    for (size_t i = 0; i < count; i++) {
+        heights[i] = Height(directions[i]);
+    }
+}
+
+void PlanetSurfaceQuery::Normals(const DirectX::XMFLOAT3* directions, DirectX::XMFLOAT3* normals, size_t count) const
+{
+    for (size_t i = 0; i < count; i++) {
+        normals[i] = Normal(directions[i]);
+    }
+}
+
+float PlanetSurfaceQuery::ExactHeight(DirectX::XMFLOAT3 direction) const
+{
+    // The terrain expects a unit direction.
+    DirectX::XMFLOAT3 unitDirection;
+    DirectX::XMStoreFloat3(&unitDirection, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&direction)));
+    return terrain->EvaluateElevation(unitDirection);
+}
+
+DirectX::XMFLOAT3 PlanetSurfaceQuery::ExactNormal(DirectX::XMFLOAT3 direction) const
+{
+    return terrain->EvaluateNormal(direction, normalEpsilon);
+}
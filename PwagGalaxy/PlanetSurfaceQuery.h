@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PlanetTerrain.h"
+#include "PlanetBake.h"
+
+// Height and normal of a body's surface for gameplay code (collision, landing, altitude display).
+// Queries are answered from the cube-map elevation grid baked during generation; bodies without a
+// bake, and callers that ask for it explicitly, fall back to evaluating the noise directly.
+//
+// All methods are const and the shared data is never modified after construction, so any number
+// of threads (physics, AI) can query the same object at the same time without locking.
+class PlanetSurfaceQuery
+{
+public:
+    PlanetSurfaceQuery(std::shared_ptr<const PlanetTerrain> terrain, std::shared_ptr<const PlanetBake> bake);
+
+    // Distance of the surface from the centre along a direction (in body units, 1 = undisplaced radius).
+    float Height(DirectX::XMFLOAT3 direction) const;
+    // Outward surface normal along a direction.
+    DirectX::XMFLOAT3 Normal(DirectX::XMFLOAT3 direction) const;
+    // Distance of a body-space position above the surface (negative when below it).
+    float Altitude(DirectX::XMFLOAT3 localPosition) const;
+
+    // Batched versions, for physics steps that query many points at once.
+    void Heights(const DirectX::XMFLOAT3* directions, float* heights, size_t count) const;
+    void Normals(const DirectX::XMFLOAT3* directions, DirectX::XMFLOAT3* normals, size_t count) const;
+
+    // Direct evaluation of the noise, slow but exact. Erosion only exists in the bake, on an eroded body
+    // these differ from Height() and Normal() by what the erosion carved and deposited.
+    float ExactHeight(DirectX::XMFLOAT3 direction) const;
+    DirectX::XMFLOAT3 ExactNormal(DirectX::XMFLOAT3 direction) const;
+
+    bool IsBaked() const { return bake != nullptr; }
+
+private:
+    std::shared_ptr<const PlanetTerrain> terrain;
+    std::shared_ptr<const PlanetBake> bake;
+    // Finite difference step for the exact normal, about one texel of the default bake.
+    float normalEpsilon;
+};
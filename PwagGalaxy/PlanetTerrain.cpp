@@ -0,0 +1,101 @@
+#include "stdafx.h"
+#include "PlanetTerrain.h"
+
+
+PlanetTerrain::PlanetTerrain(const PlanetConfiguration& planetDescription, int seed) :
+    permutation(seed), layer(planetDescription.layers[0]), craterField(planetDescription.craters, planetDescription.seed)
+{
+    evaluateNoise = SelectNoiseBatchFunction(layer.basis, layer.fractal, layer.precision);
+
+    fractalSettings.frequency = layer.baseRoughness;
+    fractalSettings.lacunarity = layer.roughness;
+    fractalSettings.persistence = layer.persistance;
+    fractalSettings.octaves = layer.steps;
+    fractalSettings.offset = layer.centre;
+}
+
+float PlanetTerrain::EvaluateElevation(DirectX::XMFLOAT3 direction) const
+{
+    float noiseValue;
+    evaluateNoise(permutation, &direction, &noiseValue, 1, fractalSettings);
+
+    float planetRadius = 1.0f;
+    return planetRadius * (1 + ShapeNoise(noiseValue) + craterField.Evaluate(direction));
+}
+
+void PlanetTerrain::EvaluateElevations(const DirectX::XMFLOAT3* directions, float* elevations, size_t count) const
+{
+    // One call for the whole batch, the noise loop has no dispatch inside.
+    evaluateNoise(permutation, directions, elevations, count, fractalSettings);
+
+    float planetRadius = 1.0f;
+    for (size_t i = 0; i < count; i++) {
+        elevations[i] = planetRadius * (1 + ShapeNoise(elevations[i]) + craterField.Evaluate(directions[i]));
+    }
+}
+
+float PlanetTerrain::ShapeNoise(float noiseValue) const
+{
+    noiseValue = (0 > (noiseValue - layer.minValue)) ? 0.0f : noiseValue - layer.minValue;
+    return noiseValue * layer.strength;
+}
+
+DirectX::XMFLOAT3 PlanetTerrain::EvaluateNormal(DirectX::XMFLOAT3 direction, float epsilon) const
+{
+    DirectX::XMVECTOR d = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&direction));
+
+    // Two tangents perpendicular to the direction.
+    DirectX::XMVECTOR helper = std::abs(DirectX::XMVectorGetY(d)) < 0.9f ? DirectX::XMVectorSet(0, 1, 0, 0) : DirectX::XMVectorSet(1, 0, 0, 0);
+    DirectX::XMVECTOR tangent1 = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(d, helper));
+    DirectX::XMVECTOR tangent2 = DirectX::XMVector3Cross(d, tangent1);
+
+    auto surfacePoint = [&](DirectX::XMVECTOR offset) {
+        DirectX::XMVECTOR pointDirection = DirectX::XMVector3Normalize(DirectX::XMVectorAdd(d, offset));
+        DirectX::XMFLOAT3 p;
+        DirectX::XMStoreFloat3(&p, pointDirection);
+        return DirectX::XMVectorScale(pointDirection, EvaluateElevation(p));
+    };
+
+    DirectX::XMVECTOR du = DirectX::XMVectorSubtract(surfacePoint(DirectX::XMVectorScale(tangent1, epsilon)), surfacePoint(DirectX::XMVectorScale(tangent1, -epsilon)));
+    DirectX::XMVECTOR dv = DirectX::XMVectorSubtract(surfacePoint(DirectX::XMVectorScale(tangent2, epsilon)), surfacePoint(DirectX::XMVectorScale(tangent2, -epsilon)));
+    DirectX::XMVECTOR normal = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(du, dv));
+    if (DirectX::XMVectorGetX(DirectX::XMVector3Dot(normal, d)) < 0.0f)
+        normal = DirectX::XMVectorNegate(normal);
+
+    DirectX::XMFLOAT3 result;
+    DirectX::XMStoreFloat3(&result, normal);
+    return result;
+}
+
+DirectX::XMFLOAT4 PlanetTerrain::SampleGradient(const ColorGradient& gradient, float normalizedElevation, DirectX::XMFLOAT4 fallbackColor)
+{
+    for (int idx = 0; idx < gradient.size(); idx++) {
+        const std::pair<float, DirectX::XMFLOAT4>& color = gradient[idx];
+        const std::pair<float, DirectX::XMFLOAT4>& nextColor = (idx < gradient.size() - 1) ? gradient[idx + 1] : color;
+
+        if (color.first > normalizedElevation) {
+
+            float distRange = nextColor.first - color.first;
+            if (distRange > 0.0f) {
+                float dist = normalizedElevation - color.first;
+                float percentage = dist / distRange;
+                return DirectX::XMFLOAT4(
+                    color.second.x * (1.0f - percentage) + nextColor.second.x * percentage,
+                    color.second.y * (1.0f - percentage) + nextColor.second.y * percentage,
+                    color.second.z * (1.0f - percentage) + nextColor.second.z * percentage,
+                    1.0f
+                );
+            }
+            return color.second;
+        }
+    }
+    return fallbackColor;
+}
+
+float PlanetTerrain::NormalizeElevation(float elevation, float minElevation, float maxElevation)
+{
+    float elevationRange = maxElevation - minElevation;
+    if (!(elevationRange > 1e-6f))
+        return 0.5f;
+    return (elevation - minElevation) / elevationRange;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "NoiseLibrary.h"
+#include "ConfigurationGenerator.h"
+#include "CraterField.h"
+
+// Colour stops (normalized elevation, colour) used to tint the surface of a body.
+typedef std::vector<std::pair<float, DirectX::XMFLOAT4>> ColorGradient;
+
+// Evaluates the surface of a generated body from its configuration. Mesh generation and terrain
+// baking both go through this class, so every representation of a body has the same surface.
+class PlanetTerrain
+{
+public:
+    PlanetTerrain(const PlanetConfiguration& planetDescription, int seed);
+
+    // Elevation of the surface above the given unit direction, in planet radii (1 = undisplaced sphere).
+    float EvaluateElevation(DirectX::XMFLOAT3 direction) const;
+    void EvaluateElevations(const DirectX::XMFLOAT3* directions, float* elevations, size_t count) const;
+    // Surface normal from central differences of the elevation, epsilon is the angular step in radians.
+    DirectX::XMFLOAT3 EvaluateNormal(DirectX::XMFLOAT3 direction, float epsilon) const;
+
+    // Colour of the gradient at a normalized elevation (0 = lowest point of the body, 1 = highest).
+    // Elevations past the last stop keep the fallback colour.
+    static DirectX::XMFLOAT4 SampleGradient(const ColorGradient& gradient, float normalizedElevation, DirectX::XMFLOAT4 fallbackColor);
+    // Elevation between the lowest and the highest point of a body mapped to [0, 1]. A body without relief
+    // has no range to normalise by, all of it takes the middle of the gradient.
+    static float NormalizeElevation(float elevation, float minElevation, float maxElevation);
+
+private:
+    // Minimum value and strength applied to the raw fractal noise.
+    float ShapeNoise(float noiseValue) const;
+
+    NoisePermutation permutation;
+    // The specialisation selected by the layer configuration, resolved once here.
+    NoiseBatchFunction evaluateNoise;
+    FractalSettings fractalSettings;
+    PlanetSurfaceConfiguration layer;
+    // Added on top of the noise layers.
+    CraterField craterField;
+};
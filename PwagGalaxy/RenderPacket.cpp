@@ -0,0 +1,80 @@
+#include "stdafx.h"
+#include "RenderPacket.h"
+
+RenderArena::RenderArena(size_t blockSize)
+{
+    Block block;
+    block.memory.reset(new uint8_t[blockSize]);
+    block.size = blockSize;
+    blocks.push_back(std::move(block));
+}
+
+void* RenderArena::AllocateBytes(size_t size, size_t alignment)
+{
+    Block* block = &blocks.back();
+    size_t padding = (alignment - reinterpret_cast<uintptr_t>(block->memory.get() + blockOffset) % alignment) % alignment;
+    if (blockOffset + padding + size > block->size) {
+        // Chained until the next Reset(), the allocations made so far stay where they are.
+        Block next;
+        next.size = std::max(block->size, size + alignment);
+        next.memory.reset(new uint8_t[next.size]);
+        blocks.push_back(std::move(next));
+        block = &blocks.back();
+        blockOffset = 0;
+        padding = (alignment - reinterpret_cast<uintptr_t>(block->memory.get()) % alignment) % alignment;
+    }
+
+    void* allocation = block->memory.get() + blockOffset + padding;
+    blockOffset += padding + size;
+    usedBytes += padding + size;
+    return allocation;
+}
+
+void RenderArena::Reset()
+{
+    if (blocks.size() > 1) {
+        size_t size = GetCapacity();
+        blocks.clear();
+        Block block;
+        block.memory.reset(new uint8_t[size]);
+        block.size = size;
+        blocks.push_back(std::move(block));
+    }
+    blockOffset = 0;
+    usedBytes = 0;
+}
+
+size_t RenderArena::GetCapacity() const
+{
+    size_t capacity = 0;
+    for (const Block& block : blocks)
+        capacity += block.size;
+    return capacity;
+}
+
+void RenderPacket::Reset(size_t drawCapacity)
+{
+    arena.Reset();
+    draws = arena.Allocate<RenderDraw>(drawCapacity);
+    drawCount = 0;
+    this->drawCapacity = drawCapacity;
+    tileCopies = nullptr;
+    tileCopyCount = 0;
+}
+
+RenderDraw& RenderPacket::AddDraw(RenderMaterial material, Mesh* mesh, uint32_t slot)
+{
+    if (drawCount == drawCapacity)
+        throw "Render packet full!";
+
+    RenderDraw& draw = draws[drawCount++];
+    draw.mesh = mesh;
+    draw.material = material;
+    draw.slot = slot;
+    draw.instanceCount = 0;
+    draw.firstInstance = 0;
+    draw.texture = RenderDraw::NoTexture;
+    draw.constants = nullptr;
+    draw.constantCount = 0;
+    return draw;
+}
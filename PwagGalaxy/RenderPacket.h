@@ -0,0 +1,107 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+class Mesh;
+
+// Bump allocator of the render packet of one frame. Allocations stay valid until Reset(), which keeps the
+// memory for the next frame. A frame that outgrows the block chains another one; the next Reset() replaces
+// them by one block large enough for both, so once the scene settled a frame allocates nothing.
+class RenderArena
+{
+public:
+    explicit RenderArena(size_t blockSize = 64 * 1024);
+    RenderArena(const RenderArena& other) = delete;
+    void operator=(const RenderArena&) = delete;
+
+    // Uninitialised room for count values. Nothing is destroyed on Reset(), only plain data belongs here.
+    template<typename T>
+    T* Allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "The arena never runs destructors!");
+        return static_cast<T*>(AllocateBytes(sizeof(T) * count, alignof(T)));
+    }
+
+    void Reset();
+
+    size_t GetUsedBytes() const { return usedBytes; }
+    size_t GetCapacity() const;
+
+private:
+    void* AllocateBytes(size_t size, size_t alignment);
+
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size;
+    };
+    std::vector<Block> blocks;
+    size_t blockOffset = 0;             // In the last block.
+    size_t usedBytes = 0;               // Of every block, alignment included.
+};
+
+// Pipeline state and root signature of a draw, together with the bindings shared by every draw using it.
+enum class RenderMaterial : uint8_t
+{
+    Lit,
+    Wireframe,
+    BakedPlanet,
+    Sun,
+    Instanced,
+    RingBillboard,
+    RingParticles
+};
+
+// One draw of a frame, everything else it needs is owned by the engine and does not change after loading.
+struct RenderDraw
+{
+    static const uint32_t NoTexture = UINT32_MAX;
+
+    Mesh* mesh;
+    RenderMaterial material;
+    uint32_t slot;                      // WVP matrices in the constant buffer of the frame.
+    uint32_t instanceCount;             // Instanced draws only, their transforms are in the instance buffer of the frame.
+    uint32_t firstInstance;
+    uint32_t texture;                   // Offset in the shader access heap of a texture of this draw only.
+    const uint32_t* constants;          // Root constants in the arena, nullptr if the draw has none.
+    uint32_t constantCount;
+};
+
+// Region of a texture written from the upload buffer of the frame, one footprint per copy in order.
+struct RenderTileCopy
+{
+    uint32_t subresource;
+    uint32_t x;
+    uint32_t y;
+};
+
+// What the render thread needs to record a frame, built by the game thread. The transforms of the draws
+// are in the constant and instance buffers of the frame slot (written while the entities were updated),
+// the packet refers to them by slot; every other array lives in the arena.
+struct RenderPacket
+{
+    RenderArena arena;
+    uint64_t frame = 0;
+    uint32_t frameSlot = 0;             // Constant buffers, upload buffers and command allocator of the frame.
+    uint64_t fenceValue = 0;            // Signalled on the fence of the slot once the GPU is done with the frame.
+
+    RenderDraw* draws = nullptr;
+    size_t drawCount = 0;
+    size_t drawCapacity = 0;
+    RenderTileCopy* tileCopies = nullptr;
+    size_t tileCopyCount = 0;
+
+    // Empties the arena and makes room for up to drawCapacity draws.
+    void Reset(size_t drawCapacity);
+    RenderDraw& AddDraw(RenderMaterial material, Mesh* mesh, uint32_t slot);
+    // The root constants of a draw, copied into the arena.
+    template<typename T>
+    void SetConstants(RenderDraw& draw, const T& values)
+    {
+        static_assert(sizeof(T) % 4 == 0, "Root constants are 32-bit values!");
+        draw.constants = static_cast<const uint32_t*>(memcpy(arena.Allocate<uint32_t>(sizeof(T) / 4), &values, sizeof(T)));
+        draw.constantCount = sizeof(T) / 4;
+    }
+};
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "RenderThread.h"
+
+RenderThread::~RenderThread()
+{
+    Stop();
+}
+
+void RenderThread::Start(const RenderFunction& render)
+{
+    if (IsRunning())
+        throw "Render thread already running!";
+
+    this->render = render;
+    submitted = 0;
+    rendered = 0;
+    acquired = false;
+    failure = nullptr;
+    stats = RenderThreadStats();
+    renderMsSum = 0.0;
+    waitMsSum = 0.0;
+    packetKBSum = 0.0;
+
+    running = true;
+    thread = std::thread(&RenderThread::Run, this);
+}
+
+void RenderThread::Stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    changed.notify_all();
+    if (thread.joinable())
+        thread.join();
+}
+
+RenderPacket& RenderThread::Acquire()
+{
+    RenderPacket* packet = nullptr;
+    while (packet == nullptr)
+        packet = TryAcquire(std::chrono::milliseconds(1000));
+    return *packet;
+}
+
+RenderPacket* RenderThread::TryAcquire(std::chrono::milliseconds timeout)
+{
+    if (acquired)
+        throw "Render packet acquired twice!";
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    bool free = changed.wait_for(lock, timeout, [this] { return submitted - rendered < PacketCount || failure; });
+    if (failure)
+        std::rethrow_exception(failure);
+    waitMsSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (!free)
+        return nullptr;
+
+    acquired = true;
+    RenderPacket& packet = packets[submitted % PacketCount];
+    packet.frame = submitted;
+    return &packet;
+}
+
+bool RenderThread::HasFailed()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return failure != nullptr;
+}
+
+void RenderThread::Submit()
+{
+    if (!acquired)
+        throw "No render packet acquired!";
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        acquired = false;
+        submitted++;
+    }
+    changed.notify_all();
+}
+
+void RenderThread::Run()
+{
+    while (true) {
+        RenderPacket* packet;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [this] { return rendered < submitted || !running; });
+            if (rendered == submitted)
+                return;
+            packet = &packets[rendered % PacketCount];
+        }
+
+        // The game thread only touches the other packet meanwhile.
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        try {
+            render(*packet);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            failure = std::current_exception();
+            changed.notify_all();
+            return;
+        }
+        double renderMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            rendered++;
+            stats.frames++;
+            renderMsSum += renderMs;
+            stats.maxRenderMs = std::max(stats.maxRenderMs, renderMs);
+            packetKBSum += packet->arena.GetUsedBytes() / 1024.0;
+        }
+        changed.notify_all();
+    }
+}
+
+RenderThreadStats RenderThread::TakeStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    RenderThreadStats taken = stats;
+    if (stats.frames > 0) {
+        taken.meanRenderMs = renderMsSum / stats.frames;
+        taken.meanWaitMs = waitMsSum / stats.frames;
+        taken.meanPacketKB = packetKBSum / stats.frames;
+    }
+    stats = RenderThreadStats();
+    renderMsSum = 0.0;
+    waitMsSum = 0.0;
+    packetKBSum = 0.0;
+    return taken;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "RenderPacket.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+struct RenderThreadStats
+{
+    size_t frames = 0;
+    double meanRenderMs = 0.0;          // Render thread: recording, submitting and presenting a packet.
+    double maxRenderMs = 0.0;
+    double meanWaitMs = 0.0;            // Game thread: waiting in Acquire() for the render thread to free a packet.
+    double meanPacketKB = 0.0;          // Arena memory used by a packet.
+};
+
+// Records and presents the frames on a thread of its own. The game thread fills one of two packets while
+// the render thread consumes the other, so frame N is recorded while frame N + 1 is updated. Acquire()
+// waits until the render thread is done with the packet of two frames ago, the game thread is never more
+// than one frame ahead.
+class RenderThread
+{
+public:
+    typedef std::function<void(const RenderPacket& packet)> RenderFunction;
+
+    static const int PacketCount = 2;
+
+    RenderThread() = default;
+    ~RenderThread();
+    RenderThread(const RenderThread& other) = delete;
+    void operator=(const RenderThread&) = delete;
+
+    void Start(const RenderFunction& render);
+    // Renders the packets submitted so far, then joins the thread.
+    void Stop();
+    bool IsRunning() const { return thread.joinable(); }
+    // The render function threw, the packets submitted since were not rendered.
+    bool HasFailed();
+
+    // Game thread: the packet of the next frame. Throws what the render function threw on an earlier frame.
+    RenderPacket& Acquire();
+    // The same, but gives up after timeout and returns nullptr. A window thread uses it to keep pumping
+    // its messages, Present() on the render thread can wait for them.
+    RenderPacket* TryAcquire(std::chrono::milliseconds timeout);
+    // Hands the acquired packet over to the render thread.
+    void Submit();
+
+    // Statistics since the last call.
+    RenderThreadStats TakeStats();
+
+private:
+    void Run();
+
+    std::thread thread;
+    RenderFunction render;
+
+    std::mutex mutex;
+    std::condition_variable changed;
+    RenderPacket packets[PacketCount];
+    uint64_t submitted = 0;             // Packets handed over, packet i is packets[i % PacketCount].
+    uint64_t rendered = 0;
+    bool acquired = false;
+    bool running = false;
+    std::exception_ptr failure;
+
+    // Statistics, under the mutex.
+    RenderThreadStats stats;
+    double renderMsSum = 0.0;
+    double waitMsSum = 0.0;
+    double packetKBSum = 0.0;
+};
@@ -8,4 +8,8 @@ such as material and texture classes. */
 #include "DefaultTexturedMaterial.h"
 #include "WireframeMaterial.h"
 #include "NormalsDebugMaterial.h"
-#include "LitMaterial.h"
\ No newline at end of file
+#include "LitMaterial.h"
+#include "BakedPlanetMaterial.h"
+#include "SunMaterial.h"
+#include "InstancedMaterial.h"
+#include "RingMaterial.h"
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "stdafx.h"
+#include "RingMaterial.h"
+
+std::vector<D3D12_ROOT_PARAMETER> RingMaterial::CreateRootParameters()
+{
+    // Create the root descriptor (for wvp matrices)
+    D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
+    rootCBVDescriptor.ShaderRegister = 0; // b0 in shader
+    rootCBVDescriptor.RegisterSpace = 0;
+
+    // The particles near the camera.
+    D3D12_ROOT_DESCRIPTOR particleSRVDescriptor;
+    particleSRVDescriptor.ShaderRegister = 0; // t0 in shader
+    particleSRVDescriptor.RegisterSpace = 0;
+
+    rootParameters.resize(3);
+    // WVP matrix.
+    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    rootParameters[0].Descriptor = rootCBVDescriptor;
+    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    // Colour and fade distances, different for every ring so they are passed as root constants.
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParameters[1].Constants.ShaderRegister = 1; // b1 in shader
+    rootParameters[1].Constants.RegisterSpace = 0;
+    rootParameters[1].Constants.Num32BitValues = sizeof(RingConstants) / 4;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    // Particle positions and sizes.
+    rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_SRV;
+    rootParameters[2].Descriptor = particleSRVDescriptor;
+    rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    return rootParameters;
+}
+
+D3D12_ROOT_SIGNATURE_FLAGS RingMaterial::CreateRootSignatureFlags()
+{
+    D3D12_ROOT_SIGNATURE_FLAGS flags = (
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
+
+    return flags;
+}
+
+void RingMaterial::CustomizePipelineStateObjectDescription(D3D12_GRAPHICS_PIPELINE_STATE_DESC& psoDesc)
+{
+    // Thin and see-through: seen from both sides, blended over what is behind and tested against the
+    // depth of the opaque bodies without writing it.
+    psoDesc.RasterizerState.CullMode = D3D12_CULL_MODE_NONE;
+    psoDesc.DepthStencilState.DepthWriteMask = D3D12_DEPTH_WRITE_MASK_ZERO;
+    D3D12_RENDER_TARGET_BLEND_DESC& blend = psoDesc.BlendState.RenderTarget[0];
+    blend.BlendEnable = TRUE;
+    blend.SrcBlend = D3D12_BLEND_SRC_ALPHA;
+    blend.DestBlend = D3D12_BLEND_INV_SRC_ALPHA;
+    blend.BlendOp = D3D12_BLEND_OP_ADD;
+    blend.SrcBlendAlpha = D3D12_BLEND_ONE;
+    blend.DestBlendAlpha = D3D12_BLEND_INV_SRC_ALPHA;
+    blend.BlendOpAlpha = D3D12_BLEND_OP_ADD;
+}
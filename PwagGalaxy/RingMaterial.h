@@ -0,0 +1,28 @@
+#pragma once
+#include "Material.h"
+
+// Unlit, alpha blended material of planet rings (see PlanetRing). The same root signature serves the
+// annulus drawn from afar and the particle quads drawn near the camera, which read their positions from
+// a structured buffer (t0, a root SRV) indexed with SV_InstanceID. The two cross-fade around the near
+// distance passed in the root constants.
+class RingMaterial : public Material
+{
+public:
+    RingMaterial() = default;
+
+    // Root constants of both shaders (b1).
+    struct RingConstants
+    {
+        DirectX::XMFLOAT4 color;
+        float nearDistance;     // World units, the particles fade out and the annulus fades in towards it.
+        float fadeWidth;
+        float padding[2];
+    };
+
+private:
+    std::vector<D3D12_ROOT_PARAMETER> rootParameters;
+
+    virtual std::vector<D3D12_ROOT_PARAMETER> CreateRootParameters();
+    virtual D3D12_ROOT_SIGNATURE_FLAGS CreateRootSignatureFlags();
+    virtual void CustomizePipelineStateObjectDescription(D3D12_GRAPHICS_PIPELINE_STATE_DESC& psoDesc);
+};
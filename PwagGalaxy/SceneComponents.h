@@ -0,0 +1,111 @@
+#pragma once
+
+#include "EntityWorld.h"
+
+// Components of the scene entities (see EntityWorld). They are plain data and small; meshes, bakes and
+// the planet configurations stay in VoyagerEngine::engineObjects and are referenced by index.
+
+// Placement of an entity: scaled, turned by rotation, moved to position and then turned around the
+// origin by orbit. Rotations are quaternions.
+struct TransformComponent
+{
+    DirectX::XMFLOAT4 rotation;
+    DirectX::XMFLOAT4 orbit;
+    DirectX::XMFLOAT3 position;
+    float scale;
+};
+
+// World matrix built from the TransformComponent, written by the transform system.
+struct WorldMatrixComponent
+{
+    DirectX::XMFLOAT4X4 world;
+};
+
+// Kepler orbit of an entity around a focus (see KeplerOrbit). Position and orbit of the TransformComponent
+// are a closed form of the simulation time, so any time costs the same, however far it is from the last one.
+struct OrbitComponent
+{
+    DirectX::XMFLOAT3 axis;         // Unit normal of the orbit plane.
+    float semiMajorAxis;
+    DirectX::XMFLOAT3 periapsis;    // Unit direction of the closest point, perpendicular to the axis.
+    float eccentricity;
+    DirectX::XMFLOAT3 focus;        // Added before the orbit turn, exact for a focus on the axis.
+    float meanMotion;               // Radians per second of simulation time, 0 for a body that stands still.
+    float meanAnomalyAtEpoch;       // At simulation time 0.
+    double evaluatedTime;           // Simulation time the TransformComponent was last written for.
+};
+
+// Drawn with the mesh of an engine object and the WVP constant buffer slot of that object.
+struct RenderableComponent
+{
+    uint32_t object;                // Index into engineObjects, also the constant buffer slot.
+    uint32_t drawBaked;             // Set every frame: far enough away for the baked representation.
+    uint32_t culled;                // Outside of the view: not drawn, its slot is not written.
+};
+
+// A generated body with its configuration at the same index of engineObjects.
+struct PlanetComponent
+{
+    float radius;
+    uint32_t hasBake;
+};
+
+// Bounding sphere around the position of the world matrix: the radius of the body times its largest
+// elevation. Entities with one are culled against the view (see SceneSystems::CullEntities()).
+struct BoundsComponent
+{
+    float radius;
+};
+
+// Kept in front of the camera (the ship), turning with it.
+struct CameraAttachmentComponent
+{
+    float forward;
+    float down;
+};
+
+// Placed relative to a parent (moons around their planet, planets around their star): node in the
+// TransformHierarchy of the scene. The TransformComponent is the local placement, the world matrix is
+// written by SceneSystems::PropagateHierarchy().
+struct HierarchyComponent
+{
+    uint32_t node;
+};
+
+// Change tracking of a transform, so unchanged entities skip the work of SceneSystems::WriteTransforms().
+// The systems that write the TransformComponent bump transform; world is the version the world matrix
+// was built from and uploaded the version in the constant buffer of every frame slot.
+struct TransformVersionComponent
+{
+    static const int FrameSlots = 3;    // VoyagerEngine::mc_frameBufferCount.
+
+    uint32_t transform;
+    uint32_t world;
+    uint32_t uploaded[FrameSlots];
+};
+
+// A new entity: world matrix built, not uploaded to any frame slot yet.
+inline TransformVersionComponent CreateTransformVersion()
+{
+    TransformVersionComponent version = { 1, 1, { 0, 0, 0 } };
+    return version;
+}
+
+// World matrix of a transform: scale, rotation, translation and then the orbit.
+inline DirectX::XMMATRIX ComposeWorldMatrix(const TransformComponent& transform)
+{
+    return DirectX::XMMatrixScaling(transform.scale, transform.scale, transform.scale) *
+        DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&transform.rotation)) *
+        DirectX::XMMatrixTranslation(transform.position.x, transform.position.y, transform.position.z) *
+        DirectX::XMMatrixRotationQuaternion(DirectX::XMLoadFloat4(&transform.orbit));
+}
+
+template<> struct ComponentId<TransformComponent> { static const int Value = 0; };
+template<> struct ComponentId<WorldMatrixComponent> { static const int Value = 1; };
+template<> struct ComponentId<OrbitComponent> { static const int Value = 2; };
+template<> struct ComponentId<RenderableComponent> { static const int Value = 3; };
+template<> struct ComponentId<PlanetComponent> { static const int Value = 4; };
+template<> struct ComponentId<CameraAttachmentComponent> { static const int Value = 5; };
+template<> struct ComponentId<TransformVersionComponent> { static const int Value = 6; };
+template<> struct ComponentId<HierarchyComponent> { static const int Value = 7; };
+template<> struct ComponentId<BoundsComponent> { static const int Value = 8; };
@@ -0,0 +1,267 @@
+#include "stdafx.h"
+#include "SceneSystems.h"
+
+namespace
+{
+    enum class TransformWork
+    {
+        Skip,
+        Project,
+        Compute,
+        World
+    };
+
+    // Without composing, world matrices made elsewhere (by the hierarchy) are only projected.
+    TransformWork WorkOf(const TransformVersionComponent& version, const RenderableComponent& renderable, const SceneFrame& frame, bool composes)
+    {
+        // Culled entities keep their world matrix current for the bounds and the children, their slot is
+        // written once they are in view again (see CullEntities()).
+        if (renderable.culled)
+            return composes && version.world != version.transform ? TransformWork::World : TransformWork::Skip;
+        if (version.world != version.transform)
+            return composes ? TransformWork::Compute : TransformWork::Project;
+        if (frame.cameraChanged || version.uploaded[frame.frameSlot] != version.transform)
+            return TransformWork::Project;
+        return TransformWork::Skip;
+    }
+
+    // The work of WriteTransforms() on one chunk, counted by TransformWork. Transforms is nullptr for the
+    // chunks whose world matrices come from the hierarchy.
+    void WriteChunk(size_t count, const TransformComponent* transforms, WorldMatrixComponent* worlds, const RenderableComponent* renderables,
+        TransformVersionComponent* versions, const SceneFrame& frame, size_t* counts)
+    {
+        bool composes = transforms != nullptr;
+        // With a new camera every slot is written anyway. A chunk with any moved entity is composed as one
+        // batch then, short runs alternating between composing and projecting are slower than that.
+        bool composeChunk = false;
+        if (composes && frame.cameraChanged) {
+            for (size_t i = 0; i < count && !composeChunk; i++)
+                composeChunk = versions[i].world != versions[i].transform;
+        }
+        // Otherwise runs of neighbours with the same work stay batches.
+        for (size_t first = 0; first < count;) {
+            TransformWork work = composeChunk ? TransformWork::Compute : WorkOf(versions[first], renderables[first], frame, composes);
+            size_t end = composeChunk ? count : first + 1;
+            while (end < count && WorkOf(versions[end], renderables[end], frame, composes) == work)
+                end++;
+
+            if (work == TransformWork::Compute)
+                TransformBatch::Compute(frame.path, end - first, transforms + first, renderables + first, worlds + first, frame.matrices, frame.constantBuffer, frame.slotStride);
+            else if (work == TransformWork::Project)
+                TransformBatch::Project(frame.path, end - first, worlds + first, renderables + first, frame.matrices, frame.constantBuffer, frame.slotStride);
+            else if (work == TransformWork::World)
+                TransformBatch::Compose(frame.path, end - first, transforms + first, worlds + first);
+            bool uploaded = work == TransformWork::Compute || work == TransformWork::Project;
+            for (size_t i = first; i < end; i++) {
+                versions[i].world = versions[i].transform;
+                if (uploaded)
+                    versions[i].uploaded[frame.frameSlot] = versions[i].transform;
+                // A culled slot keeps the old camera, any other version has it written once in view.
+                else if (frame.cameraChanged)
+                    versions[i].uploaded[frame.frameSlot] = versions[i].transform - 1;
+            }
+            counts[static_cast<int>(work)] += end - first;
+            first = end;
+        }
+    }
+}
+
+SceneUpdateStats SceneSystems::Update(EntityWorld& world, const SceneFrame& frame)
+{
+    AdvanceOrbits(world, frame);
+    FollowCamera(world, frame);
+    PropagateHierarchy(world, frame);
+    SceneUpdateStats stats = WriteTransforms(world, frame);
+    SelectLevelOfDetail(world, frame);
+    UpdateBounds(world, frame);
+    stats.culled = CullEntities(world, frame);
+    stats.visible = frame.bounds != nullptr ? frame.bounds->visible.size() : 0;
+    return stats;
+}
+
+void SceneSystems::AdvanceOrbits(EntityWorld& world, const SceneFrame& frame)
+{
+    world.ParallelForEachChunk<TransformComponent, OrbitComponent, RenderableComponent, TransformVersionComponent>([&](size_t count,
+        TransformComponent* transforms, OrbitComponent* orbits, const RenderableComponent* renderables, TransformVersionComponent* versions) {
+        for (size_t i = 0; i < count; i++) {
+            // Bodies that stand still (the star) keep their version, as does everything while time is paused.
+            if (orbits[i].evaluatedTime == frame.simulationTime || (orbits[i].meanMotion == 0.0f && orbits[i].evaluatedTime >= 0.0))
+                continue;
+            KeplerOrbit::Evaluate(orbits[i], frame.simulationTime, transforms[i]);
+            versions[i].transform++;
+        }
+    });
+}
+
+void SceneSystems::FollowCamera(EntityWorld& world, const SceneFrame& frame)
+{
+    // Only the ship, not worth the thread pool.
+    DirectX::XMVECTOR cameraPosition = DirectX::XMLoadFloat3(&frame.cameraPosition);
+    DirectX::XMVECTOR cameraFront = DirectX::XMLoadFloat3(&frame.cameraFront);
+    DirectX::XMVECTOR cameraUp = DirectX::XMLoadFloat3(&frame.cameraUp);
+    DirectX::XMVECTOR cameraTurn = DirectX::XMLoadFloat4(&frame.cameraTurn);
+    world.ForEachChunk<TransformComponent, CameraAttachmentComponent, TransformVersionComponent>([&](size_t count, TransformComponent* transforms, const CameraAttachmentComponent* attachments, TransformVersionComponent* versions) {
+        for (size_t i = 0; i < count; i++) {
+            DirectX::XMVECTOR position = DirectX::XMVectorAdd(cameraPosition, DirectX::XMVectorScale(cameraFront, attachments[i].forward));
+            position = DirectX::XMVectorAdd(position, DirectX::XMVectorScale(cameraUp, -attachments[i].down));
+            TransformComponent moved = transforms[i];
+            DirectX::XMStoreFloat3(&moved.position, position);
+            // Renormalising would change the last bits even when the camera did not turn.
+            if (frame.cameraTurn.w != 1.0f) {
+                DirectX::XMVECTOR rotation = DirectX::XMQuaternionMultiply(DirectX::XMLoadFloat4(&transforms[i].rotation), cameraTurn);
+                DirectX::XMStoreFloat4(&moved.rotation, DirectX::XMQuaternionNormalize(rotation));
+            }
+            if (memcmp(&moved, &transforms[i], sizeof(moved)) != 0) {
+                transforms[i] = moved;
+                versions[i].transform++;
+            }
+        }
+    });
+}
+
+void SceneSystems::PropagateHierarchy(EntityWorld& world, const SceneFrame& frame)
+{
+    if (frame.hierarchy == nullptr)
+        return;
+
+    // A handful of bodies, one linear pass over the hierarchy is cheaper than jobs.
+    TransformHierarchy& hierarchy = *frame.hierarchy;
+    world.ForEachChunk<TransformComponent, HierarchyComponent, TransformVersionComponent>([&](size_t count, const TransformComponent* transforms, const HierarchyComponent* nodes, const TransformVersionComponent* versions) {
+        for (size_t i = 0; i < count; i++) {
+            if (versions[i].world == versions[i].transform)
+                continue;
+            DirectX::XMFLOAT4X4 local;
+            DirectX::XMStoreFloat4x4(&local, ComposeWorldMatrix(transforms[i]));
+            hierarchy.SetLocal(nodes[i].node, local);
+        }
+    });
+    hierarchy.Propagate();
+
+    // Children of a moved parent moved too. Either way the world matrix is done, so WriteTransforms()
+    // only projects it.
+    world.ForEachChunk<WorldMatrixComponent, HierarchyComponent, TransformVersionComponent>([&](size_t count, WorldMatrixComponent* worlds, const HierarchyComponent* nodes, TransformVersionComponent* versions) {
+        for (size_t i = 0; i < count; i++) {
+            if (!hierarchy.WasUpdated(nodes[i].node))
+                continue;
+            worlds[i].world = hierarchy.GetWorld(nodes[i].node);
+            if (versions[i].world == versions[i].transform)
+                versions[i].transform++;
+            versions[i].world = versions[i].transform;
+        }
+    });
+}
+
+SceneUpdateStats SceneSystems::WriteTransforms(EntityWorld& world, const SceneFrame& frame)
+{
+    if (frame.frameSlot >= TransformVersionComponent::FrameSlots)
+        throw "Frame slot out of range!";
+
+    std::atomic<size_t> recomputed{ 0 }, projected{ 0 }, deferred{ 0 }, skipped{ 0 };
+    auto addCounts = [&](const size_t* counts) {
+        skipped += counts[static_cast<int>(TransformWork::Skip)];
+        projected += counts[static_cast<int>(TransformWork::Project)];
+        recomputed += counts[static_cast<int>(TransformWork::Compute)];
+        deferred += counts[static_cast<int>(TransformWork::World)];
+    };
+    // Entities in the hierarchy got their world matrices from PropagateHierarchy(). Composing their
+    // transforms would drop the parent of a child, so their chunks are left out here, whatever they hold.
+    world.ParallelForEachChunkWithout<HierarchyComponent, TransformComponent, WorldMatrixComponent, RenderableComponent, TransformVersionComponent>([&](size_t count,
+        const TransformComponent* transforms, WorldMatrixComponent* worlds, const RenderableComponent* renderables, TransformVersionComponent* versions) {
+        size_t counts[4] = { 0, 0, 0, 0 };
+        WriteChunk(count, transforms, worlds, renderables, versions, frame, counts);
+        addCounts(counts);
+    });
+    // A handful of bodies, their world matrices are only projected.
+    world.ForEachChunk<WorldMatrixComponent, RenderableComponent, HierarchyComponent, TransformVersionComponent>([&](size_t count,
+        WorldMatrixComponent* worlds, const RenderableComponent* renderables, const HierarchyComponent*, TransformVersionComponent* versions) {
+        size_t counts[4] = { 0, 0, 0, 0 };
+        WriteChunk(count, nullptr, worlds, renderables, versions, frame, counts);
+        addCounts(counts);
+    });
+
+    SceneUpdateStats stats;
+    stats.recomputed = recomputed;
+    stats.projected = projected;
+    stats.deferred = deferred;
+    stats.skipped = skipped;
+    return stats;
+}
+
+void SceneSystems::SelectLevelOfDetail(EntityWorld& world, const SceneFrame& frame)
+{
+    DirectX::XMVECTOR cameraPosition = DirectX::XMLoadFloat3(&frame.cameraPosition);
+    world.ParallelForEachChunk<WorldMatrixComponent, RenderableComponent, PlanetComponent>([&](size_t count, const WorldMatrixComponent* worlds, RenderableComponent* renderables, const PlanetComponent* planets) {
+        for (size_t i = 0; i < count; i++) {
+            DirectX::XMVECTOR objectPosition = DirectX::XMVectorSet(worlds[i].world._41, worlds[i].world._42, worlds[i].world._43, 1.0f);
+            float distance = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(objectPosition, cameraPosition)));
+            renderables[i].drawBaked = planets[i].hasBake && distance > frame.fullDetailDistance * planets[i].radius ? 1 : 0;
+        }
+    });
+}
+
+void SceneSystems::UpdateBounds(EntityWorld& world, const SceneFrame& frame)
+{
+    if (frame.bounds == nullptr)
+        return;
+
+    // In chunk order, the same items every frame while no entity is created or destroyed.
+    SceneBounds& bounds = *frame.bounds;
+    bounds.spheres.clear();
+    bounds.objects.clear();
+    bounds.culler.Clear();
+    world.ForEachChunk<WorldMatrixComponent, RenderableComponent, BoundsComponent>([&](size_t count, const WorldMatrixComponent* worlds, const RenderableComponent* renderables, const BoundsComponent* spheres) {
+        for (size_t i = 0; i < count; i++) {
+            BoundingSphere sphere = { DirectX::XMFLOAT3(worlds[i].world._41, worlds[i].world._42, worlds[i].world._43), spheres[i].radius };
+            bounds.spheres.push_back(sphere);
+            bounds.objects.push_back(renderables[i].object);
+            bounds.culler.AddSphere(sphere);
+        }
+    });
+    bounds.tree.Update(bounds.spheres.data(), bounds.spheres.size());
+}
+
+size_t SceneSystems::CullEntities(EntityWorld& world, const SceneFrame& frame)
+{
+    if (frame.bounds == nullptr)
+        return 0;
+
+    // The planes of the camera of this frame, the spheres eight at a time.
+    SceneBounds& bounds = *frame.bounds;
+    bounds.culler.Cull(Frustum::FromViewProjection(DirectX::XMLoadFloat4x4(&frame.matrices.viewProjection)), bounds.found);
+    bounds.insideByObject.assign(bounds.insideByObject.size(), 0);
+    for (uint32_t item : bounds.found) {
+        uint32_t object = bounds.objects[item];
+        if (object >= bounds.insideByObject.size())
+            bounds.insideByObject.resize(object + 1, 0);
+        bounds.insideByObject[object] = 1;
+    }
+
+    // WriteTransforms() ran with the culling of the last frame and left the slots of culled entities as they
+    // were. The ones that came into view are projected here, before they are drawn.
+    size_t culled = 0;
+    world.ForEachChunk<WorldMatrixComponent, RenderableComponent, BoundsComponent, TransformVersionComponent>([&](size_t count,
+        const WorldMatrixComponent* worlds, RenderableComponent* renderables, const BoundsComponent*, TransformVersionComponent* versions) {
+        for (size_t i = 0; i < count; i++) {
+            uint32_t object = renderables[i].object;
+            uint32_t wasCulled = renderables[i].culled;
+            renderables[i].culled = object < bounds.insideByObject.size() && bounds.insideByObject[object] ? 0 : 1;
+            culled += renderables[i].culled;
+            if (wasCulled && !renderables[i].culled && versions[i].uploaded[frame.frameSlot] != versions[i].transform) {
+                TransformBatch::Project(frame.path, 1, worlds + i, renderables + i, frame.matrices, frame.constantBuffer, frame.slotStride);
+                versions[i].uploaded[frame.frameSlot] = versions[i].transform;
+            }
+        }
+    });
+
+    // Entities without bounds are never culled.
+    bounds.visible.clear();
+    world.ForEachChunk<RenderableComponent>([&](size_t count, const RenderableComponent* renderables) {
+        for (size_t i = 0; i < count; i++) {
+            if (renderables[i].culled)
+                continue;
+            VisibleObject visible = { renderables[i].object, renderables[i].drawBaked };
+            bounds.visible.push_back(visible);
+        }
+    });
+    return culled;
+}
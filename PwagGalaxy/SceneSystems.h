@@ -0,0 +1,84 @@
+#pragma once
+
+#include "TransformBatch.h"
+#include "KeplerOrbit.h"
+#include "TransformHierarchy.h"
+#include "BoundingVolumeHierarchy.h"
+#include "FrustumCuller.h"
+
+// An entity to draw this frame.
+struct VisibleObject
+{
+    uint32_t object;                        // Index into engineObjects, also the constant buffer slot.
+    uint32_t drawBaked;
+};
+
+// Bounding spheres of the entities with a BoundsComponent, written every frame, the tree over them that
+// picking and collision query, and the same spheres as a structure of arrays for the culling.
+struct SceneBounds
+{
+    BoundingVolumeHierarchy tree;
+    FrustumCuller culler;                   // Same items as the tree.
+    std::vector<BoundingSphere> spheres;    // By item of the tree.
+    std::vector<uint32_t> objects;          // RenderableComponent::object of every item.
+    std::vector<uint32_t> found;            // Scratch of the queries.
+    std::vector<uint8_t> insideByObject;    // Scratch of the culling.
+    // The entities left after culling, in chunk order, for recording the frame. Entities without bounds
+    // are always in it.
+    std::vector<VisibleObject> visible;
+};
+
+// What the scene systems need from the camera and the renderer for one frame.
+struct SceneFrame
+{
+    TransformBatchFrame matrices;
+    DirectX::XMFLOAT3 cameraPosition;
+    DirectX::XMFLOAT3 cameraFront;
+    DirectX::XMFLOAT3 cameraUp;
+    DirectX::XMFLOAT4 cameraTurn;       // Rotation of the camera in this frame (quaternion).
+    float fullDetailDistance;           // Closer than this (in radii of the body) planets use the full mesh.
+    TransformBatch::Path path;
+    uint8_t* constantBuffer;            // WVP slots of this frame.
+    size_t slotStride;
+    uint32_t frameSlot;                 // Which of the constant buffers (see TransformVersionComponent).
+    bool cameraChanged;                 // View or projection differ from the ones in this frame slot.
+    double simulationTime;              // Seconds, time warp included; the orbits are evaluated at it.
+    TransformHierarchy* hierarchy = nullptr;    // Nodes of the HierarchyComponent entities, if there are any.
+    SceneBounds* bounds = nullptr;              // Without it nothing is culled.
+};
+
+// What Update() did in a frame.
+struct SceneUpdateStats
+{
+    size_t recomputed = 0;              // Moved: world and WVP matrices built and uploaded.
+    size_t projected = 0;               // Same world matrix, the WVP matrix multiplied again and uploaded.
+    size_t deferred = 0;                // Moved while culled: world matrix built, the upload waits for the view.
+    size_t skipped = 0;                 // The slot holds the matrices already.
+    size_t visible = 0;                 // Renderable entities left to draw.
+    size_t culled = 0;                  // Outside of the view frustum.
+};
+
+// The per-frame update of the scene entities. Every system runs over the chunks of the entity world,
+// one job per chunk on the thread pool. A job only writes the components of its chunk and the constant
+// buffer slots of its entities, so the jobs need no locks and no shared scratch data. Update() returns
+// once every job has finished, before the command list is recorded.
+// Entities whose transform did not change keep their world matrix, and when the camera did not change
+// either, their slot of the frame is not written at all. Nor is the slot of a culled entity, until it is in
+// view again.
+class SceneSystems
+{
+public:
+    static SceneUpdateStats Update(EntityWorld& world, const SceneFrame& frame);
+
+    // The systems, in the order Update() runs them.
+    static void AdvanceOrbits(EntityWorld& world, const SceneFrame& frame);
+    static void FollowCamera(EntityWorld& world, const SceneFrame& frame);
+    static void PropagateHierarchy(EntityWorld& world, const SceneFrame& frame);
+    static SceneUpdateStats WriteTransforms(EntityWorld& world, const SceneFrame& frame);
+    static void SelectLevelOfDetail(EntityWorld& world, const SceneFrame& frame);
+    // Refits the tree of the scene bounds to the new world matrices (or builds it).
+    static void UpdateBounds(EntityWorld& world, const SceneFrame& frame);
+    // Marks the entities whose bounds are outside of the view frustum as culled and lists the others in
+    // SceneBounds::visible, with the level of detail of this frame. Returns how many it culled.
+    static size_t CullEntities(EntityWorld& world, const SceneFrame& frame);
+};
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "SimulationLoop.h"
+
+SimulationLoop::~SimulationLoop()
+{
+    Stop();
+}
+
+void SimulationLoop::Start(double ticksPerSecond, const SimulationSnapshot& initial, const TickFunction& tick)
+{
+    if (IsRunning())
+        throw "Simulation already running!";
+
+    this->tick = tick;
+    tickSeconds = 1.0 / ticksPerSecond;
+    // The initial state stands for the last two ticks, the third slot is the first one written.
+    for (SimulationSnapshot& snapshot : snapshots)
+        snapshot = initial;
+    snapshots[1].due = std::chrono::steady_clock::now();
+    snapshots[0].due = snapshots[1].due - std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tickSeconds));
+    snapshots[0].published = snapshots[1].published = snapshots[1].due;
+    previous = 0;
+    current = 1;
+    back = 2;
+    stats = SimulationStats();
+    tickMsSum = 0.0;
+    latencyMsSum = 0.0;
+
+    running = true;
+    thread = std::thread(&SimulationLoop::Run, this);
+}
+
+void SimulationLoop::Stop()
+{
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void SimulationLoop::Run()
+{
+    const std::chrono::steady_clock::duration interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tickSeconds));
+    std::chrono::steady_clock::time_point due = snapshots[current].due + interval;
+
+    while (running) {
+        std::this_thread::sleep_until(due);
+        // After a stall (a breakpoint, a dragged window) the ticks are dropped instead of run back to back.
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        size_t dropped = 0;
+        while (start - due > interval * MaxCatchUpTicks) {
+            due += interval;
+            dropped++;
+        }
+
+        // Only this thread writes the back snapshot and changes current, no lock needed to read them here.
+        SimulationSnapshot& next = snapshots[back];
+        next.tick = snapshots[current].tick + 1;
+        next.due = due;
+        tick(snapshots[current], next, tickSeconds);
+        std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            next.published = end;
+            int freed = previous;
+            previous = current;
+            current = back;
+            back = freed;
+
+            double tickMs = std::chrono::duration<double, std::milli>(end - start).count();
+            stats.ticks++;
+            stats.droppedTicks += dropped;
+            tickMsSum += tickMs;
+            stats.maxTickMs = std::max(stats.maxTickMs, tickMs);
+        }
+        due += interval;
+    }
+}
+
+void SimulationLoop::Read(const std::function<void(const SimulationSnapshot& previous, const SimulationSnapshot& current, float alpha)>& read)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const SimulationSnapshot& from = snapshots[previous];
+    const SimulationSnapshot& to = snapshots[current];
+
+    // One tick behind the wall clock, so there is a snapshot on either side most of the time.
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double shown = std::chrono::duration<double>(now - from.due).count() - tickSeconds;
+    double span = std::chrono::duration<double>(to.due - from.due).count();
+    float alpha = span > 0.0 ? static_cast<float>(std::min(std::max(shown / span, 0.0), 1.0)) : 1.0f;
+
+    stats.reads++;
+    latencyMsSum += std::chrono::duration<double, std::milli>(now - to.published).count();
+    read(from, to, alpha);
+}
+
+SimulationStats SimulationLoop::TakeStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    SimulationStats taken = stats;
+    taken.meanTickMs = stats.ticks > 0 ? tickMsSum / stats.ticks : 0.0;
+    taken.meanLatencyMs = stats.reads > 0 ? latencyMsSum / stats.reads : 0.0;
+    stats = SimulationStats();
+    tickMsSum = 0.0;
+    latencyMsSum = 0.0;
+    return taken;
+}
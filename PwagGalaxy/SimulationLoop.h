@@ -0,0 +1,85 @@
+#pragma once
+
+#include "Galaxy.h"
+
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+// State of the simulation after one tick, what the frames are built from.
+struct SimulationSnapshot
+{
+    uint64_t tick = 0;
+    std::chrono::steady_clock::time_point due;          // Wall time the tick stands for.
+    std::chrono::steady_clock::time_point published;
+    double orbitTime = 0.0;                             // Time of the planet orbits, time warp included.
+    double asteroidTime = 0.0;                          // Time of the asteroid orbits and spins.
+    bool asteroidGravity = false;
+    std::vector<DirectX::XMFLOAT3> asteroidPositions;   // Positions of the gravity mode, empty otherwise.
+    std::vector<GalaxySystem> nearbySystems;            // Nearest stars to the camera, home system excluded.
+    size_t shipAsteroidContacts = 0;                    // Asteroids the bounds of the ship overlap.
+};
+
+struct SimulationStats
+{
+    size_t ticks = 0;
+    size_t droppedTicks = 0;            // Skipped when the simulation fell too far behind the wall clock.
+    double meanTickMs = 0.0;
+    double maxTickMs = 0.0;
+    size_t reads = 0;
+    double meanLatencyMs = 0.0;         // Age of the newest snapshot when the game thread read it.
+};
+
+// Runs the simulation on a thread of its own at a fixed tick rate, so its steps are the same at any frame
+// rate and its cost does not add to the frame time. Every tick fills the back snapshot from the current
+// one and publishes it; the last two published snapshots stay readable. Publishing only swaps indices, and
+// it waits while the game thread is inside Read(), so a reader never sees a snapshot change under it.
+// The game thread shows the state one tick in the past, interpolated between the two snapshots around it.
+class SimulationLoop
+{
+public:
+    // Fills next (its vectors keep their capacity from two ticks ago) from current, for tickSeconds later.
+    typedef std::function<void(const SimulationSnapshot& current, SimulationSnapshot& next, double tickSeconds)> TickFunction;
+
+    SimulationLoop() = default;
+    ~SimulationLoop();
+    SimulationLoop(const SimulationLoop& other) = delete;
+    void operator=(const SimulationLoop&) = delete;
+
+    // Start ticking from the initial snapshot, which is also the first one read.
+    void Start(double ticksPerSecond, const SimulationSnapshot& initial, const TickFunction& tick);
+    void Stop();
+    bool IsRunning() const { return thread.joinable(); }
+
+    // Calls read(previous, current, alpha) with the snapshots to interpolate for now, alpha in [0, 1].
+    void Read(const std::function<void(const SimulationSnapshot& previous, const SimulationSnapshot& current, float alpha)>& read);
+
+    // Statistics since the last call.
+    SimulationStats TakeStats();
+
+    double GetTickSeconds() const { return tickSeconds; }
+
+private:
+    void Run();
+
+    static const int MaxCatchUpTicks = 4;
+
+    std::thread thread;
+    std::atomic<bool> running{ false };
+    TickFunction tick;
+    double tickSeconds = 0.0;
+
+    std::mutex mutex;
+    SimulationSnapshot snapshots[3];
+    int previous = 0;
+    int current = 1;
+    int back = 2;
+
+    // Statistics, under the mutex.
+    SimulationStats stats;
+    double tickMsSum = 0.0;
+    double latencyMsSum = 0.0;
+};
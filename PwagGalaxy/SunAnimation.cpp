@@ -0,0 +1,126 @@
+#include "stdafx.h"
+#include "SunAnimation.h"
+
+#include "PlanetBake.h"
+#include "ThreadPool.h"
+
+SunAnimation::SunAnimation(const SunAnimationSettings& settings, int seed) :
+    settings(settings),
+    noise(seed)
+{
+    if (settings.faceResolution % settings.tileSize != 0)
+        throw "Sun animation tiles do not divide the face resolution!";
+
+    tilesPerFace = settings.faceResolution / settings.tileSize;
+    tileCount = FaceCount * tilesPerFace * tilesPerFace;
+
+    int samplesPerTile = settings.tileSize * settings.tileSize * settings.octaves;
+    tilesPerFrame = std::max(1, settings.samplesPerFrame / samplesPerTile);
+    updatedTiles.reserve(tilesPerFrame);
+
+    // Texel centre directions, in the same layout as the texels.
+    size_t faceTexels = static_cast<size_t>(settings.faceResolution) * settings.faceResolution;
+    directions.resize(FaceCount * faceTexels);
+    texels.assign(FaceCount * faceTexels, 0xff000000);
+    for (int face = 0; face < FaceCount; face++) {
+        for (int y = 0; y < settings.faceResolution; y++) {
+            for (int x = 0; x < settings.faceResolution; x++) {
+                float u = (x + 0.5f) / settings.faceResolution;
+                float v = (y + 0.5f) / settings.faceResolution;
+                directions[face * faceTexels + y * settings.faceResolution + x] = PlanetBake::FaceDirection(face, u, v);
+            }
+        }
+    }
+
+    // The two keyframes shown during the first cycle.
+    ThreadPool::GetInstance()->ParallelFor(tileCount, [&](size_t tile) {
+        EvaluateTile(static_cast<int>(tile), 0, KeyframeTime(0));
+        EvaluateTile(static_cast<int>(tile), 1, KeyframeTime(1));
+    });
+}
+
+void SunAnimation::Update(double deltaTime)
+{
+    updatedTiles.clear();
+    if (tileCount == 0 || settings.keyframeSeconds <= 0.0f)
+        return;
+
+    // This cycle evaluates the keyframe shown at the end of the next one, as many tiles as the share
+    // of the cycle that has passed (within the budget of a frame).
+    phase += deltaTime / settings.keyframeSeconds;
+    int channel = (cycle + 2) % 3;
+    float time = KeyframeTime(cycle + 2);
+    int firstTile = nextTile;
+    int dueTile = static_cast<int>(std::min(std::ceil(phase * tileCount), static_cast<double>(tileCount)));
+    int lastTile = std::min(dueTile, firstTile + tilesPerFrame);
+
+    if (firstTile < lastTile) {
+        ThreadPool::GetInstance()->ParallelFor(lastTile - firstTile, [&](size_t i) {
+            EvaluateTile(firstTile + static_cast<int>(i), channel, time);
+        });
+        for (int tile = firstTile; tile < lastTile; tile++) {
+            int face = tile / (tilesPerFace * tilesPerFace);
+            int tileInFace = tile % (tilesPerFace * tilesPerFace);
+            updatedTiles.push_back({ face, (tileInFace % tilesPerFace) * settings.tileSize, (tileInFace / tilesPerFace) * settings.tileSize });
+        }
+        nextTile = lastTile;
+    }
+
+    // The ring moves on once the cycle is over and its keyframe complete. A long frame does not skip
+    // keyframes, the tiles of the skipped ones would never have been evaluated.
+    if (phase >= 1.0 && nextTile == tileCount) {
+        phase = std::min(phase - 1.0, 1.0);
+        nextTile = 0;
+        cycle++;
+    }
+}
+
+const UINT* SunAnimation::GetTileRow(const SunTile& tile, int row) const
+{
+    size_t faceTexels = static_cast<size_t>(settings.faceResolution) * settings.faceResolution;
+    return &texels[tile.face * faceTexels + static_cast<size_t>(tile.y + row) * settings.faceResolution + tile.x];
+}
+
+void SunAnimation::EvaluateTile(int tileIndex, int channel, float time)
+{
+    int face = tileIndex / (tilesPerFace * tilesPerFace);
+    int tileInFace = tileIndex % (tilesPerFace * tilesPerFace);
+    int x0 = (tileInFace % tilesPerFace) * settings.tileSize;
+    int y0 = (tileInFace / tilesPerFace) * settings.tileSize;
+    size_t faceOffset = static_cast<size_t>(face) * settings.faceResolution * settings.faceResolution;
+
+    const int tileTexels = settings.tileSize * settings.tileSize;
+    std::vector<DirectX::XMFLOAT3> points(tileTexels);
+    std::vector<float> octave(tileTexels);
+    std::vector<float> sum(tileTexels, 0.0f);
+
+    // fBm, one batch of 4D evaluations per octave.
+    float frequency = settings.frequency;
+    float amplitude = 1.0f;
+    float amplitudeSum = 0.0f;
+    for (int o = 0; o < settings.octaves; o++) {
+        for (int y = 0; y < settings.tileSize; y++) {
+            for (int x = 0; x < settings.tileSize; x++) {
+                DirectX::XMFLOAT3 direction = directions[faceOffset + static_cast<size_t>(y0 + y) * settings.faceResolution + x0 + x];
+                points[y * settings.tileSize + x] = DirectX::XMFLOAT3(direction.x * frequency, direction.y * frequency, direction.z * frequency);
+            }
+        }
+        noise.Evaluate(points.data(), time * frequency, octave.data(), tileTexels);
+        for (int i = 0; i < tileTexels; i++)
+            sum[i] += octave[i] * amplitude;
+
+        amplitudeSum += amplitude;
+        frequency *= 2.0f;
+        amplitude *= 0.5f;
+    }
+
+    int shift = channel * 8;
+    for (int y = 0; y < settings.tileSize; y++) {
+        for (int x = 0; x < settings.tileSize; x++) {
+            float value = sum[y * settings.tileSize + x] / amplitudeSum * 0.5f + 0.5f;
+            UINT byte = static_cast<UINT>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+            UINT& texel = texels[faceOffset + static_cast<size_t>(y0 + y) * settings.faceResolution + x0 + x];
+            texel = (texel & ~(0xffu << shift)) | (byte << shift);
+        }
+    }
+}
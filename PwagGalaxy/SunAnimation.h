@@ -0,0 +1,84 @@
+#pragma once
+
+#include "Noise.h"
+
+struct SunAnimationSettings
+{
+    int faceResolution = 64;        // Texels along the edge of one cube face.
+    int tileSize = 16;              // Texels along the edge of one tile, the unit of work and upload.
+    // Noise evaluations allowed per frame (at least one tile). Only slow frames use all of it; this one
+    // keeps up with the keyframes of the defaults down to 30 frames per second.
+    int samplesPerFrame = 8192;
+    int octaves = 3;
+    float frequency = 3.0f;
+    float keyframeStep = 0.08f;     // Noise time between two keyframes.
+    float keyframeSeconds = 0.35f;  // Real time from one keyframe to the next.
+};
+
+// A tile whose texels changed, to be copied to the GPU this frame.
+struct SunTile
+{
+    int face;
+    int x;
+    int y;
+};
+
+// Boiling surface of a star from 4D noise (direction and time), stored in a R8G8B8A8 cube map.
+// The red, green and blue channels hold three keyframes used as a ring: two of them are shown and
+// interpolated on the GPU while the third is evaluated a few tiles per frame, so the cost per frame
+// is bounded by samplesPerFrame and only the finished tiles have to be uploaded. The blend follows the
+// elapsed time, keyframeSeconds per keyframe at any frame rate; the tiles of the next keyframe are
+// spread over the same time. Should the frames be too slow to finish them within the budget, the
+// blend waits at the newer keyframe until the next one is complete.
+class SunAnimation
+{
+public:
+    static const int FaceCount = 6;
+
+    SunAnimation() = default;
+    // Evaluates the first two keyframes in full.
+    SunAnimation(const SunAnimationSettings& settings, int seed);
+
+    // Evaluate the tiles due after deltaTime more seconds and move the animation on.
+    void Update(double deltaTime);
+    // Tiles evaluated by the last Update(), they have to be uploaded before the next draw.
+    const std::vector<SunTile>& GetUpdatedTiles() const { return updatedTiles; }
+
+    // Channels (0 = red, 1 = green, 2 = blue) to interpolate between and the weight of the second one.
+    int GetFromChannel() const { return cycle % 3; }
+    int GetToChannel() const { return (cycle + 1) % 3; }
+    float GetBlend() const { return static_cast<float>(std::min(phase, 1.0)); }
+
+    float GetKeyframeSeconds() const { return settings.keyframeSeconds; }
+    // How many times the ring moved on.
+    int GetCycle() const { return cycle; }
+    // Tiles evaluated for every keyframe.
+    int GetTileCount() const { return tileCount; }
+    // Upper bound of tiles returned by Update(), to size the upload buffers.
+    int GetTilesPerFrame() const { return tilesPerFrame; }
+    int GetResolution() const { return settings.faceResolution; }
+    int GetTileSize() const { return settings.tileSize; }
+
+    // Texels of the faces one after another.
+    const std::vector<UINT>& GetTexels() const { return texels; }
+    const UINT* GetTileRow(const SunTile& tile, int row) const;
+
+private:
+    void EvaluateTile(int tileIndex, int channel, float time);
+    float KeyframeTime(int keyframe) const { return keyframe * settings.keyframeStep; }
+
+    SunAnimationSettings settings;
+    Noise noise;
+
+    int tilesPerFace = 0;
+    int tileCount = 0;
+    int tilesPerFrame = 0;
+
+    int cycle = 0;
+    double phase = 0.0;             // Keyframes since the start of this cycle.
+    int nextTile = 0;               // Of the keyframe evaluated in this cycle.
+
+    std::vector<DirectX::XMFLOAT3> directions;
+    std::vector<UINT> texels;
+    std::vector<SunTile> updatedTiles;
+};
@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "SunMaterial.h"
+
+std::vector<D3D12_ROOT_PARAMETER> SunMaterial::CreateRootParameters()
+{
+    // Create the root descriptor (for wvp matrices)
+    D3D12_ROOT_DESCRIPTOR rootCBVDescriptor;
+    rootCBVDescriptor.ShaderRegister = 0; // b0 in shader
+    rootCBVDescriptor.RegisterSpace = 0;
+
+    // The animation keyframes.
+    descriptorTableCubeMapRanges.resize(1);
+    descriptorTableCubeMapRanges[0].RangeType = D3D12_DESCRIPTOR_RANGE_TYPE_SRV;
+    descriptorTableCubeMapRanges[0].NumDescriptors = 1;
+    descriptorTableCubeMapRanges[0].BaseShaderRegister = 0; // t0 in shader
+    descriptorTableCubeMapRanges[0].RegisterSpace = 0;
+    descriptorTableCubeMapRanges[0].OffsetInDescriptorsFromTableStart = D3D12_DESCRIPTOR_RANGE_OFFSET_APPEND;
+
+    D3D12_ROOT_DESCRIPTOR_TABLE descriptorTableCubeMap;
+    descriptorTableCubeMap.NumDescriptorRanges = descriptorTableCubeMapRanges.size();
+    descriptorTableCubeMap.pDescriptorRanges = descriptorTableCubeMapRanges.data();
+
+    rootParameters.resize(3);
+    // WVP matrix.
+    rootParameters[0].ParameterType = D3D12_ROOT_PARAMETER_TYPE_CBV;
+    rootParameters[0].Descriptor = rootCBVDescriptor;
+    rootParameters[0].ShaderVisibility = D3D12_SHADER_VISIBILITY_VERTEX;
+
+    // Animation blend, changes every frame so it is passed as root constants.
+    rootParameters[1].ParameterType = D3D12_ROOT_PARAMETER_TYPE_32BIT_CONSTANTS;
+    rootParameters[1].Constants.ShaderRegister = 1; // b1 in shader
+    rootParameters[1].Constants.RegisterSpace = 0;
+    rootParameters[1].Constants.Num32BitValues = sizeof(AnimationConstants) / 4;
+    rootParameters[1].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    // Animation cube map.
+    rootParameters[2].ParameterType = D3D12_ROOT_PARAMETER_TYPE_DESCRIPTOR_TABLE;
+    rootParameters[2].DescriptorTable = descriptorTableCubeMap;
+    rootParameters[2].ShaderVisibility = D3D12_SHADER_VISIBILITY_PIXEL;
+
+    return rootParameters;
+}
+
+D3D12_STATIC_SAMPLER_DESC SunMaterial::CreateSampler()
+{
+    // The keyframes are filtered, all texels share the same blend so this does not mix keyframes.
+    D3D12_STATIC_SAMPLER_DESC sampler = Material::CreateSampler();
+    sampler.Filter = D3D12_FILTER_MIN_MAG_MIP_LINEAR;
+    sampler.AddressU = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    sampler.AddressV = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+    sampler.AddressW = D3D12_TEXTURE_ADDRESS_MODE_CLAMP;
+
+    return sampler;
+}
+
+D3D12_ROOT_SIGNATURE_FLAGS SunMaterial::CreateRootSignatureFlags()
+{
+    D3D12_ROOT_SIGNATURE_FLAGS flags = (
+        D3D12_ROOT_SIGNATURE_FLAG_ALLOW_INPUT_ASSEMBLER_INPUT_LAYOUT |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_HULL_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_DOMAIN_SHADER_ROOT_ACCESS |
+        D3D12_ROOT_SIGNATURE_FLAG_DENY_GEOMETRY_SHADER_ROOT_ACCESS);
+
+    return flags;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "Material.h"
+
+// Unlit material of the animated star (see SunAnimation). The vertex colour is brightened and darkened
+// by the keyframes of the animation cube map, blended with the weights passed as root constants.
+class SunMaterial : public Material
+{
+public:
+    SunMaterial() = default;
+
+    // Root constants of the pixel shader (b1).
+    struct AnimationConstants
+    {
+        float blend;            // Weight of the second keyframe.
+        UINT fromChannel;       // Channels of the cube map holding the two keyframes.
+        UINT toChannel;
+        float intensity;        // How much the animation changes the brightness.
+    };
+
+private:
+    std::vector<D3D12_DESCRIPTOR_RANGE> descriptorTableCubeMapRanges;
+    std::vector<D3D12_ROOT_PARAMETER> rootParameters;
+
+    virtual std::vector<D3D12_ROOT_PARAMETER> CreateRootParameters();
+    virtual D3D12_STATIC_SAMPLER_DESC CreateSampler();
+    virtual D3D12_ROOT_SIGNATURE_FLAGS CreateRootSignatureFlags();
+};
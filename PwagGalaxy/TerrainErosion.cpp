@@ -0,0 +1,255 @@
+#include "stdafx.h"
+#include "TerrainErosion.h"
+
+#include "ThreadPool.h"
+#include <chrono>
+#include <algorithm>
+
+namespace
+{
+    // Small counter-based generator, every tile of every pass gets its own independent stream.
+    struct TileRandom
+    {
+        uint64_t state;
+
+        float Next()
+        {
+            uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            z = z ^ (z >> 31);
+            return (z >> 40) * (1.0f / 16777216.0f);
+        }
+    };
+
+    // SplitMix64 finaliser, to fold values of any size into a stream start without them overlapping.
+    uint64_t MixBits(uint64_t value)
+    {
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+}
+
+TerrainErosion::TerrainErosion(const ErosionSettings& settings) :
+    settings(settings)
+{
+}
+
+bool TerrainErosion::Erode(const std::vector<ErosionFace>& faces, float cellSize)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto outOfTime = [&]() {
+        if (settings.timeBudgetMs <= 0.0f)
+            return false;
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() > settings.timeBudgetMs;
+    };
+
+    // The simulation works in texel units, so slopes are independent of the grid resolution.
+    float heightScale = 1.0f / cellSize;
+
+    // Keep the input for the fade towards the face edges.
+    std::vector<std::vector<float>> original(faces.size());
+    for (size_t f = 0; f < faces.size(); f++) {
+        const ErosionFace& face = faces[f];
+        original[f].resize(static_cast<size_t>(face.resolution) * face.resolution);
+        for (int y = 0; y < face.resolution; y++)
+            std::copy(face.heights + y * face.stride, face.heights + y * face.stride + face.resolution, &original[f][y * face.resolution]);
+    }
+
+    // Hydraulic passes, the tile grid moves by half a tile every other pass so tile edges do not show.
+    int pass = 0;
+    for (; pass < settings.hydraulicPasses && !outOfTime(); pass++) {
+        std::vector<Tile> tiles = CreateTiles(faces, (pass % 2) * settings.tileSize / 2);
+        ThreadPool::GetInstance()->ParallelFor(tiles.size(), [&](size_t i) {
+            HydraulicTile(faces[tiles[i].face], tiles[i], pass, heightScale);
+        });
+    }
+
+    bool complete = pass >= settings.hydraulicPasses;
+
+    // Thermal iterations read one copy of the grid and write the other (including the border,
+    // which is only copied), so every texel sees the same neighbours whatever the tile order.
+    if (settings.thermalIterations > 0) {
+        std::vector<std::vector<float>> scratch(faces.size());
+        std::vector<ErosionFace> scratchFaces(faces.size());
+        for (size_t f = 0; f < faces.size(); f++) {
+            const ErosionFace& face = faces[f];
+            // Rows from -1 to resolution, so the border ring next to the interior is available.
+            scratch[f].resize(static_cast<size_t>(face.resolution + 2) * face.stride);
+            scratchFaces[f] = { &scratch[f][face.stride + 1], face.stride, face.resolution };
+            for (int y = -1; y <= face.resolution; y++)
+                std::copy(face.heights + y * face.stride - 1, face.heights + y * face.stride + face.resolution + 1, scratchFaces[f].heights + y * face.stride - 1);
+        }
+
+        std::vector<Tile> tiles = CreateTiles(faces, 0);
+        std::vector<ErosionFace> source = faces;
+        std::vector<ErosionFace> destination = scratchFaces;
+        int iteration = 0;
+        for (; iteration < settings.thermalIterations && !outOfTime(); iteration++) {
+            ThreadPool::GetInstance()->ParallelFor(tiles.size(), [&](size_t i) {
+                ThermalTile(source[tiles[i].face], destination[tiles[i].face], tiles[i], heightScale);
+            });
+            std::swap(source, destination);
+        }
+        complete = complete && iteration >= settings.thermalIterations;
+
+        // An odd number of iterations leaves the result in the scratch copy.
+        if (iteration % 2 == 1) {
+            for (size_t f = 0; f < faces.size(); f++) {
+                for (int y = 0; y < faces[f].resolution; y++)
+                    std::copy(scratchFaces[f].heights + y * faces[f].stride, scratchFaces[f].heights + y * faces[f].stride + faces[f].resolution, faces[f].heights + y * faces[f].stride);
+            }
+        }
+    }
+
+    // Fade back to the input near the face edges, the neighbouring face was eroded separately.
+    ThreadPool::GetInstance()->ParallelFor(faces.size(), [&](size_t f) {
+        const ErosionFace& face = faces[f];
+        float fade = static_cast<float>(std::max(settings.edgeFadeTexels, 1));
+        for (int y = 0; y < face.resolution; y++) {
+            for (int x = 0; x < face.resolution; x++) {
+                int edgeDistance = std::min(std::min(x, y), std::min(face.resolution - 1 - x, face.resolution - 1 - y));
+                float weight = std::min(edgeDistance / fade, 1.0f);
+                weight = weight * weight * (3.0f - 2.0f * weight);
+                float& height = face.heights[y * face.stride + x];
+                float input = original[f][y * face.resolution + x];
+                height = input + (height - input) * weight;
+            }
+        }
+    });
+    return complete;
+}
+
+std::vector<TerrainErosion::Tile> TerrainErosion::CreateTiles(const std::vector<ErosionFace>& faces, int offset)
+{
+    std::vector<Tile> tiles;
+    int tileSize = std::max(settings.tileSize, 4);
+    for (int f = 0; f < static_cast<int>(faces.size()); f++) {
+        int resolution = faces[f].resolution;
+        for (int y0 = -offset; y0 < resolution; y0 += tileSize) {
+            for (int x0 = -offset; x0 < resolution; x0 += tileSize) {
+                Tile tile = { f, std::max(x0, 0), std::max(y0, 0), std::min(x0 + tileSize, resolution), std::min(y0 + tileSize, resolution) };
+                if (tile.x1 - tile.x0 >= 2 && tile.y1 - tile.y0 >= 2)
+                    tiles.push_back(tile);
+            }
+        }
+    }
+    return tiles;
+}
+
+void TerrainErosion::HydraulicTile(const ErosionFace& face, const Tile& tile, int pass, float heightScale)
+{
+    uint64_t stream = MixBits(settings.seed);
+    stream = MixBits(stream ^ ((static_cast<uint64_t>(pass) << 32) | static_cast<uint32_t>(tile.face)));
+    stream = MixBits(stream ^ ((static_cast<uint64_t>(tile.y0) << 32) | static_cast<uint32_t>(tile.x0)));
+    TileRandom random = { stream };
+
+    auto height = [&](int x, int y) -> float& { return face.heights[y * face.stride + x]; };
+    // Bilinear height (in texel units) and gradient at a position inside the tile.
+    auto sample = [&](float px, float py, float& gradientX, float& gradientY) {
+        int x = static_cast<int>(px);
+        int y = static_cast<int>(py);
+        float u = px - x;
+        float v = py - y;
+        float h00 = height(x, y) * heightScale;
+        float h10 = height(x + 1, y) * heightScale;
+        float h01 = height(x, y + 1) * heightScale;
+        float h11 = height(x + 1, y + 1) * heightScale;
+        gradientX = (h10 - h00) * (1 - v) + (h11 - h01) * v;
+        gradientY = (h01 - h00) * (1 - u) + (h11 - h10) * u;
+        return h00 * (1 - u) * (1 - v) + h10 * u * (1 - v) + h01 * (1 - u) * v + h11 * u * v;
+    };
+    // Spread a height change (in texel units) over the four texels around a position.
+    auto change = [&](float px, float py, float amount) {
+        int x = static_cast<int>(px);
+        int y = static_cast<int>(py);
+        float u = px - x;
+        float v = py - y;
+        amount /= heightScale;
+        height(x, y) += amount * (1 - u) * (1 - v);
+        height(x + 1, y) += amount * u * (1 - v);
+        height(x, y + 1) += amount * (1 - u) * v;
+        height(x + 1, y + 1) += amount * u * v;
+    };
+
+    // Droplets stay where all four texels they touch belong to the tile.
+    float minX = static_cast<float>(tile.x0);
+    float minY = static_cast<float>(tile.y0);
+    float maxX = tile.x1 - 1.001f;
+    float maxY = tile.y1 - 1.001f;
+    int dropletCount = static_cast<int>(settings.dropletsPerTexel * (tile.x1 - tile.x0) * (tile.y1 - tile.y0) + 0.5f);
+
+    for (int droplet = 0; droplet < dropletCount; droplet++) {
+        float px = minX + random.Next() * (maxX - minX);
+        float py = minY + random.Next() * (maxY - minY);
+        float directionX = 0.0f;
+        float directionY = 0.0f;
+        float speed = 1.0f;
+        float water = 1.0f;
+        float sediment = 0.0f;
+
+        for (int step = 0; step < settings.maxDropletSteps; step++) {
+            float gradientX, gradientY;
+            float currentHeight = sample(px, py, gradientX, gradientY);
+
+            directionX = directionX * settings.inertia - gradientX * (1 - settings.inertia);
+            directionY = directionY * settings.inertia - gradientY * (1 - settings.inertia);
+            float length = std::sqrt(directionX * directionX + directionY * directionY);
+            if (length < 1e-6f)
+                break;
+            directionX /= length;
+            directionY /= length;
+
+            float oldX = px;
+            float oldY = py;
+            px += directionX;
+            py += directionY;
+            if (px < minX || py < minY || px > maxX || py > maxY)
+                break;
+
+            float unusedX, unusedY;
+            float deltaHeight = sample(px, py, unusedX, unusedY) - currentHeight;
+
+            float capacity = std::max(-deltaHeight * speed * water * settings.sedimentCapacity, settings.minSedimentCapacity);
+            if (sediment > capacity || deltaHeight > 0) {
+                // Uphill the droplet fills the pit behind it, otherwise it drops what it cannot carry.
+                float deposit = deltaHeight > 0 ? std::min(deltaHeight, sediment) : (sediment - capacity) * settings.depositSpeed;
+                sediment -= deposit;
+                change(oldX, oldY, deposit);
+            }
+            else {
+                // Never dig deeper than the height difference, that would create spikes.
+                float erode = std::min((capacity - sediment) * settings.erodeSpeed, -deltaHeight);
+                change(oldX, oldY, -erode);
+                sediment += erode;
+            }
+
+            speed = std::sqrt(std::max(speed * speed - deltaHeight * settings.gravity, 0.0f));
+            water *= 1 - settings.evaporateSpeed;
+        }
+    }
+}
+
+void TerrainErosion::ThermalTile(const ErosionFace& source, ErosionFace& destination, const Tile& tile, float heightScale)
+{
+    float talus = settings.talusSlope / heightScale;
+    const int offsets[4][2] = { { 1, 0 }, { -1, 0 }, { 0, 1 }, { 0, -1 } };
+
+    for (int y = tile.y0; y < tile.y1; y++) {
+        for (int x = tile.x0; x < tile.x1; x++) {
+            float height = source.heights[y * source.stride + x];
+            float change = 0.0f;
+            // Symmetric exchange with each neighbour, so material is only moved, never created.
+            for (const int* offset : offsets) {
+                float neighbour = source.heights[(y + offset[1]) * source.stride + x + offset[0]];
+                float difference = neighbour - height;
+                if (difference > talus)
+                    change += settings.thermalRate * (difference - talus);
+                else if (difference < -talus)
+                    change += settings.thermalRate * (difference + talus);
+            }
+            destination.heights[y * destination.stride + x] = height + change;
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+struct ErosionSettings
+{
+    bool enabled = false;
+    unsigned int seed = 0;
+
+    // Budget. Passes always run in the same order; with a time budget the erosion stops early once it
+    // is used up, which keeps load times bounded but makes the result depend on the machine.
+    int hydraulicPasses = 4;
+    int thermalIterations = 16;
+    float timeBudgetMs = 0.0f;          // 0 = no time limit.
+
+    // Square tiles that run in parallel. Droplets never leave their tile, so tiles of one pass never
+    // touch the same texels and the result does not depend on the number of threads.
+    int tileSize = 32;
+    int edgeFadeTexels = 8;             // Erosion fades out towards the face edges, so faces still meet.
+
+    // Thermal erosion: material slides down slopes steeper than the talus slope.
+    float talusSlope = 0.6f;            // Height difference per texel (in texel units).
+    float thermalRate = 0.1f;
+
+    // Hydraulic erosion: water droplets picking up and depositing sediment.
+    float dropletsPerTexel = 0.05f;     // Per pass.
+    int maxDropletSteps = 32;
+    float inertia = 0.05f;
+    float sedimentCapacity = 4.0f;
+    float minSedimentCapacity = 0.01f;
+    float depositSpeed = 0.3f;
+    float erodeSpeed = 0.3f;
+    float evaporateSpeed = 0.02f;
+    float gravity = 4.0f;
+};
+
+// One face of a bordered elevation grid (see PlanetBake). Only the interior resolution x resolution
+// texels are eroded, the border is read but never written.
+struct ErosionFace
+{
+    float* heights;     // Points at texel (0, 0) of the interior.
+    int stride;
+    int resolution;
+};
+
+// Erosion of per-face elevation grids, run after the noise is evaluated and before normals and
+// colours are derived from the elevations.
+class TerrainErosion
+{
+public:
+    TerrainErosion(const ErosionSettings& settings);
+
+    // Heights are in planet radii, cellSize is the distance between texels in the same unit. Returns false
+    // when the time budget ran out before all passes and iterations, the result then depends on the machine.
+    bool Erode(const std::vector<ErosionFace>& faces, float cellSize);
+
+private:
+    struct Tile
+    {
+        int face;
+        int x0, y0, x1, y1;
+    };
+
+    std::vector<Tile> CreateTiles(const std::vector<ErosionFace>& faces, int offset);
+    void HydraulicTile(const ErosionFace& face, const Tile& tile, int pass, float heightScale);
+    void ThermalTile(const ErosionFace& source, ErosionFace& destination, const Tile& tile, float heightScale);
+
+    ErosionSettings settings;
+};
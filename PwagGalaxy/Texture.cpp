@@ -49,13 +49,53 @@ bool Texture::CreateFromFile(const std::string fileName)
     return true;
 }
 
+bool Texture::CreateCubeFromTexels(const std::vector<UINT>& texels, UINT faceResolution)
+{
+    const UINT faceCount = 6;
+    if (texels.size() != static_cast<size_t>(faceCount) * faceResolution * faceResolution)
+        throw "Cube map texels do not match the face resolution!";
+
+    BufferMemoryManager buffMng;
+    CD3DX12_RESOURCE_DESC desc = CD3DX12_RESOURCE_DESC::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, faceResolution, faceResolution, faceCount, 1);
+    textureDesc = desc;
+    isCubeMap = true;
+
+    UINT64 textureUploadBufferSize = 0;
+    DXContext::getDevice().Get()->GetCopyableFootprints(&textureDesc, 0, faceCount, 0, nullptr, nullptr, nullptr, &textureUploadBufferSize);
+    ComPtr<ID3D12Resource> textureUploadBuffer;
+    buffMng.AllocateBuffer(textureBuffer, &desc, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_HEAP_TYPE_DEFAULT);
+    buffMng.AllocateBuffer(textureUploadBuffer, textureUploadBufferSize, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_HEAP_TYPE_UPLOAD);
+
+    std::vector<D3D12_SUBRESOURCE_DATA> faceData(faceCount);
+    for (UINT face = 0; face < faceCount; face++)
+    {
+        faceData[face].pData = &texels[static_cast<size_t>(face) * faceResolution * faceResolution];
+        faceData[face].RowPitch = faceResolution * sizeof(UINT);
+        faceData[face].SlicePitch = faceData[face].RowPitch * faceResolution;
+    }
+    buffMng.FillBuffer(textureBuffer, faceData, textureUploadBuffer, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+    textureBuffer->SetName(L"Cube map texture buffer resource");
+
+    CreateTextureView();
+
+    return true;
+}
+
 void Texture::CreateTextureView()
 {
     D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
     srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
     srvDesc.Format = textureDesc.Format;
-    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
-    srvDesc.Texture2D.MipLevels = 1;
+    if (isCubeMap)
+    {
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURECUBE;
+        srvDesc.TextureCube.MipLevels = 1;
+    }
+    else
+    {
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D;
+        srvDesc.Texture2D.MipLevels = 1;
+    }
 
     viewOffsetInHeap = ShaderResourceHeapManager::AddShaderResourceView(srvDesc, textureBuffer);
 }
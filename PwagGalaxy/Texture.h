@@ -8,7 +8,11 @@ public:
     Texture() = default;
     Texture(const std::string fileName);
     bool CreateFromFile(const std::string fileName);
+    // Creates a R8G8B8A8 cube map from six square faces stored one after another (D3D face order).
+    bool CreateCubeFromTexels(const std::vector<UINT>& texels, UINT faceResolution);
     UINT GetOffsetInHeap() { return viewOffsetInHeap; }
+    // For textures updated after creation (copies into the resource).
+    ComPtr<ID3D12Resource> GetResource() { return textureBuffer; }
 
     // Creates a view/descriptor of the texture in the heap provided.
     void CreateTextureView();
@@ -16,4 +20,5 @@ private:
     ComPtr<ID3D12Resource> textureBuffer;
     D3D12_RESOURCE_DESC textureDesc;
     UINT viewOffsetInHeap;
+    bool isCubeMap = false;
 };
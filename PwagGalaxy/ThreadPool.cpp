@@ -0,0 +1,151 @@
+#include "stdafx.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+
+ThreadPool* ThreadPool::instance{ nullptr };
+std::mutex ThreadPool::mutex;
+unsigned int ThreadPool::requestedThreadCount{ 0 };
+
+namespace
+{
+    // Set on pool threads and while the calling thread is inside ParallelFor, so nested calls run inline.
+    thread_local bool insideParallelFor = false;
+}
+
+ThreadPool::ThreadPool()
+{
+    unsigned int threadCount = requestedThreadCount != 0 ? requestedThreadCount : std::thread::hardware_concurrency();
+    unsigned int workerCount = threadCount > 1 ? threadCount - 1 : 0;
+
+    for (unsigned int i = 0; i < workerCount; i++)
+    {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        shuttingDown = true;
+    }
+    jobAvailable.notify_all();
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+ThreadPool* ThreadPool::GetInstance()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (instance == nullptr)
+    {
+        instance = new ThreadPool();
+    }
+    return instance;
+}
+
+void ThreadPool::SetThreadCount(unsigned int count)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    requestedThreadCount = count;
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& job)
+{
+    if (count == 0)
+        return;
+
+    // Nested calls and single items are not worth waking the workers for.
+    if (insideParallelFor || workers.empty() || count == 1 || threadLimit == 1)
+    {
+        for (size_t i = 0; i < count; i++)
+            job(i);
+        return;
+    }
+
+    // Every caller queues its own submission, so two threads submitting at once (the simulation thread and
+    // the render thread) share the workers instead of one of them running its job alone.
+    Submission submission;
+    submission.job = &job;
+    submission.count = count;
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        submissions.push_back(&submission);
+    }
+    jobAvailable.notify_all();
+
+    insideParallelFor = true;
+    RunJobs(submission);
+    insideParallelFor = false;
+
+    // Workers that picked up this submission must leave it before it goes out of scope.
+    std::unique_lock<std::mutex> lock(jobMutex);
+    jobFinished.wait(lock, [&] { return submission.completedCount.load() == count && submission.activeWorkers == 0; });
+    auto queued = std::find(submissions.begin(), submissions.end(), &submission);
+    if (queued != submissions.end())
+        submissions.erase(queued);
+}
+
+ThreadPool::Submission* ThreadPool::NextSubmission()
+{
+    while (!submissions.empty())
+    {
+        Submission* submission = submissions.front();
+        if (submission->nextIndex.load() < submission->count)
+            return submission;
+        submissions.pop_front();
+    }
+    return nullptr;
+}
+
+void ThreadPool::WorkerLoop(unsigned int index)
+{
+    insideParallelFor = true;
+
+    while (true)
+    {
+        Submission* submission;
+        {
+            std::unique_lock<std::mutex> lock(jobMutex);
+            // Over the limit, this one sits the submissions out.
+            jobAvailable.wait(lock, [&] {
+                return shuttingDown || ((threadLimit == 0 || index + 1 < threadLimit) && NextSubmission() != nullptr);
+            });
+            if (shuttingDown)
+                return;
+            submission = NextSubmission();
+            submission->activeWorkers++;
+        }
+
+        RunJobs(*submission);
+
+        {
+            std::lock_guard<std::mutex> lock(jobMutex);
+            submission->activeWorkers--;
+        }
+        jobFinished.notify_all();
+    }
+}
+
+void ThreadPool::RunJobs(Submission& submission)
+{
+    const std::function<void(size_t)>& job = *submission.job;
+    size_t count = submission.count;
+    size_t finishedHere = 0;
+
+    for (size_t i = submission.nextIndex++; i < count; i = submission.nextIndex++)
+    {
+        job(i);
+        finishedHere++;
+    }
+
+    if (finishedHere > 0 && submission.completedCount.fetch_add(finishedHere) + finishedHere == count)
+    {
+        std::lock_guard<std::mutex> lock(jobMutex);
+        jobFinished.notify_all();
+    }
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <deque>
+
+// Engine-wide pool of worker threads for data-parallel CPU work (terrain baking, generation, simulation).
+class ThreadPool
+{
+private:
+    static ThreadPool* instance;
+    static std::mutex mutex;
+    static unsigned int requestedThreadCount;
+
+protected:
+    ThreadPool();
+    ~ThreadPool();
+
+public:
+    ThreadPool(ThreadPool& other) = delete;
+    void operator=(const ThreadPool&) = delete;
+
+    static ThreadPool* GetInstance();
+    // Threads the pool is created with (0 for one per hardware thread). Only has an effect before the
+    // first GetInstance(); processes that run next to many others of their kind ask for 1.
+    static void SetThreadCount(unsigned int count);
+
+    // Calls job(i) for every i in [0, count) and returns once all calls have finished.
+    // The calling thread takes part in the work. Calls from several threads at once each queue their own
+    // submission and the workers help with them in order. Calls made from inside a job run serially.
+    void ParallelFor(size_t count, const std::function<void(size_t)>& job);
+
+    // Number of threads that execute a ParallelFor (workers plus the calling thread).
+    unsigned int GetThreadCount() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    // Lets only the calling thread and limit - 1 workers take part in the following ParallelFor calls
+    // (0 for all of them). For measuring how work scales with the core count.
+    void SetThreadLimit(unsigned int limit) { threadLimit = limit; }
+    unsigned int GetThreadLimit() const { return threadLimit; }
+
+private:
+    // One ParallelFor call, owned by the calling thread's stack until all its items have finished.
+    struct Submission
+    {
+        const std::function<void(size_t)>* job = nullptr;
+        size_t count = 0;
+        std::atomic<size_t> nextIndex{ 0 };
+        std::atomic<size_t> completedCount{ 0 };
+        unsigned int activeWorkers = 0;
+    };
+
+    void WorkerLoop(unsigned int index);
+    void RunJobs(Submission& submission);
+    // First queued submission with items left to claim, dropping the used up ones. Needs jobMutex.
+    Submission* NextSubmission();
+
+    std::vector<std::thread> workers;
+    std::mutex jobMutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobFinished;
+    bool shuttingDown = false;
+
+    // ParallelFor calls with items the workers can still help with, oldest first.
+    std::deque<Submission*> submissions;
+    std::atomic<unsigned int> threadLimit{ 0 };
+};
@@ -0,0 +1,387 @@
+#include "stdafx.h"
+#include "TransformBatch.h"
+
+#include "VectorMath.h"
+
+namespace
+{
+    // One constant buffer slot, as VoyagerEngine::wvpConstantBuffer.
+    struct SlotConstants
+    {
+        DirectX::XMFLOAT4X4 wvpMat;
+        DirectX::XMFLOAT4X4 worldMat;
+        DirectX::XMFLOAT4X4 viewMat;
+        DirectX::XMFLOAT4X4 projectionMat;
+    };
+
+    static_assert(sizeof(TransformComponent) == 12 * sizeof(float), "The loads expect a transform of 12 floats.");
+
+    // Arithmetic of one register of Width entities.
+    template<int Width>
+    struct Lanes;
+
+    template<>
+    struct Lanes<8>
+    {
+        typedef __m256 Vector;
+        static Vector Set(float value) { return _mm256_set1_ps(value); }
+        static Vector Add(Vector a, Vector b) { return _mm256_add_ps(a, b); }
+        static Vector Sub(Vector a, Vector b) { return _mm256_sub_ps(a, b); }
+        static Vector Mul(Vector a, Vector b) { return _mm256_mul_ps(a, b); }
+        static Vector MulAdd(Vector a, Vector b, Vector c) { return _mm256_fmadd_ps(a, b, c); }
+    };
+
+    template<>
+    struct Lanes<16>
+    {
+        typedef __m512 Vector;
+        static Vector Set(float value) { return _mm512_set1_ps(value); }
+        static Vector Add(Vector a, Vector b) { return _mm512_add_ps(a, b); }
+        static Vector Sub(Vector a, Vector b) { return _mm512_sub_ps(a, b); }
+        static Vector Mul(Vector a, Vector b) { return _mm512_mul_ps(a, b); }
+        static Vector MulAdd(Vector a, Vector b, Vector c) { return _mm512_fmadd_ps(a, b, c); }
+    };
+
+    // Rows of the rotation matrix of unit quaternions (as XMMatrixRotationQuaternion), row-major.
+    template<int Width>
+    void RotationRows(typename Lanes<Width>::Vector x, typename Lanes<Width>::Vector y, typename Lanes<Width>::Vector z, typename Lanes<Width>::Vector w,
+        typename Lanes<Width>::Vector* rows)
+    {
+        typedef Lanes<Width> L;
+        typename L::Vector one = L::Set(1.0f);
+        typename L::Vector x2 = L::Add(x, x), y2 = L::Add(y, y), z2 = L::Add(z, z);
+        typename L::Vector xx = L::Mul(x, x2), yy = L::Mul(y, y2), zz = L::Mul(z, z2);
+        typename L::Vector xy = L::Mul(x, y2), xz = L::Mul(x, z2), yz = L::Mul(y, z2);
+        typename L::Vector wx = L::Mul(w, x2), wy = L::Mul(w, y2), wz = L::Mul(w, z2);
+        rows[0] = L::Sub(one, L::Add(yy, zz));
+        rows[1] = L::Add(xy, wz);
+        rows[2] = L::Sub(xz, wy);
+        rows[3] = L::Sub(xy, wz);
+        rows[4] = L::Sub(one, L::Add(xx, zz));
+        rows[5] = L::Add(yz, wx);
+        rows[6] = L::Add(xz, wy);
+        rows[7] = L::Sub(yz, wx);
+        rows[8] = L::Sub(one, L::Add(xx, yy));
+    }
+
+    // ComposeWorldMatrix() of Width entities. Input is one register per transform value (rotation, orbit,
+    // position, scale), output one per matrix element, row-major.
+    template<int Width>
+    void ComposeLanes(const typename Lanes<Width>::Vector* transform, typename Lanes<Width>::Vector* world)
+    {
+        typedef Lanes<Width> L;
+        typename L::Vector rotation[9], orbit[9];
+        RotationRows<Width>(transform[0], transform[1], transform[2], transform[3], rotation);
+        RotationRows<Width>(transform[4], transform[5], transform[6], transform[7], orbit);
+        typename L::Vector scale = transform[11];
+
+        // Scaled rotation, then the orbit; the translation only moves the last row.
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                typename L::Vector sum = L::Mul(rotation[i * 3], orbit[j]);
+                sum = L::MulAdd(rotation[i * 3 + 1], orbit[3 + j], sum);
+                sum = L::MulAdd(rotation[i * 3 + 2], orbit[6 + j], sum);
+                world[i * 4 + j] = L::Mul(sum, scale);
+            }
+            world[i * 4 + 3] = L::Set(0.0f);
+        }
+        for (int j = 0; j < 3; j++) {
+            typename L::Vector sum = L::Mul(transform[8], orbit[j]);
+            sum = L::MulAdd(transform[9], orbit[3 + j], sum);
+            world[12 + j] = L::MulAdd(transform[10], orbit[6 + j], sum);
+        }
+        world[15] = L::Set(1.0f);
+    }
+
+    // WVP matrix of Width world matrices, one register per element, row-major.
+    template<int Width>
+    void ProjectLanes(const typename Lanes<Width>::Vector* world, const typename Lanes<Width>::Vector* viewProjection, typename Lanes<Width>::Vector* wvp)
+    {
+        typedef Lanes<Width> L;
+        // The last column of the world matrix is (0, 0, 0, 1).
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                typename L::Vector sum = L::Mul(world[i * 4], viewProjection[j]);
+                sum = L::MulAdd(world[i * 4 + 1], viewProjection[4 + j], sum);
+                sum = L::MulAdd(world[i * 4 + 2], viewProjection[8 + j], sum);
+                wvp[i * 4 + j] = i == 3 ? L::Add(sum, viewProjection[12 + j]) : sum;
+            }
+        }
+    }
+
+    // Eight transforms to one register per value.
+    void LoadTransforms8(const TransformComponent* transforms, __m256* values)
+    {
+        const float* source = reinterpret_cast<const float*>(transforms);
+        // Floats 0-7 of every transform hold the rotation (and the orbit), 4-11 the orbit, position and scale.
+        __m256 a[8], b[8];
+        for (int i = 0; i < 8; i++) {
+            a[i] = _mm256_loadu_ps(source + 12 * i);
+            b[i] = _mm256_loadu_ps(source + 12 * i + 4);
+        }
+        VectorMath::Transpose8(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+        VectorMath::Transpose8(b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7]);
+        for (int v = 0; v < 4; v++)
+            values[v] = a[v];
+        for (int v = 0; v < 8; v++)
+            values[4 + v] = b[v];
+    }
+
+    // Eight world matrices to one register per element.
+    void LoadWorlds8(const WorldMatrixComponent* worlds, __m256* elements)
+    {
+        __m256 low[8], high[8];
+        for (int i = 0; i < 8; i++) {
+            low[i] = _mm256_loadu_ps(&worlds[i].world.m[0][0]);
+            high[i] = _mm256_loadu_ps(&worlds[i].world.m[2][0]);
+        }
+        VectorMath::Transpose8(low[0], low[1], low[2], low[3], low[4], low[5], low[6], low[7]);
+        VectorMath::Transpose8(high[0], high[1], high[2], high[3], high[4], high[5], high[6], high[7]);
+        for (int v = 0; v < 8; v++) {
+            elements[v] = low[v];
+            elements[8 + v] = high[v];
+        }
+    }
+
+    // Sixteen matrix elements of eight entities to eight matrices of 16 floats, in element order.
+    void TransposeMatrices8(const __m256* elements, __m256* low, __m256* high)
+    {
+        for (int v = 0; v < 8; v++) {
+            low[v] = elements[v];
+            high[v] = elements[8 + v];
+        }
+        VectorMath::Transpose8(low[0], low[1], low[2], low[3], low[4], low[5], low[6], low[7]);
+        VectorMath::Transpose8(high[0], high[1], high[2], high[3], high[4], high[5], high[6], high[7]);
+    }
+
+    // Worlds can be nullptr, when the world matrices are stored already.
+    void StoreMatrices8(const __m256* world, const __m256* wvp, const __m256* viewProjectionSlot, const RenderableComponent* renderables,
+        WorldMatrixComponent* worlds, uint8_t* constantBuffer, size_t slotStride)
+    {
+        // The GPU takes the matrices transposed: element (r, c) of the slot is element (c, r).
+        __m256 wvpTransposed[16], worldTransposed[16];
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++) {
+                wvpTransposed[r * 4 + c] = wvp[c * 4 + r];
+                worldTransposed[r * 4 + c] = world[c * 4 + r];
+            }
+        }
+
+        __m256 low[8], high[8];
+        if (worlds != nullptr) {
+            TransposeMatrices8(world, low, high);
+            for (int i = 0; i < 8; i++) {
+                float* destination = &worlds[i].world.m[0][0];
+                _mm256_storeu_ps(destination, low[i]);
+                _mm256_storeu_ps(destination + 8, high[i]);
+            }
+        }
+
+        TransposeMatrices8(wvpTransposed, low, high);
+        for (int i = 0; i < 8; i++) {
+            float* slot = reinterpret_cast<float*>(constantBuffer + renderables[i].object * slotStride);
+            _mm256_stream_ps(slot, low[i]);
+            _mm256_stream_ps(slot + 8, high[i]);
+        }
+        TransposeMatrices8(worldTransposed, low, high);
+        for (int i = 0; i < 8; i++) {
+            float* slot = reinterpret_cast<float*>(constantBuffer + renderables[i].object * slotStride);
+            _mm256_stream_ps(slot + 16, low[i]);
+            _mm256_stream_ps(slot + 24, high[i]);
+            for (int v = 0; v < 4; v++)
+                _mm256_stream_ps(slot + 32 + 8 * v, viewProjectionSlot[v]);
+        }
+    }
+
+    __m512 Combine(__m256 low, __m256 high)
+    {
+        return _mm512_castpd_ps(_mm512_insertf64x4(_mm512_castpd256_pd512(_mm256_castps_pd(low)), _mm256_castps_pd(high), 1));
+    }
+
+    __m256 LowHalf(__m512 value)
+    {
+        return _mm512_castps512_ps256(value);
+    }
+
+    __m256 HighHalf(__m512 value)
+    {
+        return _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(value), 1));
+    }
+}
+
+TransformBatch::Path TransformBatch::GetBestPath()
+{
+    if (VectorMath::HasAvx512())
+        return Path::Avx512;
+    if (VectorMath::HasAvx2())
+        return Path::Avx2;
+    return Path::Scalar;
+}
+
+const char* TransformBatch::GetPathName(Path path)
+{
+    switch (path) {
+    case Path::Avx2:
+        return "AVX2";
+    case Path::Avx512:
+        return "AVX-512";
+    default:
+        return "scalar";
+    }
+}
+
+void TransformBatch::Compute(Path path, size_t count, const TransformComponent* transforms, const RenderableComponent* renderables,
+    WorldMatrixComponent* worlds, const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride)
+{
+    path = Supported(path);
+    if (path == Path::Scalar) {
+        ComputeScalar(count, transforms, renderables, worlds, frame, constantBuffer, slotStride);
+        return;
+    }
+    if ((reinterpret_cast<uintptr_t>(constantBuffer) | slotStride) % 32 != 0)
+        throw "Constant buffer slots have to be 32 byte aligned!";
+
+    const float* viewProjection = &frame.viewProjection.m[0][0];
+    __m256 viewProjectionSlot[4] = {
+        _mm256_loadu_ps(&frame.viewTransposed.m[0][0]), _mm256_loadu_ps(&frame.viewTransposed.m[2][0]),
+        _mm256_loadu_ps(&frame.projectionTransposed.m[0][0]), _mm256_loadu_ps(&frame.projectionTransposed.m[2][0])
+    };
+
+    size_t i = 0;
+    if (path == Path::Avx512) {
+        __m512 viewProjection16[16];
+        for (int e = 0; e < 16; e++)
+            viewProjection16[e] = _mm512_set1_ps(viewProjection[e]);
+        for (; i + 16 <= count; i += 16) {
+            __m256 low[12], high[12];
+            LoadTransforms8(transforms + i, low);
+            LoadTransforms8(transforms + i + 8, high);
+            __m512 values[12], world[16], wvp[16];
+            for (int v = 0; v < 12; v++)
+                values[v] = Combine(low[v], high[v]);
+            ComposeLanes<16>(values, world);
+            ProjectLanes<16>(world, viewProjection16, wvp);
+
+            __m256 worldHalf[16], wvpHalf[16];
+            for (int e = 0; e < 16; e++) {
+                worldHalf[e] = LowHalf(world[e]);
+                wvpHalf[e] = LowHalf(wvp[e]);
+            }
+            StoreMatrices8(worldHalf, wvpHalf, viewProjectionSlot, renderables + i, worlds + i, constantBuffer, slotStride);
+            for (int e = 0; e < 16; e++) {
+                worldHalf[e] = HighHalf(world[e]);
+                wvpHalf[e] = HighHalf(wvp[e]);
+            }
+            StoreMatrices8(worldHalf, wvpHalf, viewProjectionSlot, renderables + i + 8, worlds + i + 8, constantBuffer, slotStride);
+        }
+    }
+
+    __m256 viewProjection8[16];
+    for (int e = 0; e < 16; e++)
+        viewProjection8[e] = _mm256_set1_ps(viewProjection[e]);
+    for (; i + 8 <= count; i += 8) {
+        __m256 values[12], world[16], wvp[16];
+        LoadTransforms8(transforms + i, values);
+        ComposeLanes<8>(values, world);
+        ProjectLanes<8>(world, viewProjection8, wvp);
+        StoreMatrices8(world, wvp, viewProjectionSlot, renderables + i, worlds + i, constantBuffer, slotStride);
+    }
+
+    ComputeScalar(count - i, transforms + i, renderables + i, worlds + i, frame, constantBuffer, slotStride);
+    // The streamed slots are complete before the command list is submitted.
+    _mm_sfence();
+}
+
+void TransformBatch::ComputeScalar(size_t count, const TransformComponent* transforms, const RenderableComponent* renderables,
+    WorldMatrixComponent* worlds, const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride)
+{
+    DirectX::XMMATRIX viewProjection = DirectX::XMLoadFloat4x4(&frame.viewProjection);
+    SlotConstants constants;
+    constants.viewMat = frame.viewTransposed;
+    constants.projectionMat = frame.projectionTransposed;
+    for (size_t i = 0; i < count; i++) {
+        DirectX::XMMATRIX worldMat = ComposeWorldMatrix(transforms[i]);
+        DirectX::XMStoreFloat4x4(&worlds[i].world, worldMat);
+        DirectX::XMStoreFloat4x4(&constants.worldMat, DirectX::XMMatrixTranspose(worldMat));
+        DirectX::XMStoreFloat4x4(&constants.wvpMat, DirectX::XMMatrixTranspose(worldMat * viewProjection));
+        memcpy(constantBuffer + renderables[i].object * slotStride, &constants, sizeof(constants));
+    }
+}
+
+void TransformBatch::Compose(Path path, size_t count, const TransformComponent* transforms, WorldMatrixComponent* worlds)
+{
+    // Without the projection and the slots there is too little work to widen to 16 lanes.
+    size_t i = 0;
+    if (Supported(path) != Path::Scalar) {
+        for (; i + 8 <= count; i += 8) {
+            __m256 values[12], world[16], low[8], high[8];
+            LoadTransforms8(transforms + i, values);
+            ComposeLanes<8>(values, world);
+            TransposeMatrices8(world, low, high);
+            for (int e = 0; e < 8; e++) {
+                float* destination = &worlds[i + e].world.m[0][0];
+                _mm256_storeu_ps(destination, low[e]);
+                _mm256_storeu_ps(destination + 8, high[e]);
+            }
+        }
+    }
+    for (; i < count; i++)
+        DirectX::XMStoreFloat4x4(&worlds[i].world, ComposeWorldMatrix(transforms[i]));
+}
+
+void TransformBatch::Project(Path path, size_t count, const WorldMatrixComponent* worlds, const RenderableComponent* renderables,
+    const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride)
+{
+    // One matrix product per entity, the 8-wide path serves both vector paths.
+    if (Supported(path) == Path::Scalar) {
+        ProjectScalar(count, worlds, renderables, frame, constantBuffer, slotStride);
+        return;
+    }
+    if ((reinterpret_cast<uintptr_t>(constantBuffer) | slotStride) % 32 != 0)
+        throw "Constant buffer slots have to be 32 byte aligned!";
+
+    const float* viewProjection = &frame.viewProjection.m[0][0];
+    __m256 viewProjectionSlot[4] = {
+        _mm256_loadu_ps(&frame.viewTransposed.m[0][0]), _mm256_loadu_ps(&frame.viewTransposed.m[2][0]),
+        _mm256_loadu_ps(&frame.projectionTransposed.m[0][0]), _mm256_loadu_ps(&frame.projectionTransposed.m[2][0])
+    };
+    __m256 viewProjection8[16];
+    for (int e = 0; e < 16; e++)
+        viewProjection8[e] = _mm256_set1_ps(viewProjection[e]);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 world[16], wvp[16];
+        LoadWorlds8(worlds + i, world);
+        ProjectLanes<8>(world, viewProjection8, wvp);
+        StoreMatrices8(world, wvp, viewProjectionSlot, renderables + i, nullptr, constantBuffer, slotStride);
+    }
+
+    ProjectScalar(count - i, worlds + i, renderables + i, frame, constantBuffer, slotStride);
+    _mm_sfence();
+}
+
+void TransformBatch::ProjectScalar(size_t count, const WorldMatrixComponent* worlds, const RenderableComponent* renderables,
+    const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride)
+{
+    DirectX::XMMATRIX viewProjection = DirectX::XMLoadFloat4x4(&frame.viewProjection);
+    SlotConstants constants;
+    constants.viewMat = frame.viewTransposed;
+    constants.projectionMat = frame.projectionTransposed;
+    for (size_t i = 0; i < count; i++) {
+        DirectX::XMMATRIX worldMat = DirectX::XMLoadFloat4x4(&worlds[i].world);
+        DirectX::XMStoreFloat4x4(&constants.worldMat, DirectX::XMMatrixTranspose(worldMat));
+        DirectX::XMStoreFloat4x4(&constants.wvpMat, DirectX::XMMatrixTranspose(worldMat * viewProjection));
+        memcpy(constantBuffer + renderables[i].object * slotStride, &constants, sizeof(constants));
+    }
+}
+
+TransformBatch::Path TransformBatch::Supported(Path path)
+{
+    // Never wider than the CPU.
+    if (path == Path::Avx512 && !VectorMath::HasAvx512())
+        path = Path::Avx2;
+    if (path == Path::Avx2 && !VectorMath::HasAvx2())
+        path = Path::Scalar;
+    return path;
+}
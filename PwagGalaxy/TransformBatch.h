@@ -0,0 +1,51 @@
+#pragma once
+
+#include "SceneComponents.h"
+
+// Matrices of the frame shared by every object of a batch.
+struct TransformBatchFrame
+{
+    DirectX::XMFLOAT4X4 viewProjection;
+    // Copied into every constant buffer slot, already transposed for the GPU.
+    DirectX::XMFLOAT4X4 viewTransposed;
+    DirectX::XMFLOAT4X4 projectionTransposed;
+};
+
+// World and WVP matrices of many entities at once. The transforms of 8 (AVX2) or 16 (AVX-512) entities
+// are transposed into one register per value, composed there (ComposeWorldMatrix() lane by lane) and
+// transposed back; the constant buffer slots are written with non-temporal stores, the GPU reads them
+// and the CPU never does. The scalar path is the DirectXMath reference.
+class TransformBatch
+{
+public:
+    enum class Path
+    {
+        Scalar,
+        Avx2,
+        Avx512
+    };
+
+    // The widest path the CPU supports.
+    static Path GetBestPath();
+    static const char* GetPathName(Path path);
+
+    // Writes the world matrices of count entities into worlds and fills their constant buffer slots with
+    // the transposed WVP, world, view and projection matrices (the layout of VoyagerEngine::wvpConstantBuffer).
+    // The slot of entity i starts at constantBuffer + renderables[i].object * slotStride and has to be
+    // 32 byte aligned.
+    static void Compute(Path path, size_t count, const TransformComponent* transforms, const RenderableComponent* renderables,
+        WorldMatrixComponent* worlds, const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride);
+    // Only the world matrices, for entities whose slots are not written (culled ones).
+    static void Compose(Path path, size_t count, const TransformComponent* transforms, WorldMatrixComponent* worlds);
+    // Same slots from world matrices that did not change, only the WVP matrix is multiplied again.
+    static void Project(Path path, size_t count, const WorldMatrixComponent* worlds, const RenderableComponent* renderables,
+        const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride);
+
+private:
+    static void ComputeScalar(size_t count, const TransformComponent* transforms, const RenderableComponent* renderables,
+        WorldMatrixComponent* worlds, const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride);
+    static void ProjectScalar(size_t count, const WorldMatrixComponent* worlds, const RenderableComponent* renderables,
+        const TransformBatchFrame& frame, uint8_t* constantBuffer, size_t slotStride);
+    // The path that is used for a request on this CPU.
+    static Path Supported(Path path);
+};
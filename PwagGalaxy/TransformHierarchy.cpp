@@ -0,0 +1,219 @@
+#include "stdafx.h"
+#include "TransformHierarchy.h"
+
+const uint32_t TransformHierarchy::NoNode;
+
+uint32_t TransformHierarchy::Add(const DirectX::XMFLOAT4X4& local, uint32_t parent, Inherit inherit)
+{
+    if (parent != NoNode && parent >= records.size())
+        throw "Unknown parent node!";
+
+    uint32_t node = static_cast<uint32_t>(records.size());
+    uint32_t depth = parent == NoNode ? 0 : records[parent].depth + 1;
+    while (levelStarts.size() < depth + 2)
+        levelStarts.push_back(levelStarts.back());
+
+    // Appended to the deepest depth, then moved up to its own.
+    uint32_t index = static_cast<uint32_t>(locals.size());
+    locals.push_back(local);
+    worlds.push_back(local);
+    parents.push_back(NoNode);
+    nodes.push_back(node);
+    flags.push_back(Dirty | (inherit == Inherit::Position ? PositionOnly : 0));
+    levelStarts.back()++;
+    NodeRecord record = { index, depth, NoNode, NoNode, NoNode, NoNode };
+    records.push_back(record);
+    Link(node, parent);
+
+    std::vector<uint32_t> moved;
+    MoveToDepth(index, static_cast<uint32_t>(levelStarts.size() - 2), depth, moved);
+    FixParents(moved);
+    parents[records[node].index] = parent == NoNode ? NoNode : records[parent].index;
+    return node;
+}
+
+void TransformHierarchy::SetParent(uint32_t node, uint32_t parent)
+{
+    if (node >= records.size() || (parent != NoNode && parent >= records.size()))
+        throw "Unknown node!";
+    if (records[node].parent == parent)
+        return;
+    for (uint32_t ancestor = parent; ancestor != NoNode; ancestor = records[ancestor].parent) {
+        if (ancestor == node)
+            throw "A node cannot be moved below its own subtree!";
+    }
+
+    Unlink(node);
+    Link(node, parent);
+
+    // Only a new depth moves nodes: the subtree shifts by the same number of depths, each node by one
+    // position per depth it crosses (plus one node of every depth in between).
+    int32_t shift = static_cast<int32_t>(parent == NoNode ? 0 : records[parent].depth + 1) - static_cast<int32_t>(records[node].depth);
+    std::vector<uint32_t> moved;
+    if (shift != 0) {
+        std::vector<uint32_t> subtree(1, node);
+        uint32_t deepest = records[node].depth;
+        for (size_t s = 0; s < subtree.size(); s++) {
+            deepest = std::max(deepest, records[subtree[s]].depth);
+            for (uint32_t child = records[subtree[s]].firstChild; child != NoNode; child = records[child].nextSibling)
+                subtree.push_back(child);
+        }
+        while (static_cast<int64_t>(levelStarts.size()) < static_cast<int64_t>(deepest) + shift + 2)
+            levelStarts.push_back(levelStarts.back());
+
+        for (uint32_t member : subtree) {
+            uint32_t depth = static_cast<uint32_t>(static_cast<int32_t>(records[member].depth) + shift);
+            MoveToDepth(records[member].index, records[member].depth, depth, moved);
+            records[member].depth = depth;
+        }
+        // Depths the subtree left empty at the bottom.
+        while (levelStarts.size() > 1 && levelStarts[levelStarts.size() - 2] == levelStarts.back())
+            levelStarts.pop_back();
+        FixParents(moved);
+    }
+
+    uint32_t index = records[node].index;
+    parents[index] = parent == NoNode ? NoNode : records[parent].index;
+    flags[index] |= Dirty;
+}
+
+void TransformHierarchy::SetLocal(uint32_t node, const DirectX::XMFLOAT4X4& local)
+{
+    uint32_t index = records[node].index;
+    locals[index] = local;
+    flags[index] |= Dirty;
+}
+
+size_t TransformHierarchy::Propagate()
+{
+    // The parent of index i is finished before i, its Updated flag already belongs to this pass.
+    size_t updated = 0;
+    for (size_t i = 0; i < locals.size(); i++) {
+        uint8_t flag = flags[i];
+        uint32_t parent = parents[i];
+        if ((flag & Dirty) == 0 && (parent == NoNode || (flags[parent] & Updated) == 0)) {
+            flags[i] = flag & PositionOnly;
+            continue;
+        }
+
+        DirectX::XMMATRIX world = DirectX::XMLoadFloat4x4(&locals[i]);
+        if (parent != NoNode) {
+            DirectX::XMMATRIX parentWorld = DirectX::XMLoadFloat4x4(&worlds[parent]);
+            if (flag & PositionOnly)
+                world.r[3] = DirectX::XMVectorSelect(world.r[3], DirectX::XMVectorAdd(world.r[3], parentWorld.r[3]), DirectX::g_XMSelect1110);
+            else
+                world = DirectX::XMMatrixMultiply(world, parentWorld);
+        }
+        DirectX::XMStoreFloat4x4(&worlds[i], world);
+        flags[i] = (flag & PositionOnly) | Updated;
+        updated++;
+    }
+    return updated;
+}
+
+void TransformHierarchy::Link(uint32_t node, uint32_t parent)
+{
+    NodeRecord& record = records[node];
+    record.parent = parent;
+    record.previousSibling = NoNode;
+    record.nextSibling = NoNode;
+    if (parent == NoNode)
+        return;
+
+    uint32_t next = records[parent].firstChild;
+    if (next != NoNode)
+        records[next].previousSibling = node;
+    record.nextSibling = next;
+    records[parent].firstChild = node;
+}
+
+void TransformHierarchy::Unlink(uint32_t node)
+{
+    NodeRecord& record = records[node];
+    if (record.previousSibling != NoNode)
+        records[record.previousSibling].nextSibling = record.nextSibling;
+    else if (record.parent != NoNode)
+        records[record.parent].firstChild = record.nextSibling;
+    if (record.nextSibling != NoNode)
+        records[record.nextSibling].previousSibling = record.previousSibling;
+    record.parent = NoNode;
+    record.previousSibling = NoNode;
+    record.nextSibling = NoNode;
+}
+
+void TransformHierarchy::MoveToDepth(uint32_t index, uint32_t fromDepth, uint32_t toDepth, std::vector<uint32_t>& moved)
+{
+    if (fromDepth == toDepth)
+        return;
+
+    // The node leaves a hole, which travels depth by depth: a node at the far end of every depth in
+    // between fills it and leaves its own hole at the near end of the next one.
+    DirectX::XMFLOAT4X4 local = locals[index];
+    DirectX::XMFLOAT4X4 world = worlds[index];
+    uint32_t parent = parents[index];
+    uint32_t node = nodes[index];
+    uint8_t flag = flags[index];
+
+    uint32_t hole;
+    if (toDepth > fromDepth) {
+        hole = levelStarts[fromDepth + 1] - 1;
+        if (hole != index)
+            MoveSlot(hole, index, moved);
+        for (uint32_t depth = fromDepth + 1; depth <= toDepth; depth++) {
+            // The hole is the first slot of this depth now.
+            levelStarts[depth]--;
+            if (depth < toDepth) {
+                uint32_t last = levelStarts[depth + 1] - 1;
+                if (last != hole)
+                    MoveSlot(last, hole, moved);
+                hole = last;
+            }
+        }
+    }
+    else {
+        hole = levelStarts[fromDepth];
+        if (hole != index)
+            MoveSlot(hole, index, moved);
+        for (uint32_t depth = fromDepth; depth > toDepth; depth--) {
+            // The hole is the last slot of the depth above now.
+            levelStarts[depth]++;
+            if (depth - 1 > toDepth) {
+                uint32_t first = levelStarts[depth - 1];
+                if (first != hole)
+                    MoveSlot(first, hole, moved);
+                hole = first;
+            }
+        }
+    }
+
+    locals[hole] = local;
+    worlds[hole] = world;
+    parents[hole] = parent;
+    nodes[hole] = node;
+    flags[hole] = flag;
+    records[node].index = hole;
+    moved.push_back(hole);
+}
+
+void TransformHierarchy::MoveSlot(uint32_t from, uint32_t to, std::vector<uint32_t>& moved)
+{
+    locals[to] = locals[from];
+    worlds[to] = worlds[from];
+    parents[to] = parents[from];
+    nodes[to] = nodes[from];
+    flags[to] = flags[from];
+    records[nodes[to]].index = to;
+    moved.push_back(to);
+}
+
+void TransformHierarchy::FixParents(const std::vector<uint32_t>& moved)
+{
+    // The parent indices of the moved nodes and of their children point to where the nodes were.
+    for (uint32_t index : moved) {
+        uint32_t node = nodes[index];
+        uint32_t parent = records[node].parent;
+        parents[index] = parent == NoNode ? NoNode : records[parent].index;
+        for (uint32_t child = records[node].firstChild; child != NoNode; child = records[child].nextSibling)
+            parents[records[child].index] = index;
+    }
+}
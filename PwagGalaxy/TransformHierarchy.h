@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+
+// Parent/child placement of scene nodes (moons around planets, planets around stars, stations, several
+// stars in one system). The nodes are kept in flat arrays sorted by depth, the roots first, then all their
+// children, then the grandchildren, so a parent always comes before its children. Propagate() is then one
+// linear pass over the arrays: every world matrix is the local matrix times the world matrix of a parent
+// that was finished earlier in the same pass, no recursion and no pointer chasing.
+// Node handles stay the same when re-parenting moves nodes between depths; only the nodes whose local
+// matrix changed since the last Propagate(), and the subtrees below them, are multiplied again.
+class TransformHierarchy
+{
+public:
+    static const uint32_t NoNode = UINT32_MAX;
+
+    // What a child takes over from the world matrix of its parent.
+    enum class Inherit : uint8_t
+    {
+        Full,               // Scale, rotation and translation (parts of one rigid object).
+        Position            // The translation only: moons follow the centre of their planet, not its spin.
+    };
+
+    TransformHierarchy() = default;
+
+    uint32_t Add(const DirectX::XMFLOAT4X4& local, uint32_t parent = NoNode, Inherit inherit = Inherit::Full);
+    // Moves the node and its subtree below another parent (NoNode for a root). The subtree keeps its local
+    // matrices, so it jumps with the new parent. Throws when the parent is inside the subtree.
+    void SetParent(uint32_t node, uint32_t parent);
+    void SetLocal(uint32_t node, const DirectX::XMFLOAT4X4& local);
+
+    // World matrices of the changed nodes and their subtrees. Returns how many were multiplied.
+    size_t Propagate();
+
+    const DirectX::XMFLOAT4X4& GetWorld(uint32_t node) const { return worlds[records[node].index]; }
+    const DirectX::XMFLOAT4X4& GetLocal(uint32_t node) const { return locals[records[node].index]; }
+    uint32_t GetParent(uint32_t node) const { return records[node].parent; }
+    uint32_t GetDepth(uint32_t node) const { return records[node].depth; }
+    // The world matrix was written by the last Propagate().
+    bool WasUpdated(uint32_t node) const { return (flags[records[node].index] & Updated) != 0; }
+
+    size_t GetNodeCount() const { return records.size(); }
+    size_t GetDepthCount() const { return levelStarts.size() - 1; }
+
+private:
+    static const uint8_t Dirty = 1;                 // Local matrix or parent changed.
+    static const uint8_t Updated = 2;               // Written by the last Propagate().
+    static const uint8_t PositionOnly = 4;          // Inherit::Position.
+
+    // Per node handle, where it is in the flat arrays and its place in the tree.
+    struct NodeRecord
+    {
+        uint32_t index;
+        uint32_t depth;
+        uint32_t parent;
+        uint32_t firstChild;
+        uint32_t nextSibling;
+        uint32_t previousSibling;
+    };
+
+    void Link(uint32_t node, uint32_t parent);
+    void Unlink(uint32_t node);
+    // Moves the node at index from its depth to another one. Nodes of the depths in between shift by one
+    // position each, their indices are collected in moved.
+    void MoveToDepth(uint32_t index, uint32_t fromDepth, uint32_t toDepth, std::vector<uint32_t>& moved);
+    void MoveSlot(uint32_t from, uint32_t to, std::vector<uint32_t>& moved);
+    void FixParents(const std::vector<uint32_t>& moved);
+
+    // Flat arrays in depth order, parents before children.
+    std::vector<DirectX::XMFLOAT4X4> locals;
+    std::vector<DirectX::XMFLOAT4X4> worlds;
+    std::vector<uint32_t> parents;                  // Index of the parent, NoNode for roots.
+    std::vector<uint32_t> nodes;                    // Handle of the node at every index.
+    std::vector<uint8_t> flags;
+    // The nodes of depth d are at [levelStarts[d], levelStarts[d + 1]).
+    std::vector<uint32_t> levelStarts = { 0 };
+
+    std::vector<NodeRecord> records;
+};
@@ -0,0 +1,123 @@
+#include "stdafx.h"
+#include "VectorMath.h"
+
+#include <intrin.h>
+
+namespace
+{
+    bool DetectAvx()
+    {
+        int registers[4];
+        __cpuid(registers, 1);
+        bool osxsave = (registers[2] & (1 << 27)) != 0;
+        bool avx = (registers[2] & (1 << 28)) != 0;
+        // The OS has to save the upper halves of the registers too.
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+    }
+
+    bool DetectAvx2()
+    {
+        int registers[4];
+        __cpuid(registers, 1);
+        bool fma = (registers[2] & (1 << 12)) != 0;
+        __cpuidex(registers, 7, 0);
+        bool avx2 = (registers[1] & (1 << 5)) != 0;
+        return VectorMath::HasAvx() && fma && avx2;
+    }
+
+    bool DetectAvx512()
+    {
+        int registers[4];
+        __cpuidex(registers, 7, 0);
+        bool avx512f = (registers[1] & (1 << 16)) != 0;
+        // The OS has to save the mask registers and both halves of the 512 bit registers.
+        return VectorMath::HasAvx2() && avx512f && (_xgetbv(0) & 0xE6) == 0xE6;
+    }
+}
+
+bool VectorMath::HasAvx()
+{
+    static const bool hasAvx = DetectAvx();
+    return hasAvx;
+}
+
+bool VectorMath::HasAvx2()
+{
+    static const bool hasAvx2 = DetectAvx2();
+    return hasAvx2;
+}
+
+bool VectorMath::HasAvx512()
+{
+    static const bool hasAvx512 = DetectAvx512();
+    return hasAvx512;
+}
+
+void VectorMath::SinCos8(__m256 x, __m256& sine, __m256& cosine)
+{
+    __m256 quadrant = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.636619772f)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    __m256 r = _mm256_sub_ps(x, _mm256_mul_ps(quadrant, _mm256_set1_ps(1.5703125f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(quadrant, _mm256_set1_ps(4.837512969970703125e-4f)));
+    r = _mm256_sub_ps(r, _mm256_mul_ps(quadrant, _mm256_set1_ps(7.54978995489188216e-8f)));
+    __m256 r2 = _mm256_mul_ps(r, r);
+
+    __m256 sinR = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(-1.9515295891e-4f), r2), _mm256_set1_ps(8.3321608736e-3f));
+    sinR = _mm256_add_ps(_mm256_mul_ps(sinR, r2), _mm256_set1_ps(-1.6666654611e-1f));
+    sinR = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinR, r2), r), r);
+
+    __m256 cosR = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(2.443315711809948e-5f), r2), _mm256_set1_ps(-1.388731625493765e-3f));
+    cosR = _mm256_add_ps(_mm256_mul_ps(cosR, r2), _mm256_set1_ps(4.166664568298827e-2f));
+    cosR = _mm256_mul_ps(_mm256_mul_ps(cosR, r2), r2);
+    cosR = _mm256_add_ps(_mm256_sub_ps(cosR, _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_set1_ps(1.0f));
+
+    // Quadrant 0..3: (sin, cos) is (s, c), (c, -s), (-s, -c) or (-c, s).
+    __m256 q = _mm256_sub_ps(quadrant, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(quadrant, _mm256_set1_ps(0.25f))), _mm256_set1_ps(4.0f)));
+    __m256 odd = _mm256_cmp_ps(_mm256_sub_ps(q, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(q, _mm256_set1_ps(0.5f))), _mm256_set1_ps(2.0f))), _mm256_set1_ps(1.0f), _CMP_EQ_OQ);
+    __m256 sineNegative = _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_GE_OQ);
+    __m256 cosineNegative = _mm256_or_ps(_mm256_cmp_ps(q, _mm256_set1_ps(1.0f), _CMP_EQ_OQ), _mm256_cmp_ps(q, _mm256_set1_ps(2.0f), _CMP_EQ_OQ));
+    __m256 signBit = _mm256_set1_ps(-0.0f);
+
+    sine = _mm256_xor_ps(_mm256_blendv_ps(sinR, cosR, odd), _mm256_and_ps(sineNegative, signBit));
+    cosine = _mm256_xor_ps(_mm256_blendv_ps(cosR, sinR, odd), _mm256_and_ps(cosineNegative, signBit));
+}
+
+void VectorMath::Transpose8(__m256& r0, __m256& r1, __m256& r2, __m256& r3, __m256& r4, __m256& r5, __m256& r6, __m256& r7)
+{
+    __m256 t0 = _mm256_unpacklo_ps(r0, r1);
+    __m256 t1 = _mm256_unpackhi_ps(r0, r1);
+    __m256 t2 = _mm256_unpacklo_ps(r2, r3);
+    __m256 t3 = _mm256_unpackhi_ps(r2, r3);
+    __m256 t4 = _mm256_unpacklo_ps(r4, r5);
+    __m256 t5 = _mm256_unpackhi_ps(r4, r5);
+    __m256 t6 = _mm256_unpacklo_ps(r6, r7);
+    __m256 t7 = _mm256_unpackhi_ps(r6, r7);
+    __m256 s0 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s1 = _mm256_shuffle_ps(t0, t2, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s2 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s3 = _mm256_shuffle_ps(t1, t3, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s4 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s5 = _mm256_shuffle_ps(t4, t6, _MM_SHUFFLE(3, 2, 3, 2));
+    __m256 s6 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(1, 0, 1, 0));
+    __m256 s7 = _mm256_shuffle_ps(t5, t7, _MM_SHUFFLE(3, 2, 3, 2));
+    r0 = _mm256_permute2f128_ps(s0, s4, 0x20);
+    r1 = _mm256_permute2f128_ps(s1, s5, 0x20);
+    r2 = _mm256_permute2f128_ps(s2, s6, 0x20);
+    r3 = _mm256_permute2f128_ps(s3, s7, 0x20);
+    r4 = _mm256_permute2f128_ps(s0, s4, 0x31);
+    r5 = _mm256_permute2f128_ps(s1, s5, 0x31);
+    r6 = _mm256_permute2f128_ps(s2, s6, 0x31);
+    r7 = _mm256_permute2f128_ps(s3, s7, 0x31);
+}
+
+void VectorMath::StoreInterleaved4(__m256 a, __m256 b, __m256 c, __m256 d, float* destination)
+{
+    __m128 low0 = _mm256_castps256_ps128(a), low1 = _mm256_castps256_ps128(b), low2 = _mm256_castps256_ps128(c), low3 = _mm256_castps256_ps128(d);
+    __m128 high0 = _mm256_extractf128_ps(a, 1), high1 = _mm256_extractf128_ps(b, 1), high2 = _mm256_extractf128_ps(c, 1), high3 = _mm256_extractf128_ps(d, 1);
+    _MM_TRANSPOSE4_PS(low0, low1, low2, low3);
+    _MM_TRANSPOSE4_PS(high0, high1, high2, high3);
+    // Pairs of float4s, one 32 byte store each.
+    _mm256_storeu_ps(destination, _mm256_insertf128_ps(_mm256_castps128_ps256(low0), low1, 1));
+    _mm256_storeu_ps(destination + 8, _mm256_insertf128_ps(_mm256_castps128_ps256(low2), low3, 1));
+    _mm256_storeu_ps(destination + 16, _mm256_insertf128_ps(_mm256_castps128_ps256(high0), high1, 1));
+    _mm256_storeu_ps(destination + 24, _mm256_insertf128_ps(_mm256_castps128_ps256(high2), high3, 1));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <immintrin.h>
+
+// Building blocks of the 8-wide (AVX) kernels, shared by the simulations that advance many bodies at
+// once. Callers check HasAvx() before using the others and keep a scalar path as the reference.
+class VectorMath
+{
+public:
+    // True when the CPU and the OS support AVX.
+    static bool HasAvx();
+    // True when AVX2 and FMA are supported as well.
+    static bool HasAvx2();
+    // True when the CPU and the OS support AVX-512 Foundation (16-wide registers).
+    static bool HasAvx512();
+
+    // Sine and cosine of eight angles: reduction by pi/2 in three parts, then the single precision
+    // minimax polynomials of Cephes on [-pi/4, pi/4]. About 1e-7 absolute error for the angles of a
+    // few hours of simulation.
+    static void SinCos8(__m256 x, __m256& sine, __m256& cosine);
+
+    // Transpose of an 8x8 block held as eight rows.
+    static void Transpose8(__m256& r0, __m256& r1, __m256& r2, __m256& r3, __m256& r4, __m256& r5, __m256& r6, __m256& r7);
+
+    // Four values of eight elements (one register per value) to eight float4s stored one after another.
+    static void StoreInterleaved4(__m256 a, __m256 b, __m256 c, __m256 d, float* destination);
+};
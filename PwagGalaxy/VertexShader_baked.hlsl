@@ -0,0 +1,44 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float3 direction : DIRECTION;
+    float4 lightPosition_viewSpace : LIGHT;
+    float4 vertexPosition_viewSpace : VERTVIEW;
+};
+
+struct wvpMatrixValue
+{
+    float4x4 wvpMatrix;
+    float4x4 worldMatrix;
+    float4x4 viewMatrix;
+    float4x4 projMatrix;
+};
+ConstantBuffer<wvpMatrixValue> constantRootDescriptor : register(b0);
+
+struct lightParams
+{
+    float3 lightPosition;
+};
+ConstantBuffer<lightParams> lightConstants : register(b1);
+
+
+PSInput main(float4 position : POSITION, float4 color : COLOR, float2 uv : UV, float3 normal : NORMAL)
+{
+    PSInput result;
+
+    float4 vertexPosition_worldSpace = mul(position, constantRootDescriptor.worldMatrix);
+    float4 vertexPosition_viewSpace = mul(vertexPosition_worldSpace, constantRootDescriptor.viewMatrix);
+    result.vertexPosition_viewSpace = vertexPosition_viewSpace;
+    result.position = mul(vertexPosition_viewSpace, constantRootDescriptor.projMatrix);
+
+    // The object space position is the lookup direction into the baked cube maps.
+    result.direction = position.xyz;
+
+    float4 lightPosition_viewSpace = mul(float4(lightConstants.lightPosition, 1), constantRootDescriptor.viewMatrix);
+    result.lightPosition_viewSpace = lightPosition_viewSpace;
+
+    result.color = color;
+
+    return result;
+}
@@ -0,0 +1,39 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float2 texCoord : TEXCOORD;
+};
+
+struct wvpMatrixValue
+{
+    float4x4 wvpMatrix;
+    float4x4 worldMatrix;
+    float4x4 viewMatrix;
+    float4x4 projMatrix;
+};
+ConstantBuffer<wvpMatrixValue> constantRootDescriptor : register(b0);
+
+struct ringParams
+{
+    float4 color;
+    float nearDistance;
+    float fadeWidth;
+};
+ConstantBuffer<ringParams> ringConstants : register(b1);
+
+
+PSInput main(float4 position : POSITION, float4 color : COLOR, float2 uv : UV, float3 normal : NORMAL)
+{
+    PSInput result;
+
+    float4 vertexPosition_viewSpace = mul(mul(position, constantRootDescriptor.worldMatrix), constantRootDescriptor.viewMatrix);
+    result.position = mul(position, constantRootDescriptor.wvpMatrix);
+
+    // The vertex alpha is the density of the band, it fades in where the particles fade out.
+    float fade = smoothstep(ringConstants.nearDistance - ringConstants.fadeWidth, ringConstants.nearDistance, length(vertexPosition_viewSpace.xyz));
+    result.color = float4(ringConstants.color.rgb * color.rgb, ringConstants.color.a * color.a * fade);
+    result.texCoord = uv;
+
+    return result;
+}
@@ -0,0 +1,45 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float2 texCoord : TEXCOORD;
+};
+
+struct wvpMatrixValue
+{
+    float4x4 wvpMatrix;
+    float4x4 worldMatrix;
+    float4x4 viewMatrix;
+    float4x4 projMatrix;
+};
+ConstantBuffer<wvpMatrixValue> constantRootDescriptor : register(b0);
+
+struct ringParams
+{
+    float4 color;
+    float nearDistance;
+    float fadeWidth;
+};
+ConstantBuffer<ringParams> ringConstants : register(b1);
+
+// World position and half size of every particle near the camera (see RingParticle).
+StructuredBuffer<float4> particles : register(t0);
+
+
+PSInput main(float4 position : POSITION, float4 color : COLOR, float2 uv : UV, float3 normal : NORMAL, uint instanceId : SV_InstanceID)
+{
+    PSInput result;
+    float4 particle = particles[instanceId];
+
+    // The corners of the quad are spread in view space, so it always faces the camera.
+    float4 particlePosition_viewSpace = mul(float4(particle.xyz, 1), constantRootDescriptor.viewMatrix);
+    particlePosition_viewSpace.xy += position.xy * particle.w;
+    result.position = mul(particlePosition_viewSpace, constantRootDescriptor.projMatrix);
+
+    // Fade out towards the near distance, where the annulus takes over.
+    float fade = 1.0 - smoothstep(ringConstants.nearDistance - ringConstants.fadeWidth, ringConstants.nearDistance, length(particlePosition_viewSpace.xyz));
+    result.color = float4(ringConstants.color.rgb, ringConstants.color.a * fade);
+    result.texCoord = uv;
+
+    return result;
+}
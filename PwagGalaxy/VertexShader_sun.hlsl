@@ -0,0 +1,29 @@
+struct PSInput
+{
+    float4 position : SV_POSITION;
+    float4 color : COLOR;
+    float3 direction : DIRECTION;
+};
+
+struct wvpMatrixValue
+{
+    float4x4 wvpMatrix;
+    float4x4 worldMatrix;
+    float4x4 viewMatrix;
+    float4x4 projMatrix;
+};
+ConstantBuffer<wvpMatrixValue> constantRootDescriptor : register(b0);
+
+
+PSInput main(float4 position : POSITION, float4 color : COLOR, float2 uv : UV, float3 normal : NORMAL)
+{
+    PSInput result;
+
+    result.position = mul(position, constantRootDescriptor.wvpMatrix);
+
+    // The object space position is the lookup direction into the animation cube map.
+    result.direction = position.xyz;
+    result.color = color;
+
+    return result;
+}
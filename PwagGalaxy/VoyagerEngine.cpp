@@ -16,6 +16,7 @@
 #include "EngineObject.h"
 #include <random>
 #include <limits>
+#include <algorithm>
 
 VoyagerEngine::VoyagerEngine(UINT windowWidth, UINT windowHeight, std::wstring windowName) :
     Engine(windowWidth, windowHeight, windowName)
@@ -29,6 +30,7 @@ VoyagerEngine::VoyagerEngine(UINT windowWidth, UINT windowHeight, std::wstring w
     windowCenter = { static_cast<float>(windowWidth) / 2.f, static_cast<float>(windowHeight) / 2.f };
     keyboradMovementInput = { 0, 0, 0 };
     mouseDelta = { 0, 0 };
+    transformPath = TransformBatch::GetBestPath();
 }
 
 void VoyagerEngine::OnInit(HWND windowHandle)
@@ -38,13 +40,26 @@ void VoyagerEngine::OnInit(HWND windowHandle)
     LoadPipeline();
     LoadAssets();
     LoadScene();
+    StartSimulation();
+    renderThread.Start([this](const RenderPacket& packet) {
+        RenderFrame(packet);
+    });
     std::cout << "Engine initialized." << std::endl;
 }
 
 void VoyagerEngine::OnUpdate()
 {
-    m_frameBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+    // Once the packet is free the render thread is done with frame N - 2, so the signal of frame N - 3, the
+    // last one in this slot, is queued and waiting for it is enough before the buffers of the slot are written.
+    // Present() may need the messages of the window, while the packet is not free the frame is skipped and
+    // the message loop runs again.
+    framePacket = renderThread.TryAcquire(std::chrono::milliseconds(mc_acquireTimeoutMs));
+    if (framePacket == nullptr)
+        return;
+    m_frameIndex++;
+    m_frameBufferIndex = m_frameIndex % mc_frameBufferCount;
     WaitForPreviousFrame();
+    frameStart = std::chrono::steady_clock::now();
 
     OnEarlyUpdate();
 
@@ -87,113 +102,93 @@ void VoyagerEngine::OnUpdate()
     // copy our ConstantBuffer instance to the mapped constant buffer resource
     memcpy(cbColorMultiplierGPUAddress[m_frameBufferIndex], &m_cbData, sizeof(m_cbData));
 
-    // Update object positions.
-    // create rotation matrices
-    DirectX::XMMATRIX rotXMat = DirectX::XMMatrixRotationX(0.f * deltaTime);
-    DirectX::XMMATRIX rotYMat = DirectX::XMMatrixRotationY(0.2f * deltaTime);
-    DirectX::XMMATRIX rotZMat = DirectX::XMMatrixRotationZ(0.f * deltaTime);
-
-    DirectX::XMMATRIX viewMat = DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat); // load view matrix
-    DirectX::XMMATRIX projMat = DirectX::XMLoadFloat4x4(&m_mainCamera.projMat); // load projection matrix
-
-    for (EngineObject &engineObject : engineObjects) {
-
-        DirectX::XMMATRIX rotMat = DirectX::XMLoadFloat4x4(&engineObject.rotation) * engineObject.delta_rotXMat * engineObject.delta_rotYMat * engineObject.delta_rotZMat;
-
-        // create translation matrix for cube 1 from cube 1's position vector
-        DirectX::XMMATRIX translationMat = DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat4(&engineObject.position));
-
-        if (engineObject.planetDesc){
-            // DirectX::XMMATRIX translationMatrix = DirectX::XMMatrixTranslationFromVector(DirectX::XMLoadFloat4(&engineObject.position));
-            DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationAxis(DirectX::XMLoadFloat3(&engineObject.planetDescripton.orbitAxis), engineObject.planetDescripton.velocity * engineObject.planetDescripton.orbitAngle);
-            rotMat = DirectX::XMLoadFloat4x4(&engineObject.rotation) * rotationMatrix;
-
+    // The camera steers the galaxy streaming of the next ticks and the ship is tested against the
+    // asteroids, the snapshots around now are drawn.
+    BoundingSphere shipBounds = {};
+    entityWorld.ForEachChunk<TransformComponent, WorldMatrixComponent, CameraAttachmentComponent>([&](size_t count, const TransformComponent* transforms, const WorldMatrixComponent* worlds, const CameraAttachmentComponent*) {
+        for (size_t i = 0; i < count; i++) {
+            shipBounds.center = DirectX::XMFLOAT3(worlds[i].world._41, worlds[i].world._42, worlds[i].world._43);
+            shipBounds.radius = transforms[i].scale;
         }
+    });
+    {
+        std::lock_guard<std::mutex> lock(simulationInputMutex);
+        DirectX::XMStoreFloat3(&simulationCameraPosition, m_mainCamera.camPosition);
+        simulationShipBounds = shipBounds;
+    }
+    size_t shipContacts = 0;
+    simulation.Read([&](const SimulationSnapshot& previous, const SimulationSnapshot& current, float alpha) {
+        // Orbits are a closed form of the time, interpolating the time interpolates them exactly.
+        simulationTime = previous.orbitTime + (current.orbitTime - previous.orbitTime) * alpha;
+        nearbySystems = current.nearbySystems;
+        shipContacts = current.shipAsteroidContacts;
+        UpdateAsteroidField(previous, current, alpha);
+    });
+    if ((shipContacts > 0) != shipInContact) {
+        if (shipContacts > 0)
+            std::cout << std::endl << "Ship hit the asteroid field (" << shipContacts << " rocks in contact)." << std::endl;
+        shipInContact = shipContacts > 0;
+    }
 
-        DirectX::XMStoreFloat4x4(&engineObject.rotation, rotMat);
-
-        // we want cube 2 to be half the size of cube 1, so we scale it by .5 in all dimensions
-
-        float scale = (engineObject.planetDesc) ? engineObject.planetDescripton.radius : 0.5f;
-        DirectX::XMMATRIX scaleMat =  DirectX::XMMatrixScaling(scale, scale, scale);
-
-        // create cube1's world matrix by first rotating the cube, then positioning the rotated cube
-        DirectX::XMMATRIX worldMat = scaleMat * translationMat *rotMat;
-        DirectX::XMStoreFloat4x4(&engineObject.worldMat, worldMat);
-        // store cube1's world matrix
-
-        DirectX::XMStoreFloat4x4(&m_wvpPerObject.worldMat, DirectX::XMMatrixTranspose(worldMat));
-
-        // Store the view matrix (for lighting).
-        /*DirectX::XMStoreFloat4x4(&m_wvpPerObject.viewMat, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat)));
-        DirectX::XMStoreFloat4x4(&m_wvpPerObject.projectionMat, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&m_mainCamera.projMat)));*/
-
-        // update constant buffer for cube1
-        // create the wvp matrix and store in constant buffer
-
-        DirectX::XMMATRIX wvpMat = DirectX::XMLoadFloat4x4(&engineObject.worldMat) * viewMat * projMat; // create wvp matrix
-        DirectX::XMMATRIX transposed = DirectX::XMMatrixTranspose(wvpMat); // must transpose wvp matrix for the gpu
-        DirectX::XMStoreFloat4x4(&m_wvpPerObject.wvpMat, transposed); // store transposed wvp matrix in constant buffer
-        // copy our ConstantBuffer instance to the mapped constant buffer resource
-        memcpy(m_WVPConstantBuffersGPUAddress[m_frameBufferIndex] + sizeof(m_wvpPerObject)* engineObject.idx, &m_wvpPerObject, sizeof(m_wvpPerObject));
+    UpdateSunAnimation(deltaTime);
+    UpdateGalaxy();
+    UpdateEntities();
 
-    }
+    UpdatePlanetRings();
+}
 
-    // position the ship
-    DirectX::XMVECTOR pos = m_mainCamera.camPosition;
-    pos = DirectX::XMVectorAdd(pos, DirectX::XMVectorScale(m_mainCamera.localFront, 0.8)); // move ship in front of camera
-    pos = DirectX::XMVectorAdd(pos, DirectX::XMVectorScale(m_mainCamera.localUp, -0.15)); // move ship down
-    DirectX::XMStoreFloat4(&ship.position, pos);
+void VoyagerEngine::OnRender()
+{
+    // Skipped by OnUpdate().
+    if (framePacket == nullptr)
+        return;
 
-    DirectX::XMMATRIX rotMat = DirectX::XMLoadFloat4x4(&ship.rotation);
-    rotMat = rotMat * m_mainCamera.rotMat;
-    DirectX::XMStoreFloat4x4(&ship.rotation, rotMat);
-    DirectX::XMMATRIX translationMat = DirectX::XMMatrixTranslationFromVector(pos);
-    DirectX::XMMATRIX scaleMat = DirectX::XMMatrixScaling(0.05, 0.05, 0.05);
+    // The render thread records and presents the frame (RenderFrame()) while the next one is updated.
+    BuildRenderPacket(*framePacket);
 
-    //DirectX::XMMATRIX worldMat = scaleMat * translationMat * m_mainCamera.rotMat;
-    DirectX::XMMATRIX worldMat = scaleMat * rotMat * translationMat;
-    DirectX::XMStoreFloat4x4(&ship.worldMat, worldMat);
+    frameMsSum += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    frameCount++;
 
-    DirectX::XMStoreFloat4x4(&m_wvpPerObject.worldMat, DirectX::XMMatrixTranspose(worldMat));
-    /*DirectX::XMStoreFloat4x4(&m_wvpPerObject.viewMat, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat)));
-    DirectX::XMStoreFloat4x4(&m_wvpPerObject.projectionMat, DirectX::XMMatrixTranspose(DirectX::XMLoadFloat4x4(&m_mainCamera.projMat)));*/
-    DirectX::XMMATRIX transposed = DirectX::XMMatrixTranspose(worldMat * viewMat * projMat); // must transpose wvp matrix for the gpu
-    DirectX::XMStoreFloat4x4(&m_wvpPerObject.wvpMat, transposed); // store transposed wvp matrix in constant buffer
+    renderThread.Submit();
+    framePacket = nullptr;
 
-    memcpy(m_WVPConstantBuffersGPUAddress[m_frameBufferIndex] + sizeof(m_wvpPerObject) * ship.idx, &m_wvpPerObject, sizeof(m_wvpPerObject));
+    //std::cout << "Engine rendered." << std::endl;
 }
 
-void VoyagerEngine::OnRender()
+void VoyagerEngine::RenderFrame(const RenderPacket& packet)
 {
-    //m_frameBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
-    //WaitForPreviousFrame();
-
     // Record all the commands we need to render the scene into the command list.
-    PopulateCommandList();
+    PopulateCommandList(packet);
 
     // Execute the command list.
     ID3D12CommandList* ppCommandLists[] = { m_commandList.Get() };
     m_commandQueue->ExecuteCommandLists(_countof(ppCommandLists), ppCommandLists);
-    // Set the signall fence command at the end of the command queue (it will set the value of the fence to the passed m_fenceValue).
-    m_fenceValue[m_frameBufferIndex]++;
-    ThrowIfFailed(m_commandQueue->Signal(m_fence[m_frameBufferIndex].Get(), m_fenceValue[m_frameBufferIndex]));
+    // Set the signall fence command at the end of the command queue, the game thread waits for it before
+    // it writes the buffers of this slot again.
+    ThrowIfFailed(m_commandQueue->Signal(m_fence[packet.frameSlot].Get(), packet.fenceValue));
 
     // Present the frame.
     ThrowIfFailed(m_swapChain->Present(0, 0));
-
-    //WaitForPreviousFrame();
-
-    //std::cout << "Engine rendered." << std::endl;
 }
 
 void VoyagerEngine::OnDestroy()
 {
+    simulation.Stop();
+    // Presents the frames still in the packets.
+    renderThread.Stop();
+
     // Get swapchain out out fullscreen before exiting
     BOOL fs = false;
     if (m_swapChain->GetFullscreenState(&fs, NULL))
         m_swapChain->SetFullscreenState(false, NULL);
 
+    // The fence values of the packets after a failed frame were counted but never signalled, the queue
+    // signals them after the work it has.
+    if (renderThread.HasFailed()) {
+        for (int i = 0; i < mc_frameBufferCount; i++)
+            m_commandQueue->Signal(m_fence[i].Get(), m_fenceValue[i]);
+    }
+
     // Wait for the GPU to be done with all frames.
     //WaitForPreviousFrame();
     for (int i = 0; i < mc_frameBufferCount; i++) {
@@ -253,6 +248,16 @@ void VoyagerEngine::OnKeyUp(UINT8 keyCode)
         break;
     case 0x58: // X
         useWireframe = !useWireframe;
+        break;
+    case 0x4E: // N
+        asteroidGravityToggled = true;
+        break;
+    case 0x21: // PAGE UP
+        ChangeTimeWarp(true);
+        break;
+    case 0x22: // PAGE DOWN
+        ChangeTimeWarp(false);
+        break;
     };
 }
 
@@ -264,6 +269,12 @@ void VoyagerEngine::OnMouseMove(int mouseX, int mouseY)
     }
 }
 
+void VoyagerEngine::OnMouseClick(int mouseX, int mouseY)
+{
+    if (hasFocus)
+        PickBody(mouseX, mouseY);
+}
+
 void VoyagerEngine::OnGotFocus()
 {
     hasFocus = true;
@@ -345,7 +356,7 @@ void VoyagerEngine::LoadPipeline()
 
     std::cout << "Pipeline loaded." << std::endl;
 
-    ShaderResourceHeapManager::CreateHeap(mc_frameBufferCount + 1);
+    ShaderResourceHeapManager::CreateHeap(mc_frameBufferCount + 1 + 2 * mc_maxBakedBodies + 1);
 }
 
 void VoyagerEngine::LoadAssets()
@@ -476,19 +487,21 @@ void VoyagerEngine::LoadAssets()
     {
 
         ConfigurationGenerator generator;
-        const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-        const int charsetSize = sizeof(charset) - 1;
 
-        std::string randomString;
-        randomString.reserve(10);
-        for (int i = 0; i < 10; ++i) {
-            randomString += charset[rand() % charsetSize];
+        // The home system is the one of the galaxy at the origin.
+        galaxy = Galaxy(galaxySettings);
+        GalaxySystem homeSystem = galaxy.GetHomeSystem();
+        homeSystemKey = homeSystem.key;
+        if (galaxyDatabase.Open("galaxy.bin")) {
+            if (galaxyDatabase.Matches(galaxySettings))
+                std::cout << "Galaxy database: " << galaxyDatabase.GetSystemCount() << " systems mapped." << std::endl;
+            else
+                galaxyDatabase.Close();
         }
 
-
         PlanetConfiguration solarDescriptor = generator.GeneratePlanetConfiguration("SUN", 0.0f, DirectX::XMFLOAT3(0, 0, 0));
         solarDescriptor.orbitEmptyRange = 0.0f;
-        solarDescriptor.radius = 1.0f;
+        solarDescriptor.radius = homeSystem.starRadius;
         solarDescriptor.layers[0].baseRoughness = 0.5f;
 
         //solarDescriptor.layers[0].minValue = 0.1f;
@@ -497,69 +510,57 @@ void VoyagerEngine::LoadAssets()
 
 
 
-        float orbit = solarDescriptor.radius;
-        randomString = generator.GenerateSeed(randomString);
-        for (int i = 1; i < 8; i++) {
-            std::string SID = randomString.substr(i * 8, 8);
-            std::cout << SID << std::endl;
-            PlanetConfiguration planetDescripton = generator.GeneratePlanetConfiguration(SID, orbit, DirectX::XMFLOAT3(0, 0, 0));
+        // Planets get eroded terrain. The iteration counts are the budget, so the system looks the same on
+        // every machine; the time budget, well above what they take here, only caps the load on much slower ones.
+        bakeSettings.erosion.enabled = true;
+        bakeSettings.erosion.hydraulicPasses = 4;
+        bakeSettings.erosion.thermalIterations = 16;
+        bakeSettings.erosion.timeBudgetMs = 1000.0f;
+
+        for (int i = 0; i < homeSystem.planetCount; i++) {
+            PlanetConfiguration planetDescripton = galaxy.GetPlanetConfiguration(homeSystem, i);
+            std::cout << planetDescripton.id << std::endl;
             //generator.PrintPlanetConfiguration(planetDescripton);
 
-            CreateSphere(planetDescripton, orbit);
-            orbit = EstimateNewOrbit(planetDescripton);
+            CreateSphere(planetDescripton, planetDescripton.orbit, false, false, sunObjectIndex);
         }
 
 
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_real_distribution<float> distribution(2.0f, 5.0f);
-        std::uniform_real_distribution<float> distribution2(0.01,0.04f);
-        std::uniform_real_distribution<float> distribution3(0, 15.0f);
-        for (int i = 0; i < 32; i++) {
-
-            std::string randomString2;
-            randomString2.reserve(10);
-            for (int i = 0; i < 10; ++i) {
-                randomString2 += charset[rand() % charsetSize];
-            }
-            std::string SID = "asteroida" + randomString2;
-            float random_number = distribution(gen);
-            PlanetConfiguration asteroidDesc = generator.GeneratePlanetConfiguration(SID, random_number, DirectX::XMFLOAT3(0, 0, 0));
-            for (PlanetSurfaceConfiguration &layer : asteroidDesc.layers) {
-                layer.baseRoughness = 2.0f;
-
-                layer.minValue = 0.1f;
-                layer.strength = 0.8f;
-                layer.persistance = 0.01f;
-
+        CreateAsteroidField();
+        CreatePlanetRings();
+        CreateMoons();
 
+        // One coarse sphere for all the neighbouring stars.
+        {
+            const int starResolution = 8;
+            std::vector<Vertex> starVertices;
+            std::vector<DWORD> starIndices;
+            GenerateCubeSphereGrid(starVertices, starResolution);
+            for (Vertex& vertex : starVertices) {
+                vertex.position = normalize(vertex.position);
+                vertex.normal = vertex.position;
+                vertex.color = DirectX::XMFLOAT4(1.0f, 0.85f, 0.6f, 1.0f);
             }
-
-            asteroidDesc.radius = distribution2(gen);
-
-
-
-            CreateSphere(asteroidDesc, random_number, false, true);
-
-
+            GenerateCubeSphereIndices(starIndices, starResolution);
+            galaxyStarMesh = Mesh(starVertices, starIndices);
         }
 
-
         shipMesh.CreateFromFile("ship_v1_normals_test.obj");
-        ship = EngineObject(engineObjects.size(), shipMesh);
-        //EngineObject engineObject = EngineObject(engineObjects.size(), shipMesh);
-        ship.position = DirectX::XMFLOAT4(2.f, 0.0f, 0.0f, 0.0f);
-        ship.delta_rotXMat = DirectX::XMMatrixRotationX(0.0f);
-        ship.delta_rotYMat = DirectX::XMMatrixRotationY(0.01f);
-        ship.delta_rotZMat = DirectX::XMMatrixRotationZ(0.0f);
-
-
-        DirectX::XMVECTOR posVec = DirectX::XMLoadFloat4(&ship.position);
-        DirectX::XMMATRIX tmpMat = DirectX::XMMatrixTranslationFromVector(posVec);
-        DirectX::XMStoreFloat4x4(&ship.worldMat, tmpMat);
-        DirectX::XMStoreFloat4x4(&ship.rotation, DirectX::XMMatrixIdentity());
-
-        //engineObjects.push_back(engineObject);
+        // The ship is kept in front of the camera (see UpdateEntities).
+        {
+            EngineObject ship = EngineObject(engineObjects.size(), shipMesh);
+            TransformComponent transform;
+            DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+            DirectX::XMStoreFloat4(&transform.orbit, DirectX::XMQuaternionIdentity());
+            transform.position = DirectX::XMFLOAT3(2.0f, 0.0f, 0.0f);
+            transform.scale = 0.05f;
+            WorldMatrixComponent world;
+            DirectX::XMStoreFloat4x4(&world.world, ComposeWorldMatrix(transform));
+            RenderableComponent renderable = { static_cast<uint32_t>(ship.idx), 0 };
+            CameraAttachmentComponent attachment = { 0.8f, 0.15f };
+            ship.entity = entityWorld.Create(transform, world, renderable, attachment, CreateTransformVersion());
+            engineObjects.push_back(ship);
+        }
 
         // Load the texture
         {
@@ -622,6 +623,22 @@ void VoyagerEngine::LoadMaterials()
 
     materialLit.SetShaders("VertexShader_lit.hlsl", "PixelShader_lit.hlsl");
     materialLit.CreateMaterial();
+
+    materialBakedPlanet.SetShaders("VertexShader_baked.hlsl", "PixelShader_baked.hlsl");
+    materialBakedPlanet.CreateMaterial();
+
+    materialSun.SetShaders("VertexShader_sun.hlsl", "PixelShader_sun.hlsl");
+    materialSun.CreateMaterial();
+
+    // Same pixel shader as the lit material, only the transforms come from the instance buffer.
+    materialInstanced.SetShaders("VertexShader_instanced.hlsl", "PixelShader_lit.hlsl");
+    materialInstanced.CreateMaterial();
+
+    // Both ring pipelines share the root signature layout and the round sprite pixel shader.
+    materialRingBillboard.SetShaders("VertexShader_ringBillboard.hlsl", "PixelShader_ring.hlsl");
+    materialRingBillboard.CreateMaterial();
+    materialRingParticles.SetShaders("VertexShader_ringParticles.hlsl", "PixelShader_ring.hlsl");
+    materialRingParticles.CreateMaterial();
 }
 
 void VoyagerEngine::LoadScene()
@@ -654,35 +671,144 @@ void VoyagerEngine::LoadScene()
     }
 }
 
-void VoyagerEngine::PopulateCommandList()
+void VoyagerEngine::BuildRenderPacket(RenderPacket& packet)
 {
-    // We already waited for the GPU to finish work for this framebuffer (we cannot reset a commandAllocator before it's commands have finished executing!)
-    ThrowIfFailed(m_commandAllocator[m_frameBufferIndex]->Reset());
+    // At most a draw per visible entity, asteroid template, nearby star and ring (two when near), and the star.
+    packet.Reset(sceneBounds.visible.size() + asteroidTemplates.size() + nearbySystems.size() + 2 * planetRings.size() + 1);
+    packet.frameSlot = m_frameBufferIndex;
+    packet.fenceValue = ++m_fenceValue[m_frameBufferIndex];
+
+    // draw ball
+    RenderMaterial bodyMaterial = useWireframe ? RenderMaterial::Wireframe : RenderMaterial::Lit;
+    bool anyBaked = false;
+    // Only the entities left after culling (see SceneSystems::CullEntities()).
+    for (const VisibleObject& visible : sceneBounds.visible) {
+        // Drawn with its animation below.
+        if (static_cast<int>(visible.object) == sunObjectIndex && !useWireframe)
+            continue;
+        EngineObject& engineObject = engineObjects[visible.object];
+        Mesh* mesh = &engineObject.mesh;
+        if (visible.drawBaked) {
+            // Drawn in the baked pass below (the wireframe shows the coarse mesh right away).
+            if (!useWireframe) {
+                anyBaked = true;
+                continue;
+            }
+            mesh = &engineObject.bakedMesh;
+        }
+        packet.AddDraw(bodyMaterial, mesh, engineObject.idx);
+    }
+
+    // The asteroid field, one draw per template (the wireframe material has no instanced variant).
+    if (!asteroidTemplates.empty() && !useWireframe) {
+        for (int t = 0; t < asteroidField.GetTemplateCount(); t++) {
+            if (asteroidField.GetInstanceCount(t) == 0)
+                continue;
+            RenderDraw& draw = packet.AddDraw(RenderMaterial::Instanced, &asteroidTemplates[t], mc_asteroidFieldSlot);
+            draw.instanceCount = static_cast<uint32_t>(asteroidField.GetInstanceCount(t));
+            draw.firstInstance = static_cast<uint32_t>(asteroidField.GetFirstInstance(t));
+        }
+    }
+
+    // Tiles finished this frame, staged in this frame's upload buffer by UpdateSunAnimation(). Copied in
+    // wireframe too, the animation goes on and would leave the cube map stale.
+    if (sunObjectIndex >= 0) {
+        const std::vector<SunTile>& tiles = sunAnimation.GetUpdatedTiles();
+        packet.tileCopies = packet.arena.Allocate<RenderTileCopy>(tiles.size());
+        packet.tileCopyCount = tiles.size();
+        for (size_t t = 0; t < tiles.size(); t++) {
+            packet.tileCopies[t].subresource = tiles[t].face;
+            packet.tileCopies[t].x = tiles[t].x;
+            packet.tileCopies[t].y = tiles[t].y;
+        }
+    }
+
+    // The star, its vertex colours brightened and darkened by the animation.
+    if (sunObjectIndex >= 0 && !useWireframe) {
+        SunMaterial::AnimationConstants animation;
+        animation.blend = sunAnimation.GetBlend();
+        animation.fromChannel = sunAnimation.GetFromChannel();
+        animation.toChannel = sunAnimation.GetToChannel();
+        animation.intensity = sunAnimationIntensity;
+        EngineObject& sunObject = engineObjects[sunObjectIndex];
+        RenderDraw& sun = packet.AddDraw(RenderMaterial::Sun, &sunObject.mesh, sunObject.idx);
+        packet.SetConstants(sun, animation);
+
+        // The nearest other stars of the galaxy share the coarse sphere and the animated surface.
+        for (UINT i = 0; i < nearbySystems.size(); i++) {
+            RenderDraw& star = packet.AddDraw(RenderMaterial::Sun, &galaxyStarMesh, mc_galaxyStarSlot + i);
+            star.constants = sun.constants;
+            star.constantCount = sun.constantCount;
+        }
+    }
+
+    // Far away planets: coarse mesh shaded from the baked cube maps.
+    if (anyBaked) {
+        for (const VisibleObject& visible : sceneBounds.visible) {
+            if (!visible.drawBaked)
+                continue;
+            EngineObject& engineObject = engineObjects[visible.object];
+            RenderDraw& draw = packet.AddDraw(RenderMaterial::BakedPlanet, &engineObject.bakedMesh, engineObject.idx);
+            draw.texture = engineObject.bakedNormalMap.GetOffsetInHeap();
+        }
+    }
+
+    // Planet rings last, they are blended over everything else. Far away the annulus, near the camera
+    // the particles written this frame.
+    if (!planetRings.empty() && !useWireframe) {
+        size_t firstRingDraw = packet.drawCount;
+        for (UINT r = 0; r < planetRings.size(); r++) {
+            const PlanetRing& ring = planetRings[r];
+            RingMaterial::RingConstants ringConstants;
+            ringConstants.color = ring.GetSettings().color;
+            ringConstants.nearDistance = ring.GetSettings().nearDistance * ring.GetPlanetRadius();
+            ringConstants.fadeWidth = 0.25f * ringConstants.nearDistance;
+            RenderDraw& draw = packet.AddDraw(RenderMaterial::RingBillboard, &planetRingBillboards[r], mc_planetRingSlot + r);
+            packet.SetConstants(draw, ringConstants);
+        }
+
+        if (planetRingsNear) {
+            for (UINT r = 0; r < planetRings.size(); r++) {
+                if (planetRingCount[r] == 0)
+                    continue;
+                const RenderDraw& billboard = packet.draws[firstRingDraw + r];
+                RenderDraw& draw = packet.AddDraw(RenderMaterial::RingParticles, &ringParticleQuad, mc_planetRingSlot + r);
+                draw.constants = billboard.constants;
+                draw.constantCount = billboard.constantCount;
+                draw.instanceCount = static_cast<uint32_t>(planetRingCount[r]);
+                draw.firstInstance = static_cast<uint32_t>(planetRingFirst[r]);
+            }
+        }
+    }
+}
+
+void VoyagerEngine::PopulateCommandList(const RenderPacket& packet)
+{
+    UINT slot = packet.frameSlot;
+    // Only this thread presents, the back buffer cannot change under it.
+    UINT backBufferIndex = m_swapChain->GetCurrentBackBufferIndex();
+
+    // The game thread already waited for the GPU to finish the last frame of this slot (we cannot reset a commandAllocator before it's commands have finished executing!)
+    ThrowIfFailed(m_commandAllocator[slot]->Reset());
 
     // However, when ExecuteCommandList() is called on a particular command
     // list, that command list can then be reset at any time and must be before
-    // re-recording.
-    ThrowIfFailed(m_commandList->Reset(m_commandAllocator[m_frameBufferIndex].Get(), materialLit.GetPSO().Get()));
+    // re-recording. The pipeline state is set by the first draw.
+    ThrowIfFailed(m_commandList->Reset(m_commandAllocator[slot].Get(), nullptr));
 
     // Indicate that the back buffer will be used as a render target.
-    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
+    auto barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[backBufferIndex].Get(), D3D12_RESOURCE_STATE_PRESENT, D3D12_RESOURCE_STATE_RENDER_TARGET);
     m_commandList->ResourceBarrier(1, &barrier);
 
-    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_RTVHeap->GetCPUDescriptorHandleForHeapStart(), m_frameBufferIndex, m_rtvDescriptorSize);
+    CD3DX12_CPU_DESCRIPTOR_HANDLE rtvHandle(m_RTVHeap->GetCPUDescriptorHandleForHeapStart(), backBufferIndex, m_rtvDescriptorSize);
     CD3DX12_CPU_DESCRIPTOR_HANDLE dsvHandle(m_dsHeap->GetCPUDescriptorHandleForHeapStart());
     // set the render target for the output merger stage (the output of the pipeline)
     m_commandList->OMSetRenderTargets(1, &rtvHandle, FALSE, &dsvHandle);
 
     // Set necessary state.
-    m_commandList->SetGraphicsRootSignature(materialLit.GetRootSignature().Get());
     m_commandList->RSSetViewports(1, &m_viewport);
     m_commandList->RSSetScissorRects(1, &m_scissorRect);
 
-    if (useWireframe) {
-        m_commandList->SetPipelineState(materialWireframe.GetPSO().Get());
-        m_commandList->SetGraphicsRootSignature(materialWireframe.GetRootSignature().Get());
-    }
-
     // Record commands.
     const float clearColor[] = { 0.005f, 0.005f, 0.005f, 1.0f };
     m_commandList->ClearRenderTargetView(rtvHandle, clearColor, 0, nullptr);
@@ -692,52 +818,108 @@ void VoyagerEngine::PopulateCommandList()
     // set constant buffer descriptor table heap and srv descriptor table heap
     ID3D12DescriptorHeap* descriptorHeaps[] = { ShaderResourceHeapManager::GetHeap().Get() };
     m_commandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-    // Set the root table at index 2 to the texture.
-    CD3DX12_GPU_DESCRIPTOR_HANDLE descriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(ShaderResourceHeapManager::GetHeap()->GetGPUDescriptorHandleForHeapStart());
-    if (!useWireframe) {
-        m_commandList->SetGraphicsRootDescriptorTable(2, descriptorHandle.Offset(sampleTexture.GetOffsetInHeap(), ShaderResourceHeapManager::GetDescriptorSize()));
-        m_commandList->SetGraphicsRootConstantBufferView(1, m_LigtParamConstantBuffer->GetGPUVirtualAddress());
-    }
-    //CD3DX12_GPU_DESCRIPTOR_HANDLE descriptorHandle(ShaderResourceHeapManager::GetHeap()->GetGPUDescriptorHandleForHeapStart());
-    //m_commandList->SetGraphicsRootDescriptorTable(0, descriptorHandle.Offset(m_frameBufferIndex, ShaderResourceHeapManager::GetDescriptorSize()));
 
-    // set the root descriptor table 2 to the srv
-    //descriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(ShaderResourceHeapManager::GetHeap()->GetGPUDescriptorHandleForHeapStart());
-    //m_commandList->SetGraphicsRootDescriptorTable(2, descriptorHandle.Offset(sampleTexture.GetOffsetInHeap(), ShaderResourceHeapManager::GetDescriptorSize()));
-
-    //CD3DX12_GPU_DESCRIPTOR_HANDLE descriptorHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(ShaderResourceHeapManager::GetHeap()->GetGPUDescriptorHandleForHeapStart());
-    //m_commandList->SetGraphicsRootDescriptorTable(0, descriptorHandle.Offset(m_frameBufferIndex, ShaderResourceHeapManager::GetDescriptorSize()));
+    // Finished tiles of the star surface, copied before anything samples it.
+    if (packet.tileCopyCount > 0) {
+        ID3D12Resource* sunTexture = sunAnimationMap.GetResource().Get();
+        barrier = CD3DX12_RESOURCE_BARRIER::Transition(sunTexture, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE, D3D12_RESOURCE_STATE_COPY_DEST);
+        m_commandList->ResourceBarrier(1, &barrier);
+
+        for (size_t t = 0; t < packet.tileCopyCount; t++) {
+            D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+            footprint.Offset = t * m_sunTileFootprintSize;
+            footprint.Footprint.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            footprint.Footprint.Width = sunAnimation.GetTileSize();
+            footprint.Footprint.Height = sunAnimation.GetTileSize();
+            footprint.Footprint.Depth = 1;
+            footprint.Footprint.RowPitch = m_sunTileRowPitch;
+
+            const RenderTileCopy& tile = packet.tileCopies[t];
+            CD3DX12_TEXTURE_COPY_LOCATION destination(sunTexture, tile.subresource);
+            CD3DX12_TEXTURE_COPY_LOCATION source(m_sunTileUploadBuffers[slot].Get(), footprint);
+            m_commandList->CopyTextureRegion(&destination, tile.x, tile.y, 0, &source, nullptr);
+        }
 
-    // draw ball
-    int idx = 0;
-    for (int i = 0; i < engineObjects.size(); i++) {
-        engineObjects[i].mesh.InsertBufferBind(m_commandList);
-        // set the root constant at index 0 for mvp matix
-        m_commandList->SetGraphicsRootConstantBufferView(0, m_WVPConstantBuffers[m_frameBufferIndex]->GetGPUVirtualAddress() + sizeof(wvpConstantBuffer) * engineObjects[i].idx);
-        engineObjects[i].mesh.InsertDrawIndexed(m_commandList);
+        barrier = CD3DX12_RESOURCE_BARRIER::Transition(sunTexture, D3D12_RESOURCE_STATE_COPY_DEST, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE);
+        m_commandList->ResourceBarrier(1, &barrier);
     }
 
-    // draw ship
-    ship.mesh.InsertBufferBind(m_commandList);
-    m_commandList->SetGraphicsRootConstantBufferView(0, m_WVPConstantBuffers[m_frameBufferIndex]->GetGPUVirtualAddress() + sizeof(wvpConstantBuffer) * ship.idx);
-    ship.mesh.InsertDrawIndexed(m_commandList);
-
-    //
-    //m_commandList->SetPipelineState(materialWireframe.GetPSO().Get());
-    //m_commandList->SetGraphicsRootSignature(materialWireframe.GetRootSignature().Get());
+    // The draws in the order of the packet, state is only set when it differs from the previous draw.
+    D3D12_GPU_VIRTUAL_ADDRESS wvpAddress = m_WVPConstantBuffers[slot]->GetGPUVirtualAddress();
+    const RenderDraw* previous = nullptr;
+    for (size_t d = 0; d < packet.drawCount; d++) {
+        const RenderDraw& draw = packet.draws[d];
+        // A new root signature drops the root constants, vertex and index buffers stay bound.
+        bool newMaterial = !previous || draw.material != previous->material;
+        if (newMaterial)
+            BindMaterial(draw.material);
+        if (!previous || draw.mesh != previous->mesh)
+            draw.mesh->InsertBufferBind(m_commandList);
+        if (draw.constants && (newMaterial || draw.constants != previous->constants))
+            m_commandList->SetGraphicsRoot32BitConstants(1, draw.constantCount, draw.constants, 0);
 
+        // set the root constant at index 0 for mvp matix
+        m_commandList->SetGraphicsRootConstantBufferView(0, wvpAddress + sizeof(wvpConstantBuffer) * draw.slot);
+        if (draw.texture != RenderDraw::NoTexture) {
+            CD3DX12_GPU_DESCRIPTOR_HANDLE descriptorHandle(ShaderResourceHeapManager::GetHeap()->GetGPUDescriptorHandleForHeapStart());
+            m_commandList->SetGraphicsRootDescriptorTable(3, descriptorHandle.Offset(draw.texture, ShaderResourceHeapManager::GetDescriptorSize()));
+        }
 
-    //shipMesh.InsertBufferBind(m_commandList);
-    //m_commandList->SetGraphicsRootConstantBufferView(0, m_WVPConstantBuffers[m_frameBufferIndex]->GetGPUVirtualAddress() + sizeof(wvpConstantBuffer) * planets.size());
-    //shipMesh.InsertDrawIndexed(m_commandList);
+        if (draw.instanceCount == 0) {
+            draw.mesh->InsertDrawIndexed(m_commandList);
+        }
+        else {
+            // The asteroids and the ring particles read their instances from this frame's upload buffers.
+            if (draw.material == RenderMaterial::Instanced)
+                m_commandList->SetGraphicsRootShaderResourceView(3, m_asteroidInstanceBuffers[slot]->GetGPUVirtualAddress() + sizeof(InstanceTransform) * draw.firstInstance);
+            else
+                m_commandList->SetGraphicsRootShaderResourceView(2, m_ringParticleBuffers[slot]->GetGPUVirtualAddress() + sizeof(RingParticle) * draw.firstInstance);
+            draw.mesh->InsertDrawIndexedInstanced(m_commandList, draw.instanceCount);
+        }
+        previous = &draw;
+    }
 
     // Indicate that the back buffer will now be used to present.
-    barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[m_frameBufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
+    barrier = CD3DX12_RESOURCE_BARRIER::Transition(m_renderTargets[backBufferIndex].Get(), D3D12_RESOURCE_STATE_RENDER_TARGET, D3D12_RESOURCE_STATE_PRESENT);
     m_commandList->ResourceBarrier(1, &barrier);
 
     ThrowIfFailed(m_commandList->Close());
 }
 
+void VoyagerEngine::BindMaterial(RenderMaterial material)
+{
+    Material* bound = nullptr;
+    switch (material) {
+    case RenderMaterial::Lit:           bound = &materialLit; break;
+    case RenderMaterial::Wireframe:     bound = &materialWireframe; break;
+    case RenderMaterial::BakedPlanet:   bound = &materialBakedPlanet; break;
+    case RenderMaterial::Sun:           bound = &materialSun; break;
+    case RenderMaterial::Instanced:     bound = &materialInstanced; break;
+    case RenderMaterial::RingBillboard: bound = &materialRingBillboard; break;
+    case RenderMaterial::RingParticles: bound = &materialRingParticles; break;
+    default:
+        throw "Unknown render material!";
+    }
+    m_commandList->SetPipelineState(bound->GetPSO().Get());
+    m_commandList->SetGraphicsRootSignature(bound->GetRootSignature().Get());
+
+    // Set the root table at index 2 to the texture.
+    CD3DX12_GPU_DESCRIPTOR_HANDLE descriptorHandle(ShaderResourceHeapManager::GetHeap()->GetGPUDescriptorHandleForHeapStart());
+    switch (material) {
+    case RenderMaterial::Lit:
+    case RenderMaterial::BakedPlanet:
+    case RenderMaterial::Instanced:
+        m_commandList->SetGraphicsRootDescriptorTable(2, descriptorHandle.Offset(sampleTexture.GetOffsetInHeap(), ShaderResourceHeapManager::GetDescriptorSize()));
+        m_commandList->SetGraphicsRootConstantBufferView(1, m_LigtParamConstantBuffer->GetGPUVirtualAddress());
+        break;
+    case RenderMaterial::Sun:
+        m_commandList->SetGraphicsRootDescriptorTable(2, descriptorHandle.Offset(sunAnimationMap.GetOffsetInHeap(), ShaderResourceHeapManager::GetDescriptorSize()));
+        break;
+    default:
+        break;
+    }
+}
+
 void VoyagerEngine::WaitForPreviousFrame()
 {
     // WAITING FOR THE FRAME TO COMPLETE BEFORE CONTINUING IS NOT BEST PRACTICE.
@@ -764,46 +946,78 @@ void VoyagerEngine::SetLightPosition()
 
 }
 
-void VoyagerEngine::CreateSphere(PlanetConfiguration planetDescripton, float orbit, bool sun, bool asteroid)
+void VoyagerEngine::CreateSphere(PlanetConfiguration planetDescripton, float orbit, bool sun, bool asteroid, int parent, bool allowBake)
 {
     std::vector<Vertex> triangleVertices;
     std::vector<DWORD> triangleIndices;
+    ColorGradient gradient = CreateColorGradient(engineObjects.size(), sun, asteroid);
+    float minElevation, maxElevation;
+
+    std::shared_ptr<PlanetTerrain> terrain = std::make_shared<PlanetTerrain>(planetDescripton, engineObjects.size());
+    // Planets are baked first, after erosion the bake holds the elevations for the full mesh too.
+    std::shared_ptr<PlanetBake> bake;
+    if (!sun && !asteroid && allowBake && bakedBodyCount < mc_maxBakedBodies) {
+        ErosionSettings erosion = bakeSettings.erosion;
+        erosion.seed = engineObjects.size();
+        bake = std::make_shared<PlanetBake>();
+        bake->Bake(*terrain, bakeSettings.textureResolution, erosion);
+        if (!bake->IsErosionComplete())
+            std::cout << "Erosion of " << planetDescripton.id << " ran out of time, its terrain differs from other machines." << std::endl;
+    }
 
-
-    GenerateSphereVertices(triangleVertices, triangleIndices, planetDescripton, engineObjects.size(), sun, asteroid);
+    GenerateSphereVertices(triangleVertices, triangleIndices, *terrain, bake.get(), gradient, minElevation, maxElevation, sun, asteroid);
     EngineObject engineObject = EngineObject(engineObjects.size(), Mesh(triangleVertices, triangleIndices));
-    engineObject.position = DirectX::XMFLOAT4(engineObjects.size(), 0.0f, 0.0f, 0.0f);
-
-
-    DirectX::XMFLOAT3 estimatedOrbitVector = sun? DirectX::XMFLOAT3(0,0,0) : EstimateOrbitVector(planetDescripton);
-
-
-    engineObject.position = DirectX::XMFLOAT4(
-        planetDescripton.starPosition.x + estimatedOrbitVector.x,
-        planetDescripton.starPosition.y + estimatedOrbitVector.y,
-        planetDescripton.starPosition.z + estimatedOrbitVector.z,
-        1.0f);
-
-
-
-
-    DirectX::XMVECTOR posVec = DirectX::XMLoadFloat4(&engineObject.position);
-    DirectX::XMMATRIX tmpMat = DirectX::XMMatrixTranslationFromVector(posVec);
-    DirectX::XMStoreFloat4x4(&engineObject.worldMat, tmpMat);
-
-    //planetDescripton.orbitInitialAngleRad;
-    //planetDescripton.orbitAngle
-
-
-
-
-    //DirectX::XMStoreFloat4x4(&engineObject.rotation, DirectX::XMMatrixIdentity());
     engineObject.planetDescripton = planetDescripton;
     engineObject.planetDesc = true;
 
-    DirectX::XMMATRIX rotationMatrix = DirectX::XMMatrixRotationAxis(DirectX::XMLoadFloat3(&engineObject.planetDescripton.orbitAxis), engineObject.planetDescripton.orbitInitialAngleRad);
-    DirectX::XMStoreFloat4x4(&engineObject.rotation, rotationMatrix);
+    // Placed on its Kepler orbit around the star. The configured turn per update becomes the mean motion,
+    // the initial angle the mean anomaly at time 0 and five times the orbit offset the eccentricity, at
+    // most mc_maxOrbitEccentricity (KeplerOrbit itself would allow up to MaxEccentricity).
+    DirectX::XMFLOAT3 estimatedOrbitVector = sun? DirectX::XMFLOAT3(0,0,0) : EstimateOrbitVector(planetDescripton);
+    float semiMajorAxis = std::sqrt(estimatedOrbitVector.x * estimatedOrbitVector.x + estimatedOrbitVector.y * estimatedOrbitVector.y + estimatedOrbitVector.z * estimatedOrbitVector.z);
+    DirectX::XMFLOAT3 periapsis = semiMajorAxis > 0.0f ? scale(estimatedOrbitVector, 1.0f / semiMajorAxis) : DirectX::XMFLOAT3(1, 0, 0);
+    DirectX::XMFLOAT3 focus = parent >= 0 ? DirectX::XMFLOAT3(0, 0, 0) : planetDescripton.starPosition;
+    float eccentricity = 5.0f * std::abs(planetDescripton.orbitOffset);
+    if (eccentricity > mc_maxOrbitEccentricity)
+        eccentricity = mc_maxOrbitEccentricity;
+    OrbitComponent keplerOrbit = KeplerOrbit::Create(planetDescripton.orbitAxis, periapsis, focus, semiMajorAxis,
+        eccentricity, planetDescripton.velocity * planetDescripton.orbitAngle * KeplerOrbit::ConfiguredUpdateRate,
+        planetDescripton.orbitInitialAngleRad);
+    TransformComponent transform;
+    DirectX::XMStoreFloat4(&transform.rotation, DirectX::XMQuaternionIdentity());
+    transform.scale = planetDescripton.radius;
+    KeplerOrbit::Evaluate(keplerOrbit, simulationTime, transform);
+    // The orbit is relative to the parent, which keeps only its position: moons do not spin with their planet.
+    DirectX::XMFLOAT4X4 local;
+    DirectX::XMStoreFloat4x4(&local, ComposeWorldMatrix(transform));
+    HierarchyComponent node;
+    if (parent >= 0)
+        node.node = sceneHierarchy.Add(local, entityWorld.Get<HierarchyComponent>(engineObjects[parent].entity)->node, TransformHierarchy::Inherit::Position);
+    else
+        node.node = sceneHierarchy.Add(local);
+    sceneHierarchy.Propagate();
+    WorldMatrixComponent world;
+    world.world = sceneHierarchy.GetWorld(node.node);
+    if (bake != nullptr) {
+        BakePlanet(engineObject, bake, *terrain, gradient, minElevation, maxElevation);
+    }
+    if (sun && sunObjectIndex < 0) {
+        CreateSunAnimation(engineObject.idx);
+    }
+
+    // Surface queries reuse the rendering bake, other bodies get a small elevation grid of their own.
+    std::shared_ptr<const PlanetBake> queryBake = engineObject.bake;
+    if (queryBake == nullptr) {
+        std::shared_ptr<PlanetBake> queryOnlyBake = std::make_shared<PlanetBake>();
+        queryOnlyBake->Bake(*terrain, bakeSettings.queryResolution);
+        queryBake = queryOnlyBake;
+    }
+    engineObject.surface = std::make_shared<PlanetSurfaceQuery>(terrain, queryBake);
 
+    RenderableComponent renderable = { static_cast<uint32_t>(engineObject.idx), 0 };
+    PlanetComponent planet = { planetDescripton.radius, engineObject.bake != nullptr ? 1u : 0u };
+    BoundsComponent bounds = { planetDescripton.radius * maxElevation };
+    engineObject.entity = entityWorld.Create(transform, world, keplerOrbit, renderable, planet, node, bounds, CreateTransformVersion());
     engineObjects.push_back(engineObject);
 }
 
@@ -850,22 +1064,110 @@ float randFloat() {
 
 
 
-void VoyagerEngine::GenerateSphereVertices(std::vector<Vertex>& triangleVertices, std::vector<DWORD>& triangleIndices, PlanetConfiguration planetDescripton, int id, bool sun, bool asteroid)
+void VoyagerEngine::GenerateSphereVertices(std::vector<Vertex>& triangleVertices, std::vector<DWORD>& triangleIndices, const PlanetTerrain& terrain, const PlanetBake* bake, const ColorGradient& gradient, float& minElevation, float& maxElevation, bool sun, bool asteroid, int resolution)
 {
 
-    int resolution = asteroid? 16 : 256;
+    // Asteroids need a few vertices per crater.
+    if (resolution <= 0)
+        resolution = asteroid? 40 : 256;
 
+    GenerateCubeSphereGrid(triangleVertices, resolution);
+
+    //if (!sun)
+    {
+        // Erosion only exists in the baked elevations.
+        bool useBake = bake != nullptr && bake->IsEroded();
 
+        minElevation = FLT_MAX;
+        maxElevation = FLT_MIN;
 
+        for (int i = 0; i < 6 * resolution * resolution; i++) {
+
+            float elevation = useBake ? bake->SampleHeight(triangleVertices[i].position) : terrain.EvaluateElevation(triangleVertices[i].position);
+            if (elevation > maxElevation) {
+                maxElevation = elevation;
+            }
+
+            if (elevation < minElevation) {
+                minElevation = elevation;
+            }
+
+            triangleVertices[i].position.x *= elevation;
+            triangleVertices[i].position.y *= elevation;
+            triangleVertices[i].position.z *= elevation;
 
+        }
+
+        for (int i = 0; i < 6 * resolution * resolution; i++) {
+            DirectX::XMVECTOR positionVector = DirectX::XMLoadFloat3(&triangleVertices[i].position);
+            float elevation = DirectX::XMVectorGetX(DirectX::XMVector3Length(positionVector));
+            float normalizedElevation = PlanetTerrain::NormalizeElevation(elevation, minElevation, maxElevation);
+
+            triangleVertices[i].color = PlanetTerrain::SampleGradient(gradient, normalizedElevation, triangleVertices[i].color);
+        }
+
+    }
+
+    // Indexes
+    GenerateCubeSphereIndices(triangleIndices, resolution);
+
+    // Calculate smooth normals:
+    // First, loop over all triangles and calculate per-triangle normal.
+    // Then add that normal to each vertex's normal.
+    for (int i = 0; i < triangleIndices.size() - 2; i++)
+    {
+        // Create two vectors along two edges, staring in one vetex.
+        DirectX::XMVECTOR edge1, edge2, vert1, vert2, vert3;
+        vert1 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i]].position);
+        vert2 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 1]].position);
+        vert3 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 2]].position);
+
+        edge1 = DirectX::XMVectorSubtract(vert2, vert1);
+        edge2 = DirectX::XMVectorSubtract(vert3, vert1);
+
+        // Calculate their cross product (face normal).
+        DirectX::XMVECTOR faceNormal = DirectX::XMVector3Cross(edge1, edge2);
+
+        // Add the face normal to the vertex normals.
+        DirectX::XMVECTOR normal1, normal2, normal3;
+        normal1 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i]].normal);
+        normal2 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 1]].normal);
+        normal3 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 2]].normal);
+
+        normal1 = DirectX::XMVectorAdd(normal1, faceNormal);
+        normal2 = DirectX::XMVectorAdd(normal2, faceNormal);
+        normal3 = DirectX::XMVectorAdd(normal3, faceNormal);
+
+        // Store the modified vertex normals.
+        DirectX::XMStoreFloat3(&triangleVertices[triangleIndices[i]].normal, normal1);
+        DirectX::XMStoreFloat3(&triangleVertices[triangleIndices[i + 1]].normal, normal2);
+        DirectX::XMStoreFloat3(&triangleVertices[triangleIndices[i + 2]].normal, normal3);
+    }
+
+    // Now loop over all vertices and normalize their normals (duh...).
+    // This will basically average the per-triangle normals and give smooth normals.
+    float negateNormals = 1;
+    if (sun) {
+        negateNormals = -1; // flip normals if ot's the sun!
+    }
+
+    for (int i = 0; i < triangleVertices.size(); i++)
+    {
+        DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&triangleVertices[i].normal);
+        normal = DirectX::XMVectorScale(DirectX::XMVector3Normalize(normal), negateNormals);
+        DirectX::XMStoreFloat3(&triangleVertices[i].normal, normal);
+    }
+
+    return;
+}
+
+void VoyagerEngine::GenerateCubeSphereGrid(std::vector<Vertex>& triangleVertices, int resolution)
+{
     Vertex vert;
     vert.color = DirectX::XMFLOAT4(1, 1, 0, 1);
     vert.uvCoordinates = {0.f, 0.f};
     vert.normal = { 0.f, 0.f, 0.f };
 
-
-
-
     DirectX::XMVECTOR faces[] = {
         DirectX::XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f),
         DirectX::XMVectorSet(0.0f, -1.0f, 0.0f, 0.0f),
@@ -884,7 +1186,6 @@ void VoyagerEngine::GenerateSphereVertices(std::vector<Vertex>& triangleVertices
 
         for (int y = 0; y < resolution; y++) {
             for (int x = 0; x < resolution; x++) {
-                int i = y * resolution + x;
                 float xPercent = (float)x / (resolution - 1);
                 float yPercent = (float)y / (resolution - 1);
                 float xStage = (xPercent - 0.5f) * 2.0f;
@@ -901,212 +1202,502 @@ void VoyagerEngine::GenerateSphereVertices(std::vector<Vertex>& triangleVertices
             }
         }
     }
+}
 
-    //std::uniform_real_distribution<float> distribution(-0.1f, 0.1f);
-    //std::mt19937 generator(std::random_device{}());
-
-
-    //if (!sun)
-    {
-
-
-
-        Noise noise(id);
-
-
-        float minElevation = FLT_MAX;
-        float maxElevation = FLT_MIN;
-
-
-
-        for (int i = 0; i < 6 * resolution * resolution; i++) {
-
-            float noiseValue = 0.0f;
-            float amplitude = 1.0f;
-            float frequency = planetDescripton.layers[0].baseRoughness;
-
-
-            for (int s = 0; s < planetDescripton.layers[0].steps; s++) {
-
-                DirectX::XMFLOAT3 point = DirectX::XMFLOAT3(
-                    triangleVertices[i].position.x * frequency + planetDescripton.layers[0].centre.x,
-                    triangleVertices[i].position.y * frequency + planetDescripton.layers[0].centre.y,
-                    triangleVertices[i].position.z * frequency + planetDescripton.layers[0].centre.z
-                );
-                float signal = noise.Evaluate(point);
+void VoyagerEngine::GenerateCubeSphereIndices(std::vector<DWORD>& triangleIndices, int resolution)
+{
+    triangleIndices = std::vector<DWORD>{ };
+    for (int face = 0; face < 6; face++) {
 
-                noiseValue += amplitude * (signal + 1.0f) * (0.5f);
-                frequency *= planetDescripton.layers[0].roughness;
-                amplitude *= planetDescripton.layers[0].persistance;
+        for (int y = 0; y < resolution - 1; y++) {
+            for (int x = 0; x < resolution - 1; x++) {
+                int vertexId = x + y * resolution + face* resolution* resolution;
+                triangleIndices.push_back(vertexId);
+                triangleIndices.push_back(vertexId + resolution);
+                triangleIndices.push_back(vertexId + resolution + 1);
+                triangleIndices.push_back(vertexId);
+                triangleIndices.push_back(vertexId + resolution + 1);
+                triangleIndices.push_back(vertexId + 1);
             }
-            noiseValue = (0 > (noiseValue - planetDescripton.layers[0].minValue)) ? 0.0f : noiseValue - planetDescripton.layers[0].minValue;
-            noiseValue *= planetDescripton.layers[0].strength;
+        }
+    }
+}
 
-            float planetRadius = 1.0f;
-            float elevation = planetRadius * (1 + noiseValue);
-            if (elevation > maxElevation) {
-                maxElevation = elevation;
-            }
+ColorGradient VoyagerEngine::CreateColorGradient(int id, bool sun, bool asteroid)
+{
+    ColorGradient gradient;
+    if (sun) {
+        gradient.push_back({ 0.1,  DirectX::XMFLOAT4(1, 0.15, 0, 1) });
+        gradient.push_back({ 0.5,  DirectX::XMFLOAT4(1, 0.3, 0, 1) });
+        gradient.push_back({ 0.95,  DirectX::XMFLOAT4(1, 0.15, 0, 1) });
+        gradient.push_back({ 1.0,  DirectX::XMFLOAT4(0, 0, 0, 1) });
+    }
+    else if (asteroid) {
+        gradient.push_back({ 0.1,  DirectX::XMFLOAT4(0.3, 0.3, 0.4, 1) });
+        gradient.push_back({ 1.0,  DirectX::XMFLOAT4(0.3,0.4, 0.4, 1) });
 
-            if (elevation < minElevation) {
-                minElevation = elevation;
-            }
+    }
+    else if (id == 2) {
+        gradient.push_back({ 0.2,  DirectX::XMFLOAT4(0, 0, 1, 1) });
+        gradient.push_back({ 0.3,  DirectX::XMFLOAT4(1, 1, 0, 1) });
+        gradient.push_back({ 0.5,  DirectX::XMFLOAT4(0, 1, 0, 1) });
+        gradient.push_back({ 0.8,  DirectX::XMFLOAT4(0.5, 0.25, 0, 1) });
+        gradient.push_back({ 1,  DirectX::XMFLOAT4(1, 1, 1, 1) });
 
-            triangleVertices[i].position.x *= elevation;
-            triangleVertices[i].position.y *= elevation;
-            triangleVertices[i].position.z *= elevation;
+    }
+    else {
+        gradient.push_back({ 0.2,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
+        gradient.push_back({ 0.3,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
+        gradient.push_back({ 0.5,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
+        gradient.push_back({ 0.8,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
+        gradient.push_back({ 1,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
+    }
+    return gradient;
+}
 
-        }
+void VoyagerEngine::BakePlanet(EngineObject& engineObject, std::shared_ptr<PlanetBake> bake, const PlanetTerrain& terrain, const ColorGradient& gradient, float minElevation, float maxElevation)
+{
+    // Colours use the elevation range of the full mesh, so both representations are tinted the same.
+    bake->BakeColors(gradient, minElevation, maxElevation, DirectX::XMFLOAT4(1, 1, 0, 1));
+
+#ifdef _DEBUG
+    if (!bake->IsEroded()) {
+        PlanetBakeVerification verification = bake->Verify(terrain, 4096);
+        std::cout << "Baked " << engineObject.planetDescripton.id
+            << ": texel error " << verification.maxTexelError
+            << ", sample error max " << verification.maxSampleError << " mean " << verification.meanSampleError
+            << ", normal error max " << verification.maxNormalErrorDeg << " mean " << verification.meanNormalErrorDeg << " deg" << std::endl;
+    }
+#endif
 
+    // Both views are used as one descriptor table, so they are created one after another.
+    engineObject.bakedNormalMap.CreateCubeFromTexels(bake->GetNormalTexels(), bake->GetResolution());
+    engineObject.bakedColorMap.CreateCubeFromTexels(bake->GetColorTexels(), bake->GetResolution());
 
+    // The coarse mesh only carries the silhouette, shading comes from the cube maps.
+    std::vector<Vertex> triangleVertices;
+    std::vector<DWORD> triangleIndices;
+    GenerateCubeSphereGrid(triangleVertices, bakeSettings.coarseMeshResolution);
+    for (Vertex& vertex : triangleVertices) {
+        float elevation = bake->SampleHeight(vertex.position);
+        vertex.normal = bake->SampleNormal(vertex.position);
+        vertex.color = DirectX::XMFLOAT4(1, 1, 1, 1);
+        vertex.position = scale(vertex.position, elevation);
+    }
+    GenerateCubeSphereIndices(triangleIndices, bakeSettings.coarseMeshResolution);
 
-        std::vector<std::pair<float, DirectX::XMFLOAT4>> gradient;
-        if (sun) {
-            gradient.push_back({ 0.1,  DirectX::XMFLOAT4(1, 0.15, 0, 1) });
-            gradient.push_back({ 0.5,  DirectX::XMFLOAT4(1, 0.3, 0, 1) });
-            gradient.push_back({ 0.95,  DirectX::XMFLOAT4(1, 0.15, 0, 1) });
-            gradient.push_back({ 1.0,  DirectX::XMFLOAT4(0, 0, 0, 1) });
-        }
-        else if (asteroid) {
-            gradient.push_back({ 0.1,  DirectX::XMFLOAT4(0.3, 0.3, 0.4, 1) });
-            gradient.push_back({ 1.0,  DirectX::XMFLOAT4(0.3,0.4, 0.4, 1) });
+    engineObject.bakedMesh = Mesh(triangleVertices, triangleIndices);
+    engineObject.bake = bake;
+    bakedBodyCount++;
+}
 
+void VoyagerEngine::CreateAsteroidField()
+{
+    ConfigurationGenerator generator;
+    PlanetCraterSettings asteroidCraters;
+    asteroidCraters.count = { 150, 400 };
+
+    // Every template is a rock of its own, with its own seed and craters.
+    for (int t = 0; t < asteroidFieldSettings.templateCount; t++) {
+        std::string SID = "asteroid-" + std::to_string(asteroidFieldSettings.seed) + "-" + std::to_string(t);
+        PlanetConfiguration asteroidDesc = generator.GeneratePlanetConfiguration(SID, 0.0f, DirectX::XMFLOAT3(0, 0, 0));
+        for (PlanetSurfaceConfiguration &layer : asteroidDesc.layers) {
+            layer.baseRoughness = 2.0f;
+            layer.minValue = 0.1f;
+            layer.strength = 0.8f;
+            layer.persistance = 0.01f;
+            // Small and never seen up close, the cheapest noise tier is enough.
+            layer.basis = NoiseBasis::Value;
+            layer.precision = NoisePrecision::Float;
         }
-        else if (id == 2) {
-
+        asteroidDesc.craters = generator.GenerateCraterConfiguration(asteroidDesc.seed, asteroidCraters);
+
+        std::vector<Vertex> triangleVertices;
+        std::vector<DWORD> triangleIndices;
+        float minElevation, maxElevation;
+        PlanetTerrain terrain(asteroidDesc, t);
+        GenerateSphereVertices(triangleVertices, triangleIndices, terrain, nullptr, CreateColorGradient(t, false, true), minElevation, maxElevation, false, true, asteroidFieldSettings.templateResolution);
+        asteroidTemplates.push_back(Mesh(triangleVertices, triangleIndices));
+        asteroidBoundingScale = t == 0 ? maxElevation : std::max(asteroidBoundingScale, maxElevation);
+    }
 
-            gradient.push_back({ 0.2,  DirectX::XMFLOAT4(0, 0, 1, 1) });
-            gradient.push_back({ 0.3,  DirectX::XMFLOAT4(1, 1, 0, 1) });
-            gradient.push_back({ 0.5,  DirectX::XMFLOAT4(0, 1, 0, 1) });
-            gradient.push_back({ 0.8,  DirectX::XMFLOAT4(0.5, 0.25, 0, 1) });
-            gradient.push_back({ 1,  DirectX::XMFLOAT4(1, 1, 1, 1) });
+    asteroidField = AsteroidField(asteroidFieldSettings);
 
-        }
-        else {
-
-            gradient.push_back({ 0.2,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
-            gradient.push_back({ 0.3,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
-            gradient.push_back({ 0.5,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
-            gradient.push_back({ 0.8,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
-            gradient.push_back({ 1,  DirectX::XMFLOAT4(randFloat(), randFloat(), randFloat(), 1.0f) });
-        }
+    BufferMemoryManager buffMng;
+    CD3DX12_RANGE readRange(0, 0);    // We do not intend to read from this resource on the CPU.
+    UINT bufferSize = static_cast<UINT>(asteroidField.GetInstanceCount() * sizeof(InstanceTransform));
+    for (int i = 0; i < mc_frameBufferCount; i++) {
+        buffMng.AllocateBuffer(m_asteroidInstanceBuffers[i], bufferSize, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_HEAP_TYPE_UPLOAD);
+        m_asteroidInstanceBuffers[i]->SetName(L"Asteroid instance transform upload buffer");
+        ThrowIfFailed(m_asteroidInstanceBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_asteroidInstanceGPUAddress[i])));
+    }
 
-        for (int i = 0; i < 6 * resolution * resolution; i++) {
-            DirectX::XMVECTOR positionVector = DirectX::XMLoadFloat3(&triangleVertices[i].position);
-            float elevation = DirectX::XMVectorGetX(DirectX::XMVector3Length(positionVector));
-            float normalizedElevation = (elevation - minElevation) / (maxElevation - minElevation);
+    std::cout << "Asteroid field: " << asteroidField.GetInstanceCount() << " rocks, " << asteroidField.GetTemplateCount() << " template meshes." << std::endl;
+}
 
+void VoyagerEngine::UpdateAsteroidField(const SimulationSnapshot& previous, const SimulationSnapshot& current, float alpha)
+{
+    if (asteroidTemplates.empty())
+        return;
+
+    // The GPU is done with this frame's upload buffer (see WaitForPreviousFrame).
+    double time = previous.asteroidTime + (current.asteroidTime - previous.asteroidTime) * alpha;
+    const DirectX::XMFLOAT3* to = current.asteroidGravity ? current.asteroidPositions.data() : nullptr;
+    // Right after the gravity was switched on there is only one state to take the positions from.
+    const DirectX::XMFLOAT3* from = previous.asteroidGravity ? previous.asteroidPositions.data() : to;
+    asteroidField.Update(time, from, to, alpha, m_asteroidInstanceGPUAddress[m_frameBufferIndex]);
+    // View and projection were stored at the start of the frame.
+    memcpy(m_WVPConstantBuffersGPUAddress[m_frameBufferIndex] + sizeof(m_wvpPerObject) * mc_asteroidFieldSlot, &m_wvpPerObject, sizeof(m_wvpPerObject));
+}
 
+void VoyagerEngine::AdvanceAsteroidField(SimulationSnapshot& next, double tickSeconds)
+{
+    if (asteroidTemplates.empty())
+        return;
+
+    if (asteroidGravityToggled.exchange(false))
+        ToggleAsteroidGravity(next.asteroidTime);
+    next.asteroidGravity = asteroidField.UsesGravity();
+    if (!next.asteroidGravity) {
+        next.asteroidPositions.clear();
+        return;
+    }
 
-            for (int idx = 0; idx < gradient.size(); idx++) {
-                std::pair<float, DirectX::XMFLOAT4> color = gradient[idx];
+    // The star at the origin holds the belt, the planets pull with a mass growing with their volume.
+    std::vector<NBodyAttractor> attractors;
+    float starMass = asteroidField.GetStarMass();
+    attractors.push_back({ DirectX::XMFLOAT3(0, 0, 0), starMass });
+    for (size_t i = 0; i < attractorOrbits.size(); i++) {
+        TransformComponent transform;
+        KeplerOrbit::Evaluate(attractorOrbits[i], next.orbitTime, transform);
+        DirectX::XMFLOAT3 position;
+        DirectX::XMStoreFloat3(&position, DirectX::XMVector3Rotate(DirectX::XMLoadFloat3(&transform.position), DirectX::XMLoadFloat4(&transform.orbit)));
+        attractors.push_back({ position, starMass * attractorMasses[i] });
+    }
+    NBodySimulation& gravity = asteroidField.GetGravity();
+    gravity.SetAttractors(attractors);
+    gravity.Advance(tickSeconds);
 
-                std::pair<float, DirectX::XMFLOAT4> nextColor = (idx < gradient.size() - 1) ? gradient[idx + 1] : color;
+    next.asteroidPositions.resize(gravity.GetBodyCount());
+    for (size_t i = 0; i < next.asteroidPositions.size(); i++)
+        next.asteroidPositions[i] = gravity.GetPosition(i);
+}
 
-                if (color.first > normalizedElevation) {
+void VoyagerEngine::DetectAsteroidContacts(SimulationSnapshot& next, const BoundingSphere& ship)
+{
+    next.shipAsteroidContacts = 0;
+    if (asteroidTemplates.empty() || ship.radius <= 0.0f)
+        return;
+
+    // On their orbits the rocks stay in the belt, the tree is only kept up while the ship is close to it.
+    // Under gravity they may be anywhere.
+    const AsteroidFieldSettings& settings = asteroidField.GetSettings();
+    float reach = settings.outerRadius * std::sin(settings.inclination) + settings.thickness + settings.scale.max * asteroidBoundingScale + ship.radius;
+    float distance = std::sqrt(ship.center.x * ship.center.x + ship.center.z * ship.center.z);
+    bool nearBelt = distance > settings.innerRadius - reach && distance < settings.outerRadius + reach && std::abs(ship.center.y) < reach;
+    if (!nearBelt && !next.asteroidGravity)
+        return;
+
+    // The transforms of the rocks at the tick, as the frames write them.
+    size_t count = asteroidField.GetInstanceCount();
+    asteroidTickTransforms.resize(count);
+    const DirectX::XMFLOAT3* positions = next.asteroidGravity ? next.asteroidPositions.data() : nullptr;
+    asteroidField.Update(next.asteroidTime, positions, positions, 0.0f, asteroidTickTransforms.data());
+    asteroidSpheres.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const DirectX::XMFLOAT4* rows = asteroidTickTransforms[i].rows;
+        float scale = std::sqrt(rows[0].x * rows[0].x + rows[0].y * rows[0].y + rows[0].z * rows[0].z);
+        asteroidSpheres[i].center = DirectX::XMFLOAT3(rows[0].w, rows[1].w, rows[2].w);
+        asteroidSpheres[i].radius = scale * asteroidBoundingScale;
+    }
+    asteroidBounds.Update(asteroidSpheres.data(), count);
 
-                    float distRange = nextColor.first - color.first;
-                    if (distRange > 0.0f) {
-                        float dist = normalizedElevation - color.first;
-                        float percentage = dist / distRange;
-                        DirectX::XMFLOAT4 gradientCol = DirectX::XMFLOAT4(
-                            color.second.x * (1.0f - percentage) + nextColor.second.x * percentage,
-                            color.second.y * (1.0f - percentage) + nextColor.second.y * percentage,
-                            color.second.z * (1.0f - percentage) + nextColor.second.z * percentage,
-                            1.0f
-                        );
-                        triangleVertices[i].color = gradientCol;
-                    }
-                    else {
-                        triangleVertices[i].color = color.second;
-                    }
+    asteroidContacts.clear();
+    asteroidBounds.QuerySphere(ship, asteroidContacts);
+    next.shipAsteroidContacts = asteroidContacts.size();
+}
 
+void VoyagerEngine::ToggleAsteroidGravity(double time)
+{
+    if (asteroidField.UsesGravity()) {
+        asteroidField.DisableGravity();
+        std::cout << "Asteroid gravity off." << std::endl;
+        return;
+    }
+    // One step per simulation tick.
+    NBodySettings gravitySettings;
+    gravitySettings.timeStep = static_cast<float>(simulation.GetTickSeconds());
+    gravitySettings.maxStepsPerAdvance = 2;
+    gravitySettings.softening = asteroidFieldSettings.scale.max;
+    asteroidField.EnableGravity(time, gravitySettings);
+    std::cout << "Asteroid gravity on: " << asteroidField.GetInstanceCount() << " bodies, opening angle " << gravitySettings.openingAngle << "." << std::endl;
+}
 
-                    break;
+void VoyagerEngine::CreatePlanetRings()
+{
+    // The planets with at least four fifths of the radius of the largest one get rings.
+    std::vector<int> candidates = LargestPlanets();
+    for (int i : candidates) {
+        float radius = engineObjects[i].planetDescripton.radius;
+        if (planetRings.size() == mc_maxPlanetRings || radius < 0.8f * engineObjects[candidates[0]].planetDescripton.radius)
+            break;
+        PlanetRingSettings settings = planetRingSettings;
+        settings.seed = planetRingSettings.seed + i;
+        planetRings.push_back(PlanetRing(settings, radius));
+        planetRingObjects.push_back(i);
+
+        // The annulus, two rows of vertices per band so every band has a flat density.
+        const PlanetRing& ring = planetRings.back();
+        const int segments = 128;
+        std::vector<Vertex> vertices;
+        std::vector<DWORD> indices;
+        for (int b = 0; b < ring.GetBandCount(); b++) {
+            DWORD first = static_cast<DWORD>(vertices.size());
+            float bandRadii[2] = { ring.GetBandInnerRadius(b), ring.GetBandOuterRadius(b) };
+            for (int s = 0; s <= segments; s++) {
+                float angle = DirectX::XM_2PI * s / segments;
+                for (float bandRadius : bandRadii) {
+                    Vertex vertex;
+                    vertex.position = DirectX::XMFLOAT3(bandRadius * std::cos(angle), 0.0f, bandRadius * std::sin(angle));
+                    vertex.color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, ring.GetBandDensity(b));
+                    vertex.uvCoordinates = DirectX::XMFLOAT2(0.5f, 0.5f);
+                    vertex.normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+                    vertices.push_back(vertex);
                 }
-
             }
-
-
-
+            for (DWORD s = 0; s < segments; s++) {
+                DWORD inner = first + 2 * s;
+                indices.insert(indices.end(), { inner, inner + 1, inner + 3, inner, inner + 3, inner + 2 });
+            }
         }
-
+        planetRingBillboards.push_back(Mesh(vertices, indices));
+        std::cout << "Planet ring of " << engineObjects[i].planetDescripton.id << ": " << ring.GetParticleCount() << " particles in " << ring.GetBandCount() << " bands." << std::endl;
+    }
+    if (planetRings.empty())
+        return;
+    planetRingFirst.resize(planetRings.size());
+    planetRingCount.resize(planetRings.size());
+
+    // Quad of a particle, the vertex shader spreads the corners by its size.
+    std::vector<Vertex> quadVertices(4);
+    const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { 1.0f, 1.0f }, { -1.0f, 1.0f } };
+    for (int c = 0; c < 4; c++) {
+        quadVertices[c].position = DirectX::XMFLOAT3(corners[c][0], corners[c][1], 0.0f);
+        quadVertices[c].color = DirectX::XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f);
+        quadVertices[c].uvCoordinates = DirectX::XMFLOAT2(0.5f + 0.5f * corners[c][0], 0.5f + 0.5f * corners[c][1]);
+        quadVertices[c].normal = DirectX::XMFLOAT3(0.0f, 0.0f, -1.0f);
     }
+    ringParticleQuad = Mesh(quadVertices, { 0, 1, 2, 0, 2, 3 });
 
+    BufferMemoryManager buffMng;
+    CD3DX12_RANGE readRange(0, 0);    // We do not intend to read from this resource on the CPU.
+    UINT bufferSize = static_cast<UINT>(mc_maxRingParticles * sizeof(RingParticle));
+    for (int i = 0; i < mc_frameBufferCount; i++) {
+        buffMng.AllocateBuffer(m_ringParticleBuffers[i], bufferSize, D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_HEAP_TYPE_UPLOAD);
+        m_ringParticleBuffers[i]->SetName(L"Ring particle upload buffer");
+        ThrowIfFailed(m_ringParticleBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_ringParticleGPUAddress[i])));
+    }
+}
 
+std::vector<int> VoyagerEngine::LargestPlanets() const
+{
+    std::vector<int> planets;
+    for (int i = 0; i < engineObjects.size(); i++) {
+        if (engineObjects[i].planetDesc && i != sunObjectIndex)
+            planets.push_back(i);
+    }
+    std::sort(planets.begin(), planets.end(), [this](int left, int right) {
+        return engineObjects[left].planetDescripton.radius > engineObjects[right].planetDescripton.radius;
+    });
+    return planets;
+}
 
+void VoyagerEngine::CreateMoons()
+{
+    std::vector<int> candidates = LargestPlanets();
+    if (candidates.size() > mc_maxMoons)
+        candidates.resize(mc_maxMoons);
+
+    // A quarter of the planet, a few of its radii out and faster than it, on an orbit of its own tilt.
+    ConfigurationGenerator generator;
+    for (int i : candidates) {
+        const PlanetConfiguration& planetDescripton = engineObjects[i].planetDescripton;
+        PlanetConfiguration moonDescripton = generator.GeneratePlanetConfiguration(planetDescripton.id + "-MOON", 0.0f, DirectX::XMFLOAT3(0, 0, 0));
+        moonDescripton.radius = 0.25f * planetDescripton.radius;
+        moonDescripton.orbit = 3.5f * planetDescripton.radius;
+        moonDescripton.velocity = 4.0f * planetDescripton.velocity;
+        // Shaded like a planet; not baked, the few bake slots stay with the planets.
+        CreateSphere(moonDescripton, moonDescripton.orbit, false, false, i, false);
+        std::cout << "Moon of " << planetDescripton.id << " at " << moonDescripton.orbit << "." << std::endl;
+    }
+}
 
-    // Indexes
-    triangleIndices = std::vector<DWORD>{ };
-    for (int face = 0; face < 6; face++) {
+void VoyagerEngine::UpdatePlanetRings()
+{
+    if (planetRings.empty())
+        return;
+
+    DirectX::XMFLOAT3 cameraPosition;
+    DirectX::XMStoreFloat3(&cameraPosition, m_mainCamera.camPosition);
+    DirectX::XMMATRIX viewMat = DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat);
+    DirectX::XMMATRIX projMat = DirectX::XMLoadFloat4x4(&m_mainCamera.projMat);
+
+    // The particles orbit on the interpolated simulation time, with the planets and the time warp.
+    // The rings share the budget of the upload buffer, the GPU is done with the one of this frame.
+    size_t written = 0;
+    double updateMs = 0.0;
+    size_t dropped = 0;
+    for (UINT r = 0; r < planetRings.size(); r++) {
+        const EngineObject& planet = engineObjects[planetRingObjects[r]];
+        DirectX::XMFLOAT3 planetPosition;
+        DirectX::XMStoreFloat3(&planetPosition, GetWorldMatrix(planet).r[3]);
+        planetRingFirst[r] = written;
+        planetRingCount[r] = planetRings[r].Update(simulationTime, planetPosition, cameraPosition, m_ringParticleGPUAddress[m_frameBufferIndex] + written, mc_maxRingParticles - written);
+        written += planetRingCount[r];
+        updateMs += planetRings[r].GetStats().updateMs;
+        dropped += planetRings[r].GetStats().droppedParticles;
+
+        DirectX::XMMATRIX worldMat = planetRings[r].GetWorldMatrix(planetPosition);
+        DirectX::XMStoreFloat4x4(&m_wvpPerObject.worldMat, DirectX::XMMatrixTranspose(worldMat));
+        DirectX::XMStoreFloat4x4(&m_wvpPerObject.wvpMat, DirectX::XMMatrixTranspose(worldMat * viewMat * projMat));
+        memcpy(m_WVPConstantBuffersGPUAddress[m_frameBufferIndex] + sizeof(m_wvpPerObject) * (mc_planetRingSlot + r), &m_wvpPerObject, sizeof(m_wvpPerObject));
+    }
 
-        for (int y = 0; y < resolution - 1; y++) {
-            for (int x = 0; x < resolution - 1; x++) {
-                int vertexId = x + y * resolution + face* resolution* resolution;
-                triangleIndices.push_back(vertexId);
-                triangleIndices.push_back(vertexId + resolution);
-                triangleIndices.push_back(vertexId + resolution + 1);
-                triangleIndices.push_back(vertexId);
-                triangleIndices.push_back(vertexId + resolution + 1);
-                triangleIndices.push_back(vertexId + 1);
-            }
-        }
+    // Report the cost whenever the camera reaches or leaves the particles.
+    bool anyNear = written > 0;
+    if (anyNear != planetRingsNear) {
+        std::cout << "Planet rings: " << written << " near particles, " << written * sizeof(RingParticle) / 1024 << " KB uploaded (at most " <<
+            mc_maxRingParticles * sizeof(RingParticle) / 1024 << " KB), " << updateMs << " ms, " << dropped << " over the budget." << std::endl;
     }
+    planetRingsNear = anyNear;
+}
 
-    // Calculate smooth normals:
-    // First, loop over all triangles and calculate per-triangle normal.
-    // Then add that normal to each vertex's normal.
-    for (int i = 0; i < triangleIndices.size() - 2; i++)
-    {
-        // Create two vectors along two edges, staring in one vetex.
-        DirectX::XMVECTOR edge1, edge2, vert1, vert2, vert3;
-        vert1 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i]].position);
-        vert2 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 1]].position);
-        vert3 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 2]].position);
+void VoyagerEngine::CreateSunAnimation(int id)
+{
+    sunAnimation = SunAnimation(sunAnimationSettings, id);
+    sunAnimationMap.CreateCubeFromTexels(sunAnimation.GetTexels(), sunAnimation.GetResolution());
+    sunObjectIndex = id;
 
-        edge1 = DirectX::XMVectorSubtract(vert2, vert1);
-        edge2 = DirectX::XMVectorSubtract(vert3, vert1);
+    // Every tile gets its own placed footprint in the upload buffer of a frame.
+    UINT tileSize = sunAnimation.GetTileSize();
+    m_sunTileRowPitch = (tileSize * sizeof(UINT) + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+    m_sunTileFootprintSize = (m_sunTileRowPitch * tileSize + D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT - 1);
 
-        // Calculate their cross product (face normal).
-        DirectX::XMVECTOR faceNormal = DirectX::XMVector3Cross(edge1, edge2);
+    BufferMemoryManager buffMng;
+    CD3DX12_RANGE readRange(0, 0);    // We do not intend to read from this resource on the CPU.
+    for (int i = 0; i < mc_frameBufferCount; i++) {
+        buffMng.AllocateBuffer(m_sunTileUploadBuffers[i], m_sunTileFootprintSize * sunAnimation.GetTilesPerFrame(), D3D12_RESOURCE_STATE_GENERIC_READ, D3D12_HEAP_TYPE_UPLOAD);
+        m_sunTileUploadBuffers[i]->SetName(L"Sun animation tile upload buffer");
+        ThrowIfFailed(m_sunTileUploadBuffers[i]->Map(0, &readRange, reinterpret_cast<void**>(&m_sunTileUploadGPUAddress[i])));
+    }
 
-        // Add the face normal to the vertex normals.
-        DirectX::XMVECTOR normal1, normal2, normal3;
-        normal1 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i]].normal);
-        normal2 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 1]].normal);
-        normal3 = DirectX::XMLoadFloat3(&triangleVertices[triangleIndices[i + 2]].normal);
+    std::cout << "Sun animation: at most " << sunAnimation.GetTilesPerFrame() << " tiles per frame, "
+        << sunAnimation.GetTileCount() << " tiles per keyframe every " << sunAnimation.GetKeyframeSeconds() << " s" << std::endl;
+}
 
-        normal1 = DirectX::XMVectorAdd(normal1, faceNormal);
-        normal2 = DirectX::XMVectorAdd(normal2, faceNormal);
-        normal3 = DirectX::XMVectorAdd(normal3, faceNormal);
+void VoyagerEngine::UpdateSunAnimation(double deltaTime)
+{
+    if (sunObjectIndex < 0)
+        return;
 
-        // Store the modified vertex normals.
-        DirectX::XMStoreFloat3(&triangleVertices[triangleIndices[i]].normal, normal1);
-        DirectX::XMStoreFloat3(&triangleVertices[triangleIndices[i + 1]].normal, normal2);
-        DirectX::XMStoreFloat3(&triangleVertices[triangleIndices[i + 2]].normal, normal3);
+    sunAnimation.Update(deltaTime);
+
+    // The GPU is done with this frame's upload buffer (see WaitForPreviousFrame).
+    const std::vector<SunTile>& tiles = sunAnimation.GetUpdatedTiles();
+    for (size_t t = 0; t < tiles.size(); t++) {
+        UINT8* destination = m_sunTileUploadGPUAddress[m_frameBufferIndex] + t * m_sunTileFootprintSize;
+        for (int row = 0; row < sunAnimation.GetTileSize(); row++)
+            memcpy(destination + row * m_sunTileRowPitch, sunAnimation.GetTileRow(tiles[t], row), sunAnimation.GetTileSize() * sizeof(UINT));
     }
+}
 
-    // Now loop over all vertices and normalize their normals (duh...).
-    // This will basically average the per-triangle normals and give smooth normals.
-    float negateNormals = 1;
-    if (sun) {
-        negateNormals = -1; // flip normals if ot's the sun!
+void VoyagerEngine::UpdateEntities()
+{
+    SceneFrame frame;
+    DirectX::XMStoreFloat4x4(&frame.matrices.viewProjection, DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat) * DirectX::XMLoadFloat4x4(&m_mainCamera.projMat));
+    frame.matrices.viewTransposed = m_wvpPerObject.viewMat;
+    frame.matrices.projectionTransposed = m_wvpPerObject.projectionMat;
+    DirectX::XMStoreFloat3(&frame.cameraPosition, m_mainCamera.camPosition);
+    DirectX::XMStoreFloat3(&frame.cameraFront, m_mainCamera.localFront);
+    DirectX::XMStoreFloat3(&frame.cameraUp, m_mainCamera.localUp);
+    DirectX::XMStoreFloat4(&frame.cameraTurn, DirectX::XMQuaternionRotationMatrix(m_mainCamera.rotMat));
+    frame.fullDetailDistance = bakeSettings.fullDetailDistance;
+    frame.path = transformPath;
+    // Every entity has a slot of its own, the jobs never share the m_wvpPerObject scratch.
+    frame.constantBuffer = m_WVPConstantBuffersGPUAddress[m_frameBufferIndex];
+    frame.slotStride = sizeof(wvpConstantBuffer);
+    frame.frameSlot = m_frameBufferIndex;
+    frame.simulationTime = simulationTime;
+    frame.hierarchy = &sceneHierarchy;
+    frame.bounds = &sceneBounds;
+
+    // Every frame slot remembers the camera it was written with.
+    if (memcmp(&frame.matrices, &lastFrameMatrices, sizeof(frame.matrices)) != 0) {
+        cameraVersion++;
+        lastFrameMatrices = frame.matrices;
     }
+    frame.cameraChanged = uploadedCameraVersion[m_frameBufferIndex] != cameraVersion;
+    uploadedCameraVersion[m_frameBufferIndex] = cameraVersion;
 
-    for (int i = 0; i < triangleVertices.size(); i++)
-    {
-        DirectX::XMVECTOR normal = DirectX::XMLoadFloat3(&triangleVertices[i].normal);
-        normal = DirectX::XMVectorScale(DirectX::XMVector3Normalize(normal), negateNormals);
-        DirectX::XMStoreFloat3(&triangleVertices[i].normal, normal);
+    // Returns after all jobs are done, BuildRenderPacket() reads the visible list with the level of detail.
+    sceneStats = SceneSystems::Update(entityWorld, frame);
+}
+
+void VoyagerEngine::ChangeTimeWarp(bool faster)
+{
+    // Only changed here, the simulation thread reads it every tick.
+    double warp = timeWarp.load();
+    if (faster)
+        warp = warp * 10.0 < mc_maxTimeWarp ? warp * 10.0 : mc_maxTimeWarp;
+    else
+        warp = warp / 10.0 > 1.0 ? warp / 10.0 : 1.0;
+    timeWarp = warp;
+    std::cout << std::endl << "Time warp " << warp << "x." << std::endl;
+}
+
+void VoyagerEngine::PickBody(int mouseX, int mouseY)
+{
+    // The ray from the near to the far plane through the pixel.
+    DirectX::XMMATRIX viewProjection = DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat) * DirectX::XMLoadFloat4x4(&m_mainCamera.projMat);
+    DirectX::XMMATRIX toWorld = DirectX::XMMatrixInverse(nullptr, viewProjection);
+    float x = 2.0f * (mouseX + 0.5f) / windowWidth - 1.0f;
+    float y = 1.0f - 2.0f * (mouseY + 0.5f) / windowHeight;
+    DirectX::XMVECTOR nearPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(x, y, 0.0f, 1.0f), toWorld);
+    DirectX::XMVECTOR farPoint = DirectX::XMVector3TransformCoord(DirectX::XMVectorSet(x, y, 1.0f, 1.0f), toWorld);
+    DirectX::XMVECTOR direction = DirectX::XMVector3Normalize(DirectX::XMVectorSubtract(farPoint, nearPoint));
+
+    float distance;
+    uint32_t item = sceneBounds.tree.Raycast(m_mainCamera.camPosition, direction, FLT_MAX, &distance);
+    if (item == BoundingVolumeHierarchy::NoItem) {
+        std::cout << std::endl << "Nothing picked." << std::endl;
+        return;
     }
+    const EngineObject& engineObject = engineObjects[sceneBounds.objects[item]];
+    std::cout << std::endl << "Picked " << engineObject.planetDescripton.id << ", " << distance << " away, altitude " <<
+        SurfaceAltitude(engineObject, m_mainCamera.camPosition) << "." << std::endl;
+}
 
-    return;
+DirectX::XMMATRIX VoyagerEngine::GetWorldMatrix(const EngineObject& engineObject)
+{
+    const WorldMatrixComponent* world = entityWorld.Get<WorldMatrixComponent>(engineObject.entity);
+    if (world == nullptr)
+        throw "Engine object without a world matrix!";
+    return DirectX::XMLoadFloat4x4(&world->world);
 }
 
-void VoyagerEngine::OnEarlyUpdate()
+float VoyagerEngine::SurfaceAltitude(const EngineObject& engineObject, DirectX::XMVECTOR worldPosition)
 {
-    m_frameIndex++;
+    // The world matrix scales the body by its radius, so distances in body space are in radii.
+    DirectX::XMMATRIX worldMat = GetWorldMatrix(engineObject);
+    DirectX::XMVECTOR localPosition = DirectX::XMVector3Transform(worldPosition, DirectX::XMMatrixInverse(nullptr, worldMat));
+    DirectX::XMFLOAT3 position;
+    DirectX::XMStoreFloat3(&position, localPosition);
 
+    return engineObject.surface->Altitude(position) * engineObject.planetDescripton.radius;
+}
+
+void VoyagerEngine::OnEarlyUpdate()
+{
     // Update the timer values (deltaTime, FPS).
     Timer* timer = Timer::GetInstance();
     timer->Update();
@@ -1117,7 +1708,23 @@ void VoyagerEngine::OnEarlyUpdate()
     if (timeTillFpsDisplayUpdate > 0.5)
     {
         timeTillFpsDisplayUpdate = 0.0;
-        std::cout << timer->GetFps() << "\r";
+        // Altitude above the closest surface, for landing.
+        float altitude = FLT_MAX;
+        for (const EngineObject& engineObject : engineObjects) {
+            if (engineObject.surface)
+                altitude = std::min(altitude, SurfaceAltitude(engineObject, m_mainCamera.camPosition));
+        }
+        // Simulation ticks, game frames and recorded frames are timed on their own threads. Overlapped, the
+        // CPU time of a frame is the longer of the game and the render thread.
+        SimulationStats simulationStats = simulation.TakeStats();
+        RenderThreadStats renderStats = renderThread.TakeStats();
+        double frameMs = frameCount > 0 ? frameMsSum / frameCount : 0.0;
+        frameMsSum = 0.0;
+        frameCount = 0;
+        std::cout << timer->GetFps() << " fps, frame " << frameMs << " ms, render " << renderStats.meanRenderMs << " ms (" << renderStats.meanWaitMs <<
+            " waited, " << renderStats.meanPacketKB << " KB packets), tick " << simulationStats.meanTickMs << " ms (max " << simulationStats.maxTickMs <<
+            ", " << simulationStats.droppedTicks << " dropped), latency " << simulationStats.meanLatencyMs << " ms, altitude " << altitude << ", objects " <<
+            sceneStats.recomputed << " moved " << sceneStats.deferred << " moved out of view " << sceneStats.projected << " reprojected " << sceneStats.skipped << " unchanged, " << sceneStats.visible << " visible " << sceneStats.culled << " culled, time warp " << timeWarp.load() << "x        \r";
     }
 
     GetMouseDelta();
@@ -1136,3 +1743,84 @@ void VoyagerEngine::GetMouseDelta()
         SetCursorPos(center.x, center.y);
     }
 }
+
+void VoyagerEngine::StreamGalaxy(const DirectX::XMFLOAT3& cameraPosition, std::vector<GalaxySystem>& systems)
+{
+    // One more than drawn, the home system is among them when the camera is close to it.
+    if (galaxyDatabase.IsOpen()) {
+        galaxyDatabase.FindNearestSystems(cameraPosition, mc_maxGalaxyStars + 1, systems);
+    }
+    else {
+        galaxy.Update(cameraPosition);
+        galaxy.FindNearestSystems(cameraPosition, mc_maxGalaxyStars + 1, systems);
+    }
+    systems.erase(std::remove_if(systems.begin(), systems.end(),
+        [this](const GalaxySystem& system) { return system.key == homeSystemKey; }), systems.end());
+    if (systems.size() > mc_maxGalaxyStars)
+        systems.resize(mc_maxGalaxyStars);
+
+    // Report the streaming state whenever the camera enters another sector.
+    uint64_t sectorKey = galaxy.GetSectorKey(cameraPosition);
+    if (sectorKey != cameraSectorKey && !galaxyDatabase.IsOpen()) {
+        cameraSectorKey = sectorKey;
+        const GalaxyStats& stats = galaxy.GetStats();
+        std::cout << "Galaxy: " << stats.residentSystems << " systems in " << stats.residentSectors << " sectors, " << stats.memory / 1024 << " KB, " <<
+            stats.meanSectorMs << " ms per sector (max update " << stats.maxUpdateMs << " ms), " << stats.evictedSectors << " sectors evicted." << std::endl;
+    }
+}
+
+void VoyagerEngine::UpdateGalaxy()
+{
+    DirectX::XMMATRIX viewMat = DirectX::XMLoadFloat4x4(&m_mainCamera.viewMat);
+    DirectX::XMMATRIX projMat = DirectX::XMLoadFloat4x4(&m_mainCamera.projMat);
+    for (UINT i = 0; i < nearbySystems.size(); i++) {
+        const GalaxySystem& system = nearbySystems[i];
+        DirectX::XMMATRIX worldMat = DirectX::XMMatrixScaling(system.starRadius, system.starRadius, system.starRadius) *
+            DirectX::XMMatrixTranslation(system.position.x, system.position.y, system.position.z);
+        DirectX::XMStoreFloat4x4(&m_wvpPerObject.worldMat, DirectX::XMMatrixTranspose(worldMat));
+        DirectX::XMStoreFloat4x4(&m_wvpPerObject.wvpMat, DirectX::XMMatrixTranspose(worldMat * viewMat * projMat));
+        memcpy(m_WVPConstantBuffersGPUAddress[m_frameBufferIndex] + sizeof(m_wvpPerObject) * (mc_galaxyStarSlot + i), &m_wvpPerObject, sizeof(m_wvpPerObject));
+    }
+}
+
+void VoyagerEngine::StartSimulation()
+{
+    // The planets pull at the asteroids with a mass growing with their volume.
+    float starRadius = sunObjectIndex >= 0 ? engineObjects[sunObjectIndex].planetDescripton.radius : 1.0f;
+    // Moons orbit their planet, not the star; they are too light to matter.
+    entityWorld.ForEachChunk<OrbitComponent, RenderableComponent, HierarchyComponent>([&](size_t count, const OrbitComponent* orbits, const RenderableComponent* renderables, const HierarchyComponent* nodes) {
+        for (size_t i = 0; i < count; i++) {
+            const EngineObject& engineObject = engineObjects[renderables[i].object];
+            if (!engineObject.planetDesc || engineObject.idx == sunObjectIndex || sceneHierarchy.GetDepth(nodes[i].node) != 1)
+                continue;
+            float ratio = engineObject.planetDescripton.radius / starRadius;
+            attractorOrbits.push_back(orbits[i]);
+            attractorMasses.push_back(ratio * ratio * ratio);
+        }
+    });
+
+    SimulationSnapshot initial;
+    initial.orbitTime = simulationTime;
+    DirectX::XMStoreFloat3(&simulationCameraPosition, m_mainCamera.camPosition);
+    StreamGalaxy(simulationCameraPosition, initial.nearbySystems);
+    simulation.Start(mc_simulationTicksPerSecond, initial, [this](const SimulationSnapshot& current, SimulationSnapshot& next, double tickSeconds) {
+        SimulationTick(current, next, tickSeconds);
+    });
+}
+
+void VoyagerEngine::SimulationTick(const SimulationSnapshot& current, SimulationSnapshot& next, double tickSeconds)
+{
+    next.orbitTime = current.orbitTime + tickSeconds * timeWarp.load();
+    next.asteroidTime = current.asteroidTime + tickSeconds;
+    AdvanceAsteroidField(next, tickSeconds);
+
+    DirectX::XMFLOAT3 cameraPosition;
+    BoundingSphere ship;
+    {
+        std::lock_guard<std::mutex> lock(simulationInputMutex);
+        cameraPosition = simulationCameraPosition;
+        ship = simulationShipBounds;
+    }
+    DetectAsteroidContacts(next, ship);
+    StreamGalaxy(cameraPosition, next.nearbySystems);
+}
@@ -7,6 +7,16 @@
 #include "RenderingComponents.h"
 #include "ConfigurationGenerator.h"
 #include "EngineObject.h"
+#include "PlanetTerrain.h"
+#include "PlanetBake.h"
+#include "SunAnimation.h"
+#include "Galaxy.h"
+#include "GalaxyDatabase.h"
+#include "AsteroidField.h"
+#include "PlanetRing.h"
+#include "SceneSystems.h"
+#include "SimulationLoop.h"
+#include "RenderThread.h"
 
 using Microsoft::WRL::ComPtr;
 
@@ -23,11 +33,34 @@ public:
     virtual void OnKeyDown(UINT8 keyCode);
     virtual void OnKeyUp(UINT8 keyCode);
     virtual void OnMouseMove(int mouseX, int mouseY);
+    virtual void OnMouseClick(int mouseX, int mouseY);
     virtual void OnGotFocus();
     virtual void OnLostFocus();
 
 private:
     static const UINT mc_frameBufferCount = 3;
+    static_assert(mc_frameBufferCount == TransformVersionComponent::FrameSlots, "Every frame buffer needs its upload version.");
+    // Every baked body takes two descriptors (normal and colour cube maps) in the shader access heap.
+    static const UINT mc_maxBakedBodies = 32;
+    // Neighbouring stars drawn from the galaxy, their WVP matrices use the last slots of the constant buffer.
+    static const UINT mc_maxGalaxyStars = 32;
+    static const UINT mc_galaxyStarSlot = 256 - mc_maxGalaxyStars;
+    // The instanced asteroids only need the view and projection, they share one slot below the stars.
+    static const UINT mc_asteroidFieldSlot = mc_galaxyStarSlot - 1;
+    // Rings of the largest planets, one slot each below the asteroids. Their near particles share one
+    // upload buffer per frame, which bounds the upload of all rings together.
+    static const UINT mc_maxPlanetRings = 4;
+    static const UINT mc_planetRingSlot = mc_asteroidFieldSlot - mc_maxPlanetRings;
+    static const UINT mc_maxRingParticles = 262144;
+    // The largest planets get a moon each.
+    static const UINT mc_maxMoons = 2;
+    // Generated planets orbit the star at most this eccentric, which keeps the neighbouring orbits apart.
+    static constexpr float mc_maxOrbitEccentricity = 0.05f;
+    // Orbits stay a closed form of the time at any warp, this only keeps the view followable.
+    static constexpr double mc_maxTimeWarp = 1e6;
+    static constexpr double mc_simulationTicksPerSecond = 60.0;
+    // Longest the window thread waits for a free render packet before it pumps its messages again.
+    static const UINT mc_acquireTimeoutMs = 10;
 
     // This is the structure of the color constant buffer (used in the root desriptor table).
     struct ColorConstantBuffer {
@@ -73,16 +106,108 @@ private:
     WireframeMaterial materialWireframe;
     NormalsDebugMaterial materialNormalsDebug;
     LitMaterial materialLit;
+    BakedPlanetMaterial materialBakedPlanet;
+    SunMaterial materialSun;
+    InstancedMaterial materialInstanced;
+    RingMaterial materialRingBillboard;
+    RingMaterial materialRingParticles;
 
     bool useWireframe = false;
+    PlanetBakeSettings bakeSettings;
+    UINT bakedBodyCount = 0;
+
+    // Animated star surface (see SunAnimation), finished tiles are copied to the cube map every frame.
+    SunAnimationSettings sunAnimationSettings;
+    SunAnimation sunAnimation;
+    Texture sunAnimationMap;
+    int sunObjectIndex = -1;
+    float sunAnimationIntensity = 0.35f;
+    ComPtr<ID3D12Resource> m_sunTileUploadBuffers[mc_frameBufferCount];
+    UINT8* m_sunTileUploadGPUAddress[mc_frameBufferCount];
+    UINT m_sunTileRowPitch;
+    UINT m_sunTileFootprintSize;
+
+    // Star systems around the camera (see Galaxy). The home system at the origin is built in full, the
+    // nearest other stars are drawn with a shared coarse sphere and the animated star surface.
+    GalaxySettings galaxySettings;
+    Galaxy galaxy;
+    // A baked galaxy (see GalaxyDatabase) replaces the streaming when its file is present and matches the settings.
+    GalaxyDatabase galaxyDatabase;
+    uint64_t homeSystemKey = 0;
+    Mesh galaxyStarMesh;
+    std::vector<GalaxySystem> nearbySystems;   // Copied from the current simulation snapshot.
+    uint64_t cameraSectorKey = 0;
+
+    // Belt of rocks (see AsteroidField), one instanced draw per template mesh. The transforms are
+    // written every frame into the upload buffer of the frame and read by the vertex shader from there.
+    AsteroidFieldSettings asteroidFieldSettings;
+    AsteroidField asteroidField;
+    std::vector<Mesh> asteroidTemplates;
+    ComPtr<ID3D12Resource> m_asteroidInstanceBuffers[mc_frameBufferCount];
+    InstanceTransform* m_asteroidInstanceGPUAddress[mc_frameBufferCount];
+
+    // Planet rings (see PlanetRing): an annulus per ring from afar, the particles near the camera as
+    // instanced quads read from this frame's upload buffer.
+    PlanetRingSettings planetRingSettings;
+    std::vector<PlanetRing> planetRings;
+    std::vector<int> planetRingObjects;         // Index of the planet of every ring in engineObjects.
+    std::vector<Mesh> planetRingBillboards;
+    std::vector<size_t> planetRingFirst;        // Near particles of every ring in this frame's buffer.
+    std::vector<size_t> planetRingCount;
+    Mesh ringParticleQuad;
+    ComPtr<ID3D12Resource> m_ringParticleBuffers[mc_frameBufferCount];
+    RingParticle* m_ringParticleGPUAddress[mc_frameBufferCount];
+    bool planetRingsNear = false;
 
     Mesh shipMesh;
-    EngineObject ship;
     std::vector<Mesh> planets;
 
     Texture sampleTexture;
 
+    // Resources of the scene objects, the entities reference them by index (RenderableComponent).
     std::vector<EngineObject> engineObjects;
+    EntityWorld entityWorld;
+    // Every generated body is a node: the star the root, the planets below it and the moons below them.
+    TransformHierarchy sceneHierarchy;
+    // Bounding spheres of the bodies, for culling and picking (see SceneSystems::UpdateBounds()).
+    SceneBounds sceneBounds;
+    TransformBatch::Path transformPath;
+    // Change tracking of the camera for the constant buffers of the frames (see SceneSystems).
+    TransformBatchFrame lastFrameMatrices = {};
+    uint32_t cameraVersion = 1;
+    uint32_t uploadedCameraVersion[mc_frameBufferCount] = {};
+    SceneUpdateStats sceneStats;
+    // Time of the planet orbits (see KeplerOrbit) in the frame, interpolated between the simulation ticks.
+    double simulationTime = 0.0;
+
+    // The simulation thread (see SimulationLoop) owns the galaxy streaming and the asteroid field once it
+    // runs, the game thread only reads its snapshots. Input reaches it through the members below.
+    SimulationLoop simulation;
+    std::atomic<double> timeWarp{ 1.0 };
+    std::atomic<bool> asteroidGravityToggled{ false };
+    std::mutex simulationInputMutex;
+    DirectX::XMFLOAT3 simulationCameraPosition = {};
+    BoundingSphere simulationShipBounds = {};
+    // Ship against asteroids on the simulation thread: the rock spheres of the tick and their tree, refit
+    // every tick while the ship is near the belt.
+    std::vector<InstanceTransform> asteroidTickTransforms;
+    std::vector<BoundingSphere> asteroidSpheres;
+    BoundingVolumeHierarchy asteroidBounds;
+    std::vector<uint32_t> asteroidContacts;
+    float asteroidBoundingScale = 1.0f;         // Largest elevation of the template meshes.
+    bool shipInContact = false;                 // Game thread, reports the contacts once.
+    // Planets pulling at the asteroids: their orbits (evaluated by the simulation) and masses.
+    std::vector<OrbitComponent> attractorOrbits;
+    std::vector<float> attractorMasses;
+    // The render thread (see RenderThread) records and presents the packets the game thread builds from
+    // the entities, one frame behind it. Only the game thread writes the buffers of a frame slot and the
+    // fence values, the render thread only signals them.
+    RenderThread renderThread;
+    RenderPacket* framePacket = nullptr;
+    // CPU time of the frames on the game thread, from the end of the fence wait to the submitted packet.
+    std::chrono::steady_clock::time_point frameStart;
+    double frameMsSum = 0.0;
+    size_t frameCount = 0;
 
 
     // Constant Descriptor Table resources.
@@ -131,12 +256,65 @@ private:
     void LoadAssets();
     void LoadMaterials();
     void LoadScene();
-    void PopulateCommandList();
+    // Describe the draws of this frame for the render thread.
+    void BuildRenderPacket(RenderPacket& packet);
+    // Record, submit and present a packet (render thread).
+    void RenderFrame(const RenderPacket& packet);
+    void PopulateCommandList(const RenderPacket& packet);
+    // Pipeline state, root signature and the bindings shared by every draw of a material.
+    void BindMaterial(RenderMaterial material);
     void WaitForPreviousFrame();
 
     void SetLightPosition();
-    void CreateSphere(PlanetConfiguration planetDescripton, float orbit, bool sun = false, bool asteroid = false);
-    void GenerateSphereVertices(std::vector<Vertex>& triangleVertices, std::vector<DWORD>& triangleIndices, PlanetConfiguration planetDescripton, int id, bool sun = false, bool asteroid = false);
+    // A body with a parent (index into engineObjects) orbits it, without one it orbits the star position.
+    // Without allowBake a planet keeps its full mesh at any distance.
+    void CreateSphere(PlanetConfiguration planetDescripton, float orbit, bool sun = false, bool asteroid = false, int parent = -1, bool allowBake = true);
+    void GenerateSphereVertices(std::vector<Vertex>& triangleVertices, std::vector<DWORD>& triangleIndices, const PlanetTerrain& terrain, const PlanetBake* bake, const ColorGradient& gradient, float& minElevation, float& maxElevation, bool sun = false, bool asteroid = false, int resolution = 0);
+    void GenerateCubeSphereGrid(std::vector<Vertex>& triangleVertices, int resolution);
+    void GenerateCubeSphereIndices(std::vector<DWORD>& triangleIndices, int resolution);
+    ColorGradient CreateColorGradient(int id, bool sun, bool asteroid);
+    // Upload the cube maps of a baked planet and build its coarse mesh for drawing from afar.
+    void BakePlanet(EngineObject& engineObject, std::shared_ptr<PlanetBake> bake, const PlanetTerrain& terrain, const ColorGradient& gradient, float minElevation, float maxElevation);
+    // Build the template meshes of the asteroid field and the upload buffers of its transforms.
+    void CreateAsteroidField();
+    // Write the asteroid transforms of this frame, interpolated between two simulation snapshots.
+    void UpdateAsteroidField(const SimulationSnapshot& previous, const SimulationSnapshot& current, float alpha);
+    // Advance the N-body gravity of the asteroids by one simulation tick (simulation thread).
+    void AdvanceAsteroidField(SimulationSnapshot& next, double tickSeconds);
+    // Find the asteroids the ship touches in the next tick (simulation thread).
+    void DetectAsteroidContacts(SimulationSnapshot& next, const BoundingSphere& ship);
+    // Switch the asteroids between their fixed orbits and the N-body gravity (key N, simulation thread).
+    void ToggleAsteroidGravity(double time);
+    // Indices of the planets in engineObjects (not the star), the largest radius first.
+    std::vector<int> LargestPlanets() const;
+    // Give the largest planets a ring, with its annulus mesh and the particle upload buffers.
+    void CreatePlanetRings();
+    // Give the largest planets a small moon, placed below them in the scene hierarchy.
+    void CreateMoons();
+    // Write the near ring particles of this frame, after the planets have moved.
+    void UpdatePlanetRings();
+    // Evaluate the first keyframes of the star surface and create its cube map and upload buffers.
+    void CreateSunAnimation(int id);
+    // Advance the star surface by deltaTime and stage the finished tiles in the upload buffer of this frame.
+    void UpdateSunAnimation(double deltaTime);
+    // Stream the galaxy around the camera and find the nearest stars (simulation thread).
+    void StreamGalaxy(const DirectX::XMFLOAT3& cameraPosition, std::vector<GalaxySystem>& systems);
+    // Place the nearest stars of the snapshot.
+    void UpdateGalaxy();
+    // Hand the galaxy and the asteroids over to the simulation thread.
+    void StartSimulation();
+    // One tick of the simulation thread.
+    void SimulationTick(const SimulationSnapshot& current, SimulationSnapshot& next, double tickSeconds);
+    // Move the entities and write their world and WVP matrices and level of detail for this frame.
+    void UpdateEntities();
+    // Speed the orbits up or down by a factor of ten (keys PAGE UP and PAGE DOWN).
+    void ChangeTimeWarp(bool faster);
+    // Print the body under a window position, found along the ray through it.
+    void PickBody(int mouseX, int mouseY);
+    // World matrix of an object written by UpdateEntities().
+    DirectX::XMMATRIX GetWorldMatrix(const EngineObject& engineObject);
+    // Distance of a world-space position above the surface of a body, in world units.
+    float SurfaceAltitude(const EngineObject& engineObject, DirectX::XMVECTOR worldPosition);
     float EstimateNewOrbit(PlanetConfiguration planetDescription);
 
     void OnEarlyUpdate();
@@ -100,6 +100,14 @@ LRESULT CALLBACK WindowsApplication::WindowProc(HWND hwnd, UINT uMsg, WPARAM wPa
         }
         return 0;
 
+    case WM_LBUTTONDOWN:
+        {
+            int xPos = GET_X_LPARAM(lParam);
+            int yPos = GET_Y_LPARAM(lParam);
+            gameEngine->OnMouseClick(xPos, yPos);
+        }
+        return 0;
+
     case WM_SETFOCUS:
         {
             gameEngine->OnGotFocus();
@@ -1,12 +1,23 @@
 #include "stdafx.h"
 
 #include "ConsoleHelper.h"
+#include "Benchmarks.h"
+#include "GalaxyDatabase.h"
+#include "GenerationWorkers.h"
 #include "VoyagerEngine.h"
 #include "WindowsApplication.h"
+#include <sstream>
 
 _Use_decl_annotations_
 int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine, int nCmdShow)
 {
+    std::wstring commandLine(pCmdLine);
+
+    // Child process of a GenerationWorkerPool: "-generationworker <coordinator process id> <index>".
+    size_t workerArgument = commandLine.find(L"-generationworker");
+    if (workerArgument != std::wstring::npos)
+        return GenerationWorkerPool::RunWorker(commandLine.substr(workerArgument + wcslen(L"-generationworker")));
+
 #ifdef _DEBUG
     if (!CreateNewConsole(1024))
         return -1;
@@ -14,6 +25,45 @@ int WINAPI wWinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, PWSTR pCmdLine
 
     std::cout << "Hello World!" << std::endl;
 
+    // Headless benchmarks instead of the game: "-benchmark <name>".
+    size_t benchmarkArgument = commandLine.find(L"-benchmark");
+    if (benchmarkArgument != std::wstring::npos)
+    {
+#ifndef _DEBUG
+        if (!CreateNewConsole(1024))
+            return -1;
+#endif // !_DEBUG
+        std::wstring name = commandLine.substr(benchmarkArgument + wcslen(L"-benchmark"));
+        name.erase(0, name.find_first_not_of(L' '));
+        name.erase(name.find_last_not_of(L' ') + 1);
+        if (name.empty())
+            name = L"all";
+
+        bool result = EngineBenchmarks::Run(std::string(name.begin(), name.end()));
+        std::cout << "Press Enter to exit." << std::endl;
+        std::cin.get();
+        return result ? 0 : 1;
+    }
+
+    // Offline galaxy bake instead of the game: "-bakegalaxy <file> <radius in sectors>".
+    size_t bakeArgument = commandLine.find(L"-bakegalaxy");
+    if (bakeArgument != std::wstring::npos)
+    {
+#ifndef _DEBUG
+        if (!CreateNewConsole(1024))
+            return -1;
+#endif // !_DEBUG
+        std::wstringstream arguments(commandLine.substr(bakeArgument + wcslen(L"-bakegalaxy")));
+        std::wstring path = L"galaxy.bin";
+        int radius = 40;
+        arguments >> path >> radius;
+
+        bool result = GalaxyDatabase::Bake(GalaxySettings(), radius, std::string(path.begin(), path.end()));
+        std::cout << "Press Enter to exit." << std::endl;
+        std::cin.get();
+        return result ? 0 : 1;
+    }
+
     VoyagerEngine voyager(1500, 1000, L"Voyager Game");
     int returnCode = WindowsApplication::Run(&voyager, hInstance, nCmdShow);
 
@@ -3,6 +3,9 @@
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers.
 #endif
+#ifndef NOMINMAX
+#define NOMINMAX                        // Keep std::min and std::max usable.
+#endif
 
 // OS includes
 #include <windows.h>